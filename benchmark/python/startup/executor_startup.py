@@ -0,0 +1,107 @@
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#   http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+
+"""Benchmark the startup time of a model: loading the symbol JSON and the
+parameters, binding the executor and running the first forward pass.
+
+The phases of executor initialization inside bind are logged by MXNET_EXEC_INIT_VERBOSE_LOGGING.
+Compare MXNET_EXEC_INIT_NUM_THREADS=1 with the default to see the gain of parallel initialization.
+"""
+from __future__ import print_function
+
+import argparse
+import os
+import tempfile
+import time
+
+_parser = argparse.ArgumentParser(description='Benchmark the startup time of a model.')
+_parser.add_argument('--network', type=str, default='resnet50_v1',
+                     help='gluon model zoo network exported when --symbol is not given')
+_parser.add_argument('--symbol', type=str, default=None, help='symbol JSON file')
+_parser.add_argument('--params', type=str, default=None, help='parameter file')
+_parser.add_argument('--data-shape', type=str, default='3,224,224')
+_parser.add_argument('--batch-size', type=int, default=1)
+_parser.add_argument('--gpu', type=int, default=None)
+_parser.add_argument('--repeat', type=int, default=3, help='number of startups to average over')
+_parser.add_argument('--verbose', action='store_true',
+                     help='log the phases of executor initialization')
+args = _parser.parse_args()
+
+if args.verbose:
+    os.environ['MXNET_EXEC_INIT_VERBOSE_LOGGING'] = '1'
+
+import mxnet as mx
+
+
+def export_network(name):
+    net = mx.gluon.model_zoo.vision.get_model(name, pretrained=False)
+    net.initialize(mx.init.Xavier())
+    net.hybridize()
+    net(mx.nd.zeros((1,) + data_shape))
+    prefix = os.path.join(tempfile.mkdtemp(), name)
+    net.export(prefix)
+    return prefix + '-symbol.json', prefix + '-0000.params'
+
+
+def timed(phases, name, fn):
+    start = time.time()
+    ret = fn()
+    mx.nd.waitall()
+    phases.append((name, (time.time() - start) * 1000))
+    return ret
+
+
+def startup(symbol_file, param_file, ctx):
+    phases = []
+    sym = timed(phases, 'load symbol', lambda: mx.sym.load(symbol_file))
+    params = timed(phases, 'load params', lambda: mx.nd.load(param_file))
+    arg_params = {k[4:]: v for k, v in params.items() if k.startswith('arg:')}
+    aux_params = {k[4:]: v for k, v in params.items() if k.startswith('aux:')}
+    if not arg_params and not aux_params:
+        # parameters saved by gluon are not prefixed
+        arg_names = set(sym.list_arguments())
+        arg_params = {k: v for k, v in params.items() if k in arg_names}
+        aux_params = {k: v for k, v in params.items() if k not in arg_names}
+    data_name = [n for n in sym.list_arguments() if n not in arg_params][0]
+    shape = (args.batch_size,) + data_shape
+    exe = timed(phases, 'bind', lambda: sym.simple_bind(ctx, grad_req='null',
+                                                        **{data_name: shape}))
+    timed(phases, 'copy params',
+          lambda: exe.copy_params_from(arg_params, aux_params, allow_extra_params=True))
+    exe.arg_dict[data_name][:] = mx.nd.random.uniform(shape=shape)
+    mx.nd.waitall()
+    timed(phases, 'first forward', lambda: exe.forward(is_train=False))
+    timed(phases, 'second forward', lambda: exe.forward(is_train=False))
+    return phases
+
+
+data_shape = tuple(int(i) for i in args.data_shape.split(','))
+ctx = mx.cpu() if args.gpu is None else mx.gpu(args.gpu)
+if args.symbol is None:
+    symbol_file, param_file = export_network(args.network)
+else:
+    symbol_file, param_file = args.symbol, args.params
+
+results = [startup(symbol_file, param_file, ctx) for _ in range(args.repeat)]
+print('startup time of %s over %d runs (ms):' % (os.path.basename(symbol_file), args.repeat))
+for i, (name, _) in enumerate(results[0]):
+    times = [r[i][1] for r in results]
+    print('  %-16s first %9.2f  mean of later %9.2f' %
+          (name, times[0], sum(times[1:]) / max(len(times) - 1, 1)))
+total = [sum(t for name, t in r if name != 'second forward') for r in results]
+print('  %-16s first %9.2f  mean of later %9.2f' %
+      ('total', total[0], sum(total[1:]) / max(len(total) - 1, 1)))
@@ -85,6 +85,8 @@ typedef void *DataIterHandle;
 typedef void *KVStoreHandle;
 /*! \brief handle to RecordIO */
 typedef void *RecordIOHandle;
+/*! \brief handle to a shared memory ring */
+typedef void *ShmRingHandle;
 /*! \brief handle to MXRtc*/
 typedef void *RtcHandle;
 /*! \brief handle to rtc cuda module*/
@@ -1883,6 +1885,39 @@ MXNET_DLL int MXDataIterGetPadNum(DataIterHandle handle,
  */
 MXNET_DLL int MXDataIterGetLabel(DataIterHandle handle,
                                  NDArrayHandle *out);
+/*!
+ * \brief Open the shared memory ring created by a ShmRingIter, to push batches
+ *  to it from another process
+ * \param name name of the ring, as passed to the iterator
+ * \param out handle to the ring
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXShmRingOpen(const char *name, ShmRingHandle *out);
+/*!
+ * \brief Copy a batch into a free slot of a shared memory ring,
+ *  waiting until a slot is free
+ * \param handle handle to the ring
+ * \param num_arrays number of arrays in the batch, the data first and then the label
+ * \param arrays the arrays of the batch
+ * \param num_batch_padd number of padded instances in the batch
+ * \param out set to 1 if the batch was pushed, 0 if the iterator went away
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXShmRingPush(ShmRingHandle handle, mx_uint num_arrays,
+                            NDArrayHandle *arrays, int num_batch_padd, int *out);
+/*!
+ * \brief Mark the end of an epoch of this producer
+ * \param handle handle to the ring
+ * \param out set to 1 if the marker was pushed, 0 if the iterator went away
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXShmRingPushEndOfEpoch(ShmRingHandle handle, int *out);
+/*!
+ * \brief Close a shared memory ring opened with MXShmRingOpen
+ * \param handle handle to the ring
+ * \return 0 when success, -1 when failure happens
+ */
+MXNET_DLL int MXShmRingFree(ShmRingHandle handle);
 //--------------------------------------------
 // Part 6: basic KVStore interface
 //--------------------------------------------
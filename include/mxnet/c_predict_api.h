@@ -121,6 +121,9 @@ MXNET_DLL int MXPredCreatePartialOut(const char* symbol_json_str,
                                      PredictorHandle* out);
 /*!
  * \brief Change the input shape of an existing predictor.
+ *  The reshaped predictor shares memory with the original one and cannot be
+ *  used in parallel with it. Executors are cached by input shapes, so
+ *  reshaping back to a shape seen before does not bind the network again.
  * \param num_input_nodes Number of input nodes to the net,
  *    For feedforward net, this is 1.
  * \param input_keys The name of input argument.
@@ -519,6 +519,31 @@ class NDArray {
     return ret;
   }
 
+  /*!
+   * \brief Create an NDArray that shares memory with the current one, starting
+   *  at a byte offset. The new array has a different shape and data type and is
+   *  a view when the offset is not 0.
+   * \param byte_offset offset of the new array from the beginning of the current one.
+   * \param shape the shape of the new array.
+   * \param dtype the data type of the new array.
+   * \return NDArray in new shape and type.
+   */
+  inline NDArray AsArrayAt(size_t byte_offset, const TShape &shape, int dtype) const {
+    if (byte_offset == 0) return AsArray(shape, dtype);
+    CHECK_EQ(storage_type(), kDefaultStorage)
+             << "AsArrayAt is intended only for kDefaultStorage.";
+    CHECK_GE(ptr_->shandle.size,
+             byte_offset_ + byte_offset + shape.Size() * mshadow::mshadow_sizeof(dtype))
+        << "NDArray.AsArrayAt: target memory range is out of bounds";
+    CHECK(!IsView());
+    NDArray ret = *this;
+    ret.byte_offset_ += byte_offset;
+    ret.shape_ = shape;
+    ret.dtype_ = dtype;
+    ret.reuse_ = false;
+    return ret;
+  }
+
   /*!
    * \brief Update ndarray chunk storage handles using existing ndarray storage handles
    * Also update the aux_handle, aux_shapes and aux_types.
@@ -95,6 +95,13 @@ class Storage {
    * \param handle Handle struct.
    */
   virtual void DirectFree(Handle handle) = 0;
+  /*!
+   * \brief Release all memory cached by the memory pool of a device back to the system.
+   *  Has no effect if the device does not use a pooled storage manager.
+   *
+   * \param ctx Context of the device whose pool is released.
+   */
+  virtual void ReleaseAll(Context ctx) = 0;
   /*!
    * \brief Destructor.
    */
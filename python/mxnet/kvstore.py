@@ -429,13 +429,23 @@ class KVStore(object):
         a dictionary which includes `threshold` like:
         {'type': '2bit', 'threshold': 0.5}
 
+        `topk` compression sends, for each block of 1024 values of the gradient plus residual,
+        the `ratio` fraction of them with the largest magnitude as (index, value) pairs, and
+        keeps the others in the residual, like: {'type': 'topk', 'ratio': 0.01}.
+        `1bit` compression sends the sign of each value of the gradient plus residual and
+        the mean magnitude of each block of 1024 values, and keeps the error in the residual.
+        `fp16` compression casts the gradient to float16 and keeps no residual.
+        These three types run on CPU, so they apply to 'dist' kvstores. The 'device'
+        kvstore compresses the gradients on the GPUs and only supports `2bit`, other
+        types raise an error.
+
         Parameters
         ----------
         compression_params : dict
             A dictionary specifying the type and parameters for gradient compression.
             The key `type` in this dictionary is a
             required string argument and specifies the type of gradient compression.
-            Currently `type` can be only `2bit`
+            `type` can be `2bit`, `topk`, `1bit` or `fp16`
             Other keys in this dictionary are optional and specific to the type
             of gradient compression.
         """
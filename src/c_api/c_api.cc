@@ -44,6 +44,7 @@
 #include <functional>
 #include <utility>
 #include "./c_api_common.h"
+#include "../io/shm_ring.h"
 #include "../operator/custom/custom-inl.h"
 #include "../operator/tensor/matrix_op-inl.h"
 
@@ -776,6 +777,43 @@ int MXDataIterGetPadNum(DataIterHandle handle, int *pad) {
   API_END();
 }
 
+int MXShmRingOpen(const char *name, ShmRingHandle *out) {
+  API_BEGIN();
+  *out = new io::ShmRing(name);
+  API_END();
+}
+
+int MXShmRingPush(ShmRingHandle handle, mx_uint num_arrays,
+                  NDArrayHandle *arrays, int num_batch_padd, int *out) {
+  API_BEGIN();
+  std::vector<NDArray> cpu_arrays;
+  std::vector<TBlob> blobs;
+  for (mx_uint i = 0; i < num_arrays; ++i) {
+    const NDArray& arr = *static_cast<NDArray*>(arrays[i]);
+    CHECK_EQ(arr.storage_type(), kDefaultStorage)
+        << "MXShmRingPush only supports dense arrays";
+    cpu_arrays.push_back(arr.ctx().dev_mask() == cpu::kDevMask ? arr : arr.Copy(Context::CPU()));
+  }
+  for (NDArray& arr : cpu_arrays) {
+    arr.WaitToRead();
+    blobs.push_back(arr.data());
+  }
+  *out = static_cast<io::ShmRing*>(handle)->Push(blobs, num_batch_padd);
+  API_END();
+}
+
+int MXShmRingPushEndOfEpoch(ShmRingHandle handle, int *out) {
+  API_BEGIN();
+  *out = static_cast<io::ShmRing*>(handle)->PushEndOfEpoch();
+  API_END();
+}
+
+int MXShmRingFree(ShmRingHandle handle) {
+  API_BEGIN();
+  delete static_cast<io::ShmRing*>(handle);
+  API_END();
+}
+
 int MXKVStoreCreate(const char *type,
                     KVStoreHandle *out) {
   API_BEGIN();
@@ -28,7 +28,10 @@
 #include <mxnet/executor.h>
 #include <mxnet/ndarray.h>
 #include <nnvm/pass_functions.h>
+#include <algorithm>
 #include <memory>
+#include <mutex>
+#include <sstream>
 #include <unordered_set>
 #include <unordered_map>
 #include "./c_api_common.h"
@@ -37,6 +40,19 @@
 
 using namespace mxnet;
 
+// executors bound by a predictor and the predictors reshaped from it,
+// keyed by the shapes of the arguments
+struct MXAPIPredictorExecCache {
+  struct Entry {
+    std::shared_ptr<Executor> exec;
+    std::vector<NDArray> arg_arrays;
+    std::vector<NDArray> aux_arrays;
+  };
+  // guards entries, predictors sharing the cache may be reshaped concurrently
+  std::mutex mu;
+  std::unordered_map<std::string, Entry> entries;
+};
+
 // predictor interface
 struct MXAPIPredictor {
   // output arrays
@@ -51,8 +67,10 @@ struct MXAPIPredictor {
   std::vector<uint32_t> out_shapes_buffer;
   // key to arguments
   std::unordered_map<std::string, size_t> key2arg;
-  // executor
-  std::unique_ptr<Executor> exec;
+  // executor, shared with the predictors reshaped to the same shapes
+  std::shared_ptr<Executor> exec;
+  // cache of the executors bound for reshaping
+  std::shared_ptr<MXAPIPredictorExecCache> exec_cache;
   // symbol
   nnvm::Symbol sym;
   // Context
@@ -67,6 +85,19 @@ struct MXAPINDList {
   std::vector<mx_float> data;
 };
 
+// key of the shapes of arguments in the executor cache
+static std::string PredictorShapeKey(const std::vector<NDArray>& arg_arrays) {
+  std::ostringstream os;
+  for (const NDArray& nd : arg_arrays) os << nd.shape();
+  return os.str();
+}
+
+static std::string PredictorShapeKey(const std::vector<TShape>& arg_shapes) {
+  std::ostringstream os;
+  for (const TShape& shape : arg_shapes) os << shape;
+  return os.str();
+}
+
 int MXPredCreate(const char* symbol_json_str,
                  const void* param_bytes,
                  int param_size,
@@ -248,6 +279,9 @@ int MXPredCreatePartialOut(const char* symbol_json_str,
     ret->out_shapes = out_shapes;
     ret->out_arrays = ret->exec->outputs();
   }
+  ret->exec_cache = std::make_shared<MXAPIPredictorExecCache>();
+  ret->exec_cache->entries.emplace(PredictorShapeKey(ret->arg_arrays),
+      MXAPIPredictorExecCache::Entry{ret->exec, ret->arg_arrays, ret->aux_arrays});
   *out = ret;
   API_END_HANDLE_ERROR(delete ret);
 }
@@ -299,14 +333,11 @@ int MXPredReshape(mx_uint num_input_nodes,
     throw dmlc::Error(err.msg);
   }
 
-  ret->arg_arrays = p->arg_arrays;
   ret->ctx = p->ctx;
   for (size_t i=0; i < arg_names.size(); ++i) {
     TShape newShape = arg_shapes[i];
     NDArray &arr = p->arg_arrays[i];
-    if (new_shape.count(arg_names[i]) != 0) {
-      ret->arg_arrays[i].ReshapeAndAlloc(newShape);
-    } else {
+    if (new_shape.count(arg_names[i]) == 0) {
        CHECK_EQ(newShape.Size(), arr.shape().Size())
         << "arg " << arg_names[i]
         << " shape has been changed, only allow to change the shape of input data.";
@@ -320,23 +351,36 @@ int MXPredReshape(mx_uint num_input_nodes,
       << "aux " << aux_names[i]
       << " shape has been changed, only allow to change the shape of input data.";
   }
-  ret->aux_arrays = p->aux_arrays;
 
-  // bind
+  // reuse the executor bound for the same shapes, otherwise reshape the
+  // executor, which reuses its memory plan if the new shapes fit in it
+  ret->exec_cache = p->exec_cache;
+  MXAPIPredictorExecCache* cache = ret->exec_cache.get();
+  const std::string key = PredictorShapeKey(arg_shapes);
   {
+    std::lock_guard<std::mutex> lock(cache->mu);
+    auto it = cache->entries.find(key);
+    if (it != cache->entries.end()) {
+      ret->exec = it->second.exec;
+      ret->arg_arrays = it->second.arg_arrays;
+      ret->aux_arrays = it->second.aux_arrays;
+    }
+  }
+  if (ret->exec == nullptr) {
     std::map<std::string, Context> ctx_map;
     std::vector<NDArray> grad_store;
-    grad_store.reserve(ret->arg_arrays.size());
-    std::vector<OpReqType> grad_req(ret->arg_arrays.size(), kNullOp);
-
-    ret->exec.reset(Executor::Bind(ret->sym, ret->ctx, ctx_map,
-                                   ret->arg_arrays,
-                                   grad_store, grad_req,
-                                   ret->aux_arrays,
-                                   p->exec.get()));
-    ret->out_shapes = out_shapes;
-    ret->out_arrays = ret->exec->outputs();
+    ret->exec.reset(p->exec->Reshape(true, true, ret->ctx, ctx_map, new_shape,
+                                     &ret->arg_arrays, &grad_store, &ret->aux_arrays));
+    static const size_t max_cache_size =
+        std::max(dmlc::GetEnv("MXNET_PREDICTOR_RESHAPE_CACHE_SIZE", 16), 0);
+    std::lock_guard<std::mutex> lock(cache->mu);
+    if (cache->entries.size() < max_cache_size) {
+      cache->entries.emplace(key,
+          MXAPIPredictorExecCache::Entry{ret->exec, ret->arg_arrays, ret->aux_arrays});
+    }
   }
+  ret->out_shapes = out_shapes;
+  ret->out_arrays = ret->exec->outputs();
   *out = ret.release();
   API_END();
 }
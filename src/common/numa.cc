@@ -0,0 +1,133 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file numa.cc
+ * \brief NUMA topology discovery and thread/memory placement on CPU.
+ */
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include "./numa.h"
+
+#if defined(__linux__)
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif  // defined(__linux__)
+
+namespace mxnet {
+namespace common {
+
+#if defined(__linux__)
+namespace {
+// memory policy from linux/mempolicy.h, to avoid a dependency on libnuma
+constexpr int kMPolPreferred = 1;
+constexpr unsigned kMPolMFMove = 1 << 1;
+
+/*!
+ * \brief Parse a kernel cpu/node list such as "0-3,8-11"
+ */
+std::vector<int> ParseSysfsList(const std::string& path) {
+  std::vector<int> ret;
+  std::ifstream is(path);
+  std::string list;
+  if (!is || !std::getline(is, list)) return ret;
+  std::stringstream ss(list);
+  std::string range;
+  while (std::getline(ss, range, ',')) {
+    if (range.empty()) continue;
+    size_t dash = range.find('-');
+    int begin = std::stoi(range.substr(0, dash));
+    int end = dash == std::string::npos ? begin : std::stoi(range.substr(dash + 1));
+    for (int i = begin; i <= end; ++i) ret.push_back(i);
+  }
+  return ret;
+}
+}  // namespace
+#endif  // defined(__linux__)
+
+NUMATopology *NUMATopology::Get() {
+  static NUMATopology topology;
+  return &topology;
+}
+
+NUMATopology::NUMATopology() {
+#if defined(__linux__)
+  for (int id : ParseSysfsList("/sys/devices/system/node/online")) {
+    std::vector<int> cpus = ParseSysfsList(
+        "/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+    // memory-only nodes cannot host workers
+    if (cpus.empty()) continue;
+    node_ids_.push_back(id);
+    node_cpus_.push_back(cpus);
+  }
+#endif  // defined(__linux__)
+  if (node_cpus_.empty()) {
+    // unknown topology, treat the host as a single node
+    node_ids_.push_back(0);
+    node_cpus_.emplace_back();
+  }
+  enabled_ = dmlc::GetEnv("MXNET_USE_NUMA", false) && node_cpus_.size() > 1;
+  if (enabled_) {
+    LOG(INFO) << "NUMA-aware placement enabled on " << node_cpus_.size() << " nodes.";
+  }
+}
+
+bool NUMATopology::BindThread(int node) const {
+#if defined(__linux__)
+  const std::vector<int>& cpus = node_cpus(node);
+  if (cpus.empty()) return false;
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  for (int cpu : cpus) CPU_SET(cpu, &mask);
+  if (sched_setaffinity(0, sizeof(mask), &mask) != 0) {
+    LOG(WARNING) << "Failed to bind thread to NUMA node " << node_ids_[node];
+    return false;
+  }
+  return true;
+#else
+  return false;
+#endif  // defined(__linux__)
+}
+
+void NUMATopology::BindMemory(void *ptr, size_t size, int node) const {
+#if defined(__linux__) && defined(SYS_mbind)
+  // mbind works on whole pages, only the pages fully inside the range are placed
+  const uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+  const uintptr_t begin = (reinterpret_cast<uintptr_t>(ptr) + page - 1) & ~(page - 1);
+  const uintptr_t end = (reinterpret_cast<uintptr_t>(ptr) + size) & ~(page - 1);
+  if (end <= begin) return;
+  const int id = node_ids_.at(node);
+  const size_t bits = 8 * sizeof(unsigned long);  // NOLINT(*)
+  std::vector<unsigned long> nodemask(id / bits + 1, 0);  // NOLINT(*)
+  nodemask[id / bits] |= 1ul << (id % bits);
+  // pages the allocator already touched (e.g. recycled heap memory) are migrated;
+  // placement is a hint, failures (e.g. restricted cpusets) are not fatal
+  syscall(SYS_mbind, begin, end - begin, kMPolPreferred, nodemask.data(),
+          nodemask.size() * bits + 1, kMPolMFMove);
+#endif  // defined(__linux__) && defined(SYS_mbind)
+}
+
+}  // namespace common
+}  // namespace mxnet
@@ -0,0 +1,102 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file numa.h
+ * \brief NUMA topology discovery and thread/memory placement on CPU.
+ */
+#ifndef MXNET_COMMON_NUMA_H_
+#define MXNET_COMMON_NUMA_H_
+
+#include <mxnet/base.h>
+#include <vector>
+
+namespace mxnet {
+namespace common {
+
+/*!
+ * \brief NUMA topology of the host and placement helpers.
+ *
+ *  When MXNET_USE_NUMA is set, every CPU context is served by the NUMA node
+ *  dev_id % num_nodes(): its storage comes from a per-node memory arena and its
+ *  engine workers, together with their OpenMP threads, are pinned to the cores of
+ *  that node. Running one executor per socket on cpu(0), cpu(1), ... then keeps both
+ *  data and compute local to a node.
+ *
+ *  Only Linux is supported; on other platforms the host is reported as a single node
+ *  and placement requests are no-ops.
+ */
+class NUMATopology {
+ public:
+  /*!
+   * \brief Get the NUMATopology singleton
+   * \return Singleton NUMATopology pointer
+   */
+  static NUMATopology *Get();
+  /*!
+   * \brief Whether NUMA-aware placement is requested and there is more than one node
+   */
+  bool enabled() const { return enabled_; }
+  /*!
+   * \brief Number of NUMA nodes on this host
+   */
+  int num_nodes() const { return static_cast<int>(node_cpus_.size()); }
+  /*!
+   * \brief Logical CPUs belonging to a node
+   * \param node Node index, between 0 and num_nodes() - 1
+   */
+  const std::vector<int>& node_cpus(int node) const { return node_cpus_.at(node); }
+  /*!
+   * \brief NUMA node which serves a CPU context
+   * \param ctx The context, must be a CPU context
+   */
+  int NodeOf(const Context& ctx) const {
+    return ctx.dev_id % num_nodes();
+  }
+  /*!
+   * \brief Restrict the calling thread to the CPUs of a node
+   * \param node Node index
+   * \return Whether the affinity was applied
+   */
+  bool BindThread(int node) const;
+  /*!
+   * \brief Prefer a node for the pages backing a memory range. Untouched pages are
+   *  placed on first touch; pages already present are migrated, which is expensive, so
+   *  this should be called right after allocation.
+   * \param ptr Start of the range
+   * \param size Size of the range in bytes
+   * \param node Node index
+   */
+  void BindMemory(void *ptr, size_t size, int node) const;
+
+ private:
+  NUMATopology();
+  /*! \brief Whether NUMA-aware placement is enabled */
+  bool enabled_ = false;
+  /*! \brief Logical CPUs of each node, indexed by node */
+  std::vector<std::vector<int>> node_cpus_;
+  /*! \brief Id of each node as known to the kernel, indexed by node */
+  std::vector<int> node_ids_;
+};
+
+}  // namespace common
+}  // namespace mxnet
+
+#endif  // MXNET_COMMON_NUMA_H_
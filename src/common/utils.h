@@ -44,6 +44,7 @@
 #include <algorithm>
 #include <functional>
 #include <limits>
+#include <exception>
 
 #include "../operator/mxnet_op.h"
 #if MXNET_USE_MKLDNN == 1
@@ -491,6 +492,39 @@ inline int GetExecNumMatchColor() {
   return std::min(num_match_color, GetNumThreadsPerGPU());
 }
 
+// number of threads to initialize the nodes of an executor.
+// small graphs are initialized serially.
+inline int GetExecInitNumThreads(size_t num_nodes) {
+  static const int num_threads = dmlc::GetEnv("MXNET_EXEC_INIT_NUM_THREADS",
+      engine::OpenMP::Get()->GetRecommendedOMPThreadCount());
+  return num_nodes < 256 ? 1 : std::max(num_threads, 1);
+}
+
+/*!
+ * \brief Run fn(i) for each i in [0, n) on num_threads OpenMP threads.
+ *  The first exception thrown by fn is rethrown on the calling thread.
+ */
+template<typename FFunc>
+void ParallelFor(size_t n, int num_threads, FFunc fn) {
+  if (num_threads <= 1 || n <= 1) {
+    for (size_t i = 0; i < n; ++i) fn(i);
+    return;
+  }
+  std::exception_ptr exception = nullptr;
+  #pragma omp parallel for num_threads(num_threads) schedule(dynamic, 16)
+  for (int64_t i = 0; i < static_cast<int64_t>(n); ++i) {
+    try {
+      fn(static_cast<size_t>(i));
+    } catch (...) {
+      #pragma omp critical
+      {
+        if (exception == nullptr) exception = std::current_exception();
+      }
+    }
+  }
+  if (exception != nullptr) std::rethrow_exception(exception);
+}
+
 template<typename T, typename V>
 V ParallelAccumulate(const T* a, const int n, V start) {
   V sum = start;
@@ -713,6 +747,38 @@ inline void EmplaceBackZeros(const NDArrayStorageType stype, const TShape &shape
   }
 }
 
+/*!
+ * \brief Helper to add a NDArray of zeros to a std::vector, deferring the
+ *  allocation of default storage to AllocZeros.
+ */
+inline void EmplaceBackDelayedZeros(const NDArrayStorageType stype, const TShape &shape,
+                                    const Context &ctx, const int dtype,
+                                    std::vector<NDArray> *vec,
+                                    std::vector<NDArray> *delayed) {
+  if (stype == kDefaultStorage) {
+    vec->emplace_back(shape, ctx, true, dtype);
+    delayed->push_back(vec->back());
+  } else {
+    // NDArray with non-default storage. Storage allocation is always delayed.
+    vec->emplace_back(stype, shape, ctx, true, dtype);
+  }
+}
+
+/*!
+ * \brief Allocate the arrays added by EmplaceBackDelayedZeros, in parallel
+ *  on CPU, and fill them with zeros. All arrays are allocated before the fill
+ *  is pushed, so that no allocation happens inside engine operations.
+ */
+inline void AllocZeros(const std::vector<NDArray>& delayed, int num_threads) {
+  ParallelFor(delayed.size(), num_threads, [&delayed](size_t i) {
+    if (delayed[i].ctx().dev_mask() == cpu::kDevMask) delayed[i].CheckAndAlloc();
+  });
+  for (const NDArray& nd : delayed) {
+    if (nd.ctx().dev_mask() != cpu::kDevMask) nd.CheckAndAlloc();
+  }
+  for (NDArray nd : delayed) nd = 0;
+}
+
 }  // namespace common
 }  // namespace mxnet
 #endif  // MXNET_COMMON_UTILS_H_
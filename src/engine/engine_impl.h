@@ -95,6 +95,8 @@ Engine *CreateNaiveEngine();
 Engine *CreateThreadedEnginePooled();
 /*! \return ThreadedEnginePerDevie instance */
 Engine *CreateThreadedEnginePerDevice();
+/*! \return ThreadedEngineWorkStealing instance */
+Engine *CreateThreadedEngineWorkStealing();
 #endif
 }  // namespace engine
 }  // namespace mxnet
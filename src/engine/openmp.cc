@@ -20,7 +20,9 @@
 #include <dmlc/base.h>
 #include <dmlc/parameter.h>
 #include <climits>
+#include <algorithm>
 #include "./openmp.h"
+#include "../common/numa.h"
 
 namespace mxnet {
 namespace engine {
@@ -69,6 +71,23 @@ void OpenMP::on_start_worker_thread(bool use_omp) {
 #endif
 }
 
+void OpenMP::on_start_numa_worker_thread(int numa_node) {
+  const common::NUMATopology *topology = common::NUMATopology::Get();
+  // threads created from here on, including the omp team of this thread, inherit the mask
+  topology->BindThread(numa_node);
+#ifdef _OPENMP
+  if (!omp_num_threads_set_in_environment_) {
+    const int nthreads = std::max(1, GetRecommendedOMPThreadCount(true) / topology->num_nodes());
+    omp_set_num_threads(nthreads);
+  }
+  // OMP runtimes may have created their team before the mask was set; pin it explicitly
+  #pragma omp parallel
+  {
+    topology->BindThread(numa_node);
+  }
+#endif
+}
+
 void OpenMP::set_reserve_cores(int cores) {
   CHECK_GE(cores, 0);
   reserve_cores_ = cores;
@@ -74,6 +74,14 @@ class OpenMP {
    */
   void on_start_worker_thread(bool use_omp);
 
+  /*!
+   * \brief Call at the beginning of a worker thread's life which serves a single NUMA node.
+   *        Pins this thread and the threads of its omp regions to the cores of the node,
+   *        and sizes its omp regions to the node's share of the cores
+   * \param numa_node Index of the node in common::NUMATopology
+   */
+  void on_start_numa_worker_thread(int numa_node);
+
   /*!
    * \brief Get the OpenMP object's singleton pointer
    * \return Singleton OpenMP object pointer
@@ -30,6 +30,9 @@
 #include <dmlc/base.h>
 #include <dmlc/logging.h>
 #include <dmlc/omp.h>
+#include <algorithm>
+#include <cassert>
+#include <memory>
 #include <vector>
 #include <functional>
 #include <condition_variable>
@@ -108,9 +111,35 @@ struct VersionedVarBlock
   DEFINE_ENGINE_DEBUG_INFO(VersionedVarBlock);
 };  // struct VersionedVarBlock
 
+/*!
+ * \brief Minimal spin lock for very short critical sections in the engine.
+ *  Satisfies BasicLockable, so it can be used with std::lock_guard.
+ */
+class SpinLock {
+ public:
+  inline void lock() {
+    while (flag_.test_and_set(std::memory_order_acquire)) {
+      std::this_thread::yield();
+    }
+  }
+  inline void unlock() {
+    flag_.clear(std::memory_order_release);
+  }
+
+ private:
+  std::atomic_flag flag_ = ATOMIC_FLAG_INIT;
+};  // class SpinLock
+
 /*!
  * \brief Variable implementation.
  *  Each ThreadedVar is a linked list(queue) of operations to be performed.
+ *
+ *  The number of running reads and whether a write is pending are kept in one
+ *  atomic word. Appending a read while no write is pending and completing a read
+ *  are single compare-and-swap operations; only operations that have to wait, and
+ *  writes, mutate the queue under a spin lock. A read that completes and finds
+ *  itself last before a pending write triggers that write in the same
+ *  compare-and-swap, so readers and writers keep their order on the queue.
  */
 class ThreadedVar final
     : public Var, public common::ObjectPoolAllocatable<ThreadedVar> {
@@ -179,15 +208,20 @@ class ThreadedVar final
   std::shared_ptr<std::exception_ptr> var_exception;
 
  private:
-  // TODO(hotpxl) change this to spinlock for faster runtime
   // TODO(hotpxl) consider rename head
-  /*! \brief inetrnal mutex of the ThreadedVar */
-  std::mutex mutex_;
   /*!
-   * \brief number of pending reads operation in the variable.
-   *  will be marked as -1 when there is a already triggered pending write.
+   * \brief internal lock of the ThreadedVar.
+   *  Only needed to mutate the queue, reads that can run right away
+   *  and completion of reads never take it.
+   */
+  SpinLock lock_;
+  /*!
+   * \brief packed dependency state, see the k* constants below.
+   *  The low bits hold the number of pending read operations, or kWriteTriggered
+   *  when there is a already triggered pending write.
+   *  kWritePending is set iff pending_write_ != nullptr.
    */
-  int num_pending_reads_{0};
+  std::atomic<int> state_{0};
   /*!
    * \brief Points to the last VersionedVarBlock in the queue.
    *  head_ always points to a empty VersionedVarBlock.
@@ -207,17 +241,191 @@ class ThreadedVar final
    * \brief If true, delete after operation completes.
    */
   bool to_delete_{false};
-  /*! \brief special const on num_pending_reads_ to mark write being triggered */
-  static constexpr int kWriteTriggered = -1;
+  /*! \brief flag in state_ marking that a write is waiting or running */
+  static constexpr int kWritePending = 1 << 30;
+  /*! \brief mask of the read count in state_ */
+  static constexpr int kReadMask = kWritePending - 1;
+  /*! \brief special read count in state_ to mark write being triggered */
+  static constexpr int kWriteTriggered = kReadMask;
   /*!
    * \brief derived invariant of ready to ready, without lock.
    * \return whether the current variable is ready to read.
    */
   inline bool is_ready_to_read() const {
-    return pending_write_ == nullptr;
+    return (state_.load(std::memory_order_acquire) & kWritePending) == 0;
   }
 };  // struct ThreadedVar
 
+inline void ThreadedVar::AppendReadDependency(OprBlock* opr_block) {
+  // fast path: no write is pending, join the running reads
+  int state = state_.load(std::memory_order_acquire);
+  while ((state & kWritePending) == 0) {
+    if (state_.compare_exchange_weak(state, state + 1, std::memory_order_acq_rel)) {
+      // decrease wait counter
+      opr_block->decr_wait();
+      return;
+    }
+  }
+  auto&& new_var_block = VersionedVarBlock::New();
+  std::lock_guard<SpinLock> lock{lock_};
+  // kWritePending only changes under the lock, the read count may still
+  // drop concurrently from completing reads.
+  state = state_.load(std::memory_order_acquire);
+  while ((state & kWritePending) == 0) {
+    // the pending write completed while we were taking the lock
+    // invariant: is_ready_to_read()
+    if (state_.compare_exchange_weak(state, state + 1, std::memory_order_acq_rel)) {
+      VersionedVarBlock::Delete(new_var_block);
+      opr_block->decr_wait();
+      return;
+    }
+  }
+  assert(head_->next == nullptr);
+  assert(head_->trigger == nullptr);
+  assert(head_->write == false);
+  // append things to next.
+  head_->next = new_var_block;
+  head_->trigger = opr_block;
+  head_ = new_var_block;
+}
+
+inline void ThreadedVar::AppendWriteDependency(OprBlock* opr_block) {
+  auto&& new_var_block = VersionedVarBlock::New();
+  std::lock_guard<SpinLock> lock{lock_};
+  // invariant.
+  assert(head_->next == nullptr);
+  assert(head_->trigger == nullptr);
+  assert(head_->write == false);
+  // attach to head.
+  head_->next = new_var_block;
+  head_->trigger = opr_block;
+  head_->write = true;
+
+  // check if it is ready to write
+  if (pending_write_ == nullptr) {
+    // invariant: is_ready_to_read()
+    // publish pending_write_ before kWritePending, completing reads read it.
+    pending_write_ = head_;
+    int state = state_.load(std::memory_order_acquire);
+    int next_state;
+    do {
+      CHECK_EQ(state & kWritePending, 0);
+      next_state = (state & kReadMask) == 0 ? (kWritePending | kWriteTriggered)
+                                            : (kWritePending | state);
+    } while (!state_.compare_exchange_weak(state, next_state, std::memory_order_acq_rel));
+    if ((state & kReadMask) == 0) {
+      // STATE CHANGE
+      opr_block->decr_wait();
+    }
+  } else {
+    CHECK_NE(state_.load(std::memory_order_relaxed) & kReadMask, 0);
+  }
+  head_ = new_var_block;
+}
+
+template <typename Dispatcher>
+inline void ThreadedVar::CompleteReadDependency(Dispatcher dispatcher) {
+  int state = state_.load(std::memory_order_acquire);
+  int next_state;
+  do {
+    const int num_reads = state & kReadMask;
+    CHECK(num_reads > 0 && num_reads != kWriteTriggered);
+    // the last read before a pending write triggers it
+    next_state = (num_reads == 1 && (state & kWritePending)) ?
+        (kWritePending | kWriteTriggered) : state - 1;
+  } while (!state_.compare_exchange_weak(state, next_state, std::memory_order_acq_rel));
+  if (next_state == (kWritePending | kWriteTriggered)) {
+    // STATE CHANGE
+    // pending_write_ can only move once its write completes, which is after this trigger.
+    OprBlock *trigger = pending_write_->trigger;
+    if (trigger->decr_wait() == 0) {
+      dispatcher(trigger);
+    }
+  }
+}
+
+template <typename Dispatcher>
+inline bool ThreadedVar::CompleteWriteDependency(Dispatcher dispatcher) {
+  // this is lock scope
+  VersionedVarBlock *old_pending_write, *end_of_read_chain;
+  OprBlock* trigger_write = nullptr;
+  {
+    std::lock_guard<SpinLock> lock{lock_};
+    // invariants
+    assert(head_->next == nullptr);
+    assert(pending_write_ != nullptr);
+    CHECK_EQ(state_.load(std::memory_order_acquire), kWritePending | kWriteTriggered);
+
+    // really delete
+    if (to_delete_) {
+      VersionedVarBlock *head = pending_write_->next;
+      VersionedVarBlock::Delete(pending_write_);
+      assert(head_ == head);
+      VersionedVarBlock::Delete(head);
+      return true;
+    }
+    // detach pending write
+    old_pending_write = pending_write_;
+    // search for chains to trigger
+    end_of_read_chain = old_pending_write->next;
+    // count the reads released by this write
+    int num_pending_reads = 0;
+    while (end_of_read_chain != head_ &&
+           end_of_read_chain->write == false) {
+      ++num_pending_reads;
+      end_of_read_chain = end_of_read_chain->next;
+    }
+    // nothing else touches state_ while a write is triggered: new reads queue
+    // up behind the lock and there are no running reads to complete.
+    if (end_of_read_chain == head_) {
+      pending_write_ = nullptr;
+      state_.store(num_pending_reads, std::memory_order_release);
+    } else {
+      // check if there is pending reads, if not trigger write
+      assert(end_of_read_chain->write == true);
+      pending_write_ = end_of_read_chain;
+      if (num_pending_reads == 0) {
+        // mark write as already activated in this var
+        state_.store(kWritePending | kWriteTriggered, std::memory_order_release);
+        trigger_write = end_of_read_chain->trigger;
+      } else {
+        state_.store(kWritePending | num_pending_reads, std::memory_order_release);
+      }
+    }
+  }
+  // This is outside of lock scope
+  // Be very carful, pending_write_ and state_
+  // can change now, do not reply ont the two variables.
+  // The linked list \in [old_pending_write, end_of_read_chain)
+  // is already detached from this Var.
+  // So it is safe to modify these
+  VersionedVarBlock *cur_head = old_pending_write->next;
+  VersionedVarBlock::Delete(old_pending_write);
+  // dispatch all the events
+  while (cur_head != end_of_read_chain) {
+    if (cur_head->trigger->decr_wait() == 0) {
+      dispatcher(cur_head->trigger);
+    }
+    auto prev = cur_head;
+    cur_head = cur_head->next;
+    assert(cur_head != nullptr);
+    VersionedVarBlock::Delete(prev);
+  }
+  if (trigger_write != nullptr && trigger_write->decr_wait() == 0) {
+    dispatcher(trigger_write);
+  }
+  return false;
+}
+
+inline void ThreadedVar::SetToDelete() {
+  std::lock_guard<SpinLock> lock{lock_};
+  to_delete_ = true;
+}
+
+inline bool ThreadedVar::ready_to_read() {
+  return this->is_ready_to_read();
+}
+
 /*!
  * \brief Operator used in ThreadedEngine.
  */
@@ -299,6 +507,7 @@ class ThreadedEngine : public Engine {
 
   ThreadedEngine() {
     engine_info_ = dmlc::GetEnv("MXNET_ENGINE_INFO", false);
+    bulk_parallel_min_ops_ = dmlc::GetEnv("MXNET_EXEC_BULK_PARALLEL_MIN_OPS", 4);
 
     objpool_opr_ref_    = common::ObjectPool<ThreadedOpr>::_GetSharedRef();
     objpool_blk_ref_    = common::ObjectPool<OprBlock>::_GetSharedRef();
@@ -401,25 +610,50 @@ class ThreadedEngine : public Engine {
   int set_bulk_size(int bulk_size) override {
     BulkStatus& bulk_status = *BulkStatusStore::Get();
     std::swap(bulk_status.bulk_size, bulk_size);
-    if (bulk_status.count >= bulk_status.bulk_size) BulkFlush();
+    if (static_cast<int>(bulk_status.ops.size()) >= bulk_status.bulk_size) BulkFlush();
     return bulk_size;
   }
 
  private:
+  /*! \brief an operation recorded in the current bulk */
+  struct BulkOp {
+    /*! \brief the function of the operation */
+    SyncFn fn;
+    /*! \brief offset of the operation's variables in BulkStatus::vars */
+    size_t var_begin;
+    /*! \brief number of constant variables, stored first */
+    size_t num_const;
+    /*! \brief number of mutable variables, stored after the constant ones */
+    size_t num_mutable;
+    /*! \brief parent in the forest of dependent operations, itself for a root */
+    int group;
+    /*! \brief number of operations in the group, only valid on the root */
+    int group_size;
+  };
+  /*! \brief accesses of the current bulk to a variable */
+  struct BulkVarAccess {
+    /*! \brief the variable */
+    VarHandle var;
+    /*! \brief last operation writing the variable, -1 for none */
+    int last_write;
+    /*! \brief operations reading the variable since the last write */
+    std::vector<int> reads;
+  };
   /*! \brief structure for holding bulk execution status */
   struct BulkStatus {
     /*! \brief maximum number of ops per bulk */
     int bulk_size = 0;
-    /*! \brief current number of ops in bulk */
-    int count = 0;
     /*! \brief context of current ops */
     Context ctx;
-    /*! \brief current op functions */
-    SyncFn fn;
-    /*! \brief constant variables */
-    std::vector<VarHandle> const_vars;
-    /*! \brief mutable variables */
-    std::vector<VarHandle> mutable_vars;
+    /*! \brief current ops, in push order */
+    std::vector<BulkOp> ops;
+    /*! \brief variables of the current ops, see BulkOp::var_begin */
+    std::vector<VarHandle> vars;
+    /*! \brief accessed variables, only the first num_accesses entries are valid */
+    std::vector<BulkVarAccess> accesses;
+    size_t num_accesses = 0;
+    /*! \brief scratch space for BulkAppend and BulkFlush */
+    std::vector<int> scratch;
   };
   /*! thread local store for bulk */
   typedef dmlc::ThreadLocalStore<BulkStatus> BulkStatusStore;
@@ -465,45 +699,159 @@ class ThreadedEngine : public Engine {
   }
 
   static void OnCompleteStatic(Engine *engine, void *threaded_opr);
-  /*! \brief append an operator to bulk */
+  /*! \brief group of an op in the current bulk */
+  static inline int BulkGroup(BulkStatus *bulk_status, int op) {
+    std::vector<BulkOp>& ops = bulk_status->ops;
+    while (ops[op].group != op) {
+      ops[op].group = ops[ops[op].group].group;
+      op = ops[op].group;
+    }
+    return op;
+  }
+  /*! \brief accesses of the current bulk to a variable, nullptr if none yet */
+  static inline BulkVarAccess* BulkFindAccess(BulkStatus *bulk_status, VarHandle var) {
+    for (size_t i = 0; i < bulk_status->num_accesses; ++i) {
+      if (bulk_status->accesses[i].var == var) return &bulk_status->accesses[i];
+    }
+    return nullptr;
+  }
+  /*! \brief accesses of the current bulk to a variable, created if needed */
+  static inline BulkVarAccess* BulkGetAccess(BulkStatus *bulk_status, VarHandle var) {
+    BulkVarAccess *access = BulkFindAccess(bulk_status, var);
+    if (access != nullptr) return access;
+    if (bulk_status->num_accesses == bulk_status->accesses.size()) {
+      bulk_status->accesses.emplace_back();
+    }
+    access = &bulk_status->accesses[bulk_status->num_accesses++];
+    access->var = var;
+    access->last_write = -1;
+    access->reads.clear();
+    return access;
+  }
+  /*!
+   * \brief append an operator to bulk.
+   *
+   *  Ops of a bulk are grouped by their dependencies on each other: an op joins
+   *  the groups of the ops whose writes it reads, or whose reads and writes it
+   *  overwrites. On flush every group of at least bulk_parallel_min_ops_ ops becomes
+   *  an engine op of its own, so that independent chains run in parallel on the
+   *  worker threads, and the remaining small groups share a single engine op.
+   *
+   *  Besides reaching bulk_size ops, a bulk is flushed when an incoming op would
+   *  merge two or more groups which are large enough to run on their own.
+   */
   inline void BulkAppend(SyncFn exec_fn, Context exec_ctx,
                          std::vector<VarHandle> const& const_vars,
                          std::vector<VarHandle> const& mutable_vars) {
     BulkStatus& bulk_status = *BulkStatusStore::Get();
-    if (!bulk_status.count) {
+    if (bulk_status.ops.empty()) {
       bulk_status.ctx = exec_ctx;
-      bulk_status.fn = std::move(exec_fn);
-    } else {
-      auto prev_fn = std::move(bulk_status.fn);
-      bulk_status.fn = [exec_fn, prev_fn](RunContext rctx) {
-          prev_fn(rctx);
-          exec_fn(rctx);
-        };
+      if (bulk_status.ops.capacity() < static_cast<size_t>(bulk_status.bulk_size)) {
+        bulk_status.ops.reserve(bulk_status.bulk_size);
+      }
+    }
+    // collect the groups this op depends on
+    std::vector<int>& deps = bulk_status.scratch;
+    deps.clear();
+    for (auto var : const_vars) {
+      const BulkVarAccess *access = BulkFindAccess(&bulk_status, var);
+      if (access && access->last_write >= 0) {
+        deps.push_back(BulkGroup(&bulk_status, access->last_write));
+      }
+    }
+    for (auto var : mutable_vars) {
+      const BulkVarAccess *access = BulkFindAccess(&bulk_status, var);
+      if (!access) continue;
+      if (access->last_write >= 0) deps.push_back(BulkGroup(&bulk_status, access->last_write));
+      for (int read : access->reads) deps.push_back(BulkGroup(&bulk_status, read));
+    }
+    std::sort(deps.begin(), deps.end());
+    deps.resize(std::unique(deps.begin(), deps.end()) - deps.begin());
+    if (deps.size() >= 2) {
+      int num_large = 0;
+      for (int group : deps) {
+        if (bulk_status.ops[group].group_size >= bulk_parallel_min_ops_) ++num_large;
+      }
+      if (num_large >= 2) {
+        // let the independent chains run before they are joined
+        BulkFlush();
+        BulkAppend(std::move(exec_fn), exec_ctx, const_vars, mutable_vars);
+        return;
+      }
+    }
+    // record the op and merge the groups it depends on
+    const int op = static_cast<int>(bulk_status.ops.size());
+    bulk_status.ops.push_back(BulkOp{std::move(exec_fn), bulk_status.vars.size(),
+                                     const_vars.size(), mutable_vars.size(), op, 1});
+    bulk_status.vars.insert(bulk_status.vars.end(), const_vars.begin(), const_vars.end());
+    bulk_status.vars.insert(bulk_status.vars.end(), mutable_vars.begin(), mutable_vars.end());
+    int root = op;
+    for (int group : deps) {
+      BulkOp& large = bulk_status.ops[root].group_size >= bulk_status.ops[group].group_size ?
+          bulk_status.ops[root] : bulk_status.ops[group];
+      BulkOp& small = &large == &bulk_status.ops[root] ?
+          bulk_status.ops[group] : bulk_status.ops[root];
+      small.group = large.group;
+      large.group_size += small.group_size;
+      root = large.group;
+    }
+    for (auto var : const_vars) {
+      BulkGetAccess(&bulk_status, var)->reads.push_back(op);
+    }
+    for (auto var : mutable_vars) {
+      BulkVarAccess *access = BulkGetAccess(&bulk_status, var);
+      access->last_write = op;
+      access->reads.clear();
     }
 
-    ++bulk_status.count;
-    bulk_status.const_vars.insert(
-        bulk_status.const_vars.end(), const_vars.begin(), const_vars.end());
-    bulk_status.mutable_vars.insert(
-        bulk_status.mutable_vars.end(), mutable_vars.begin(), mutable_vars.end());
-
-    if (bulk_status.count >= bulk_status.bulk_size) BulkFlush();
+    if (static_cast<int>(bulk_status.ops.size()) >= bulk_status.bulk_size) BulkFlush();
   }
   /*! \brief flush current bulk to execution */
   inline void BulkFlush() {
     BulkStatus& bulk_status = *BulkStatusStore::Get();
-    if (!bulk_status.count) return;
-    bulk_status.count = 0;
-    DeduplicateVarHandle(&bulk_status.const_vars, &bulk_status.mutable_vars);
-    SyncFn fn = std::move(bulk_status.fn);
-    this->PushAsync([fn](RunContext ctx, CallbackOnComplete on_complete) {
-        fn(ctx);
-        on_complete();
-      }, bulk_status.ctx, bulk_status.const_vars, bulk_status.mutable_vars,
-      FnProperty::kNormal, 0, "ImperativeBulk");
-
-    bulk_status.const_vars.clear();
-    bulk_status.mutable_vars.clear();
+    if (bulk_status.ops.empty()) return;
+    const int num_ops = static_cast<int>(bulk_status.ops.size());
+    // assign every group to an engine op, small groups share one
+    std::vector<int>& slot_of_group = bulk_status.scratch;
+    slot_of_group.assign(num_ops, -1);
+    int num_slots = 0, shared_slot = -1;
+    for (int i = 0; i < num_ops; ++i) {
+      const int group = BulkGroup(&bulk_status, i);
+      if (slot_of_group[group] >= 0) continue;
+      if (bulk_status.ops[group].group_size >= bulk_parallel_min_ops_) {
+        slot_of_group[group] = num_slots++;
+      } else {
+        if (shared_slot < 0) shared_slot = num_slots++;
+        slot_of_group[group] = shared_slot;
+      }
+    }
+    std::vector<std::shared_ptr<std::vector<SyncFn>>> fns(num_slots);
+    std::vector<std::vector<VarHandle>> const_vars(num_slots), mutable_vars(num_slots);
+    for (int i = 0; i < num_slots; ++i) {
+      fns[i] = std::make_shared<std::vector<SyncFn>>();
+    }
+    for (int i = 0; i < num_ops; ++i) {
+      BulkOp& op = bulk_status.ops[i];
+      const int slot = slot_of_group[BulkGroup(&bulk_status, i)];
+      fns[slot]->push_back(std::move(op.fn));
+      auto vbegin = bulk_status.vars.begin() + op.var_begin;
+      const_vars[slot].insert(const_vars[slot].end(), vbegin, vbegin + op.num_const);
+      mutable_vars[slot].insert(mutable_vars[slot].end(), vbegin + op.num_const,
+                                vbegin + op.num_const + op.num_mutable);
+    }
+    const Context ctx = bulk_status.ctx;
+    bulk_status.ops.clear();
+    bulk_status.vars.clear();
+    bulk_status.num_accesses = 0;
+    for (int i = 0; i < num_slots; ++i) {
+      DeduplicateVarHandle(&const_vars[i], &mutable_vars[i]);
+      std::shared_ptr<std::vector<SyncFn>> slot_fns = fns[i];
+      this->PushAsync([slot_fns](RunContext ctx, CallbackOnComplete on_complete) {
+          for (const SyncFn& fn : *slot_fns) fn(ctx);
+          on_complete();
+        }, ctx, const_vars[i], mutable_vars[i],
+        FnProperty::kNormal, 0, "ImperativeBulk");
+    }
   }
   /*!
    * \brief Number of pending operations.
@@ -515,6 +863,8 @@ class ThreadedEngine : public Engine {
   std::atomic<bool> shutdown_phase_{false};
   /*!\brief show more information from engine actions */
   bool engine_info_{false};
+  /*! \brief minimum number of dependent ops in a bulk to run as an engine op of their own */
+  int bulk_parallel_min_ops_{4};
   /*! \brief debug information about wait for var. */
   std::atomic<ThreadedVar*> debug_wait_var_{nullptr};
   /*! \brief debug information about wait for var. */
@@ -31,6 +31,7 @@
 #include "./threaded_engine.h"
 #include "./thread_pool.h"
 #include "../common/lazy_alloc_array.h"
+#include "../common/numa.h"
 #include "../common/utils.h"
 
 namespace mxnet {
@@ -42,6 +43,7 @@ namespace engine {
  *  - Use fixed amount of threads for each device.
  *  - Use special threads for copy operations.
  *  - Each stream is allocated and bound to each of the thread.
+ *  - With MXNET_USE_NUMA, the workers of each CPU context are pinned to its NUMA node.
  */
 class ThreadedEnginePerDevice : public ThreadedEngine {
  public:
@@ -84,7 +86,7 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
     cpu_priority_worker_->pool.reset(new ThreadPool(
         cpu_priority_nthreads,
         [this](std::shared_ptr<dmlc::ManualEvent> ready_event) {
-          this->CPUWorker(Context(), cpu_priority_worker_.get(), ready_event);
+          this->CPUWorker(Context(), -1, cpu_priority_worker_.get(), ready_event);
         }, true));
     // GPU tasks will be created lazily
   }
@@ -110,10 +112,12 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
           int nthread = cpu_worker_nthreads_;
           auto ptr =
           cpu_normal_workers_.Get(dev_id, [this, ctx, nthread]() {
+              const common::NUMATopology *numa = common::NUMATopology::Get();
+              const int numa_node = numa->enabled() ? numa->NodeOf(ctx) : -1;
               auto blk = new ThreadWorkerBlock<kWorkerQueue>();
               blk->pool.reset(new ThreadPool(nthread,
-                  [this, ctx, blk](std::shared_ptr<dmlc::ManualEvent> ready_event) {
-                    this->CPUWorker(ctx, blk, ready_event);
+                  [this, ctx, numa_node, blk](std::shared_ptr<dmlc::ManualEvent> ready_event) {
+                    this->CPUWorker(ctx, numa_node, blk, ready_event);
                   }, true));
             return blk;
           });
@@ -275,10 +279,12 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
   }
   /*!
    * \brief CPU worker that performs operations on CPU.
+   * \param numa_node The NUMA node the worker is pinned to, -1 for no pinning.
    * \param block The task block of the worker.
    */
   template<dmlc::ConcurrentQueueType type>
   inline void CPUWorker(Context ctx,
+                        int numa_node,
                         ThreadWorkerBlock<type> *block,
                         const std::shared_ptr<dmlc::ManualEvent>& ready_event) {
     this->is_worker_ = true;
@@ -290,7 +296,11 @@ class ThreadedEnginePerDevice : public ThreadedEngine {
     ready_event->signal();
 
     // Set default number of threads for OMP parallel regions initiated by this thread
-    OpenMP::Get()->on_start_worker_thread(true);
+    if (numa_node >= 0) {
+      OpenMP::Get()->on_start_numa_worker_thread(numa_node);
+    } else {
+      OpenMP::Get()->on_start_worker_thread(true);
+    }
 
     while (task_queue->Pop(&opr_block)) {
       this->ExecuteOprBlock(run_ctx, opr_block);
@@ -0,0 +1,331 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file threaded_engine_workstealing.cc
+ * \brief ThreadedEngine whose CPU workers own a task deque each and steal from each other.
+ */
+#include <dmlc/base.h>
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <dmlc/concurrency.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "./threaded_engine.h"
+#include "./thread_pool.h"
+#include "./stream_manager.h"
+
+namespace mxnet {
+namespace engine {
+/*!
+ * \brief ThreadedEngine with work-stealing CPU workers.
+ * The policy of this Engine:
+ *  - Execute Async operation immediately if pushed from Pusher.
+ *  - Each CPU worker owns a task deque. Operations made ready by a worker are
+ *    pushed to its own deque, operations pushed from other threads are spread
+ *    round-robin over the deques.
+ *  - A worker pops the newest task of its own deque, and steals the oldest task
+ *    of another worker's deque once its own is empty. Workers only go to sleep
+ *    after a short spin finds no task anywhere.
+ *  - Prioritized CPU operations use dedicated threads and a priority queue, as in
+ *    ThreadedEnginePerDevice.
+ *  - GPU operations use a common thread pool per queue type, as in ThreadedEnginePooled.
+ */
+class ThreadedEngineWorkStealing : public ThreadedEngine {
+ public:
+  static auto constexpr kPriorityQueue = dmlc::ConcurrentQueueType::kPriority;
+
+  ThreadedEngineWorkStealing() noexcept(false) {
+    this->Start();
+  }
+  ~ThreadedEngineWorkStealing() noexcept(false) {
+    this->StopNoWait();
+  }
+
+  void StopNoWait() {
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+      kill_workers_.store(true);
+    }
+    sleep_cv_.notify_all();
+    if (cpu_priority_queue_) cpu_priority_queue_->SignalForKill();
+    if (gpu_task_queue_) gpu_task_queue_->SignalForKill();
+    if (gpu_io_task_queue_) gpu_io_task_queue_->SignalForKill();
+    cpu_pool_.reset(nullptr);
+    cpu_priority_pool_.reset(nullptr);
+    gpu_pool_.reset(nullptr);
+    gpu_io_pool_.reset(nullptr);
+    cpu_queues_.clear();
+    cpu_priority_queue_.reset(nullptr);
+    gpu_task_queue_.reset(nullptr);
+    gpu_io_task_queue_.reset(nullptr);
+    streams_.reset(nullptr);
+  }
+
+  void Stop() override {
+    if (is_worker_) return;
+    WaitForAll();
+    StopNoWait();
+  }
+
+  void Start() override {
+    if (is_worker_) return;
+    kill_workers_.store(false);
+    num_tasks_.store(0);
+    const int cpu_worker_nthreads = std::max(dmlc::GetEnv("MXNET_CPU_WORKER_NTHREADS", 4), 1);
+    const int cpu_priority_nthreads = dmlc::GetEnv("MXNET_CPU_PRIORITY_NTHREADS", 4);
+    spin_count_ = dmlc::GetEnv("MXNET_ENGINE_STEAL_SPIN_COUNT", 64);
+    for (int i = 0; i < cpu_worker_nthreads; ++i) {
+      cpu_queues_.emplace_back(new WorkerQueue());
+    }
+    std::atomic<int> next_index{0};
+    cpu_pool_.reset(new ThreadPool(
+        cpu_worker_nthreads,
+        [this, &next_index](std::shared_ptr<dmlc::ManualEvent> ready_event) {
+          this->CPUWorker(next_index++, ready_event);
+        }, true));
+    cpu_priority_queue_.reset(new dmlc::ConcurrentBlockingQueue<OprBlock*, kPriorityQueue>());
+    cpu_priority_pool_.reset(new ThreadPool(
+        cpu_priority_nthreads,
+        [this](std::shared_ptr<dmlc::ManualEvent> ready_event) {
+          this->QueueWorker(cpu_priority_queue_.get(), true, ready_event);
+        }, true));
+#if MXNET_USE_CUDA
+    streams_.reset(new StreamManager<kMaxNumGPUs, kNumStreamsPerGpu>());
+    gpu_task_queue_.reset(new dmlc::ConcurrentBlockingQueue<OprBlock*, kPriorityQueue>());
+    gpu_io_task_queue_.reset(new dmlc::ConcurrentBlockingQueue<OprBlock*, kPriorityQueue>());
+    gpu_pool_.reset(new ThreadPool(
+        kNumGPUWorkingThreads,
+        [this](std::shared_ptr<dmlc::ManualEvent> ready_event) {
+          this->QueueWorker(gpu_task_queue_.get(), false, ready_event);
+        }, true));
+    gpu_io_pool_.reset(new ThreadPool(
+        dmlc::GetEnv("MXNET_GPU_COPY_NTHREADS", 2),
+        [this](std::shared_ptr<dmlc::ManualEvent> ready_event) {
+          this->QueueWorker(gpu_io_task_queue_.get(), false, ready_event);
+        }, true));
+#endif  // MXNET_USE_CUDA
+  }
+
+ protected:
+  void PushToExecute(OprBlock *opr_block, bool pusher_thread) override {
+    const Context& ctx = opr_block->ctx;
+    const FnProperty prop = opr_block->opr->prop;
+    if ((prop == FnProperty::kAsync || prop == FnProperty::kDeleteVar) && pusher_thread) {
+      if (ctx.dev_mask() == Context::kGPU) {
+        #if MXNET_USE_CUDA
+        MSHADOW_CATCH_ERROR(mshadow::SetDevice<gpu>(ctx.dev_id));
+        #endif
+      }
+      this->ExecuteOprBlock(RunContext{ctx, nullptr}, opr_block);
+    } else if (ctx.dev_mask() == Context::kCPU) {
+      if (prop == FnProperty::kCPUPrioritized) {
+        cpu_priority_queue_->Push(opr_block, opr_block->priority);
+      } else {
+        this->PushToWorker(opr_block);
+      }
+    } else {
+#if MXNET_USE_CUDA
+      if (prop == FnProperty::kCopyFromGPU || prop == FnProperty::kCopyToGPU) {
+        gpu_io_task_queue_->Push(opr_block, opr_block->priority);
+      } else {
+        gpu_task_queue_->Push(opr_block, opr_block->priority);
+      }
+#else
+      LOG(FATAL) << "Please compile with CUDA enabled";
+#endif  // MXNET_USE_CUDA
+    }
+  }
+
+ private:
+  /*! \brief Task deque owned by a CPU worker, padded to avoid false sharing */
+  struct alignas(64) WorkerQueue {
+    SpinLock lock;
+    std::deque<OprBlock*> tasks;
+  };
+  /*! \brief Concurrency for GPU thread pool */
+  static constexpr std::size_t kNumGPUWorkingThreads = 16;
+  /*!\brief number of streams allocated for each GPU */
+  static constexpr std::size_t kNumStreamsPerGpu = 16;
+
+  /*! \brief whether this is a worker thread. */
+  static MX_THREAD_LOCAL bool is_worker_;
+  /*! \brief engine owning the current CPU worker thread, nullptr for other threads. */
+  static MX_THREAD_LOCAL ThreadedEngineWorkStealing *worker_engine_;
+  /*! \brief index of the current CPU worker thread in cpu_queues_. */
+  static MX_THREAD_LOCAL int worker_index_;
+
+  /*! \brief number of unsuccessful steal rounds before a worker sleeps */
+  int spin_count_;
+  /*! \brief deque of each CPU worker */
+  std::vector<std::unique_ptr<WorkerQueue>> cpu_queues_;
+  /*! \brief round-robin position for tasks pushed from non-worker threads */
+  std::atomic<unsigned> next_queue_{0};
+  /*! \brief number of tasks sitting in CPU worker deques */
+  std::atomic<int> num_tasks_{0};
+  /*! \brief number of CPU workers sleeping on sleep_cv_ */
+  std::atomic<int> num_sleeping_{0};
+  /*! \brief whether CPU workers should exit */
+  std::atomic<bool> kill_workers_{false};
+  /*! \brief mutex and condition variable to park idle CPU workers */
+  std::mutex sleep_mutex_;
+  std::condition_variable sleep_cv_;
+  /*! \brief CPU workers */
+  std::unique_ptr<ThreadPool> cpu_pool_;
+  /*! \brief prioritized CPU tasks and their workers */
+  std::unique_ptr<dmlc::ConcurrentBlockingQueue<OprBlock*, kPriorityQueue>> cpu_priority_queue_;
+  std::unique_ptr<ThreadPool> cpu_priority_pool_;
+  /*! \brief GPU streams, tasks and workers */
+  std::unique_ptr<StreamManager<kMaxNumGPUs, kNumStreamsPerGpu>> streams_;
+  std::unique_ptr<dmlc::ConcurrentBlockingQueue<OprBlock*, kPriorityQueue>> gpu_task_queue_;
+  std::unique_ptr<dmlc::ConcurrentBlockingQueue<OprBlock*, kPriorityQueue>> gpu_io_task_queue_;
+  std::unique_ptr<ThreadPool> gpu_pool_;
+  std::unique_ptr<ThreadPool> gpu_io_pool_;
+
+  /*!
+   * \brief Push a ready CPU task to a worker deque and wake up a sleeping worker.
+   * \param opr_block The operator block.
+   */
+  void PushToWorker(OprBlock *opr_block) {
+    const size_t index = worker_engine_ == this ?
+        static_cast<size_t>(worker_index_) : next_queue_++ % cpu_queues_.size();
+    WorkerQueue *queue = cpu_queues_[index].get();
+    queue->lock.lock();
+    queue->tasks.push_back(opr_block);
+    queue->lock.unlock();
+    ++num_tasks_;
+    if (num_sleeping_.load() > 0) {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+      sleep_cv_.notify_one();
+    }
+  }
+  /*!
+   * \brief Take a task, from the own deque first and then from the other workers.
+   * \param index Index of the calling worker.
+   * \param opr_block The task taken.
+   * \return Whether a task was found.
+   */
+  bool TryTake(size_t index, OprBlock **opr_block) {
+    const size_t nqueues = cpu_queues_.size();
+    for (size_t i = 0; i < nqueues; ++i) {
+      WorkerQueue *queue = cpu_queues_[(index + i) % nqueues].get();
+      queue->lock.lock();
+      if (!queue->tasks.empty()) {
+        // own deque is used as a stack for locality, stolen tasks are the oldest ones
+        if (i == 0) {
+          *opr_block = queue->tasks.back();
+          queue->tasks.pop_back();
+        } else {
+          *opr_block = queue->tasks.front();
+          queue->tasks.pop_front();
+        }
+        queue->lock.unlock();
+        --num_tasks_;
+        return true;
+      }
+      queue->lock.unlock();
+    }
+    return false;
+  }
+  /*!
+   * \brief Wait for the next task of a CPU worker.
+   * \param index Index of the calling worker.
+   * \param opr_block The task taken.
+   * \return false if the engine is stopping.
+   */
+  bool NextTask(size_t index, OprBlock **opr_block) {
+    while (true) {
+      for (int i = 0; i <= spin_count_; ++i) {
+        if (TryTake(index, opr_block)) return true;
+        if (kill_workers_.load()) return false;
+        std::this_thread::yield();
+      }
+      std::unique_lock<std::mutex> lock(sleep_mutex_);
+      ++num_sleeping_;
+      sleep_cv_.wait(lock, [this]() {
+        return num_tasks_.load() > 0 || kill_workers_.load();
+      });
+      --num_sleeping_;
+      if (kill_workers_.load()) return false;
+    }
+  }
+  /*!
+   * \brief CPU worker that owns a deque.
+   * \param index Index of the worker's deque.
+   */
+  void CPUWorker(size_t index, const std::shared_ptr<dmlc::ManualEvent>& ready_event) {
+    is_worker_ = true;
+    worker_engine_ = this;
+    worker_index_ = static_cast<int>(index);
+    ready_event->signal();
+
+    // Set default number of threads for OMP parallel regions initiated by this thread
+    OpenMP::Get()->on_start_worker_thread(true);
+
+    OprBlock *opr_block;
+    while (NextTask(index, &opr_block)) {
+      this->ExecuteOprBlock(RunContext{opr_block->ctx, nullptr}, opr_block);
+    }
+  }
+  /*!
+   * \brief Worker on a shared blocking queue, used for prioritized CPU and GPU tasks.
+   * \param task_queue Queue to work on.
+   * \param use_omp Whether tasks of this queue run omp regions.
+   */
+  void QueueWorker(dmlc::ConcurrentBlockingQueue<OprBlock*, kPriorityQueue> *task_queue,
+                   bool use_omp,
+                   const std::shared_ptr<dmlc::ManualEvent>& ready_event) {
+    is_worker_ = true;
+    ready_event->signal();
+    OpenMP::Get()->on_start_worker_thread(use_omp);
+    OprBlock *opr_block;
+    while (task_queue->Pop(&opr_block)) {
+      const Context& ctx = opr_block->ctx;
+      if (ctx.dev_mask() == Context::kCPU) {
+        this->ExecuteOprBlock(RunContext{ctx, nullptr}, opr_block);
+        continue;
+      }
+#if MXNET_USE_CUDA
+      CUDA_CALL(cudaSetDevice(ctx.dev_id));
+      const bool is_copy = (opr_block->opr->prop == FnProperty::kCopyFromGPU ||
+                            opr_block->opr->prop == FnProperty::kCopyToGPU);
+      this->ExecuteOprBlock(is_copy ? streams_->GetIORunContext(ctx)
+                                    : streams_->GetRunContext(ctx), opr_block);
+#endif  // MXNET_USE_CUDA
+    }
+  }
+};
+
+Engine *CreateThreadedEngineWorkStealing() {
+  return new ThreadedEngineWorkStealing();
+}
+
+MX_THREAD_LOCAL bool ThreadedEngineWorkStealing::is_worker_ = false;
+MX_THREAD_LOCAL ThreadedEngineWorkStealing *ThreadedEngineWorkStealing::worker_engine_ = nullptr;
+MX_THREAD_LOCAL int ThreadedEngineWorkStealing::worker_index_ = -1;
+
+}  // namespace engine
+}  // namespace mxnet
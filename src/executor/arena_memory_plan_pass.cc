@@ -0,0 +1,141 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file arena_memory_plan_pass.cc
+ * \brief Place the data entries of a graph in a memory arena by liveness.
+ */
+#include <mxnet/base.h>
+#include <nnvm/graph_attr_types.h>
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include "./exec_pass.h"
+
+namespace mxnet {
+namespace exec {
+
+namespace {
+// alignment of the blocks in the arena
+const size_t kArenaAlignment = 64;
+}  // namespace
+
+std::vector<ArenaBlock> PlanArenaMemory(const Graph& g,
+                                        const std::vector<bool>& planned,
+                                        std::vector<int>* entry_block) {
+  const auto& idx = g.indexed_graph();
+  const auto& vshape = g.GetAttr<nnvm::ShapeVector>("shape");
+  const auto& vdtype = g.GetAttr<nnvm::DTypeVector>("dtype");
+  const auto& vstorage = g.GetAttr<nnvm::StorageVector>("storage_id");
+  const auto& vctx = g.GetAttr<ContextVector>("context");
+  CHECK_EQ(planned.size(), idx.num_node_entries());
+
+  // last node reading each entry, graph outputs stay live until the end
+  std::vector<uint32_t> last_use(idx.num_node_entries(), 0);
+  for (uint32_t nid = 0; nid < idx.num_nodes(); ++nid) {
+    for (const auto& e : idx[nid].inputs) {
+      uint32_t eid = idx.entry_id(e);
+      last_use[eid] = std::max(last_use[eid], nid);
+    }
+  }
+  for (const auto& e : idx.outputs()) {
+    last_use[idx.entry_id(e)] = idx.num_nodes();
+  }
+
+  // entries of each storage id in order of definition
+  std::vector<std::vector<std::pair<uint32_t, uint32_t> > > sid_entries;
+  for (uint32_t nid = 0; nid < idx.num_nodes(); ++nid) {
+    for (uint32_t index = 0; index < idx[nid].source->num_outputs(); ++index) {
+      uint32_t eid = idx.entry_id(nid, index);
+      if (!planned[eid] || vstorage[eid] < 0) continue;
+      size_t sid = static_cast<size_t>(vstorage[eid]);
+      if (sid >= sid_entries.size()) sid_entries.resize(sid + 1);
+      sid_entries[sid].emplace_back(nid, eid);
+    }
+  }
+
+  std::vector<ArenaBlock> blocks;
+  entry_block->assign(idx.num_node_entries(), -1);
+  for (const auto& entries : sid_entries) {
+    int block = -1;
+    for (const auto& entry : entries) {
+      const uint32_t nid = entry.first, eid = entry.second;
+      const size_t bytes = vshape[eid].Size() * mshadow::mshadow_sizeof(vdtype[eid]);
+      const uint32_t end = std::max(last_use[eid], nid);
+      if (block >= 0 && nid <= blocks[block].end) {
+        // written while the previous entries of the storage id are live, so it is
+        // an in-place or addto output of them
+        blocks[block].bytes = std::max(blocks[block].bytes, bytes);
+        blocks[block].end = std::max(blocks[block].end, end);
+      } else {
+        block = static_cast<int>(blocks.size());
+        blocks.push_back(ArenaBlock{vctx[nid], bytes, nid, end, 0});
+      }
+      (*entry_block)[eid] = block;
+    }
+  }
+  for (auto& block : blocks) {
+    block.bytes = (std::max<size_t>(block.bytes, 1) + kArenaAlignment - 1)
+                  / kArenaAlignment * kArenaAlignment;
+  }
+
+  // greedy by size: place the largest blocks first, each at the smallest gap
+  // left by the placed blocks live at the same time which can hold it
+  std::vector<size_t> order(blocks.size());
+  for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+  std::stable_sort(order.begin(), order.end(), [&blocks](size_t lhs, size_t rhs) {
+    return blocks[lhs].bytes > blocks[rhs].bytes;
+  });
+  std::vector<size_t> placed, live;
+  for (size_t b : order) {
+    ArenaBlock& block = blocks[b];
+    live.clear();
+    for (size_t p : placed) {
+      const ArenaBlock& other = blocks[p];
+      if (other.ctx == block.ctx && other.start <= block.end && block.start <= other.end) {
+        live.push_back(p);
+      }
+    }
+    std::sort(live.begin(), live.end(), [&blocks](size_t lhs, size_t rhs) {
+      return blocks[lhs].offset < blocks[rhs].offset;
+    });
+    size_t best_offset = 0, best_gap = std::numeric_limits<size_t>::max();
+    bool found = false;
+    size_t prev_end = 0;
+    for (size_t p : live) {
+      const ArenaBlock& other = blocks[p];
+      if (other.offset > prev_end) {
+        const size_t gap = other.offset - prev_end;
+        if (gap >= block.bytes && gap < best_gap) {
+          best_offset = prev_end;
+          best_gap = gap;
+          found = true;
+        }
+      }
+      prev_end = std::max(prev_end, other.offset + other.bytes);
+    }
+    block.offset = found ? best_offset : prev_end;
+    placed.push_back(b);
+  }
+  return blocks;
+}
+
+}  // namespace exec
+}  // namespace mxnet
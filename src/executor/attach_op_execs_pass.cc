@@ -340,10 +340,28 @@ void CreateOpExecs(const Graph& g, OpExecVector* p_ret, size_t i) {
 
 // pass to attach operator executors
 Graph AttachOpExecs(Graph g) {
+  static auto& fcreate_op_state = nnvm::Op::GetAttr<FCreateOpState>("FCreateOpState");
+  static auto& is_layer_backward = nnvm::Op::GetAttr<bool>("TIsLayerOpBackward");
+  static auto& parallel_op_state = nnvm::Op::GetAttr<bool>("TParallelCreateOpState");
   const auto& idx = g.indexed_graph();
   OpExecVector ret(idx.num_nodes());
+  // only the executors of stateless operators are created in parallel. operator
+  // states may call into the frontend, like Custom, or share resources, so they
+  // are created in order after the others, unless the operator sets
+  // TParallelCreateOpState. so are the backward nodes sharing a forward state
+  std::vector<bool> serial(idx.num_nodes(), false);
+  for (size_t i = 0; i < idx.num_nodes(); ++i) {
+    if (idx[i].source->is_variable()) continue;
+    const nnvm::Op *op = idx[i].source->op();
+    serial[i] = is_layer_backward.get(op, false) ||
+        (fcreate_op_state.count(op) && !parallel_op_state.get(op, false));
+  }
+  common::ParallelFor(idx.num_nodes(), common::GetExecInitNumThreads(idx.num_nodes()),
+                      [&](size_t i) {
+    if (!serial[i]) CreateOpExecs(g, &ret, i);
+  });
   for (size_t i = 0; i < idx.num_nodes(); ++i) {
-    CreateOpExecs(g, &ret, i);
+    if (serial[i]) CreateOpExecs(g, &ret, i);
   }
   g.attrs["op_execs"] = std::make_shared<nnvm::any>(ret);
   return g;
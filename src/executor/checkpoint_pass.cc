@@ -0,0 +1,221 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file checkpoint_pass.cc
+ * \brief Choose the forward nodes recomputed in the backward pass.
+ */
+#include <mxnet/base.h>
+#include <mxnet/operator.h>
+#include <mxnet/op_attr_types.h>
+#include <nnvm/graph_attr_types.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "./exec_pass.h"
+
+namespace mxnet {
+namespace exec {
+
+namespace {
+
+// whether recomputing a node in the backward pass gives its forward results again
+bool CanRecompute(const nnvm::Node& node) {
+  static auto& fmutate_inputs = nnvm::Op::GetAttr<nnvm::FMutateInputs>("FMutateInputs");
+  static auto& fresource = nnvm::Op::GetAttr<FResourceRequest>("FResourceRequest");
+  static auto& fresource_ex = nnvm::Op::GetAttr<FResourceRequestEx>("FResourceRequestEx");
+  if (node.is_variable()) return false;
+  if (node.op()->name == "Dropout") return false;
+  // auxiliary states would be updated twice
+  if (fmutate_inputs.count(node.op())) return false;
+  // random operators would give other results
+  std::vector<ResourceRequest> reqs;
+  if (fresource_ex.count(node.op())) {
+    reqs = fresource_ex[node.op()](node.attrs, cpu::kDevMask, DispatchMode::kFCompute);
+  } else if (fresource.count(node.op())) {
+    reqs = fresource[node.op()](node.attrs);
+  }
+  for (const auto& req : reqs) {
+    if (req.type == ResourceRequest::kRandom ||
+        req.type == ResourceRequest::kParallelRandom) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// the nodes kept by a plan and its estimated activation memory
+struct CheckpointPlan {
+  std::vector<bool> keep;
+  // bytes of the kept activations
+  size_t kept_bytes = 0;
+  // bytes of the largest segment of recomputed activations
+  size_t segment_bytes = 0;
+};
+
+// keep every node which cannot be recomputed, and the node whose activations, together
+// with those of the recomputed nodes it depends on, would exceed segment_limit bytes.
+// Variables are neither recomputed nor counted as activations.
+CheckpointPlan GreedyCheckpoints(const nnvm::IndexedGraph& idx,
+                                 const std::vector<size_t>& node_bytes,
+                                 const std::vector<bool>& must_keep,
+                                 size_t segment_limit) {
+  const size_t num_nodes = idx.num_nodes();
+  CheckpointPlan plan;
+  plan.keep.resize(num_nodes, false);
+  // bytes recomputed to get the outputs of each node back, 0 for kept nodes
+  std::vector<size_t> segment(num_nodes, 0);
+  for (uint32_t nid = 0; nid < num_nodes; ++nid) {
+    if (idx[nid].source->is_variable()) {
+      plan.keep[nid] = true;
+      continue;
+    }
+    if (!must_keep[nid]) {
+      // ancestors shared by several inputs are counted once per input, which may
+      // overestimate the segment but never exceeds the budget
+      size_t bytes = node_bytes[nid];
+      uint32_t last_input = num_nodes;
+      for (const auto& e : idx[nid].inputs) {
+        if (e.node_id == last_input) continue;
+        last_input = e.node_id;
+        const size_t input_bytes = segment[e.node_id];
+        bytes = input_bytes > std::numeric_limits<size_t>::max() - bytes ?
+                std::numeric_limits<size_t>::max() : bytes + input_bytes;
+      }
+      if (bytes <= segment_limit) {
+        segment[nid] = bytes;
+        plan.segment_bytes = std::max(plan.segment_bytes, bytes);
+        continue;
+      }
+    }
+    plan.keep[nid] = true;
+    plan.kept_bytes += node_bytes[nid];
+  }
+  return plan;
+}
+
+}  // namespace
+
+std::unordered_set<const nnvm::Node*> PlanCheckpoints(const Graph& g, double budget_mb) {
+  const auto& idx = g.indexed_graph();
+  const size_t num_nodes = idx.num_nodes();
+  // the marked checkpoints and the nodes which cannot be recomputed are always kept
+  std::vector<bool> must_keep(num_nodes, false);
+  bool has_marks = false;
+  size_t num_recomputable = 0;
+  for (uint32_t nid = 0; nid < num_nodes; ++nid) {
+    const nnvm::Node* node = idx[nid].source;
+    if (!CanRecompute(*node)) {
+      must_keep[nid] = true;
+      continue;
+    }
+    auto it = node->attrs.dict.find("__checkpoint__");
+    if (it != node->attrs.dict.end() && (it->second == "True" || it->second == "1" ||
+                                         it->second == "true")) {
+      must_keep[nid] = true;
+      has_marks = true;
+      continue;
+    }
+    ++num_recomputable;
+  }
+  std::unordered_set<const nnvm::Node*> recompute;
+  if ((budget_mb == 0 && !has_marks) || num_recomputable == 0) return recompute;
+
+  // activation sizes, every node counts the same without shapes; inputs and
+  // parameters are not activations
+  const bool has_shapes = g.attrs.count("shape") && g.attrs.count("dtype");
+  std::vector<size_t> node_bytes(num_nodes, 1);
+  for (uint32_t nid = 0; nid < num_nodes; ++nid) {
+    if (idx[nid].source->is_variable()) node_bytes[nid] = 0;
+  }
+  if (has_shapes) {
+    const auto& vshape = g.GetAttr<nnvm::ShapeVector>("shape");
+    const auto& vdtype = g.GetAttr<nnvm::DTypeVector>("dtype");
+    for (uint32_t nid = 0; nid < num_nodes; ++nid) {
+      node_bytes[nid] = 0;
+      if (idx[nid].source->is_variable()) continue;
+      for (uint32_t index = 0; index < idx[nid].source->num_outputs(); ++index) {
+        const uint32_t eid = idx.entry_id(nid, index);
+        const int dtype = vdtype[eid] >= 0 ? vdtype[eid] : mshadow::kFloat32;
+        node_bytes[nid] += vshape[eid].Size() * mshadow::mshadow_sizeof(dtype);
+      }
+    }
+  }
+
+  CheckpointPlan plan;
+  if (budget_mb == 0) {
+    // only keep the marked checkpoints
+    plan = GreedyCheckpoints(idx, node_bytes, must_keep, std::numeric_limits<size_t>::max());
+  } else {
+    // try segment sizes from keeping every node to recomputing all of them
+    size_t total = 0;
+    for (uint32_t nid = 0; nid < num_nodes; ++nid) {
+      if (!must_keep[nid]) total += node_bytes[nid];
+    }
+    const bool use_budget = budget_mb > 0 && has_shapes;
+    const size_t budget = use_budget ? static_cast<size_t>(budget_mb * (1 << 20)) : 0;
+    const int kNumCandidates = 32;
+    bool found = false;
+    for (int i = 0; i <= kNumCandidates; ++i) {
+      const size_t limit = i == 0 ? 0 : static_cast<size_t>(
+          std::pow(static_cast<double>(total), static_cast<double>(i) / kNumCandidates));
+      CheckpointPlan candidate = GreedyCheckpoints(idx, node_bytes, must_keep, limit);
+      const size_t peak = candidate.kept_bytes + candidate.segment_bytes;
+      const size_t best_peak = plan.kept_bytes + plan.segment_bytes;
+      if (use_budget) {
+        // within budget, keep as much as possible to recompute less
+        if (peak <= budget) {
+          if (!found || candidate.kept_bytes > plan.kept_bytes) plan = std::move(candidate);
+          found = true;
+        } else if (!found && (plan.keep.empty() || peak < best_peak)) {
+          plan = std::move(candidate);
+        }
+      } else if (plan.keep.empty() || peak < best_peak) {
+        // no budget: the smallest footprint, about sqrt(n) segments
+        plan = std::move(candidate);
+      }
+    }
+    if (use_budget && !found) {
+      LOG(WARNING) << "Gradient checkpointing cannot fit the activations in " << budget_mb
+                   << " MB, using the smallest plan of "
+                   << ((plan.kept_bytes + plan.segment_bytes) >> 20) << " MB";
+    }
+  }
+
+  for (uint32_t nid = 0; nid < num_nodes; ++nid) {
+    if (!plan.keep[nid]) recompute.insert(idx[nid].source);
+  }
+  if (dmlc::GetEnv("MXNET_MEM_PLAN_VERBOSE_LOGGING", false)) {
+    size_t total = 0;
+    for (uint32_t nid = 0; nid < num_nodes; ++nid) total += node_bytes[nid];
+    LOG(INFO) << "Gradient checkpointing: recompute " << recompute.size() << " of "
+              << num_nodes - idx.input_nodes().size() << " forward nodes, keep "
+              << (has_shapes ? plan.kept_bytes >> 20 : plan.kept_bytes) << " of "
+              << (has_shapes ? total >> 20 : total)
+              << (has_shapes ? " MB of activations" : " activations");
+  }
+  return recompute;
+}
+
+}  // namespace exec
+}  // namespace mxnet
@@ -34,6 +34,7 @@
 #include <vector>
 #include <memory>
 #include <string>
+#include <unordered_set>
 
 namespace mxnet {
 namespace exec {
@@ -123,6 +124,45 @@ void CreateOpExecs(const Graph& g, OpExecVector* p_ret, size_t i);
  */
 Graph AttachOpExecs(Graph g);
 
+/*!
+ * \brief a step of a fused elementwise kernel.
+ *  Operands refer to the result of a previous step if non-negative,
+ *  or to input `-1 - operand` of the kernel otherwise.
+ */
+struct FusedElemwiseStep {
+  /*! \brief the elementwise operator */
+  int op;
+  /*! \brief the scalar of scalar operators */
+  double scalar;
+  /*! \brief the first operand */
+  int lhs;
+  /*! \brief the second operand of binary operators */
+  int rhs;
+};
+
+/*!
+ * \brief Get the fused kernel step of an operator node.
+ *
+ * \param attrs attributes of the node
+ * \param step the step to fill, operands are left untouched
+ * \return number of inputs of the operator, 0 if it cannot be fused
+ */
+int GetFusedElemwiseOp(const nnvm::NodeAttrs& attrs, FusedElemwiseStep* step);
+/*!
+ * \brief Create an OpExecutor running a chain of elementwise operators in a
+ *  single pass over memory. The in_array, out_array and req fields have to be
+ *  filled by the caller, with one output per entry of out_steps.
+ *
+ * \param steps the steps of the kernel, in execution order
+ * \param out_steps the steps whose results are written to out_array
+ * \param execs executors of the fused nodes, used when the inputs
+ *  cannot be read directly
+ */
+std::shared_ptr<OpExecutor> CreateFusedElemwiseExec(
+    const std::vector<FusedElemwiseStep>& steps,
+    const std::vector<int>& out_steps,
+    const std::vector<std::shared_ptr<OpExecutor> >& execs);
+
 /*!
  * \brief Attach Resource to the OpExecVector of the graph.
  *
@@ -159,6 +199,59 @@ void AttachOpResources(const Graph& g,
  */
 Graph DetectInplaceAddTo(Graph g);
 
+/*! \brief a buffer of a memory arena, live between two nodes in topological order */
+struct ArenaBlock {
+  /*! \brief context of the buffer */
+  Context ctx;
+  /*! \brief size in bytes */
+  size_t bytes;
+  /*! \brief first node using the buffer */
+  uint32_t start;
+  /*! \brief last node using the buffer */
+  uint32_t end;
+  /*! \brief offset in the arena of the context */
+  size_t offset;
+};
+
+/*!
+ * \brief Place the data entries of a graph in a memory arena by liveness.
+ *
+ * Entries sharing a storage id while being live at the same time (in-place
+ * and addto entries) are kept in the same block, the others get blocks of
+ * their own. The blocks are placed greedily by decreasing size, at the
+ * best-fitting offset not overlapping the blocks live at the same time.
+ *
+ * Require storage placement to be already finished.
+ *
+ * \param g input graph with "storage_id", "shape", "dtype" and "context" attributes.
+ * \param planned whether each entry should be placed, entries with a negative
+ *  storage id are never placed.
+ * \param entry_block returns the block of each entry, -1 if not placed.
+ * \return the blocks with their offsets.
+ */
+std::vector<ArenaBlock> PlanArenaMemory(const Graph& g,
+                                        const std::vector<bool>& planned,
+                                        std::vector<int>* entry_block);
+
+/*!
+ * \brief Choose the forward nodes to recompute in the backward pass instead of
+ *  keeping their outputs, to be used as the mirror function of the gradient pass.
+ *
+ * Nodes marked with the attribute __checkpoint__, random operators and operators
+ * updating auxiliary states are always kept. Between the kept nodes, activations are
+ * grouped into segments recomputed together, a segment being a node with the recomputed
+ * nodes it depends on. The segment size is chosen to keep as many activations as fit in
+ * the budget, or to minimize the kept activations plus the largest segment when there is
+ * no budget. Variables are not activations and do not count towards the budget.
+ *
+ * \param g the forward graph, with "shape" and "dtype" attributes for a budget in bytes.
+ * \param budget_mb memory budget of the forward activations in MB, negative for the
+ *  smallest footprint, 0 to only recompute the nodes between marked checkpoints.
+ *  Without shapes, every budget gives the smallest footprint in number of nodes.
+ * \return the nodes to recompute, empty if there are neither marks nor a budget.
+ */
+std::unordered_set<const nnvm::Node*> PlanCheckpoints(const Graph& g, double budget_mb);
+
 /*!
  * \brief Infer shapes in the graph given the information.
  * \param graph The input graph.
@@ -0,0 +1,250 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file fused_elemwise_exec.cc
+ * \brief Executor running a chain of elementwise operators in one pass over memory.
+ */
+#include <mxnet/base.h>
+#include <mxnet/operator.h>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "./exec_pass.h"
+#include "../engine/openmp.h"
+#include "../operator/mshadow_op.h"
+
+namespace mxnet {
+namespace exec {
+
+namespace {
+
+namespace mshadow_op = ::mxnet::op::mshadow_op;
+
+/*! \brief operators supported by the fused kernel */
+enum FusedElemwiseOp {
+  // unary operators
+  kRelu, kSigmoid, kTanh, kSoftReLU, kSoftSign, kExp, kLog, kSqrt, kSquare, kAbs,
+  kNegative, kReciprocal, kIdentity,
+  // binary operators
+  kPlus, kMinus, kMul, kDiv, kMaximum, kMinimum,
+  // operators with a scalar
+  kPlusScalar, kMinusScalar, kRMinusScalar, kMulScalar, kDivScalar, kRDivScalar,
+  kMaximumScalar, kMinimumScalar, kPowerScalar, kRPowerScalar
+};
+
+/*! \brief number of elements of a tile, the results of all steps of a tile stay in cache */
+const int64_t kTileSize = 2048;
+
+template<typename OP, typename DType>
+inline void UnaryStep(DType* out, const DType* in, int64_t n) {
+  for (int64_t i = 0; i < n; ++i) out[i] = OP::Map(in[i]);
+}
+
+template<typename OP, typename DType>
+inline void BinaryStep(DType* out, const DType* lhs, const DType* rhs, int64_t n) {
+  for (int64_t i = 0; i < n; ++i) out[i] = OP::Map(lhs[i], rhs[i]);
+}
+
+template<typename OP, typename DType>
+inline void ScalarStep(DType* out, const DType* in, DType scalar, int64_t n) {
+  for (int64_t i = 0; i < n; ++i) out[i] = OP::Map(in[i], scalar);
+}
+
+template<typename DType>
+inline void RunStep(int code, DType scalar, DType* out,
+                    const DType* lhs, const DType* rhs, int64_t n) {
+  switch (code) {
+    case kRelu:           UnaryStep<mshadow_op::relu>(out, lhs, n); break;
+    case kSigmoid:        UnaryStep<mshadow_op::sigmoid>(out, lhs, n); break;
+    case kTanh:           UnaryStep<mshadow_op::tanh>(out, lhs, n); break;
+    case kSoftReLU:       UnaryStep<mshadow_op::softrelu>(out, lhs, n); break;
+    case kSoftSign:       UnaryStep<mshadow_op::softsign>(out, lhs, n); break;
+    case kExp:            UnaryStep<mshadow_op::exp>(out, lhs, n); break;
+    case kLog:            UnaryStep<mshadow_op::log>(out, lhs, n); break;
+    case kSqrt:           UnaryStep<mshadow_op::square_root>(out, lhs, n); break;
+    case kSquare:         UnaryStep<mshadow_op::square>(out, lhs, n); break;
+    case kAbs:            UnaryStep<mshadow_op::abs>(out, lhs, n); break;
+    case kNegative:       UnaryStep<mshadow_op::negation>(out, lhs, n); break;
+    case kReciprocal:     UnaryStep<mshadow_op::reciprocal>(out, lhs, n); break;
+    case kIdentity:       UnaryStep<mshadow_op::identity>(out, lhs, n); break;
+    case kPlus:           BinaryStep<mshadow_op::plus>(out, lhs, rhs, n); break;
+    case kMinus:          BinaryStep<mshadow_op::minus>(out, lhs, rhs, n); break;
+    case kMul:            BinaryStep<mshadow_op::mul>(out, lhs, rhs, n); break;
+    case kDiv:            BinaryStep<mshadow_op::div>(out, lhs, rhs, n); break;
+    case kMaximum:        BinaryStep<mshadow_op::maximum>(out, lhs, rhs, n); break;
+    case kMinimum:        BinaryStep<mshadow_op::minimum>(out, lhs, rhs, n); break;
+    case kPlusScalar:     ScalarStep<mshadow_op::plus>(out, lhs, scalar, n); break;
+    case kMinusScalar:    ScalarStep<mshadow_op::minus>(out, lhs, scalar, n); break;
+    case kRMinusScalar:   ScalarStep<mshadow_op::rminus>(out, lhs, scalar, n); break;
+    case kMulScalar:      ScalarStep<mshadow_op::mul>(out, lhs, scalar, n); break;
+    case kDivScalar:      ScalarStep<mshadow_op::div>(out, lhs, scalar, n); break;
+    case kRDivScalar:     ScalarStep<mshadow_op::rdiv>(out, lhs, scalar, n); break;
+    case kMaximumScalar:  ScalarStep<mshadow_op::maximum>(out, lhs, scalar, n); break;
+    case kMinimumScalar:  ScalarStep<mshadow_op::minimum>(out, lhs, scalar, n); break;
+    case kPowerScalar:    ScalarStep<mshadow_op::power>(out, lhs, scalar, n); break;
+    case kRPowerScalar:   ScalarStep<mshadow_op::rpower>(out, lhs, scalar, n); break;
+    default:
+      LOG(FATAL) << "Unknown fused elementwise operator " << code;
+  }
+}
+
+}  // namespace
+
+int GetFusedElemwiseOp(const nnvm::NodeAttrs& attrs, FusedElemwiseStep* step) {
+  static const std::unordered_map<std::string, int> unary_ops = {
+    {"relu", kRelu}, {"sigmoid", kSigmoid}, {"tanh", kTanh}, {"softsign", kSoftSign},
+    {"exp", kExp}, {"log", kLog}, {"sqrt", kSqrt}, {"square", kSquare}, {"abs", kAbs},
+    {"negative", kNegative}, {"reciprocal", kReciprocal}, {"_copy", kIdentity}
+  };
+  // broadcast operators are fused only when no broadcasting happens,
+  // which is checked by the caller on the shapes
+  static const std::unordered_map<std::string, int> binary_ops = {
+    {"elemwise_add", kPlus}, {"elemwise_sub", kMinus},
+    {"elemwise_mul", kMul}, {"elemwise_div", kDiv},
+    {"_maximum", kMaximum}, {"_minimum", kMinimum},
+    {"broadcast_add", kPlus}, {"broadcast_sub", kMinus},
+    {"broadcast_mul", kMul}, {"broadcast_div", kDiv},
+    {"broadcast_maximum", kMaximum}, {"broadcast_minimum", kMinimum}
+  };
+  static const std::unordered_map<std::string, int> scalar_ops = {
+    {"_plus_scalar", kPlusScalar}, {"_minus_scalar", kMinusScalar},
+    {"_rminus_scalar", kRMinusScalar}, {"_mul_scalar", kMulScalar},
+    {"_div_scalar", kDivScalar}, {"_rdiv_scalar", kRDivScalar},
+    {"_maximum_scalar", kMaximumScalar}, {"_minimum_scalar", kMinimumScalar},
+    {"_power_scalar", kPowerScalar}, {"_rpower_scalar", kRPowerScalar}
+  };
+  static const std::unordered_map<std::string, int> activation_ops = {
+    {"relu", kRelu}, {"sigmoid", kSigmoid}, {"tanh", kTanh},
+    {"softrelu", kSoftReLU}, {"softsign", kSoftSign}
+  };
+  if (attrs.op == nullptr) return 0;
+  const std::string& name = attrs.op->name;
+  step->scalar = 0;
+  if (name == "Activation") {
+    auto act_type = attrs.dict.find("act_type");
+    if (act_type == attrs.dict.end()) return 0;
+    auto it = activation_ops.find(act_type->second);
+    if (it == activation_ops.end()) return 0;
+    step->op = it->second;
+    return 1;
+  }
+  auto it = unary_ops.find(name);
+  if (it != unary_ops.end()) {
+    step->op = it->second;
+    return 1;
+  }
+  it = binary_ops.find(name);
+  if (it != binary_ops.end()) {
+    step->op = it->second;
+    return 2;
+  }
+  it = scalar_ops.find(name);
+  if (it != scalar_ops.end()) {
+    step->op = it->second;
+    step->scalar = nnvm::get<double>(attrs.parsed);
+    return 1;
+  }
+  return 0;
+}
+
+// executor of a fused chain of elementwise operators.
+// The input is processed in tiles: every step runs over a tile of its
+// operands, keeping the intermediate results in a per-thread buffer, and only
+// the results used outside of the chain are written back to memory.
+class FusedElemwiseOpExecutor : public OpExecutor {
+ public:
+  FusedElemwiseOpExecutor(const std::vector<FusedElemwiseStep>& steps,
+                          const std::vector<int>& out_steps,
+                          const std::vector<std::shared_ptr<OpExecutor> >& execs)
+      : steps_(steps), out_steps_(out_steps), execs_(execs) {}
+
+  void Setup() override {}
+
+  void Run(RunContext rctx, bool is_gpu) override {
+    op_ctx.run_ctx = rctx;
+    CHECK(!is_gpu) << "Fused elementwise kernels only run on CPU";
+#if MXNET_USE_MKLDNN == 1
+    // inputs in a MKLDNN layout cannot be read elementwise
+    for (const auto& nd : in_array) {
+      if (nd.IsMKLDNNData()) {
+        for (auto& exec : execs_) exec->Run(rctx, is_gpu);
+        return;
+      }
+    }
+#endif
+    CHECK_EQ(out_array.size(), out_steps_.size());
+    const int64_t size = out_array[0].shape().Size();
+    MSHADOW_REAL_TYPE_SWITCH(out_array[0].dtype(), DType, {
+      std::vector<const DType*> inputs;
+      std::vector<DType*> outputs;
+      for (const auto& nd : in_array) inputs.push_back(nd.data().dptr<DType>());
+      for (const auto& nd : out_array) outputs.push_back(nd.data().dptr<DType>());
+      const int64_t num_tiles = (size + kTileSize - 1) / kTileSize;
+      const int omp_threads = std::max(1, static_cast<int>(std::min<int64_t>(
+          engine::OpenMP::Get()->GetRecommendedOMPThreadCount(), num_tiles)));
+      #pragma omp parallel num_threads(omp_threads)
+      {
+        std::vector<DType> buffer(steps_.size() * kTileSize);
+        #pragma omp for
+        for (int64_t tile = 0; tile < num_tiles; ++tile) {
+          const int64_t begin = tile * kTileSize;
+          const int64_t n = std::min(kTileSize, size - begin);
+          auto operand = [&](int index) -> const DType* {
+            return index >= 0 ? &buffer[index * kTileSize] : inputs[-1 - index] + begin;
+          };
+          for (size_t s = 0; s < steps_.size(); ++s) {
+            const FusedElemwiseStep& step = steps_[s];
+            RunStep(step.op, static_cast<DType>(step.scalar), &buffer[s * kTileSize],
+                    operand(step.lhs), operand(step.rhs), n);
+          }
+          // outputs may share memory with the inputs, write them once all steps have read the tile
+          for (size_t i = 0; i < out_steps_.size(); ++i) {
+            const DType* result = &buffer[out_steps_[i] * kTileSize];
+            std::copy(result, result + n, outputs[i] + begin);
+          }
+        }
+      }
+    });
+  }
+
+  ExecType exec_type() const override {
+    return ExecType::kSync;
+  }
+
+ private:
+  // the steps of the kernel
+  std::vector<FusedElemwiseStep> steps_;
+  // steps written to out_array
+  std::vector<int> out_steps_;
+  // executors of the fused nodes
+  std::vector<std::shared_ptr<OpExecutor> > execs_;
+};
+
+std::shared_ptr<OpExecutor> CreateFusedElemwiseExec(
+    const std::vector<FusedElemwiseStep>& steps,
+    const std::vector<int>& out_steps,
+    const std::vector<std::shared_ptr<OpExecutor> >& execs) {
+  return std::make_shared<FusedElemwiseOpExecutor>(steps, out_steps, execs);
+}
+
+}  // namespace exec
+}  // namespace mxnet
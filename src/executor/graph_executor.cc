@@ -25,8 +25,13 @@
 #include <mxnet/base.h>
 #include <nnvm/graph.h>
 #include <nnvm/pass_functions.h>
+#include <dmlc/timer.h>
 #include <vector>
 #include <algorithm>
+#include <limits>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "./exec_pass.h"
 #include "./graph_executor.h"
@@ -50,6 +55,11 @@ GraphExecutor::~GraphExecutor() {
       Engine::Get()->DeleteOperator(n.cached_opr);
     }
   }
+  for (auto& group : fused_groups_) {
+    if (group.cached_opr != nullptr) {
+      Engine::Get()->DeleteOperator(group.cached_opr);
+    }
+  }
   // clean up seg ops
   for (auto& seg : cached_seg_opr_) {
     if (seg.opr != nullptr) {
@@ -96,6 +106,15 @@ void GraphExecutor::Print(std::ostream &os) const {  // NOLINT(*)
   size_t total_bytes = graph_.GetAttr<size_t>("storage_allocated_bytes");
   os << "Total " << (total_bytes >> 20UL) <<" MB allocated\n";
   os << "Total " << 11 << " TempSpace resource requested\n";
+  const auto& idx = graph_.indexed_graph();
+  for (const auto& group : fused_groups_) {
+    os << "FusedElemwise:";
+    for (size_t nid = group.topo_start; nid < group.topo_end; ++nid) {
+      os << ' ' << idx[nid].source->attrs.name;
+    }
+    os << '\n';
+  }
+  if (reshape_bucket_ >= 0) os << "Reshape reused the memory plan of a bucket\n";
 }
 
 void GraphExecutor::SetMonitorCallback(const MonitorCallback& callback) {
@@ -226,8 +245,11 @@ inline ValueType get_node_attr(
  * \brief Create the graph for backward pass.
  * This is triggered by both simple_bind and bind flows.
  */
-nnvm::Graph GraphExecutor::InitFullGraph(nnvm::Symbol symbol,
-                                         const std::vector<OpReqType>& grad_req_types) {
+nnvm::Graph GraphExecutor::InitFullGraph(
+    nnvm::Symbol symbol,
+    const std::vector<OpReqType>& grad_req_types,
+    const std::unordered_map<std::string, TShape>& arg_shape_map,
+    const std::unordered_map<std::string, int>& arg_dtype_map) {
   using nnvm::NodePtr;
   using nnvm::NodeEntry;
   // initial information
@@ -254,12 +276,36 @@ nnvm::Graph GraphExecutor::InitFullGraph(nnvm::Symbol symbol,
     }
   }
 
+  // plan gradient checkpoints, with the activation sizes when the input shapes are known
+  std::unordered_set<const nnvm::Node*> recompute;
+  {
+    const double checkpoint_mb = dmlc::GetEnv("MXNET_BACKWARD_CHECKPOINT_MB", 0.0);
+    nnvm::Graph fwd;
+    fwd.outputs = symbol.outputs;
+    if (checkpoint_mb != 0 && !arg_shape_map.empty()) {
+      const auto& idx = fwd.indexed_graph();
+      nnvm::ShapeVector arg_shapes(idx.input_nodes().size(), TShape());
+      nnvm::DTypeVector arg_dtypes(idx.input_nodes().size(), -1);
+      for (size_t i = 0; i < idx.input_nodes().size(); ++i) {
+        const std::string& name = idx[idx.input_nodes()[i]].source->attrs.name;
+        auto shape = arg_shape_map.find(name);
+        if (shape != arg_shape_map.end()) arg_shapes[i] = shape->second;
+        auto dtype = arg_dtype_map.find(name);
+        if (dtype != arg_dtype_map.end()) arg_dtypes[i] = dtype->second;
+      }
+      fwd = InferShape(std::move(fwd), std::move(arg_shapes), "__shape__");
+      fwd = InferType(std::move(fwd), std::move(arg_dtypes), "__dtype__");
+    }
+    recompute = PlanCheckpoints(fwd, checkpoint_mb);
+  }
+
   int do_mirror = dmlc::GetEnv("MXNET_BACKWARD_DO_MIRROR", 0);
-  auto need_mirror = [do_mirror](const nnvm::Node& node) -> int {
+  auto need_mirror = [do_mirror, &recompute](const nnvm::Node& node) -> int {
     if (node.is_variable()) return 0;
     const std::string& type = node.attrs.op->name;
     if (type == "Dropout") return false;
     if (get_node_attr(node, "__force_mirroring__", false)) return true;
+    if (!recompute.empty()) return recompute.count(&node);
     if (do_mirror == 0) return false;
     if (type == "Convolution") return false;
     if (type == "FullyConnected") return false;
@@ -300,6 +346,7 @@ void GraphExecutor::Init(nnvm::Symbol symbol,
                          const std::vector<NDArray>& aux_states,
                          Executor* shared_exec,
                          const nnvm::NodeEntryMap<NDArray>& feed_dict) {
+  init_phase_end_ = dmlc::GetTime();
   // create in_arg_ctxes, arg_grad_ctxes, aux_state_ctxes
   auto get_ctx1 = [](const NDArray& nd) { return nd.ctx(); };
   auto get_ctx2 = [default_ctx](const NDArray& nd) -> Context {
@@ -313,8 +360,24 @@ void GraphExecutor::Init(nnvm::Symbol symbol,
   std::vector<Context> aux_state_ctxes(aux_states.size());
   std::transform(aux_states.begin(), aux_states.end(), aux_state_ctxes.begin(), get_ctx1);
 
+  // known shapes and types of the inputs, to plan gradient checkpoints
+  std::unordered_map<std::string, TShape> arg_shape_map;
+  std::unordered_map<std::string, int> arg_dtype_map;
+  const auto arg_names = symbol.ListInputNames(nnvm::Symbol::kReadOnlyArgs);
+  const auto aux_names = symbol.ListInputNames(nnvm::Symbol::kAuxiliaryStates);
+  for (size_t i = 0; i < arg_names.size() && i < in_args.size(); ++i) {
+    arg_shape_map[arg_names[i]] = in_args[i].shape();
+    arg_dtype_map[arg_names[i]] = in_args[i].dtype();
+  }
+  for (size_t i = 0; i < aux_names.size() && i < aux_states.size(); ++i) {
+    arg_shape_map[aux_names[i]] = aux_states[i].shape();
+    arg_dtype_map[aux_names[i]] = aux_states[i].dtype();
+  }
+
   nnvm::Graph g = InitGraph(symbol, default_ctx, ctx_map, in_arg_ctxes,
-                            arg_grad_ctxes, aux_state_ctxes, grad_req_types);
+                            arg_grad_ctxes, aux_state_ctxes, grad_req_types,
+                            arg_shape_map, arg_dtype_map);
+  MarkInitPhase("InitGraph");
 
   // create arg_shapes and arg_dtypes for shape and type inferences
   const auto& idx = g.indexed_graph();
@@ -369,6 +432,7 @@ void GraphExecutor::Init(nnvm::Symbol symbol,
     HandleInferShapeError(num_forward_inputs_, g.indexed_graph(),
                           g.GetAttr<nnvm::ShapeVector>("shape"));
   }
+  MarkInitPhase("InferShape");
 
   arg_dtypes.resize(idx.input_nodes().size(), -1);
   g = InferType(std::move(g), std::move(arg_dtypes), "__dtype__");
@@ -376,6 +440,7 @@ void GraphExecutor::Init(nnvm::Symbol symbol,
     HandleInferTypeError(num_forward_inputs_, g.indexed_graph(),
                          g.GetAttr<nnvm::DTypeVector>("dtype"));
   }
+  MarkInitPhase("InferType");
 
   g.attrs["storage_type"] = std::make_shared<dmlc::any>(std::move(arg_stypes));
   g = InferStorageType(std::move(g), StorageTypeVector(), "");
@@ -383,6 +448,7 @@ void GraphExecutor::Init(nnvm::Symbol symbol,
     HandleInferStorageTypeError(num_forward_inputs_, g.indexed_graph(),
                                 g.GetAttr<StorageTypeVector>("storage_type"));
   }
+  MarkInitPhase("InferStorageType");
 
   // Initialize the rest attributes of the graph.
   // This function can be called by regular bind
@@ -410,6 +476,8 @@ void GraphExecutor::InitArguments(const nnvm::IndexedGraph& idx,
   // initialize in_args, arg_grads, and aux_states
   // populate grad_store_
   data_entry_.resize(idx.num_node_entries());
+  // arrays of zeros are allocated together after the loop
+  std::vector<NDArray> delayed_zeros;
   size_t arg_top = 0, aux_top = 0;
   const auto& mutable_nodes = idx.mutable_input_nodes();
   for (size_t i = 0; i < num_forward_inputs_; ++i) {
@@ -420,8 +488,8 @@ void GraphExecutor::InitArguments(const nnvm::IndexedGraph& idx,
     const NDArrayStorageType inferred_stype = (NDArrayStorageType) inferred_stypes[eid];
     const std::string& arg_name = idx[nid].source->attrs.name;
     if (mutable_nodes.count(nid)) {  // aux_states
-      EmplaceBackZeros(inferred_stype, inferred_shape, aux_state_ctxes[aux_top],
-                       inferred_dtype, aux_state_vec);
+      EmplaceBackDelayedZeros(inferred_stype, inferred_shape, aux_state_ctxes[aux_top],
+                              inferred_dtype, aux_state_vec, &delayed_zeros);
       data_entry_[eid] = aux_state_vec->back();
       aux_state_map_.emplace(arg_name, aux_state_vec->back());
       ++aux_top;
@@ -430,8 +498,8 @@ void GraphExecutor::InitArguments(const nnvm::IndexedGraph& idx,
                   << common::stype_string(inferred_stype);
       }
     } else {  // in_args
-      EmplaceBackZeros(inferred_stype, inferred_shape, in_arg_ctxes[arg_top],
-                       inferred_dtype, in_arg_vec);
+      EmplaceBackDelayedZeros(inferred_stype, inferred_shape, in_arg_ctxes[arg_top],
+                              inferred_dtype, in_arg_vec, &delayed_zeros);
       data_entry_[eid] = in_arg_vec->back();
       if (log_verbose_) {
         LOG(INFO) << "\tassign data entry\t" << eid << "\tas "
@@ -445,8 +513,8 @@ void GraphExecutor::InitArguments(const nnvm::IndexedGraph& idx,
         auto grad_oid = grad_store_.size() + num_forward_outputs_;
         auto grad_eid = idx.entry_id(idx.outputs()[grad_oid]);
         auto grad_stype = (NDArrayStorageType) inferred_stypes[grad_eid];
-        EmplaceBackZeros(grad_stype, inferred_shape, arg_grad_ctxes[arg_top],
-                         inferred_dtype, arg_grad_vec);
+        EmplaceBackDelayedZeros(grad_stype, inferred_shape, arg_grad_ctxes[arg_top],
+                                inferred_dtype, arg_grad_vec, &delayed_zeros);
         if (log_verbose_) {
           LOG(INFO) << "\tassign grad entry\t" << grad_eid << "\tas "
                     << common::stype_string(grad_stype);
@@ -458,6 +526,7 @@ void GraphExecutor::InitArguments(const nnvm::IndexedGraph& idx,
       ++arg_top;
     }
   }
+  AllocZeros(delayed_zeros, GetExecInitNumThreads(idx.num_nodes()));
 }
 
 /*!
@@ -482,6 +551,8 @@ void GraphExecutor::InitArguments(const nnvm::IndexedGraph& idx,
                                   std::vector<NDArray>* aux_state_vec) {
   // initialize in_args, arg_grads, and aux_states and populate grad_store_
   data_entry_.resize(idx.num_node_entries());
+  // arrays of zeros are allocated together after the loop
+  std::vector<NDArray> delayed_zeros;
   size_t arg_top = 0, aux_top = 0;
   const auto& mutable_nodes = idx.mutable_input_nodes();
   for (size_t i = 0; i < num_forward_inputs_; ++i) {
@@ -511,8 +582,8 @@ void GraphExecutor::InitArguments(const nnvm::IndexedGraph& idx,
           << arg_name << " for the current executor";
         aux_state_vec->emplace_back(aux_nd);
       } else {
-        EmplaceBackZeros(inferred_stype, inferred_shape, aux_state_ctxes[aux_top],
-                         inferred_dtype, aux_state_vec);
+        EmplaceBackDelayedZeros(inferred_stype, inferred_shape, aux_state_ctxes[aux_top],
+                                inferred_dtype, aux_state_vec, &delayed_zeros);
       }  // if (has_shared_exec)
       data_entry_[eid] = aux_state_vec->back();
       aux_state_map_.emplace(arg_name, aux_state_vec->back());
@@ -548,8 +619,8 @@ void GraphExecutor::InitArguments(const nnvm::IndexedGraph& idx,
           in_arg_vec->emplace_back(in_arg_nd);
         } else {
           // doesn't have shared_exec, or non-default storage
-          EmplaceBackZeros(inferred_stype, inferred_shape, in_arg_ctxes[arg_top],
-                           inferred_dtype, in_arg_vec);
+          EmplaceBackDelayedZeros(inferred_stype, inferred_shape, in_arg_ctxes[arg_top],
+                                  inferred_dtype, in_arg_vec, &delayed_zeros);
         }
         // gradient for model parameter
         if (kNullOp == grad_req_types[arg_top]) {
@@ -564,8 +635,8 @@ void GraphExecutor::InitArguments(const nnvm::IndexedGraph& idx,
             arg_grad_vec->emplace_back(shared_exec->arg_grad_map().at(arg_name));
           } else {
             // no need to reuse memory from shared_exec for gradient of non-default storage
-            EmplaceBackZeros(grad_stype, inferred_shape, arg_grad_ctxes[arg_top],
-                             inferred_dtype, arg_grad_vec);
+            EmplaceBackDelayedZeros(grad_stype, inferred_shape, arg_grad_ctxes[arg_top],
+                                    inferred_dtype, arg_grad_vec, &delayed_zeros);
           }
           grad_store_.emplace_back(grad_req_types[arg_top], arg_grad_vec->back());
         }
@@ -598,6 +669,7 @@ void GraphExecutor::InitArguments(const nnvm::IndexedGraph& idx,
       ++arg_top;
     }
   }
+  AllocZeros(delayed_zeros, GetExecInitNumThreads(idx.num_nodes()));
 }
 
 /*!
@@ -630,10 +702,10 @@ void GraphExecutor::FinishInitGraph(nnvm::Symbol symbol,
     for (size_t i = 0; i < idx.num_node_entries(); i++) {
       if (vstorage_type[i] != kDefaultStorage) arg_storage_id[i] = kDynamicStorageID;
     }
-    g.attrs["storage"] = std::make_shared<dmlc::any>(std::move(arg_storage_id));
-    g = nnvm::ApplyPass(g, "PlanMemory");
+    g = PlanGraphMemory(std::move(g), std::move(arg_storage_id));
   }
   g = DetectInplaceAddTo(g);
+  MarkInitPhase("PlanMemory");
 
   // log the static memory plan of the graph
   static bool mem_log_verbose = dmlc::GetEnv("MXNET_MEM_PLAN_VERBOSE_LOGGING", false);
@@ -644,12 +716,33 @@ void GraphExecutor::FinishInitGraph(nnvm::Symbol symbol,
   g = AttachOpExecs(g);
   AttachOpResources(g);
   graph_ = std::move(g);
+  MarkInitPhase("AttachOpExecs");
 
-  if (shared_exec != nullptr) {
+  if (reshape_bucket_ >= 0) {
+    this->InitDataEntryMemory(&(*reshape_buckets_)[reshape_bucket_].pool);
+  } else if (shared_exec != nullptr) {
     this->InitDataEntryMemory(&(dynamic_cast<GraphExecutor*>(shared_exec)->data_pool_));
   } else {
     this->InitDataEntryMemory(nullptr);
   }
+  MarkInitPhase("InitDataEntryMemory");
+  if (reshape_bucket_ < 0) {
+    memory_plan_.pool = data_pool_;
+    if (reshape_buckets_ != nullptr) {
+      // keep the largest plans, they fit the most shapes
+      static const size_t max_buckets =
+          std::max(dmlc::GetEnv("MXNET_EXEC_RESHAPE_BUCKETS", 8), 0);
+      auto& buckets = *reshape_buckets_;
+      if (max_buckets > 0 && buckets.size() >= max_buckets) {
+        auto smallest = std::min_element(buckets.begin(), buckets.end(),
+            [](const ReshapeBucket& lhs, const ReshapeBucket& rhs) {
+              return lhs.total_bytes < rhs.total_bytes;
+            });
+        if (smallest->total_bytes < memory_plan_.total_bytes) buckets.erase(smallest);
+      }
+      if (max_buckets > 0 && buckets.size() < max_buckets) buckets.push_back(memory_plan_);
+    }
+  }
 
   {
     // initialize output arrays
@@ -667,7 +760,111 @@ void GraphExecutor::FinishInitGraph(nnvm::Symbol symbol,
     }
   }
   this->InitCachedOps();
+  MarkInitPhase("InitCachedOps");
+  this->InitFusedOps();
+  MarkInitPhase("InitFusedOps");
   this->InitOpSegs();
+  MarkInitPhase("InitOpSegs");
+
+  static bool init_log_verbose = dmlc::GetEnv("MXNET_EXEC_INIT_VERBOSE_LOGGING", false);
+  if (init_log_verbose) {
+    std::ostringstream os;
+    double total = 0;
+    for (const auto& phase : init_phases_) {
+      os << " " << phase.first << " " << phase.second << " ms,";
+      total += phase.second;
+    }
+    LOG(INFO) << "Executor initialization of " << graph_.indexed_graph().num_nodes()
+              << " nodes:" << os.str() << " total " << total << " ms";
+  }
+}
+
+/*!
+ * \brief Plan the memory of the graph after shape and dtype inferences.
+ * Executors created by Reshape share a list of buckets, each holding a memory
+ * plan of the graph and the pool allocated for it. If the entries of the new
+ * shapes fit in the storage of a bucket, its plan and pool are reused and
+ * PlanMemory is skipped; otherwise the graph is planned anew.
+ */
+nnvm::Graph GraphExecutor::PlanGraphMemory(nnvm::Graph g,
+                                           nnvm::StorageVector&& arg_storage_id) {
+  const auto& idx = g.indexed_graph();
+  const auto& vshape = g.GetAttr<nnvm::ShapeVector>("shape");
+  const auto& vdtype = g.GetAttr<nnvm::DTypeVector>("dtype");
+  auto entry_bytes = [&vshape, &vdtype](uint32_t eid) {
+    return vshape[eid].Size() * mshadow::mshadow_sizeof(vdtype[eid]);
+  };
+  // find the smallest bucket planned for the same graph that fits all entries
+  reshape_bucket_ = -1;
+  if (reshape_buckets_ != nullptr) {
+    for (size_t b = 0; b < reshape_buckets_->size(); ++b) {
+      const ReshapeBucket& bucket = (*reshape_buckets_)[b];
+      if (bucket.ops.size() != idx.num_nodes() || bucket.arg_storage_id != arg_storage_id) {
+        continue;
+      }
+      if (reshape_bucket_ >= 0 &&
+          bucket.total_bytes >= (*reshape_buckets_)[reshape_bucket_].total_bytes) {
+        continue;
+      }
+      bool fit = true;
+      for (uint32_t nid = 0; fit && nid < idx.num_nodes(); ++nid) {
+        const auto& inode = idx[nid];
+        if (inode.source->op() != bucket.ops[nid]) {
+          fit = false;
+          break;
+        }
+        for (uint32_t i = 0; i < inode.source->num_outputs(); ++i) {
+          const uint32_t eid = idx.entry_id(nid, i);
+          const int sid = bucket.storage_id[eid];
+          if (sid < 0) continue;
+          if (entry_bytes(eid) > bucket.storage_bytes[sid]) {
+            fit = false;
+            break;
+          }
+          // an output computed in-place must keep the size and type of its input
+          const int in_index = bucket.storage_inplace_index[eid];
+          if (in_index >= 0) {
+            const uint32_t in_eid = idx.entry_id(inode.inputs[in_index]);
+            if (vdtype[in_eid] != vdtype[eid] || vshape[in_eid].Size() != vshape[eid].Size()) {
+              fit = false;
+              break;
+            }
+          }
+        }
+      }
+      if (fit) reshape_bucket_ = static_cast<int>(b);
+    }
+  }
+  if (reshape_bucket_ >= 0) {
+    const ReshapeBucket& bucket = (*reshape_buckets_)[reshape_bucket_];
+    g.attrs["storage_id"] = std::make_shared<dmlc::any>(bucket.storage_id);
+    g.attrs["storage_inplace_index"] = std::make_shared<dmlc::any>(bucket.storage_inplace_index);
+    return g;
+  }
+  g.attrs["storage"] = std::make_shared<dmlc::any>(arg_storage_id);
+  g = nnvm::ApplyPass(g, "PlanMemory");
+  // record the plan so that executors reshaped from this one can reuse it
+  memory_plan_.arg_storage_id = std::move(arg_storage_id);
+  memory_plan_.storage_id = g.GetAttr<nnvm::StorageVector>("storage_id");
+  memory_plan_.storage_inplace_index = g.GetAttr<std::vector<int> >("storage_inplace_index");
+  memory_plan_.ops.resize(idx.num_nodes());
+  memory_plan_.storage_bytes.clear();
+  for (uint32_t nid = 0; nid < idx.num_nodes(); ++nid) {
+    memory_plan_.ops[nid] = idx[nid].source->op();
+    for (uint32_t i = 0; i < idx[nid].source->num_outputs(); ++i) {
+      const uint32_t eid = idx.entry_id(nid, i);
+      const int sid = memory_plan_.storage_id[eid];
+      if (sid < 0) continue;
+      if (static_cast<size_t>(sid) >= memory_plan_.storage_bytes.size()) {
+        memory_plan_.storage_bytes.resize(sid + 1, 0);
+      }
+      memory_plan_.storage_bytes[sid] = std::max(memory_plan_.storage_bytes[sid],
+                                                 entry_bytes(eid));
+    }
+  }
+  memory_plan_.total_bytes = 0;
+  for (size_t bytes : memory_plan_.storage_bytes) memory_plan_.total_bytes += bytes;
+  return g;
 }
 
 /*!
@@ -701,8 +898,10 @@ void GraphExecutor::Init(nnvm::Symbol symbol,
                          std::unordered_map<std::string, NDArray>* shared_buffer,
                          Executor* shared_exec,
                          const nnvm::NodeEntryMap<NDArray>& feed_dict) {
+  init_phase_end_ = dmlc::GetTime();
   nnvm::Graph g = InitGraph(symbol, default_ctx, ctx_map, in_arg_ctxes, arg_grad_ctxes,
-                            aux_state_ctxes, grad_req_types);
+                            aux_state_ctxes, grad_req_types, arg_shape_map, arg_dtype_map);
+  MarkInitPhase("InitGraph");
   // The following code of shape and dtype inferences and argument
   // initialization is for simple_bind only. Regular bind operation
   // should do this differently.
@@ -734,18 +933,21 @@ void GraphExecutor::Init(nnvm::Symbol symbol,
     HandleInferShapeError(num_forward_inputs_, g.indexed_graph(),
                           g.GetAttr<nnvm::ShapeVector>("shape"));
   }
+  MarkInitPhase("InferShape");
 
   g = InferType(std::move(g), std::move(arg_dtypes), "__dtype__");
   if (g.GetAttr<size_t>("dtype_num_unknown_nodes") != 0U) {
     HandleInferTypeError(num_forward_inputs_, g.indexed_graph(),
                          g.GetAttr<nnvm::DTypeVector>("dtype"));
   }
+  MarkInitPhase("InferType");
 
   g = InferStorageType(std::move(g), std::move(arg_stypes), "__storage_type__");
   if (g.GetAttr<size_t>("storage_type_num_unknown_nodes") != 0U) {
     HandleInferStorageTypeError(num_forward_inputs_, g.indexed_graph(),
                                 g.GetAttr<StorageTypeVector>("storage_type"));
   }
+  MarkInitPhase("InferStorageType");
 
   // Create in_args, arg_grads, and aux_states using
   // the inferred shapes and dtypes.
@@ -763,6 +965,7 @@ void GraphExecutor::Init(nnvm::Symbol symbol,
                   grad_req_types, shared_arg_names, shared_exec,
                   shared_buffer, in_arg_vec, arg_grad_vec, aux_state_vec);
   }
+  MarkInitPhase("InitArguments");
   // The above code of shape and dtype inferences and argument
   // initialization is for simple_bind only. Regular bind operation
   // should do this differently.
@@ -789,6 +992,7 @@ Executor* GraphExecutor::Reshape(const bool partial_shaping,
                                  std::vector<NDArray>* in_args,
                                  std::vector<NDArray>* arg_grads,
                                  std::vector<NDArray>* aux_states) {
+  const double start = dmlc::GetTime();
   nnvm::Graph g;
   g.outputs = std::vector<nnvm::NodeEntry>(graph_.outputs.begin(),
     graph_.outputs.begin() + num_forward_outputs_);
@@ -878,10 +1082,29 @@ Executor* GraphExecutor::Reshape(const bool partial_shaping,
       }
     }
   }
+  // executors reshaped from this one share its buckets of memory plans
+  if (reshape_buckets_ == nullptr) {
+    reshape_buckets_ = std::make_shared<std::vector<ReshapeBucket> >();
+    reshape_buckets_->push_back(memory_plan_);
+  }
   auto exec = new GraphExecutor();
+  exec->reshape_buckets_ = reshape_buckets_;
   exec->Init(symbol, default_ctx, ctx_map,
              *in_args, *arg_grads, grad_req_types, *aux_states,
              this);
+  static bool reshape_log_verbose = dmlc::GetEnv("MXNET_EXEC_RESHAPE_VERBOSE_LOGGING", false);
+  if (reshape_log_verbose) {
+    std::ostringstream os;
+    for (const auto& kv : provided_arg_shapes) {
+      os << " " << kv.first << kv.second;
+    }
+    LOG(INFO) << "Reshape to" << os.str() << " took "
+              << (dmlc::GetTime() - start) * 1000 << " ms, "
+              << (exec->reshape_bucket_ >= 0 ? "reused a planned bucket"
+                                             : "planned a new bucket")
+              << ", data pool " << exec->pool_bytes_ / 1048576.0 << " MB, newly allocated "
+              << exec->pool_alloc_bytes_ / 1048576.0 << " MB";
+  }
   return exec;
 }
 /*!
@@ -897,9 +1120,11 @@ Graph GraphExecutor::InitGraph(nnvm::Symbol symbol,
                                const std::vector<Context>& in_arg_ctxes,
                                const std::vector<Context>& arg_grad_ctxes,
                                const std::vector<Context>& aux_state_ctxes,
-                               const std::vector<OpReqType>& grad_req_types) {
+                               const std::vector<OpReqType>& grad_req_types,
+                               const std::unordered_map<std::string, TShape>& arg_shape_map,
+                               const std::unordered_map<std::string, int>& arg_dtype_map) {
   // setup gradient
-  nnvm::Graph g = InitFullGraph(symbol, grad_req_types);
+  nnvm::Graph g = InitFullGraph(symbol, grad_req_types, arg_shape_map, arg_dtype_map);
 
   // create "device" and "context" attrs for the graph
   g = AssignContext(g, default_ctx, ctx_map,
@@ -994,6 +1219,66 @@ void GraphExecutor::InitDataEntryMemory(std::vector<NDArray>* shared_pool) {
       info.bytes = std::max(info.bytes, bytes);
     }
   }
+  // plan the entries in an arena by liveness instead of by storage id
+  const bool mem_log_verbose = dmlc::GetEnv("MXNET_MEM_PLAN_VERBOSE_LOGGING", false);
+  const bool arena_plan = dmlc::GetEnv("MXNET_MEM_PLAN_ARENA", false);
+  // pool and offset in the pool of each entry planned in the arena
+  std::vector<int> entry_pool;
+  std::vector<size_t> entry_offset;
+  if (arena_plan || mem_log_verbose) {
+    std::vector<bool> planned(data_entry_.size());
+    for (size_t i = 0; i < data_entry_.size(); ++i) {
+      planned[i] = data_entry_[i].is_none() && vstorage_type[i] == kDefaultStorage;
+    }
+    std::vector<int> entry_block;
+    const std::vector<ArenaBlock> blocks = PlanArenaMemory(graph_, planned, &entry_block);
+    // blocks overlapping in the arena must share an engine variable, so each
+    // pool holds a maximal range of overlapping blocks
+    std::vector<size_t> order(blocks.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&blocks](size_t lhs, size_t rhs) {
+      if (blocks[lhs].ctx != blocks[rhs].ctx) return blocks[lhs].ctx < blocks[rhs].ctx;
+      return blocks[lhs].offset < blocks[rhs].offset;
+    });
+    std::vector<PoolEntry> arena_pool_info;
+    std::vector<size_t> pool_begin;
+    std::vector<int> block_pool(blocks.size());
+    for (size_t b : order) {
+      const ArenaBlock& block = blocks[b];
+      if (!arena_pool_info.empty() && arena_pool_info.back().ctx == block.ctx &&
+          block.offset < pool_begin.back() + arena_pool_info.back().bytes) {
+        PoolEntry& info = arena_pool_info.back();
+        info.bytes = std::max(info.bytes, block.offset + block.bytes - pool_begin.back());
+      } else {
+        arena_pool_info.push_back(PoolEntry{block.ctx, block.bytes, kDefaultStorage});
+        pool_begin.push_back(block.offset);
+      }
+      block_pool[b] = static_cast<int>(arena_pool_info.size()) - 1;
+    }
+    if (mem_log_verbose) {
+      size_t sid_bytes = 0, arena_bytes = 0;
+      for (const auto& info : pool_info) sid_bytes += info.bytes;
+      for (const auto& info : arena_pool_info) arena_bytes += info.bytes;
+      LOG(INFO) << "Memory plan: " << pool_info.size() << " storage ids take "
+                << (sid_bytes >> 20) << " MB, " << blocks.size() << " arena blocks take "
+                << (arena_bytes >> 20) << " MB ("
+                << (sid_bytes ? 100.0 * (static_cast<double>(sid_bytes) - arena_bytes) / sid_bytes
+                              : 0.0)
+                << "% saved, " << (arena_plan ? "using the arena" : "MXNET_MEM_PLAN_ARENA=0")
+                << ")";
+    }
+    if (arena_plan) {
+      pool_info = std::move(arena_pool_info);
+      entry_pool.assign(data_entry_.size(), -1);
+      entry_offset.assign(data_entry_.size(), 0);
+      for (size_t i = 0; i < data_entry_.size(); ++i) {
+        if (entry_block[i] < 0) continue;
+        const int pool = block_pool[entry_block[i]];
+        entry_pool[i] = pool;
+        entry_offset[i] = blocks[entry_block[i]].offset - pool_begin[pool];
+      }
+    }
+  }
   // construct the re-use pool, if needed
   std::multimap<size_t, NDArray> free_pool;
   if (shared_pool != nullptr) {
@@ -1005,6 +1290,8 @@ void GraphExecutor::InitDataEntryMemory(std::vector<NDArray>* shared_pool) {
   // remake the data pool
   data_pool_.clear();
   data_pool_.resize(pool_info.size());
+  pool_bytes_ = 0;
+  pool_alloc_bytes_ = 0;
 
   // sort the pool info the descending order before allocating memory
   std::vector<size_t> sorted_pool_index;
@@ -1019,6 +1306,7 @@ void GraphExecutor::InitDataEntryMemory(std::vector<NDArray>* shared_pool) {
   for (size_t i : sorted_pool_index) {
     const Context& ctx = pool_info[i].ctx;
     size_t bytes = pool_info[i].bytes;
+    pool_bytes_ += bytes;
     bool allocated = false;
     for (auto it = free_pool.lower_bound(bytes); it != free_pool.end(); ++it) {
       if (it->second.ctx() == ctx && it->first >= bytes) {
@@ -1029,6 +1317,7 @@ void GraphExecutor::InitDataEntryMemory(std::vector<NDArray>* shared_pool) {
       }
     }
     if (!allocated) {
+      pool_alloc_bytes_ += bytes;
       size_t nword = (bytes + 3) / 4;
       CHECK_LE(nword, std::numeric_limits<nnvm::dim_t>::max());
       // allocate float arrays
@@ -1053,8 +1342,13 @@ void GraphExecutor::InitDataEntryMemory(std::vector<NDArray>* shared_pool) {
     auto storage_type = (NDArrayStorageType) vstorage_type[i];
     if (storage_type == kDefaultStorage) {
       CHECK_GE(storage_id, 0) << "Do not support runtime shape op yet";
-      const NDArray& src = data_pool_.at(storage_id);
-      data_entry_[i] = src.AsArray(vshape[i], vdtype[i]);
+      if (!entry_pool.empty()) {
+        const NDArray& src = data_pool_.at(entry_pool[i]);
+        data_entry_[i] = src.AsArrayAt(entry_offset[i], vshape[i], vdtype[i]);
+      } else {
+        const NDArray& src = data_pool_.at(storage_id);
+        data_entry_[i] = src.AsArray(vshape[i], vdtype[i]);
+      }
     } else {
       data_entry_[i] = NDArray(storage_type, vshape[i], data_context[i],
                                true, vdtype[i]);
@@ -1117,10 +1411,11 @@ void GraphExecutor::InitCachedOps() {
     op_nodes_[e.node_id].exec->req[e.index] =
         grad_store_[j - num_forward_outputs_].first;
   }
-  for (uint32_t nid = 0; nid < idx.num_nodes(); ++nid) {
+  // operators are created in parallel, each node only touches its own OpNode
+  ParallelFor(idx.num_nodes(), GetExecInitNumThreads(idx.num_nodes()), [&](size_t nid) {
     const auto& inode = idx[nid];
-    if (inode.source->is_variable()) continue;
-    if (op_nodes_[nid].skip_exec_node) continue;
+    if (inode.source->is_variable()) return;
+    if (op_nodes_[nid].skip_exec_node) return;
     auto& exec = op_nodes_[nid].exec;
     bool is_async = op_nodes_[nid].exec->exec_type() == ExecType::kAsync;
     bool is_gpu = op_nodes_[nid].ctx.dev_mask() == gpu::kDevMask;
@@ -1142,17 +1437,6 @@ void GraphExecutor::InitCachedOps() {
     }
     // dedup vars
     Engine::Get()->DeduplicateVarHandle(&use_vars, &mutate_vars);
-    // all vars include both mutate vars and use vars
-    std::vector<Engine::VarHandle> all_vars(use_vars);
-    std::copy(mutate_vars.begin(), mutate_vars.end(),
-              std::inserter(all_vars, all_vars.end()));
-    // setup exec vars
-    Engine::Get()->PushAsync(
-      [exec](RunContext rctx, Engine::CallbackOnComplete on_complete) {
-        exec->Setup();
-        on_complete();
-      }, Context::CPU(), {}, all_vars, FnProperty::kNormal, 0,
-      "SetupExec");
     auto exec_fun = [exec, is_async, is_gpu] (
         RunContext ctx, Engine::CallbackOnComplete on_complete) {
       if (is_async) {
@@ -1178,7 +1462,173 @@ void GraphExecutor::InitCachedOps() {
         op_nodes_[nid].opr_name);
     op_nodes_[nid].mutate_vars = mutate_vars;
     op_nodes_[nid].use_vars = use_vars;
+  });
+  for (uint32_t nid = 0; nid < idx.num_nodes(); ++nid) {
+    if (idx[nid].source->is_variable()) continue;
+    if (op_nodes_[nid].skip_exec_node) continue;
+    auto& exec = op_nodes_[nid].exec;
+    // all vars include both mutate vars and use vars
+    std::vector<Engine::VarHandle> all_vars(op_nodes_[nid].use_vars);
+    std::copy(op_nodes_[nid].mutate_vars.begin(), op_nodes_[nid].mutate_vars.end(),
+              std::inserter(all_vars, all_vars.end()));
+    // setup exec vars
+    Engine::Get()->PushAsync(
+      [exec](RunContext rctx, Engine::CallbackOnComplete on_complete) {
+        exec->Setup();
+        on_complete();
+      }, Context::CPU(), {}, all_vars, FnProperty::kNormal, 0,
+      "SetupExec");
+  }
+}
+
+void GraphExecutor::InitFusedOps() {
+  fused_groups_.clear();
+  if (!dmlc::GetEnv("MXNET_EXEC_ENABLE_ELEMWISE_FUSION", true)) return;
+  const auto& idx = graph_.indexed_graph();
+  const auto& vshape = graph_.GetAttr<nnvm::ShapeVector>("shape");
+  const auto& vdtype = graph_.GetAttr<nnvm::DTypeVector>("dtype");
+  const auto& vstype = graph_.GetAttr<StorageTypeVector>("storage_type");
+
+  // last node reading each entry, the results of a group
+  // are only written to memory when read after the group
+  std::vector<uint32_t> last_use(idx.num_node_entries(), 0);
+  for (uint32_t nid = 0; nid < idx.num_nodes(); ++nid) {
+    for (const auto& e : idx[nid].inputs) {
+      uint32_t eid = idx.entry_id(e);
+      last_use[eid] = std::max(last_use[eid], nid);
+    }
+  }
+  for (const auto& e : idx.outputs()) {
+    last_use[idx.entry_id(e)] = std::numeric_limits<uint32_t>::max();
+  }
+
+  auto fusable = [&](uint32_t nid) {
+    const auto& inode = idx[nid];
+    if (inode.source->is_variable()) return false;
+    const OpNode& op_node = op_nodes_[nid];
+    if (op_node.skip_exec_node || op_node.exec == nullptr) return false;
+    if (op_node.ctx.dev_mask() != cpu::kDevMask ||
+        op_node.exec->exec_type() != ExecType::kSync ||
+        !op_node.exec->op_ctx.requested.empty() ||
+        op_node.exec->var() != nullptr) {
+      return false;
+    }
+    FusedElemwiseStep step;
+    const int num_inputs = GetFusedElemwiseOp(inode.source->attrs, &step);
+    if (num_inputs == 0 || inode.inputs.size() != static_cast<size_t>(num_inputs) ||
+        inode.source->num_outputs() != 1) {
+      return false;
+    }
+    if (op_node.exec->req[0] != kWriteTo && op_node.exec->req[0] != kWriteInplace) return false;
+    const uint32_t out = idx.entry_id(nid, 0);
+    if (vstype[out] != kDefaultStorage) return false;
+    if (vdtype[out] != mshadow::kFloat32 && vdtype[out] != mshadow::kFloat64 &&
+        vdtype[out] != mshadow::kFloat16) {
+      return false;
+    }
+    for (const auto& e : inode.inputs) {
+      const uint32_t eid = idx.entry_id(e);
+      if (vstype[eid] != kDefaultStorage || vdtype[eid] != vdtype[out] ||
+          vshape[eid] != vshape[out]) {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  std::vector<uint32_t> members;
+  auto create_group = [&]() {
+    if (members.size() < 2) {
+      members.clear();
+      return;
+    }
+    FusedOpGroup group;
+    group.topo_start = members.front();
+    group.topo_end = members.back() + 1;
+    std::vector<FusedElemwiseStep> steps;
+    std::vector<int> out_steps;
+    std::vector<std::shared_ptr<OpExecutor> > execs;
+    std::vector<NDArray> in_array, out_array;
+    std::vector<OpReqType> req;
+    // operand of each entry read or written by the group
+    std::unordered_map<uint32_t, int> operands;
+    for (uint32_t nid : members) {
+      const auto& inode = idx[nid];
+      OpNode& op_node = op_nodes_[nid];
+      FusedElemwiseStep step;
+      GetFusedElemwiseOp(inode.source->attrs, &step);
+      std::vector<int> step_operands;
+      for (const auto& e : inode.inputs) {
+        const uint32_t eid = idx.entry_id(e);
+        auto it = operands.find(eid);
+        if (it == operands.end()) {
+          it = operands.emplace(eid, -1 - static_cast<int>(in_array.size())).first;
+          in_array.push_back(data_entry_[eid]);
+        }
+        step_operands.push_back(it->second);
+      }
+      step.lhs = step_operands[0];
+      step.rhs = step_operands.back();
+      const uint32_t out = idx.entry_id(nid, 0);
+      operands[out] = static_cast<int>(steps.size());
+      if (last_use[out] >= group.topo_end) {
+        out_steps.push_back(static_cast<int>(steps.size()));
+        out_array.push_back(op_node.exec->out_array[0]);
+        req.push_back(op_node.exec->req[0]);
+      }
+      steps.push_back(step);
+      execs.push_back(op_node.exec);
+      group.use_vars.insert(group.use_vars.end(),
+                            op_node.use_vars.begin(), op_node.use_vars.end());
+      group.mutate_vars.insert(group.mutate_vars.end(),
+                               op_node.mutate_vars.begin(), op_node.mutate_vars.end());
+    }
+    members.clear();
+    if (out_steps.empty()) return;
+    // tiles of the outputs are written after the same tiles of the inputs are read,
+    // outputs can only share memory with inputs at the same offset
+    for (const auto& in : in_array) {
+      for (const auto& out : out_array) {
+        if (in.var() == out.var() && !in.IsSame(out)) return;
+      }
+    }
+    group.exec = CreateFusedElemwiseExec(steps, out_steps, execs);
+    group.exec->in_array = std::move(in_array);
+    group.exec->out_array = std::move(out_array);
+    group.exec->req = std::move(req);
+    Engine::Get()->DeduplicateVarHandle(&group.use_vars, &group.mutate_vars);
+    auto exec = group.exec;
+    group.cached_opr = Engine::Get()->NewOperator(
+        [exec](RunContext ctx, Engine::CallbackOnComplete on_complete) {
+          exec->Run(ctx, false);
+          on_complete();
+        }, group.use_vars, group.mutate_vars, FnProperty::kNormal, "FusedElemwise");
+    for (size_t nid = group.topo_start; nid < group.topo_end; ++nid) {
+      op_nodes_[nid].fused_group = static_cast<int>(fused_groups_.size());
+    }
+    if (log_verbose_) {
+      LOG(INFO) << "\tfused " << steps.size() << " elementwise nodes in ["
+                << group.topo_start << ", " << group.topo_end << ")";
+    }
+    fused_groups_.push_back(std::move(group));
+  };
+
+  // only chains of consecutive nodes of the same shape are fused, so that
+  // running them together does not change the order of the graph
+  for (uint32_t nid = 0; nid < idx.num_nodes(); ++nid) {
+    if (nid == num_forward_nodes_) create_group();
+    const bool fuse = fusable(nid);
+    if (!members.empty()) {
+      const uint32_t first = members.front();
+      if (!fuse || op_nodes_[nid].ctx != op_nodes_[first].ctx ||
+          vshape[idx.entry_id(nid, 0)] != vshape[idx.entry_id(first, 0)] ||
+          vdtype[idx.entry_id(nid, 0)] != vdtype[idx.entry_id(first, 0)]) {
+        create_group();
+      }
+    }
+    if (fuse) members.push_back(nid);
   }
+  create_group();
 }
 
 void GraphExecutor::InitOpSegs() {
@@ -1289,6 +1739,12 @@ void GraphExecutor::BulkInferenceOpSegs() {
   }
 }
 
+void GraphExecutor::MarkInitPhase(const char* phase) {
+  const double now = dmlc::GetTime();
+  init_phases_.emplace_back(phase, (now - init_phase_end_) * 1000);
+  init_phase_end_ = now;
+}
+
 void GraphExecutor::ExecuteMonCallback(size_t nid) {
   static const auto& flist_outputs =
       nnvm::Op::GetAttr<nnvm::FListOutputNames>("FListOutputNames");
@@ -1341,6 +1797,16 @@ void GraphExecutor::RunOps(bool is_train, size_t topo_start, size_t topo_end) {
     if (op_nodes_[nid].skip_exec_node) continue;
     opnode.exec->op_ctx.is_train = is_train;
     opnode.exec->op_ctx.need_grad = need_grad_;
+    // Fused elementwise nodes, run separately if only a part of them is requested
+    if (monitor_callback_ == nullptr && opnode.fused_group >= 0) {
+      const FusedOpGroup& group = fused_groups_[opnode.fused_group];
+      if (group.topo_start == nid && group.topo_end <= topo_end) {
+        bool profiling = profiler::Profiler::Get()->GetState() == profiler::Profiler::kRunning;
+        Engine::Get()->Push(group.cached_opr, opnode.ctx, 0, profiling);
+        nid = group.topo_end - 1;
+        continue;
+      }
+    }
     if (opnode.exec->exec_type() == ExecType::kCrossDeviceCopy) {
       CHECK_EQ(inode.inputs.size(), 1U);
       CHECK_EQ(opnode.exec->in_array.size(), 1U);
@@ -1390,6 +1856,19 @@ GraphExecutor::CachedSegOpr GraphExecutor::CreateCachedSegOpr(size_t topo_start,
     if (*pctx != op_node.ctx) {
       return ret;
     }
+    if (op_node.fused_group >= 0) {
+      const FusedOpGroup& group = fused_groups_[op_node.fused_group];
+      if (group.topo_start == nid && group.topo_end <= topo_end) {
+        std::copy(group.mutate_vars.begin(), group.mutate_vars.end(),
+                  std::inserter(mutate_vars, mutate_vars.end()));
+        std::copy(group.use_vars.begin(), group.use_vars.end(),
+                  std::inserter(use_vars, use_vars.end()));
+        ret.exec_list.push_back(group.exec);
+        opr_names += "FusedElemwise,";
+        nid = group.topo_end - 1;
+        continue;
+      }
+    }
     auto& exec = op_nodes_[nid].exec;
     std::copy(op_node.mutate_vars.begin(), op_node.mutate_vars.end(),
               std::inserter(mutate_vars, mutate_vars.end()));
@@ -34,6 +34,7 @@
 #include <nnvm/op_attr_types.h>
 #include <nnvm/graph_attr_types.h>
 #include <map>
+#include <unordered_map>
 #include <unordered_set>
 #include <string>
 #include <utility>
@@ -135,6 +136,23 @@ class GraphExecutor : public Executor {
     std::vector<Engine::VarHandle> use_vars;
     // cached mutate vars, used for seg ops creation
     std::vector<Engine::VarHandle> mutate_vars;
+    // index of the fused elementwise group of the node, -1 for none
+    int fused_group{-1};
+  };
+  // consecutive elementwise nodes executed by a single fused kernel
+  struct FusedOpGroup {
+    // begin in topo order
+    size_t topo_start;
+    // end in topo order
+    size_t topo_end;
+    // the fused executor
+    std::shared_ptr<OpExecutor> exec;
+    // the cached operator
+    Engine::OprHandle cached_opr{nullptr};
+    // cached const vars, used for seg ops creation
+    std::vector<Engine::VarHandle> use_vars;
+    // cached mutate vars, used for seg ops creation
+    std::vector<Engine::VarHandle> mutate_vars;
   };
   // a cached segment operator that executes a segment
   struct CachedSegOpr {
@@ -149,6 +167,23 @@ class GraphExecutor : public Executor {
     // list of op executors
     std::vector<std::shared_ptr<OpExecutor> > exec_list;
   };
+  // a memory plan and its allocated pool, reused by executors reshaped
+  // to shapes whose entries fit in the pool
+  struct ReshapeBucket {
+    // storage requested by the executor before planning
+    nnvm::StorageVector arg_storage_id;
+    // planned storage ids and in-place indices, before add-to detection
+    nnvm::StorageVector storage_id;
+    std::vector<int> storage_inplace_index;
+    // operator of each node, to check the graph structure
+    std::vector<const nnvm::Op*> ops;
+    // maximum bytes of each storage id
+    std::vector<size_t> storage_bytes;
+    // total bytes of storage_bytes
+    size_t total_bytes{0};
+    // allocated pool of the executor
+    std::vector<NDArray> pool;
+  };
   // Initialize in_args, arg_grads, and aux_states
   void InitArguments(const nnvm::IndexedGraph& idx,
                      const nnvm::ShapeVector& inferred_shapes,
@@ -185,18 +220,31 @@ class GraphExecutor : public Executor {
                   const std::vector<Context>& in_arg_ctxes,
                   const std::vector<Context>& arg_grad_ctxes,
                   const std::vector<Context>& aux_state_ctxes,
-                  const std::vector<OpReqType>& grad_req_types);
-  // intialize the full graph for simple bind, including gradient
+                  const std::vector<OpReqType>& grad_req_types,
+                  const std::unordered_map<std::string, TShape>& arg_shape_map
+                    = std::unordered_map<std::string, TShape>(),
+                  const std::unordered_map<std::string, int>& arg_dtype_map
+                    = std::unordered_map<std::string, int>());
+  // intialize the full graph for simple bind, including gradient.
+  // The known input shapes and types are used to plan gradient checkpoints.
   Graph InitFullGraph(nnvm::Symbol symbol,
-                      const std::vector<OpReqType>& grad_req_types);
+                      const std::vector<OpReqType>& grad_req_types,
+                      const std::unordered_map<std::string, TShape>& arg_shape_map
+                        = std::unordered_map<std::string, TShape>(),
+                      const std::unordered_map<std::string, int>& arg_dtype_map
+                        = std::unordered_map<std::string, int>());
   // initialize the cached operator
   void InitCachedOps();
+  // fuse chains of elementwise nodes into single kernels
+  void InitFusedOps();
   // initialize the opr segments for bulk exec
   void InitOpSegs();
   // initialize the resources in the graph
   // initialize the memory of data entries
   // shared_pool: extra memory shared from other parts
   void InitDataEntryMemory(std::vector<NDArray>* shared_pool);
+  // plan the memory of graph g, reusing the plan of a reshape bucket if one fits
+  nnvm::Graph PlanGraphMemory(nnvm::Graph g, nnvm::StorageVector&& arg_storage_id);
   // run ops from topo order start to end
   void RunOps(bool is_train, size_t topo_start, size_t topo_end);
   /*!
@@ -209,6 +257,8 @@ class GraphExecutor : public Executor {
   CachedSegOpr CreateCachedSegOpr(size_t topo_start, size_t topo_end);
   // run the monitor callback for node `nid`
   void ExecuteMonCallback(size_t nid);
+  // record the time since the last phase of initialization
+  void MarkInitPhase(const char* phase);
   // peform bulking and segmentation on an inference graph
   void BulkInferenceOpSegs();
   // perform bulking and segmentation on a training graph
@@ -250,10 +300,25 @@ class GraphExecutor : public Executor {
   std::function<void(const char*, void*)> monitor_callback_{nullptr};
   // whether to enable bulk execution
   bool prefer_bulk_execution_;
+  // fused elementwise groups
+  std::vector<FusedOpGroup> fused_groups_;
   // cached segment operator
   std::vector<CachedSegOpr> cached_seg_opr_;
   // cached segment operator name (needs a longer lifecycle than cached_seg_opr_)
   std::unordered_set<std::string> cached_seg_opr_names_;
+  // memory plan of this executor, recorded as a reshape bucket
+  ReshapeBucket memory_plan_;
+  // index of the reshape bucket whose plan was reused, -1 if planned anew
+  int reshape_bucket_{-1};
+  // reshape buckets shared by this executor and the executors reshaped from it
+  std::shared_ptr<std::vector<ReshapeBucket> > reshape_buckets_;
+  // bytes of the data pool and bytes newly allocated for it
+  size_t pool_bytes_{0};
+  size_t pool_alloc_bytes_{0};
+  // phases of initialization and their time in ms
+  std::vector<std::pair<const char*, double> > init_phases_;
+  // end time of the last phase of initialization
+  double init_phase_end_{0};
   // verbose logging
   bool log_verbose_ = false;
 };
@@ -174,9 +174,20 @@ CachedOp::CachedOp(
     CHECK_GT(xs.size(), 0)
         << "There are no inputs in computation graph that require gradients.";
 
+    // shapes are not known yet, checkpoints are planned by number of nodes
+    const double checkpoint_mb = dmlc::GetEnv("MXNET_BACKWARD_CHECKPOINT_MB", 0.0);
+    const std::unordered_set<const nnvm::Node*> recompute =
+        exec::PlanCheckpoints(fwd_graph_, checkpoint_mb);
+    std::function<int(const nnvm::Node&)> need_mirror = nullptr;
+    if (!recompute.empty()) {
+      need_mirror = [&recompute](const nnvm::Node& node) -> int {
+        return recompute.count(&node);
+      };
+    }
+
     grad_graph_ = pass::Gradient(
         fwd_graph_, fwd_graph_.outputs, xs, ograd_entries_,
-        exec::AggregateGradient, nullptr, nullptr,
+        exec::AggregateGradient, need_mirror, nullptr,
         zero_ops, "_copy");
   }
 
@@ -249,24 +249,92 @@ class DefaultImageAugmenter : public ImageAugmenter {
       return inter_method;
     }
   }
+  // get the range of random aspect ratios
+  void GetAspectRatioRange(float *min_aspect_ratio, float *max_aspect_ratio) const {
+    if (param_.min_aspect_ratio.has_value()) {
+      *max_aspect_ratio = param_.max_aspect_ratio;
+      *min_aspect_ratio = param_.min_aspect_ratio.value();
+    } else {
+      *max_aspect_ratio = 1 + param_.max_aspect_ratio;
+      *min_aspect_ratio = 1 - param_.max_aspect_ratio;
+    }
+  }
+  // whether an affine transformation is applied after resizing
+  bool HasAffine(float min_aspect_ratio, float max_aspect_ratio) const {
+    return param_.max_rotate_angle > 0 || param_.max_shear_ratio > 0.0f
+        || param_.rotate > 0 || rotate_list_.size() > 0
+        || param_.max_random_scale != 1.0f || param_.min_random_scale != 1.0
+        || (!param_.random_resized_crop && (min_aspect_ratio != 1.0f || max_aspect_ratio != 1.0f))
+        || param_.max_img_size != 1e10f || param_.min_img_size != 0.0f;
+  }
+  int MinSourceEdge() const override {
+    // everything after resizing the shorter edge is independent of the source resolution
+    if (param_.resize != -1) return param_.resize;
+    float max_aspect_ratio, min_aspect_ratio;
+    GetAspectRatioRange(&min_aspect_ratio, &max_aspect_ratio);
+    // random resized crops are relative to the image size, keep the
+    // smallest possible crop at least as large as the output
+    const bool random_crop_area = param_.max_random_area != 1.0f ||
+        param_.min_random_area != 1.0f || max_aspect_ratio != 1.0f || min_aspect_ratio != 1.0f;
+    if (param_.random_resized_crop && random_crop_area && param_.pad == 0 &&
+        !HasAffine(min_aspect_ratio, max_aspect_ratio) &&
+        min_aspect_ratio > 0.0f && param_.min_random_area > 0.0f) {
+      const float max_ratio = std::max(max_aspect_ratio, 1.0f / min_aspect_ratio);
+      const float out_edge = std::max(param_.data_shape[1], param_.data_shape[2]);
+      return static_cast<int>(std::ceil(out_edge * std::sqrt(max_ratio / param_.min_random_area)));
+    }
+    return 0;
+  }
+  bool SupportsWindow() const override {
+    float max_aspect_ratio, min_aspect_ratio;
+    GetAspectRatioRange(&min_aspect_ratio, &max_aspect_ratio);
+    // conflicting random_resized_crop settings are reported by Process
+    const bool crop_conflict = param_.random_resized_crop &&
+        (param_.min_random_scale != 1.0f || param_.max_random_scale != 1.0f ||
+         param_.min_crop_size != -1 || param_.max_crop_size != -1 || param_.rand_crop);
+    return param_.inter_method == 1 && param_.pad == 0 && !crop_conflict &&
+        !HasAffine(min_aspect_ratio, max_aspect_ratio) &&
+        param_.brightness == 0.0f && param_.contrast == 0.0f && param_.saturation == 0.0f &&
+        param_.random_h == 0 && param_.random_s == 0 && param_.random_l == 0 &&
+        param_.pca_noise == 0.0f;
+  }
+  cv::Rect_<float> SampleWindow(int rows, int cols, common::RANDOM_ENGINE *prnd) override {
+    if (!seed_init_state && param_.seed_aug.has_value()) {
+      prnd->seed(param_.seed_aug.value());
+      seed_init_state = true;
+    }
+    // SupportsWindow leaves out the affine transformation and padding, so the crop
+    // is taken from the source resized like in Process
+    int res_rows = rows, res_cols = cols;
+    if (param_.resize != -1) {
+      if (rows > cols) {
+        res_rows = param_.resize*rows/cols;
+        res_cols = param_.resize;
+      } else {
+        res_rows = param_.resize;
+        res_cols = param_.resize*cols/rows;
+      }
+    }
+    const Crop crop = SampleCrop(res_rows, res_cols, prnd);
+    if (!crop.enlarge.empty()) {
+      res_rows = crop.enlarge.back().height;
+      res_cols = crop.enlarge.back().width;
+    }
+    // every step above resizes the whole image, map the window back to the source
+    const float scale_x = static_cast<float>(cols) / res_cols;
+    const float scale_y = static_cast<float>(rows) / res_rows;
+    return cv::Rect_<float>(crop.roi.x * scale_x, crop.roi.y * scale_y,
+                            crop.roi.width * scale_x, crop.roi.height * scale_y);
+  }
   cv::Mat Process(const cv::Mat &src, std::vector<float> *label,
                   common::RANDOM_ENGINE *prnd) override {
     if (!seed_init_state && param_.seed_aug.has_value()) {
       prnd->seed(param_.seed_aug.value());
       seed_init_state = true;
     }
-    using mshadow::index_t;
-    bool is_cropped = false;
-
     float max_aspect_ratio = 1.0f;
     float min_aspect_ratio = 1.0f;
-    if (param_.min_aspect_ratio.has_value()) {
-      max_aspect_ratio = param_.max_aspect_ratio;
-      min_aspect_ratio = param_.min_aspect_ratio.value();
-    } else {
-      max_aspect_ratio = 1 + param_.max_aspect_ratio;
-      min_aspect_ratio = 1 - param_.max_aspect_ratio;
-    }
+    GetAspectRatioRange(&min_aspect_ratio, &max_aspect_ratio);
 
     cv::Mat res;
     if (param_.resize != -1) {
@@ -290,11 +358,7 @@ class DefaultImageAugmenter : public ImageAugmenter {
     }
 
     // normal augmentation by affine transformation.
-    if (param_.max_rotate_angle > 0 || param_.max_shear_ratio > 0.0f
-        || param_.rotate > 0 || rotate_list_.size() > 0
-        || param_.max_random_scale != 1.0f || param_.min_random_scale != 1.0
-        || (!param_.random_resized_crop && (min_aspect_ratio != 1.0f || max_aspect_ratio != 1.0f))
-        || param_.max_img_size != 1e10f || param_.min_img_size != 0.0f) {
+    if (HasAffine(min_aspect_ratio, max_aspect_ratio)) {
       std::uniform_real_distribution<float> rand_uniform(0, 1);
       // shear
       float s = rand_uniform(*prnd) * param_.max_shear_ratio * 2 - param_.max_shear_ratio;
@@ -354,112 +418,15 @@ class DefaultImageAugmenter : public ImageAugmenter {
                          cv::Scalar(param_.fill_value, param_.fill_value, param_.fill_value));
     }
 
-    if (param_.random_resized_crop) {
-      // random resize crop
-      CHECK(param_.min_random_scale == 1.0f &&
-        param_.max_random_scale == 1.0f &&
-        param_.min_crop_size == -1 &&
-        param_.max_crop_size == -1 &&
-        !param_.rand_crop) <<
-        "\nSetting random_resized_crop to true conflicts with "
-        "min_random_scale, max_random_scale, "
-        "min_crop_size, max_crop_size, "
-        "and rand_crop.";
-
-      if (param_.max_random_area != 1.0f || param_.min_random_area != 1.0f
-          || max_aspect_ratio != 1.0f || min_aspect_ratio != 1.0f) {
-            CHECK(min_aspect_ratio > 0.0f);
-            CHECK(param_.min_random_area <= param_.max_random_area);
-            CHECK(min_aspect_ratio <= max_aspect_ratio);
-            std::uniform_real_distribution<float> rand_uniform_area(param_.min_random_area,
-                                                                    param_.max_random_area);
-            std::uniform_real_distribution<float> rand_uniform_ratio(min_aspect_ratio,
-                                                                     max_aspect_ratio);
-            std::uniform_real_distribution<float> rand_uniform(0, 1);
-            float area = res.rows * res.cols;
-            for (int i = 0; i < 10; ++i) {
-              float rand_area = rand_uniform_area(*prnd);
-              float ratio = rand_uniform_ratio(*prnd);
-              float target_area = area * rand_area;
-              int y_area = std::round(std::sqrt(target_area / ratio));
-              int x_area = std::round(std::sqrt(target_area * ratio));
-              if (rand_uniform(*prnd) > 0.5) {
-                float temp_y_area = y_area;
-                y_area = x_area;
-                x_area = temp_y_area;
-              }
-              if (y_area <= res.rows && x_area <= res.cols) {
-                index_t rand_y_area =
-                    std::uniform_int_distribution<index_t>(0, res.rows - y_area)(*prnd);
-                index_t rand_x_area =
-                    std::uniform_int_distribution<index_t>(0, res.cols - x_area)(*prnd);
-                cv::Rect roi(rand_x_area, rand_y_area, x_area, y_area);
-                int interpolation_method = GetInterMethod(param_.inter_method, x_area, y_area,
-                                                          param_.data_shape[2],
-                                                          param_.data_shape[1], prnd);
-                cv::resize(res(roi), res, cv::Size(param_.data_shape[2], param_.data_shape[1]),
-                           0, 0, interpolation_method);
-                is_cropped = true;
-                break;
-              }
-            }
-      }
-    } else if (!param_.random_resized_crop &&
-        (param_.max_crop_size != -1 || param_.min_crop_size != -1)) {
-      // random_crop
-      CHECK(res.cols >= param_.max_crop_size && res.rows >= \
-              param_.max_crop_size && param_.max_crop_size >= param_.min_crop_size)
-          << "input image size smaller than max_crop_size";
-      index_t rand_crop_size =
-          std::uniform_int_distribution<index_t>(param_.min_crop_size, param_.max_crop_size)(*prnd);
-      index_t y = res.rows - rand_crop_size;
-      index_t x = res.cols - rand_crop_size;
-      if (param_.rand_crop != 0) {
-        y = std::uniform_int_distribution<index_t>(0, y)(*prnd);
-        x = std::uniform_int_distribution<index_t>(0, x)(*prnd);
-      } else {
-        y /= 2; x /= 2;
-      }
-      cv::Rect roi(x, y, rand_crop_size, rand_crop_size);
-      int interpolation_method = GetInterMethod(param_.inter_method, rand_crop_size, rand_crop_size,
-                                                param_.data_shape[2], param_.data_shape[1], prnd);
-      cv::resize(res(roi), res, cv::Size(param_.data_shape[2], param_.data_shape[1])
-                , 0, 0, interpolation_method);
-      is_cropped = true;
+    const Crop crop = SampleCrop(res.rows, res.cols, prnd);
+    for (const cv::Size& size : crop.enlarge) {
+      cv::resize(res, res, size, 0, 0, crop.interpolation);
     }
-
-    if (!is_cropped) {
-      // center crop
-      int interpolation_method = GetInterMethod(param_.inter_method, res.cols, res.rows,
-                                                param_.data_shape[2],
-                                                param_.data_shape[1], prnd);
-      if (res.rows < param_.data_shape[1]) {
-        index_t new_cols = static_cast<index_t>(static_cast<float>(param_.data_shape[1]) /
-                                                static_cast<float>(res.rows) *
-                                                static_cast<float>(res.cols));
-        cv::resize(res, res, cv::Size(new_cols, param_.data_shape[1]),
-                   0, 0, interpolation_method);
-      }
-      if (res.cols < param_.data_shape[2]) {
-        index_t new_rows = static_cast<index_t>(static_cast<float>(param_.data_shape[2]) /
-                                                static_cast<float>(res.cols) *
-                                                static_cast<float>(res.rows));
-        cv::resize(res, res, cv::Size(param_.data_shape[2], new_rows),
-                   0, 0, interpolation_method);
-      }
-      CHECK(static_cast<index_t>(res.rows) >= param_.data_shape[1]
-            && static_cast<index_t>(res.cols) >= param_.data_shape[2])
-          << "input image size smaller than input shape";
-      index_t y = res.rows - param_.data_shape[1];
-      index_t x = res.cols - param_.data_shape[2];
-      if (param_.rand_crop != 0) {
-        y = std::uniform_int_distribution<index_t>(0, y)(*prnd);
-        x = std::uniform_int_distribution<index_t>(0, x)(*prnd);
-      } else {
-        y /= 2; x /= 2;
-      }
-      cv::Rect roi(x, y, param_.data_shape[2], param_.data_shape[1]);
-      res = res(roi);
+    if (crop.resize) {
+      cv::resize(res(crop.roi), res, cv::Size(param_.data_shape[2], param_.data_shape[1]),
+                 0, 0, crop.interpolation);
+    } else {
+      res = res(crop.roi);
     }
 
     // color jitter
@@ -548,6 +515,125 @@ class DefaultImageAugmenter : public ImageAugmenter {
 
 
  private:
+  // crop of the image sampled by SampleCrop
+  struct Crop {
+    // sizes the image is enlarged to, in order, before a center crop
+    std::vector<cv::Size> enlarge;
+    // the window, in the enlarged image if any
+    cv::Rect roi;
+    // whether the window is resized to the output shape
+    bool resize = false;
+    // interpolation method for enlarging and resizing
+    int interpolation = 1;
+  };
+  // sample the crop of Process in an image of rows x cols, after resizing, the affine
+  // transformation and padding. Random draws happen in the order of Process so that
+  // SampleWindow gives the same windows for the same random state.
+  Crop SampleCrop(int rows, int cols, common::RANDOM_ENGINE *prnd) {
+    using mshadow::index_t;
+    float max_aspect_ratio = 1.0f;
+    float min_aspect_ratio = 1.0f;
+    GetAspectRatioRange(&min_aspect_ratio, &max_aspect_ratio);
+    Crop crop;
+    if (param_.random_resized_crop) {
+      // random resize crop
+      CHECK(param_.min_random_scale == 1.0f &&
+        param_.max_random_scale == 1.0f &&
+        param_.min_crop_size == -1 &&
+        param_.max_crop_size == -1 &&
+        !param_.rand_crop) <<
+        "\nSetting random_resized_crop to true conflicts with "
+        "min_random_scale, max_random_scale, "
+        "min_crop_size, max_crop_size, "
+        "and rand_crop.";
+
+      if (param_.max_random_area != 1.0f || param_.min_random_area != 1.0f
+          || max_aspect_ratio != 1.0f || min_aspect_ratio != 1.0f) {
+        CHECK(min_aspect_ratio > 0.0f);
+        CHECK(param_.min_random_area <= param_.max_random_area);
+        CHECK(min_aspect_ratio <= max_aspect_ratio);
+        std::uniform_real_distribution<float> rand_uniform_area(param_.min_random_area,
+                                                                param_.max_random_area);
+        std::uniform_real_distribution<float> rand_uniform_ratio(min_aspect_ratio,
+                                                                 max_aspect_ratio);
+        std::uniform_real_distribution<float> rand_uniform(0, 1);
+        float area = rows * cols;
+        for (int i = 0; i < 10; ++i) {
+          float rand_area = rand_uniform_area(*prnd);
+          float ratio = rand_uniform_ratio(*prnd);
+          float target_area = area * rand_area;
+          int y_area = std::round(std::sqrt(target_area / ratio));
+          int x_area = std::round(std::sqrt(target_area * ratio));
+          if (rand_uniform(*prnd) > 0.5) {
+            std::swap(x_area, y_area);
+          }
+          if (y_area <= rows && x_area <= cols) {
+            index_t rand_y_area =
+                std::uniform_int_distribution<index_t>(0, rows - y_area)(*prnd);
+            index_t rand_x_area =
+                std::uniform_int_distribution<index_t>(0, cols - x_area)(*prnd);
+            crop.roi = cv::Rect(rand_x_area, rand_y_area, x_area, y_area);
+            crop.interpolation = GetInterMethod(param_.inter_method, x_area, y_area,
+                                                param_.data_shape[2], param_.data_shape[1],
+                                                prnd);
+            crop.resize = true;
+            return crop;
+          }
+        }
+      }
+    } else if (param_.max_crop_size != -1 || param_.min_crop_size != -1) {
+      // random_crop
+      CHECK(cols >= param_.max_crop_size && rows >= \
+              param_.max_crop_size && param_.max_crop_size >= param_.min_crop_size)
+          << "input image size smaller than max_crop_size";
+      index_t rand_crop_size =
+          std::uniform_int_distribution<index_t>(param_.min_crop_size, param_.max_crop_size)(*prnd);
+      index_t y = rows - rand_crop_size;
+      index_t x = cols - rand_crop_size;
+      if (param_.rand_crop != 0) {
+        y = std::uniform_int_distribution<index_t>(0, y)(*prnd);
+        x = std::uniform_int_distribution<index_t>(0, x)(*prnd);
+      } else {
+        y /= 2; x /= 2;
+      }
+      crop.roi = cv::Rect(x, y, rand_crop_size, rand_crop_size);
+      crop.interpolation = GetInterMethod(param_.inter_method, rand_crop_size, rand_crop_size,
+                                          param_.data_shape[2], param_.data_shape[1], prnd);
+      crop.resize = true;
+      return crop;
+    }
+
+    // center crop, enlarging images smaller than the output first
+    crop.interpolation = GetInterMethod(param_.inter_method, cols, rows,
+                                        param_.data_shape[2], param_.data_shape[1], prnd);
+    if (rows < static_cast<int>(param_.data_shape[1])) {
+      cols = static_cast<index_t>(static_cast<float>(param_.data_shape[1]) /
+                                  static_cast<float>(rows) *
+                                  static_cast<float>(cols));
+      rows = param_.data_shape[1];
+      crop.enlarge.emplace_back(cols, rows);
+    }
+    if (cols < static_cast<int>(param_.data_shape[2])) {
+      rows = static_cast<index_t>(static_cast<float>(param_.data_shape[2]) /
+                                  static_cast<float>(cols) *
+                                  static_cast<float>(rows));
+      cols = param_.data_shape[2];
+      crop.enlarge.emplace_back(cols, rows);
+    }
+    CHECK(static_cast<index_t>(rows) >= param_.data_shape[1]
+          && static_cast<index_t>(cols) >= param_.data_shape[2])
+        << "input image size smaller than input shape";
+    index_t y = rows - param_.data_shape[1];
+    index_t x = cols - param_.data_shape[2];
+    if (param_.rand_crop != 0) {
+      y = std::uniform_int_distribution<index_t>(0, y)(*prnd);
+      x = std::uniform_int_distribution<index_t>(0, x)(*prnd);
+    } else {
+      y /= 2; x /= 2;
+    }
+    crop.roi = cv::Rect(x, y, param_.data_shape[2], param_.data_shape[1]);
+    return crop;
+  }
   // temporal space
   cv::Mat temp_;
   // rotation param
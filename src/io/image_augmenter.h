@@ -59,6 +59,35 @@ class ImageAugmenter {
    */
   virtual cv::Mat Process(const cv::Mat &src, std::vector<float> *label,
                           common::RANDOM_ENGINE *prnd) = 0;
+  /*!
+   * \brief shortest edge the source image can be downscaled to before Process
+   *   without changing the result other than by resampling, this allows
+   *   decoders to produce smaller images directly.
+   * \return the edge length in pixels, or 0 if the result depends on the
+   *   resolution of the source image.
+   */
+  virtual int MinSourceEdge() const {
+    return 0;
+  }
+  /*!
+   * \brief whether Process only crops a window of the source and resizes it
+   *   to the output shape, in which case SampleWindow can be used instead.
+   */
+  virtual bool SupportsWindow() const {
+    return false;
+  }
+  /*!
+   * \brief sample the window Process would crop, with the same random draws,
+   *   so that callers can crop and resize the source in a single pass.
+   * \param rows number of rows of the source image
+   * \param cols number of columns of the source image
+   * \param prnd pointer to random number generator.
+   * \return The window in source pixels.
+   */
+  virtual cv::Rect_<float> SampleWindow(int rows, int cols, common::RANDOM_ENGINE *prnd) {
+    LOG(FATAL) << "SampleWindow is not supported by this augmenter";
+    return cv::Rect_<float>();
+  }
   // virtual destructor
   virtual ~ImageAugmenter() {}
   /*!
@@ -27,6 +27,7 @@
 #define MXNET_IO_IMAGE_ITER_COMMON_H_
 
 #include <mxnet/io.h>
+#include <algorithm>
 #include <vector>
 #include <unordered_map>
 #include <string>
@@ -131,6 +132,14 @@ struct ImageRecParserParam : public dmlc::Parameter<ImageRecParserParam> {
   size_t shuffle_chunk_size;
   /*! \brief the seed for chunk shuffling*/
   int shuffle_chunk_seed;
+  /*! \brief whether to read records in place from a memory mapping */
+  bool use_mmap;
+  /*! \brief whether to shuffle and shard single records through the index */
+  bool global_shuffle;
+  /*! \brief whether to downscale JPEG images while decoding them */
+  bool jpeg_dct_scaling;
+  /*! \brief whether to crop, resize, mirror and normalize images in one pass */
+  bool fused_augment;
 
   // declare parameters
   DMLC_DECLARE_PARAMETER(ImageRecParserParam) {
@@ -165,6 +174,57 @@ struct ImageRecParserParam : public dmlc::Parameter<ImageRecParserParam> {
         .describe("The data shuffle buffer size in MB. Only valid if shuffle is true.");
     DMLC_DECLARE_FIELD(shuffle_chunk_seed).set_default(0)
         .describe("The random seed for shuffling");
+    DMLC_DECLARE_FIELD(use_mmap).set_default(false)
+        .describe("Whether to memory-map the image RecordIO file and decode records in place. "
+                  "Requires a local file and its path_imgidx. Shuffling then permutes "
+                  "single records and shuffle_chunk_size is ignored.");
+    DMLC_DECLARE_FIELD(global_shuffle).set_default(false)
+        .describe("Whether to read single records located by path_imgidx, with one "
+                  "permutation of all records per epoch when shuffle is true. Every part "
+                  "draws the same permutation from seed and reads its slice of it, so the "
+                  "parts stay disjoint. Records of a batch are read in file order with "
+                  "nearby records merged into one read, or from the mapping with use_mmap. "
+                  "Requires a local file.");
+    DMLC_DECLARE_FIELD(jpeg_dct_scaling).set_default(false)
+        .describe("Whether to decode JPEG images at 1/2, 1/4 or 1/8 of their size when "
+                  "the augmentations only need the smaller image, e.g. when ``resize`` "
+                  "is set. Requires libjpeg-turbo.");
+    DMLC_DECLARE_FIELD(fused_augment).set_default(false)
+        .describe("Whether to crop, resize, mirror and normalize each image in a single "
+                  "bilinear pass straight into the batch when the augmentations only crop "
+                  "and resize, instead of chaining OpenCV calls.");
+  }
+};
+
+// Define pipelined image record parser parameters
+struct ImageRecPipelineParam : public dmlc::Parameter<ImageRecPipelineParam> {
+  /*! \brief whether to run read, decode, augment and batch as separate stages */
+  bool pipeline;
+  /*! \brief number of threads decoding images */
+  int decode_threads;
+  /*! \brief number of threads augmenting images */
+  int augment_threads;
+  /*! \brief number of threads assembling batches */
+  int batch_threads;
+  /*! \brief capacity of the queues between the stages */
+  int pipeline_queue_size;
+
+  // declare parameters
+  DMLC_DECLARE_PARAMETER(ImageRecPipelineParam) {
+    DMLC_DECLARE_FIELD(pipeline).set_default(false)
+        .describe("Whether to run chunk reading, decoding, augmentation and batch assembly "
+                  "as separate pipeline stages connected by bounded queues, instead of "
+                  "one parallel region per chunk.");
+    DMLC_DECLARE_FIELD(decode_threads).set_lower_bound(1).set_default(4)
+        .describe("The number of threads decoding images. Only valid if pipeline is true.");
+    DMLC_DECLARE_FIELD(augment_threads).set_lower_bound(1).set_default(4)
+        .describe("The number of threads augmenting images. Only valid if pipeline is true.");
+    DMLC_DECLARE_FIELD(batch_threads).set_lower_bound(1).set_default(1)
+        .describe("The number of threads copying images into batches. "
+                  "Only valid if pipeline is true.");
+    DMLC_DECLARE_FIELD(pipeline_queue_size).set_lower_bound(1).set_default(256)
+        .describe("The maximum number of records or images buffered between two stages. "
+                  "Only valid if pipeline is true.");
   }
 };
 
@@ -356,6 +416,41 @@ struct PrefetcherParam : public dmlc::Parameter<PrefetcherParam> {
   }
 };
 
+// Define adaptive prefetch parameters
+struct PrefetchDepthParam : public dmlc::Parameter<PrefetchDepthParam> {
+  /*! \brief whether to adapt the number of batches loaded ahead */
+  bool adaptive_prefetch;
+  /*! \brief memory budget of the batches loaded ahead in MB */
+  size_t prefetch_memory;
+
+  // declare parameters
+  DMLC_DECLARE_PARAMETER(PrefetchDepthParam) {
+    DMLC_DECLARE_FIELD(adaptive_prefetch).set_default(false)
+        .describe("Whether to adapt the number of batches loaded ahead of the consumer to "
+                  "the measured loading and consuming times. The depth starts at "
+                  "prefetch_buffer, grows when the consumer waits for a batch and "
+                  "shrinks while it never waits.");
+    DMLC_DECLARE_FIELD(prefetch_memory).set_default(0)
+        .describe("Memory budget in MB of the batches loaded ahead when adaptive_prefetch "
+                  "is set. 0 means no budget.");
+  }
+};
+
+/*!
+ * \brief the largest JPEG DCT scaling denominator out of 2, 4 and 8 that keeps
+ *  the shorter edge of a rows x cols image at least min_edge
+ * \return the denominator, or 1 if the image should be decoded at full size
+ */
+inline int JPEGScaleDenom(int rows, int cols, int min_edge) {
+  if (min_edge <= 0) return 1;
+  const int edge = std::min(rows, cols);
+  for (int denom = 8; denom > 1; denom /= 2) {
+    // libjpeg-turbo rounds the scaled size up, like TJSCALED
+    if ((edge + denom - 1) / denom >= min_edge) return denom;
+  }
+  return 1;
+}
+
 }  // namespace io
 }  // namespace mxnet
 
@@ -0,0 +1,166 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ *  Copyright (c) 2018 by Contributors
+ * \file image_remap.h
+ * \brief crop, resize, mirror and normalize a decoded image into a tensor in one pass
+ */
+#ifndef MXNET_IO_IMAGE_REMAP_H_
+#define MXNET_IO_IMAGE_REMAP_H_
+
+#if MXNET_USE_OPENCV
+#include <dmlc/logging.h>
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace mxnet {
+namespace io {
+/*! \brief per channel normalization out = (in - mean) * mult + bias, in output channel order */
+struct RemapNormalizer {
+  /*! \brief whether to normalize at all */
+  bool enabled{false};
+  float mean[4]{0, 0, 0, 0};
+  float mult[4]{1, 1, 1, 1};
+  float bias[4]{0, 0, 0, 0};
+  /*! \brief mean image in output shape, replaces mean if set */
+  const float* mean_img{nullptr};
+};
+
+namespace remap {
+// convert an interpolated pixel to the output type
+template<typename DType>
+inline DType CastPixel(float v) {
+  return static_cast<DType>(v);
+}
+template<>
+inline uint8_t CastPixel<uint8_t>(float v) {
+  return static_cast<uint8_t>(std::min(std::max(v + 0.5f, 0.0f), 255.0f));
+}
+// bilinear taps of output positions along one axis, in the convention of cv::resize
+inline void ComputeTaps(float start, float size, int out_size, int src_size, bool reverse,
+                        std::vector<int>* i0, std::vector<int>* i1, std::vector<float>* frac) {
+  i0->resize(out_size);
+  i1->resize(out_size);
+  frac->resize(out_size);
+  const float scale = size / out_size;
+  for (int o = 0; o < out_size; ++o) {
+    const int pos = reverse ? out_size - 1 - o : o;
+    float s = start + (pos + 0.5f) * scale - 0.5f;
+    s = std::min(std::max(s, 0.0f), static_cast<float>(src_size - 1));
+    const int s0 = static_cast<int>(s);
+    (*i0)[o] = s0;
+    (*i1)[o] = std::min(s0 + 1, src_size - 1);
+    (*frac)[o] = s - s0;
+  }
+}
+}  // namespace remap
+
+/*!
+ * \brief Sample window of an 8-bit BGR(A) or gray image with bilinear
+ *  interpolation into a CHW tensor of out_rows x out_cols, swapping to RGB(A),
+ *  optionally mirroring horizontally and normalizing, without intermediate images.
+ *  Source rows are interpolated horizontally once into float rows, so the
+ *  vertical interpolation, normalization and store run over contiguous arrays
+ *  that the compiler can vectorize.
+ */
+template<typename DType>
+inline void RemapImage(const cv::Mat& src, const cv::Rect_<float>& window, bool mirror,
+                       const RemapNormalizer& norm, int out_rows, int out_cols, DType* out) {
+  CHECK_EQ(src.depth(), CV_8U);
+  const int channels = src.channels();
+  CHECK(channels == 1 || channels == 3 || channels == 4) << "Unsupported number of channels";
+  const int swap[4] = {channels == 1 ? 0 : 2, 1, 0, 3};
+  std::vector<int> x0, x1, y0, y1;
+  std::vector<float> fx, fy;
+  remap::ComputeTaps(window.x, window.width, out_cols, src.cols, mirror, &x0, &x1, &fx);
+  remap::ComputeTaps(window.y, window.height, out_rows, src.rows, false, &y0, &y1, &fy);
+
+  // horizontally interpolated source rows, one plane per channel
+  std::vector<float> rows_buf(2 * channels * out_cols);
+  float* row_a = rows_buf.data();
+  float* row_b = row_a + channels * out_cols;
+  int row_a_index = -1, row_b_index = -1;
+  auto interpolate_row = [&](int index, float* dst) {
+    const uchar* p = src.ptr<uchar>(index);
+    for (int c = 0; c < channels; ++c) {
+      const uchar* pc = p + swap[c];
+      float* d = dst + c * out_cols;
+      for (int j = 0; j < out_cols; ++j) {
+        const float v0 = pc[x0[j] * channels], v1 = pc[x1[j] * channels];
+        d[j] = v0 + (v1 - v0) * fx[j];
+      }
+    }
+  };
+  const size_t plane = static_cast<size_t>(out_rows) * out_cols;
+  for (int i = 0; i < out_rows; ++i) {
+    // consecutive output rows mostly share their source rows
+    if (row_a_index != y0[i]) {
+      if (row_b_index == y0[i]) {
+        std::swap(row_a, row_b);
+        std::swap(row_a_index, row_b_index);
+      } else {
+        interpolate_row(y0[i], row_a);
+        row_a_index = y0[i];
+      }
+    }
+    if (row_b_index != y1[i]) {
+      interpolate_row(y1[i], row_b);
+      row_b_index = y1[i];
+    }
+    const float wy = fy[i];
+    for (int c = 0; c < channels; ++c) {
+      const float* a = row_a + c * out_cols;
+      const float* b = row_b + c * out_cols;
+      DType* o = out + c * plane + static_cast<size_t>(i) * out_cols;
+      if (!norm.enabled) {
+        for (int j = 0; j < out_cols; ++j) {
+          o[j] = remap::CastPixel<DType>(a[j] + (b[j] - a[j]) * wy);
+        }
+      } else if (norm.mean_img != nullptr) {
+        // the mean image is subtracted before mirroring, so it is read mirrored too
+        const float* m = norm.mean_img + c * plane + static_cast<size_t>(i) * out_cols;
+        const float mult = norm.mult[c], bias = norm.bias[c];
+        if (mirror) {
+          const float* m_end = m + out_cols - 1;
+          for (int j = 0; j < out_cols; ++j) {
+            o[j] = remap::CastPixel<DType>((a[j] + (b[j] - a[j]) * wy - m_end[-j]) * mult +
+                                           bias);
+          }
+        } else {
+          for (int j = 0; j < out_cols; ++j) {
+            o[j] = remap::CastPixel<DType>((a[j] + (b[j] - a[j]) * wy - m[j]) * mult + bias);
+          }
+        }
+      } else {
+        const float mean = norm.mean[c], mult = norm.mult[c], bias = norm.bias[c];
+        for (int j = 0; j < out_cols; ++j) {
+          o[j] = remap::CastPixel<DType>((a[j] + (b[j] - a[j]) * wy - mean) * mult + bias);
+        }
+      }
+    }
+  }
+}
+
+}  // namespace io
+}  // namespace mxnet
+#endif  // MXNET_USE_OPENCV
+#endif  // MXNET_IO_IMAGE_REMAP_H_
@@ -23,6 +23,8 @@
 #include <dmlc/registry.h>
 #include "./image_augmenter.h"
 #include "./image_iter_common.h"
+#include "./iter_text_block.h"
+#include "./row_cache.h"
 
 // Registers
 namespace dmlc {
@@ -34,9 +36,13 @@ namespace io {
 // Register parameters in header files
 DMLC_REGISTER_PARAMETER(BatchParam);
 DMLC_REGISTER_PARAMETER(PrefetcherParam);
+DMLC_REGISTER_PARAMETER(PrefetchDepthParam);
 DMLC_REGISTER_PARAMETER(ImageNormalizeParam);
 DMLC_REGISTER_PARAMETER(ImageRecParserParam);
+DMLC_REGISTER_PARAMETER(ImageRecPipelineParam);
 DMLC_REGISTER_PARAMETER(ImageRecordParam);
 DMLC_REGISTER_PARAMETER(ImageDetNormalizeParam);
+DMLC_REGISTER_PARAMETER(TextBlockParam);
+DMLC_REGISTER_PARAMETER(RowCacheParam);
 }  // namespace io
 }  // namespace mxnet
@@ -29,20 +29,46 @@
 #include <mxnet/base.h>
 #include <dmlc/logging.h>
 #include <mshadow/tensor.h>
+#include <algorithm>
+#include <cstring>
 #include <utility>
 #include <vector>
 #include <string>
 #include "./inst_vector.h"
 #include "./image_iter_common.h"
+#include "../engine/openmp.h"
 
 namespace mxnet {
 namespace io {
 
+/*!
+ * \brief instance iterator that can also hand out runs of consecutive
+ *  instances stored contiguously, so that BatchLoader copies a run at once
+ */
+template<typename DType>
+class RunIIterator : public IIterator<DType> {
+ public:
+  /*!
+   * \brief move to the next run of at most max_size instances
+   * \return number of instances in the run, 0 at the end
+   */
+  virtual size_t NextRun(size_t max_size) = 0;
+  /*!
+   * \brief the current run: index is the index of its first instance, and
+   *  data[i] has shape (n, instance shape) with the n instances contiguous
+   */
+  virtual const DType &RunValue(void) const = 0;
+};  // class RunIIterator
+
 /*! \brief create a batch iterator from single instance iterator */
 class BatchLoader : public IIterator<TBlobBatch> {
  public:
   explicit BatchLoader(IIterator<DataInst> *base):
-    head_(1), num_overflow_(0), base_(base) {
+    head_(1), num_overflow_(0), base_(base), run_base_(nullptr) {
+  }
+  /*! \brief assemble the batches from runs of instances when the base supports it */
+  explicit BatchLoader(RunIIterator<DataInst> *base):
+    head_(1), num_overflow_(0), base_(base), run_base_(base) {
   }
 
   virtual ~BatchLoader(void) {
@@ -78,53 +104,21 @@ class BatchLoader : public IIterator<TBlobBatch> {
 
     // if overflow from previous round, directly return false, until before first is called
     if (num_overflow_ != 0) return false;
-    index_t top = 0;
-
-    while (base_->Next()) {
-      const DataInst& d = base_->Value();
-      out_.inst_index[top] = d.index;
-      if (data_.size() == 0) {
-        this->InitData(d);
-      }
-      for (size_t i = 0; i < d.data.size(); ++i) {
-        CHECK_EQ(unit_size_[i], d.data[i].Size());
-        MSHADOW_TYPE_SWITCH(data_[i].type_flag_, DType, {
-            mshadow::Copy(
-              data_[i].get<cpu, 1, DType>().Slice(top * unit_size_[i],
-                                                  (top + 1) * unit_size_[i]),
-              d.data[i].get_with_shape<cpu, 1, DType>(mshadow::Shape1(unit_size_[i])));
-          });
-      }
-      if (++top >= param_.batch_size) {
-        return true;
-      }
-    }
-    if (top != 0) {
+    const index_t top = this->Fill(0);
+    if (top == 0) return false;
+    if (top < param_.batch_size) {
       if (param_.round_batch != 0) {
-        num_overflow_ = 0;
+        // pad with the instances at the start of the next round
         base_->BeforeFirst();
-        for (; top < param_.batch_size; ++top, ++num_overflow_) {
-          CHECK(base_->Next()) << "number of input must be bigger than batch size";
-          const DataInst& d = base_->Value();
-          out_.inst_index[top] = d.index;
-          // copy data
-          for (size_t i = 0; i < d.data.size(); ++i) {
-            CHECK_EQ(unit_size_[i], d.data[i].Size());
-            MSHADOW_TYPE_SWITCH(data_[i].type_flag_, DType, {
-                mshadow::Copy(
-                  data_[i].get<cpu, 1, DType>().Slice(top * unit_size_[i],
-                                                      (top + 1) * unit_size_[i]),
-                  d.data[i].get_with_shape<cpu, 1, DType>(mshadow::Shape1(unit_size_[i])));
-              });
-          }
-        }
+        const index_t filled = this->Fill(top);
+        CHECK_EQ(filled, param_.batch_size) << "number of input must be bigger than batch size";
+        num_overflow_ = param_.batch_size - top;
         out_.num_batch_padd = num_overflow_;
       } else {
         out_.num_batch_padd = param_.batch_size - top;
       }
-      return true;
     }
-    return false;
+    return true;
   }
   virtual const TBlobBatch &Value(void) const {
     return out_;
@@ -145,17 +139,75 @@ class BatchLoader : public IIterator<TBlobBatch> {
  private:
   /*! \brief base iterator */
   IIterator<DataInst> *base_;
+  /*! \brief base iterator as a run iterator, nullptr if it only has single instances */
+  RunIIterator<DataInst> *run_base_;
   /*! \brief data shape */
   std::vector<TShape> shape_;
   /*! \brief unit size */
   std::vector<size_t> unit_size_;
+  /*! \brief unit size in bytes */
+  std::vector<size_t> unit_bytes_;
+  // fill the batch from position top with instances of the base, return the new top
+  inline index_t Fill(index_t top) {
+    if (run_base_ != nullptr) {
+      while (top < param_.batch_size) {
+        const size_t n = run_base_->NextRun(param_.batch_size - top);
+        if (n == 0) break;
+        this->CopyRun(run_base_->RunValue(), top, n);
+        top += n;
+      }
+    } else {
+      while (top < param_.batch_size && base_->Next()) {
+        this->CopyRun(base_->Value(), top, 1);
+        ++top;
+      }
+    }
+    return top;
+  }
+  // copy n contiguous instances to position top of the batch
+  inline void CopyRun(const DataInst& d, index_t top, size_t n) {
+    if (data_.size() == 0) {
+      this->InitData(d, run_base_ != nullptr);
+    }
+    for (size_t k = 0; k < n; ++k) {
+      out_.inst_index[top + k] = d.index + k;
+    }
+    for (size_t i = 0; i < d.data.size(); ++i) {
+      CHECK_EQ(unit_size_[i] * n, d.data[i].Size());
+      CHECK_EQ(data_[i].type_flag_, d.data[i].type_flag_);
+      ParallelCopy(static_cast<char*>(data_[i].dptr_) + top * unit_bytes_[i],
+                   static_cast<const char*>(d.data[i].dptr_), n * unit_bytes_[i]);
+    }
+  }
+  // memcpy that splits large copies over the omp threads
+  static inline void ParallelCopy(char* dst, const char* src, size_t size) {
+    // below this many bytes per thread the fork/join costs more than it saves
+    const size_t kMinBytesPerThread = 1 << 18;
+    const int nthread = static_cast<int>(std::min<size_t>(
+        engine::OpenMP::Get()->GetRecommendedOMPThreadCount(), size / kMinBytesPerThread));
+    if (nthread <= 1) {
+      std::memcpy(dst, src, size);
+      return;
+    }
+    const size_t step = (size + nthread - 1) / nthread;
+    #pragma omp parallel for num_threads(nthread)
+    for (int t = 0; t < nthread; ++t) {
+      const size_t begin = t * step;
+      const size_t end = std::min(size, begin + step);
+      if (begin < end) std::memcpy(dst + begin, src + begin, end - begin);
+    }
+  }
   // initialize the data holder by using from the first batch.
-  inline void InitData(const DataInst& first_batch) {
+  // a run has an extra leading dimension over the instance shape.
+  inline void InitData(const DataInst& first_batch, bool is_run) {
     shape_.resize(first_batch.data.size());
     data_.resize(first_batch.data.size());
     unit_size_.resize(first_batch.data.size());
+    unit_bytes_.resize(first_batch.data.size());
     for (size_t i = 0; i < first_batch.data.size(); ++i) {
-      TShape src_shape = first_batch.data[i].shape_;
+      const TShape& first_shape = first_batch.data[i].shape_;
+      TShape src_shape = is_run ? TShape(first_shape.begin() + 1, first_shape.end())
+                                : first_shape;
       int src_type_flag = first_batch.data[i].type_flag_;
       // init object attributes
       std::vector<index_t> shape_vec;
@@ -167,6 +219,7 @@ class BatchLoader : public IIterator<TBlobBatch> {
       shape_[i] = dst_shape;
       data_[i].resize(mshadow::Shape1(dst_shape.Size()), src_type_flag);
       unit_size_[i] = src_shape.Size();
+      unit_bytes_[i] = unit_size_[i] * mshadow::mshadow_sizeof(src_type_flag);
       out_.data.push_back(TBlob(data_[i].dptr_, dst_shape, cpu::kDevMask, src_type_flag, 0));
     }
   }
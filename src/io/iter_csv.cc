@@ -27,8 +27,13 @@
 #include <dmlc/logging.h>
 #include <dmlc/parameter.h>
 #include <dmlc/data.h>
+#include <algorithm>
+#include <sstream>
+#include <vector>
 #include "./iter_prefetcher.h"
 #include "./iter_batchloader.h"
+#include "./iter_text_block.h"
+#include "./row_cache.h"
 
 namespace mxnet {
 namespace io {
@@ -57,10 +62,11 @@ struct CSVIterParam : public dmlc::Parameter<CSVIterParam> {
   }
 };
 
-class CSVIterBase: public IIterator<DataInst> {
+class CSVIterBase: public RunIIterator<DataInst> {
  public:
   CSVIterBase() {
     out_.data.resize(2);
+    run_.data.resize(2);
   }
   virtual ~CSVIterBase() {}
 
@@ -74,11 +80,18 @@ class CSVIterBase: public IIterator<DataInst> {
   virtual const DataInst &Value(void) const {
     return out_;
   }
+  /*! \brief move to next run of consecutive rows */
+  virtual size_t NextRun(size_t max_size) = 0;
+  /*! \brief get current run */
+  virtual const DataInst &RunValue(void) const {
+    return run_;
+  }
 
  protected:
   CSVIterParam param_;
 
   DataInst out_;
+  DataInst run_;
 
   // internal instance counter
   unsigned inst_counter_{0};
@@ -97,21 +110,31 @@ class CSVIterTyped: public CSVIterBase {
   // intialize iterator loads data in
   virtual void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) {
     param_.InitAllowUnknown(kwargs);
-    data_parser_.reset(dmlc::Parser<uint32_t, DType>::Create(param_.data_csv.c_str(), 0, 1, "csv"));
-    if (param_.label_csv != "NULL") {
-      label_parser_.reset(
-        dmlc::Parser<uint32_t, DType>::Create(param_.label_csv.c_str(), 0, 1, "csv"));
-    } else {
+    cache_param_.InitAllowUnknown(kwargs);
+    has_label_ = param_.label_csv != "NULL";
+    if (!has_label_) {
       dummy_label.set_pad(false);
       dummy_label.Resize(mshadow::Shape1(1));
       dummy_label = 0;
     }
+    if (this->InitCache()) return;
+    data_parser_.reset(dmlc::Parser<uint32_t, DType>::Create(param_.data_csv.c_str(), 0, 1, "csv"));
+    if (has_label_) {
+      label_parser_.reset(
+        dmlc::Parser<uint32_t, DType>::Create(param_.label_csv.c_str(), 0, 1, "csv"));
+    }
+    cache_.BeginPass();
   }
 
   virtual void BeforeFirst() {
-    data_parser_->BeforeFirst();
-    if (label_parser_.get() != nullptr) {
-      label_parser_->BeforeFirst();
+    if (cache_.reading()) {
+      cache_.reader().BeforeFirst();
+    } else {
+      data_parser_->BeforeFirst();
+      if (label_parser_.get() != nullptr) {
+        label_parser_->BeforeFirst();
+      }
+      cache_.BeginPass();
     }
     data_ptr_ = label_ptr_ = 0;
     data_size_ = label_size_ = 0;
@@ -121,9 +144,21 @@ class CSVIterTyped: public CSVIterBase {
 
   virtual bool Next() {
     if (end_) return false;
+    if (cache_.reading()) {
+      RowCacheReader& reader = cache_.reader();
+      if (!reader.Next()) {
+        end_ = true; return false;
+      }
+      out_.index = inst_counter_++;
+      out_.data[0] = reader.Value(0, param_.data_shape);
+      out_.data[1] = has_label_ ? reader.Value(1, param_.label_shape) : TBlob(dummy_label);
+      return true;
+    }
     while (data_ptr_ >= data_size_) {
       if (!data_parser_->Next()) {
-        end_ = true; return false;
+        end_ = true;
+        cache_.EndPass();
+        return false;
       }
       data_ptr_ = 0;
       data_size_ = data_parser_->Value().size;
@@ -144,10 +179,83 @@ class CSVIterTyped: public CSVIterBase {
     } else {
       out_.data[1] = dummy_label;
     }
+    cache_row_.assign(out_.data.begin(), out_.data.begin() + (has_label_ ? 2 : 1));
+    cache_.Append(cache_row_);
     return true;
   }
 
+  virtual size_t NextRun(size_t max_size) {
+    if (end_) return 0;
+    size_t n;
+    if (cache_.reading()) {
+      n = cache_.reader().NextRun(max_size);
+      if (n == 0) {
+        end_ = true; return 0;
+      }
+      run_.data[0] = cache_.reader().Value(0, RunShape(n, param_.data_shape));
+      if (has_label_) run_.data[1] = cache_.reader().Value(1, RunShape(n, param_.label_shape));
+    } else {
+      while (data_ptr_ >= data_size_) {
+        if (!data_parser_->Next()) {
+          end_ = true;
+          cache_.EndPass();
+          return 0;
+        }
+        data_ptr_ = 0;
+        data_size_ = data_parser_->Value().size;
+      }
+      // a run ends at the end of the current data block and label block
+      n = std::min(max_size, data_size_ - data_ptr_);
+      if (label_parser_.get() != nullptr) {
+        while (label_ptr_ >= label_size_) {
+          CHECK(label_parser_->Next())
+              << "Data CSV's row is smaller than the number of rows in label_csv";
+          label_ptr_ = 0;
+          label_size_ = label_parser_->Value().size;
+        }
+        n = std::min(n, label_size_ - label_ptr_);
+        run_.data[1] = AsRunTBlob(label_parser_->Value(), label_ptr_, n, param_.label_shape);
+      }
+      run_.data[0] = AsRunTBlob(data_parser_->Value(), data_ptr_, n, param_.data_shape);
+      if (cache_.writing()) {
+        for (size_t k = 0; k < n; ++k) {
+          cache_row_.assign(1, AsTBlob(data_parser_->Value()[data_ptr_ + k], param_.data_shape));
+          if (has_label_) {
+            cache_row_.push_back(
+              AsTBlob(label_parser_->Value()[label_ptr_ + k], param_.label_shape));
+          }
+          cache_.Append(cache_row_);
+        }
+      }
+      data_ptr_ += n;
+      label_ptr_ += n;
+    }
+    if (!has_label_) {
+      if (dummy_run_label_.size() < n) dummy_run_label_.resize(n, DType(0));
+      run_.data[1] = TBlob(dummy_run_label_.data(), mshadow::Shape2(n, 1), cpu::kDevMask, 0);
+    }
+    run_.index = inst_counter_;
+    inst_counter_ += n;
+    return n;
+  }
+
  private:
+  // open the row cache, returns whether the rows can be read from it
+  inline bool InitCache() {
+    const int dtype = mshadow::DataType<DType>::kFlag;
+    std::vector<RowCacheArray> arrays;
+    arrays.push_back({dtype, static_cast<int32_t>(param_.data_shape.Size())});
+    std::ostringstream signature;
+    signature << "csv " << dtype << ' ' << param_.data_csv << ' ' << param_.data_shape
+              << row_cache::InputStamp(param_.data_csv);
+    if (has_label_) {
+      arrays.push_back({dtype, static_cast<int32_t>(param_.label_shape.Size())});
+      signature << ' ' << param_.label_csv << ' ' << param_.label_shape
+                << row_cache::InputStamp(param_.label_csv);
+    }
+    return cache_.Init(cache_param_, signature.str(), arrays);
+  }
+
   inline TBlob AsTBlob(const dmlc::Row<uint32_t, DType>& row, const TShape& shape) {
     CHECK_EQ(row.length, shape.Size())
         << "The data size in CSV do not match size of shape: "
@@ -155,13 +263,57 @@ class CSVIterTyped: public CSVIterBase {
     const DType* ptr = row.value;
     return TBlob((DType*)ptr, shape, cpu::kDevMask, 0);  // NOLINT(*)
   }
+  // shape of n rows of the given shape
+  static inline TShape RunShape(size_t n, const TShape& shape) {
+    std::vector<index_t> shape_vec(1, n);
+    shape_vec.insert(shape_vec.end(), shape.begin(), shape.end());
+    return TShape(shape_vec.begin(), shape_vec.end());
+  }
+  // rows [begin, begin + n) of a block, which are contiguous in its value array
+  inline TBlob AsRunTBlob(const dmlc::RowBlock<uint32_t, DType>& block,
+                          size_t begin, size_t n, const TShape& shape) {
+    for (size_t k = begin; k < begin + n; ++k) {
+      CHECK_EQ(block.offset[k + 1] - block.offset[k], shape.Size())
+          << "The data size in CSV do not match size of shape: "
+          << "specified shape=" << shape << ", the csv row-length="
+          << block.offset[k + 1] - block.offset[k];
+    }
+    const DType* ptr = block.value + block.offset[begin];
+    return TBlob((DType*)ptr, RunShape(n, shape), cpu::kDevMask, 0);  // NOLINT(*)
+  }
+  RowCacheParam cache_param_;
+  // binary cache of the parsed rows
+  RowCache cache_;
+  std::vector<TBlob> cache_row_;
+  bool has_label_{false};
   // dummy label
   mshadow::TensorContainer<cpu, 1, DType> dummy_label;
+  // dummy labels of a run
+  std::vector<DType> dummy_run_label_;
   std::unique_ptr<dmlc::Parser<uint32_t, DType> > label_parser_;
   std::unique_ptr<dmlc::Parser<uint32_t, DType> > data_parser_;
 };
 
-class CSVIter: public IIterator<DataInst> {
+// parse the element type requested by the dtype argument, float32 by default
+inline int CSVTargetDType(const std::vector<std::pair<std::string, std::string> >& kwargs) {
+  int target_dtype = mshadow::kFloat32;
+  for (const auto& arg : kwargs) {
+    if (arg.first == "dtype") {
+      if (arg.second == "int32") {
+        target_dtype = mshadow::kInt32;
+      } else if (arg.second == "int64") {
+        target_dtype = mshadow::kInt64;
+      } else if (arg.second == "float32") {
+        target_dtype = mshadow::kFloat32;
+      } else {
+        CHECK(false) << arg.second << " is not supported for CSVIter";
+      }
+    }
+  }
+  return target_dtype;
+}
+
+class CSVIter: public RunIIterator<DataInst> {
  public:
   CSVIter() {}
   virtual ~CSVIter() {}
@@ -169,27 +321,12 @@ class CSVIter: public IIterator<DataInst> {
   // intialize iterator loads data in
   virtual void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) {
     param_.InitAllowUnknown(kwargs);
-    bool dtype_has_value = false;
-    int target_dtype = -1;
-    for (const auto& arg : kwargs) {
-      if (arg.first == "dtype") {
-        dtype_has_value = true;
-        if (arg.second == "int32") {
-          target_dtype = mshadow::kInt32;
-        } else if (arg.second == "int64") {
-          target_dtype = mshadow::kInt64;
-        } else if (arg.second == "float32") {
-          target_dtype = mshadow::kFloat32;
-        } else {
-          CHECK(false) << arg.second << " is not supported for CSVIter";
-        }
-      }
-    }
-    if (dtype_has_value && target_dtype == mshadow::kInt32) {
+    int target_dtype = CSVTargetDType(kwargs);
+    if (target_dtype == mshadow::kInt32) {
       iterator_.reset(reinterpret_cast<CSVIterBase*>(new CSVIterTyped<int32_t>()));
-    } else if (dtype_has_value && target_dtype == mshadow::kInt64) {
+    } else if (target_dtype == mshadow::kInt64) {
       iterator_.reset(reinterpret_cast<CSVIterBase*>(new CSVIterTyped<int64_t>()));
-    } else if (!dtype_has_value || target_dtype == mshadow::kFloat32) {
+    } else {
       iterator_.reset(reinterpret_cast<CSVIterBase*>(new CSVIterTyped<float>()));
     }
     iterator_->Init(kwargs);
@@ -207,11 +344,196 @@ class CSVIter: public IIterator<DataInst> {
     return iterator_->Value();
   }
 
+  virtual size_t NextRun(size_t max_size) {
+    return iterator_->NextRun(max_size);
+  }
+
+  virtual const DataInst &RunValue(void) const {
+    return iterator_->RunValue();
+  }
+
  private:
   CSVIterParam param_;
   std::unique_ptr<CSVIterBase> iterator_;
 };
 
+/*!
+ * \brief CSV iterator that parses chunks of the files on several threads and
+ *  copies the parsed rows directly into the batch, without going through DataInst
+ */
+template <typename DType>
+class CSVBlockIterTyped: public IIterator<TBlobBatch> {
+ public:
+  virtual ~CSVBlockIterTyped() {
+    delete[] out_.inst_index;
+  }
+
+  virtual void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) {
+    param_.InitAllowUnknown(kwargs);
+    batch_param_.InitAllowUnknown(kwargs);
+    block_param_.InitAllowUnknown(kwargs);
+    const int dtype = mshadow::DataType<DType>::kFlag;
+    data_reader_.reset(new TextBlockReader<DType>(
+        param_.data_csv, 0, 1, TextBlockReader<DType>::kCSV, block_param_));
+    data_len_ = param_.data_shape.Size();
+    TShape label_shape = mshadow::Shape1(1);
+    if (param_.label_csv != "NULL") {
+      label_reader_.reset(new TextBlockReader<DType>(
+          param_.label_csv, 0, 1, TextBlockReader<DType>::kCSV, block_param_));
+      label_shape = param_.label_shape;
+    }
+    label_len_ = label_shape.Size();
+    TShape data_batch_shape = this->BatchShape(param_.data_shape);
+    TShape label_batch_shape = this->BatchShape(label_shape);
+    data_.resize(mshadow::Shape1(data_batch_shape.Size()), dtype);
+    label_.resize(mshadow::Shape1(label_batch_shape.Size()), dtype);
+    // without a label file, all labels are 0
+    std::fill_n(static_cast<DType*>(label_.dptr_), label_batch_shape.Size(), DType(0));
+    out_.data.clear();
+    out_.data.push_back(TBlob(data_.dptr_, data_batch_shape, cpu::kDevMask, dtype, 0));
+    out_.data.push_back(TBlob(label_.dptr_, label_batch_shape, cpu::kDevMask, dtype, 0));
+    out_.inst_index = new unsigned[batch_param_.batch_size];
+    out_.batch_size = batch_param_.batch_size;
+  }
+
+  virtual void BeforeFirst() {
+    if (batch_param_.round_batch == 0 || num_overflow_ == 0) {
+      // otherwise, the readers were already rewound to fill the last batch
+      this->Rewind();
+    } else {
+      num_overflow_ = 0;
+    }
+  }
+
+  virtual bool Next() {
+    out_.num_batch_padd = 0;
+    // if overflow from previous round, directly return false, until before first is called
+    if (num_overflow_ != 0) return false;
+    const size_t batch_size = batch_param_.batch_size;
+    const size_t top = this->Fill(0);
+    if (top == batch_size) return true;
+    if (top == 0) return false;
+    if (batch_param_.round_batch != 0) {
+      this->Rewind();
+      CHECK_EQ(this->Fill(top), batch_size) << "number of input must be bigger than batch size";
+      num_overflow_ = batch_size - top;
+      out_.num_batch_padd = num_overflow_;
+    } else {
+      out_.num_batch_padd = batch_size - top;
+    }
+    return true;
+  }
+
+  virtual const TBlobBatch &Value(void) const {
+    return out_;
+  }
+
+ private:
+  inline TShape BatchShape(const TShape& inst_shape) const {
+    std::vector<index_t> shape_vec;
+    shape_vec.push_back(batch_param_.batch_size);
+    for (index_t dim = 0; dim < inst_shape.ndim(); ++dim) {
+      shape_vec.push_back(inst_shape[dim]);
+    }
+    return TShape(shape_vec.begin(), shape_vec.end());
+  }
+
+  inline void Rewind() {
+    data_reader_->BeforeFirst();
+    if (label_reader_.get() != nullptr) {
+      label_reader_->BeforeFirst();
+    }
+    inst_counter_ = 0;
+  }
+
+  // copy rows into the batch starting at position top, returns the new top
+  inline size_t Fill(size_t top) {
+    const size_t n = CopyRows(data_reader_.get(), batch_param_.batch_size - top,
+                              data_len_, param_.data_shape,
+                              static_cast<DType*>(data_.dptr_) + top * data_len_);
+    for (size_t i = top; i < top + n; ++i) {
+      out_.inst_index[i] = inst_counter_++;
+    }
+    if (label_reader_.get() != nullptr && n != 0) {
+      CHECK_EQ(CopyRows(label_reader_.get(), n, label_len_, param_.label_shape,
+                        static_cast<DType*>(label_.dptr_) + top * label_len_), n)
+          << "Data CSV's row is smaller than the number of rows in label_csv";
+    }
+    return top + n;
+  }
+
+  static inline size_t CopyRows(TextBlockReader<DType>* reader, size_t n, size_t row_len,
+                                const TShape& shape, DType* dst) {
+    return reader->Take(n, [row_len, &shape, dst](const TextRowBlock<DType>& blk,
+                                                 size_t begin, size_t end, size_t pos) {
+        for (size_t i = begin; i < end; ++i) {
+          CHECK_EQ(blk.Length(i), row_len)
+              << "The data size in CSV do not match size of shape: "
+              << "specified shape=" << shape << ", the csv row-length=" << blk.Length(i);
+        }
+        std::memcpy(dst + pos * row_len, blk.value.data() + blk.offset[begin],
+                    (end - begin) * row_len * sizeof(DType));
+      });
+  }
+
+  CSVIterParam param_;
+  BatchParam batch_param_;
+  TextBlockParam block_param_;
+  /*! \brief output batch */
+  TBlobBatch out_;
+  /*! \brief batch buffers */
+  TBlobContainer data_, label_;
+  /*! \brief number of values in one data row and one label row */
+  size_t data_len_{0}, label_len_{0};
+  /*! \brief number of instances read from the next round to fill the last batch */
+  size_t num_overflow_{0};
+  // internal instance counter
+  unsigned inst_counter_{0};
+  std::unique_ptr<TextBlockReader<DType> > data_reader_;
+  std::unique_ptr<TextBlockReader<DType> > label_reader_;
+};
+
+/*! \brief batch iterator choosing between row by row and block-parallel parsing */
+class CSVBatchIter: public IIterator<TBlobBatch> {
+ public:
+  virtual void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) {
+    block_param_.InitAllowUnknown(kwargs);
+    cache_param_.InitAllowUnknown(kwargs);
+    CHECK(cache_param_.cache_file.empty() || block_param_.parse_threads == 0)
+        << "cache_file is only supported with parse_threads = 0";
+    if (block_param_.parse_threads == 0) {
+      loader_.reset(new BatchLoader(new CSVIter()));
+    } else {
+      int target_dtype = CSVTargetDType(kwargs);
+      if (target_dtype == mshadow::kInt32) {
+        loader_.reset(new CSVBlockIterTyped<int32_t>());
+      } else if (target_dtype == mshadow::kInt64) {
+        loader_.reset(new CSVBlockIterTyped<int64_t>());
+      } else {
+        loader_.reset(new CSVBlockIterTyped<float>());
+      }
+    }
+    loader_->Init(kwargs);
+  }
+
+  virtual void BeforeFirst() {
+    loader_->BeforeFirst();
+  }
+
+  virtual bool Next() {
+    return loader_->Next();
+  }
+
+  virtual const TBlobBatch &Value(void) const {
+    return loader_->Value();
+  }
+
+ private:
+  TextBlockParam block_param_;
+  RowCacheParam cache_param_;
+  std::unique_ptr<IIterator<TBlobBatch> > loader_;
+};
+
 
 DMLC_REGISTER_PARAMETER(CSVIterParam);
 
@@ -232,6 +554,15 @@ to set `round_batch` to False.
 
 If ``data_csv = 'data/'`` is set, then all the files in this directory will be read.
 
+If `parse_threads` is positive, the files are read in chunks of `parse_chunk_size` MB,
+each chunk is parsed by `parse_threads` threads and the rows are copied directly into
+the batch. The batches are the same as with the default row by row parsing.
+
+If `cache_file` is set, the parsed rows are written to this local binary file during the
+first complete pass, and the following passes read them from a memory mapping of the file
+without parsing the CSV files again. The cache is rebuilt when the arguments, or the size
+or modification time of local input files, change. `cache_file` requires `parse_threads` = 0.
+
 ``reset()`` is expected to be called only after a complete pass of data.
 
 By default, the CSVIter parses all entries in the data file as float32 data type,
@@ -308,11 +639,13 @@ Examples::
 )code" ADD_FILELINE)
 .add_arguments(CSVIterParam::__FIELDS__())
 .add_arguments(BatchParam::__FIELDS__())
+.add_arguments(TextBlockParam::__FIELDS__())
+.add_arguments(RowCacheParam::__FIELDS__())
 .add_arguments(PrefetcherParam::__FIELDS__())
+.add_arguments(PrefetchDepthParam::__FIELDS__())
 .set_body([]() {
     return new PrefetcherIter(
-        new BatchLoader(
-            new CSVIter()));
+        new CSVBatchIter());
   });
 
 }  // namespace io
@@ -585,6 +585,7 @@ MXNET_REGISTER_IO_ITER(ImageDetRecordIter)
 .add_arguments(ImageDetRecordParam::__FIELDS__())
 .add_arguments(BatchParam::__FIELDS__())
 .add_arguments(PrefetcherParam::__FIELDS__())
+.add_arguments(PrefetchDepthParam::__FIELDS__())
 .add_arguments(ListDefaultDetAugParams())
 .add_arguments(ImageDetNormalizeParam::__FIELDS__())
 .set_body([]() {
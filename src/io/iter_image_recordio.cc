@@ -354,6 +354,7 @@ files.
 .add_arguments(ImageRecordParam::__FIELDS__())
 .add_arguments(BatchParam::__FIELDS__())
 .add_arguments(PrefetcherParam::__FIELDS__())
+.add_arguments(PrefetchDepthParam::__FIELDS__())
 .add_arguments(ListDefaultAugParams())
 .add_arguments(ImageNormalizeParam::__FIELDS__())
 .set_body([]() {
@@ -379,6 +380,7 @@ the data type instead of ``float``.
 .add_arguments(ImageRecordParam::__FIELDS__())
 .add_arguments(BatchParam::__FIELDS__())
 .add_arguments(PrefetcherParam::__FIELDS__())
+.add_arguments(PrefetchDepthParam::__FIELDS__())
 .add_arguments(ListDefaultAugParams())
 .set_body([]() {
     return new PrefetcherIter(
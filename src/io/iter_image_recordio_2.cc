@@ -33,14 +33,27 @@
 #include <dmlc/omp.h>
 #include <dmlc/common.h>
 #include <dmlc/timer.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <thread>
 #include <type_traits>
 #if MXNET_USE_LIBJPEG_TURBO
 #include <turbojpeg.h>
 #endif
 #include "./image_recordio.h"
 #include "./image_augmenter.h"
+#include "./image_remap.h"
 #include "./image_iter_common.h"
 #include "./inst_vector.h"
+#include "./iter_pipeline.h"
+#include "./mmap_recordio.h"
+#include "./pread_recordio.h"
 #include "../common/utils.h"
 
 namespace mxnet {
@@ -49,14 +62,31 @@ namespace io {
 template<typename DType>
 class ImageRecordIOParser2 {
  public:
+  ~ImageRecordIOParser2() {
+#if MXNET_USE_OPENCV
+    StopPipeline();
+#endif
+  }
   // initialize the parser
   inline void Init(const std::vector<std::pair<std::string, std::string> >& kwargs);
 
   // set record to the head
   inline void BeforeFirst(void) {
+#if MXNET_USE_OPENCV
+    if (pipeline_param_.pipeline) {
+      StopPipeline();
+      if (batch_param_.round_batch == 0 || !overflow) {
+        pending_.clear();
+        RewindSource();
+      } else {
+        overflow = false;
+      }
+      return;
+    }
+#endif
     if (batch_param_.round_batch == 0 || !overflow) {
       n_parsed_ = 0;
-      return source_->BeforeFirst();
+      return RewindSource();
     } else {
       overflow = false;
     }
@@ -72,12 +102,86 @@ class ImageRecordIOParser2 {
     mshadow::Tensor<cpu, 3, DType>* data_ptr, const bool is_mirrored, const float contrast_scaled,
     const float illumination_scaled);
 #if MXNET_USE_LIBJPEG_TURBO
-  cv::Mat TJimdecode(cv::Mat buf, int color);
+  cv::Mat TJimdecode(cv::Mat buf, int color, int min_edge);
 #endif
+  // decode the image of a record
+  inline cv::Mat DecodeImage(const ImageRecordIO& rec);
+  // load the label of a record, before augmentations
+  inline std::vector<float> LoadLabel(const ImageRecordIO& rec);
+  // draw random mirror, contrast and illumination of an augmented image
+  inline void DrawNormalize(common::RANDOM_ENGINE* prnd, bool* is_mirrored,
+                            float* contrast_scaled, float* illumination_scaled);
+  // normalize and copy an augmented image into data
+  inline void CopyImage(const cv::Mat& res, mshadow::Tensor<cpu, 3, DType>* data,
+                        const bool is_mirrored, const float contrast_scaled,
+                        const float illumination_scaled);
+  // crop a window of a decoded image, resize, mirror and normalize it into data
+  inline void RemapImage(const cv::Mat& src, const cv::Rect_<float>& window,
+                         mshadow::Tensor<cpu, 3, DType>* data, const bool is_mirrored,
+                         const float contrast_scaled, const float illumination_scaled);
+  /*!
+   * \brief record read by the pipeline, with its position in the epoch,
+   *  either a view into the memory mapped file or a copy in data
+   */
+  struct PipelineRecord {
+    unsigned seq;
+    char* dptr;
+    size_t size;
+    std::string data;
+  };
+  /*! \brief image flowing between the decode, augment and batch stages */
+  struct PipelineImage {
+    unsigned seq;
+    uint64_t index;
+    cv::Mat image;
+    cv::Rect_<float> window;
+    std::vector<float> label;
+    bool is_mirrored;
+    float contrast_scaled;
+    float illumination_scaled;
+  };
+  /*! \brief batch being assembled by the pipeline */
+  struct PipelineBatch {
+    std::vector<NDArray> data;
+    std::vector<uint64_t> index;
+    DType* data_dptr;
+    real_t* label_dptr;
+    unsigned filled;
+  };
+  // take the next batch assembled by the pipeline
+  inline bool NextPipelineBatch(DataBatch *out);
+  // start the threads of the pipeline
+  inline void StartPipeline(void);
+  // stop the threads of the pipeline, dropping the records in flight
+  inline void StopPipeline(void);
+  // split the next chunk into pending records, return false at the end of data
+  inline bool ReadPendingRecords(void);
+  // run a stage of the pipeline, stopping the whole pipeline on error
+  template<typename FStage>
+  inline void RunStage(FStage stage);
+  // pipeline stages
+  inline void ReadStage(void);
+  inline void DecodeStage(void);
+  inline void AugmentStage(int tid);
+  inline void BatchStage(void);
+  // allocate the arrays of a batch slot if needed and reset it
+  inline void ResetBatchSlot(PipelineBatch* slot);
+  // number of images expected in a batch, must hold batch_mutex_
+  inline unsigned ExpectedBatchSize(unsigned batch) const {
+    return batch + 1 == end_batch_ ? last_size_ : batch_param_.batch_size;
+  }
 #endif
+  /*! \brief returns the records of a chunk one by one, false once they are exhausted */
+  typedef std::function<bool(dmlc::InputSplit::Blob*)> RecordReader;
+  // move to the next chunk of at most max_records records, all remaining records of
+  // the next input chunk if zero, return false at the end of data
+  inline bool NextChunk(size_t max_records, RecordReader* reader);
+  // rewind the data source, reshuffling records read by index if needed
+  inline void RewindSource(void);
   inline unsigned ParseChunk(DType* data_dptr, real_t* label_dptr, const unsigned current_size,
-    dmlc::InputSplit::Blob * chunk);
+    const RecordReader& reader);
   inline void CreateMeanImg(void);
+  inline void InitBatchData(std::vector<NDArray>* data);
 
   // magic number to seed prng
   static const int kRandMagic = 111;
@@ -88,6 +192,7 @@ class ImageRecordIOParser2 {
   BatchParam batch_param_;
   ImageNormalizeParam normalize_param_;
   PrefetcherParam prefetch_param_;
+  ImageRecPipelineParam pipeline_param_;
   #if MXNET_USE_OPENCV
   /*! \brief augmenters */
   std::vector<std::vector<std::unique_ptr<ImageAugmenter> > > augmenters_;
@@ -97,6 +202,23 @@ class ImageRecordIOParser2 {
   common::RANDOM_ENGINE rnd_;
   /*! \brief data source */
   std::unique_ptr<dmlc::InputSplit> source_;
+  /*! \brief current chunk of source_ */
+  dmlc::InputSplit::Blob chunk_;
+  /*! \brief memory mapped data source, used instead of source_ if set */
+  std::unique_ptr<MMapRecordIO> mmap_;
+  /*! \brief data source read by index, used instead of source_ if set */
+  std::unique_ptr<PReadRecordIO> pread_;
+  /*! \brief records of the last read of pread_ */
+  std::vector<dmlc::InputSplit::Blob> pread_records_;
+  /*! \brief number of records in the file, when read by index */
+  size_t num_records_{0};
+  /*! \brief epochs started, to draw the global permutation */
+  unsigned epoch_{0};
+  /*! \brief records of this part in reading order, and the next one to read */
+  std::vector<size_t> record_order_;
+  size_t record_pos_;
+  /*! \brief records of the current chunk that were split by the writer */
+  std::deque<std::string> split_records_;
   /*! \brief label information, if any */
   std::unique_ptr<ImageLabelMap> label_map_;
   /*! \brief temporary results */
@@ -119,6 +241,40 @@ class ImageRecordIOParser2 {
   bool legacy_shuffle_;
   // whether mean image is ready.
   bool meanfile_ready_;
+  // shortest edge images can be decoded to, 0 to decode at full size
+  int decode_min_edge_;
+  // whether images are cropped and resized by RemapImage instead of the augmenters
+  bool fused_augment_;
+#if MXNET_USE_OPENCV
+  /*! \brief records read but not yet sent down the pipeline */
+  std::deque<PipelineRecord> pending_;
+  /*! \brief queues between the stages */
+  std::unique_ptr<PipelineQueue<PipelineRecord> > record_queue_;
+  std::unique_ptr<PipelineQueue<PipelineImage> > decoded_queue_;
+  std::unique_ptr<PipelineQueue<PipelineImage> > augmented_queue_;
+  /*! \brief batches being assembled, batch i goes to slot i % size */
+  std::vector<PipelineBatch> batch_slots_;
+  /*! \brief threads of the pipeline */
+  std::vector<std::thread> pipeline_threads_;
+  /*! \brief guards the fields below and the fill counts of batch slots */
+  std::mutex batch_mutex_;
+  std::condition_variable batch_cond_;
+  /*! \brief next batch to be returned */
+  unsigned next_batch_{0};
+  /*! \brief number of batches in the epoch, known once the reader is done */
+  unsigned end_batch_{std::numeric_limits<unsigned>::max()};
+  /*! \brief number of images and padding of the last batch */
+  unsigned last_size_{0}, last_pad_{0};
+  /*! \brief whether the pipeline is being stopped */
+  bool stop_{false};
+  /*! \brief first error raised by a stage */
+  std::exception_ptr pipeline_error_;
+  /*! \brief throughput of the stages */
+  PipelineStageStats read_stats_{"read"}, decode_stats_{"decode"};
+  PipelineStageStats augment_stats_{"augment"}, batch_stats_{"batch"};
+  /*! \brief start time of the epoch */
+  double pipeline_start_{0};
+#endif
 };
 
 template<typename DType>
@@ -132,6 +288,8 @@ inline void ImageRecordIOParser2<DType>::Init(
   batch_param_.InitAllowUnknown(kwargs);
   normalize_param_.InitAllowUnknown(kwargs);
   prefetch_param_.InitAllowUnknown(kwargs);
+  pipeline_param_.InitAllowUnknown(kwargs);
+  unit_size_ = {param_.data_shape.Size(), static_cast<size_t>(param_.label_width)};
   n_parsed_ = 0;
   overflow = false;
   rnd_.seed(kRandMagic + record_param_.seed);
@@ -149,16 +307,42 @@ inline void ImageRecordIOParser2<DType>::Init(
   param_.preprocess_threads = threadget;
 
   std::vector<std::string> aug_names = dmlc::Split(param_.aug_seq, ',');
+  // the pipeline keeps one set of augmenters per augment thread
+  const int num_augmenters = pipeline_param_.pipeline ?
+      std::max(threadget, pipeline_param_.augment_threads) : threadget;
   augmenters_.clear();
-  augmenters_.resize(threadget);
+  augmenters_.resize(num_augmenters);
   // setup decoders
-  for (int i = 0; i < threadget; ++i) {
+  for (int i = 0; i < num_augmenters; ++i) {
     for (const auto& aug_name : aug_names) {
       augmenters_[i].emplace_back(ImageAugmenter::Create(aug_name));
       augmenters_[i].back()->Init(kwargs);
     }
     prnds_.emplace_back(new common::RANDOM_ENGINE((i + 1) * kRandMagic));
   }
+  fused_augment_ = false;
+  if (param_.fused_augment) {
+    fused_augment_ = aug_names.size() == 1 && augmenters_[0][0]->SupportsWindow();
+    if (!fused_augment_) {
+      LOG(INFO) << "ImageRecordIOParser2: fused_augment has no effect since the "
+                << "augmentations do more than cropping and resizing";
+    }
+  }
+  decode_min_edge_ = 0;
+  if (param_.jpeg_dct_scaling) {
+#if MXNET_USE_LIBJPEG_TURBO
+    if (!aug_names.empty()) {
+      // later augmenters only see the output of the first one
+      decode_min_edge_ = augmenters_[0][0]->MinSourceEdge();
+    }
+    if (decode_min_edge_ == 0) {
+      LOG(INFO) << "ImageRecordIOParser2: jpeg_dct_scaling has no effect since the "
+                << "augmentations depend on the source image resolution";
+    }
+#else
+    LOG(INFO) << "ImageRecordIOParser2: jpeg_dct_scaling requires libjpeg-turbo, ignored";
+#endif
+  }
   if (param_.path_imglist.length() != 0) {
     label_map_.reset(new ImageLabelMap(param_.path_imglist.c_str(),
       param_.label_width, !param_.verbose));
@@ -167,11 +351,34 @@ inline void ImageRecordIOParser2<DType>::Init(
       << "ImageRecordIter2: must specify image_rec";
 
   if (param_.verbose) {
-    LOG(INFO) << "ImageRecordIOParser2: " << param_.path_imgrec
-              << ", use " << threadget << " threads for decoding..";
+    if (pipeline_param_.pipeline) {
+      LOG(INFO) << "ImageRecordIOParser2: " << param_.path_imgrec
+                << ", use a pipeline of " << pipeline_param_.decode_threads
+                << " decode, " << pipeline_param_.augment_threads
+                << " augment and " << pipeline_param_.batch_threads << " batch threads..";
+    } else {
+      LOG(INFO) << "ImageRecordIOParser2: " << param_.path_imgrec
+                << ", use " << threadget << " threads for decoding..";
+    }
   }
   legacy_shuffle_ = false;
-  if (param_.path_imgidx.length() != 0) {
+  if (param_.use_mmap || param_.global_shuffle) {
+    CHECK(param_.path_imgidx.length() != 0)
+        << "ImageRecordIter2: use_mmap and global_shuffle require path_imgidx";
+    if (param_.use_mmap) {
+      mmap_.reset(new MMapRecordIO(param_.path_imgrec, param_.path_imgidx));
+      num_records_ = mmap_->Size();
+    } else {
+      pread_.reset(new PReadRecordIO(param_.path_imgrec, param_.path_imgidx));
+      num_records_ = pread_->Size();
+    }
+    RewindSource();
+    if (param_.verbose) {
+      LOG(INFO) << "ImageRecordIOParser2: " << (param_.use_mmap ? "memory mapped " : "indexed ")
+                << record_order_.size() << " of " << num_records_ << " records"
+                << (param_.global_shuffle && record_param_.shuffle ? ", shuffled globally" : "");
+    }
+  } else if (param_.path_imgidx.length() != 0) {
     source_.reset(dmlc::InputSplit::Create(
         param_.path_imgrec.c_str(),
         param_.path_imgidx.c_str(),
@@ -255,55 +462,37 @@ inline void ImageRecordIOParser2<DType>::Init(
 
 template<typename DType>
 inline bool ImageRecordIOParser2<DType>::ParseNext(DataBatch *out) {
+#if MXNET_USE_OPENCV
+  if (pipeline_param_.pipeline) {
+    return NextPipelineBatch(out);
+  }
+#endif
   if (overflow) {
     return false;
   }
-  CHECK(source_ != nullptr);
-  dmlc::InputSplit::Blob chunk;
+  CHECK(source_ != nullptr || mmap_ != nullptr || pread_ != nullptr);
+  RecordReader reader;
   unsigned current_size = 0;
   out->index.resize(batch_param_.batch_size);
 
   // InitBatch
   if (out->data.size() == 0) {
-    // This assumes that DataInst given by
-    // InstVector contains only 2 elements in
-    // data vector (operator[] implementation)
-    out->data.resize(2);
-    unit_size_.resize(2);
-
-    std::vector<index_t> shape_vec;
-    shape_vec.push_back(batch_param_.batch_size);
-    for (index_t dim = 0; dim < param_.data_shape.ndim(); ++dim) {
-      shape_vec.push_back(param_.data_shape[dim]);
-    }
-    TShape data_shape(shape_vec.begin(), shape_vec.end());
-
-    shape_vec.clear();
-    shape_vec.push_back(batch_param_.batch_size);
-    shape_vec.push_back(param_.label_width);
-    TShape label_shape(shape_vec.begin(), shape_vec.end());
-
-    out->data.at(0) = NDArray(data_shape, Context::CPUPinned(0), false,
-      mshadow::DataType<DType>::kFlag);
-    out->data.at(1) = NDArray(label_shape, Context::CPUPinned(0), false,
-      mshadow::DataType<real_t>::kFlag);
-    unit_size_[0] = param_.data_shape.Size();
-    unit_size_[1] = param_.label_width;
+    InitBatchData(&out->data);
   }
 
   while (current_size < batch_param_.batch_size) {
     // int n_to_copy;
     unsigned n_to_out = 0;
     if (n_parsed_ == 0) {
-      if (source_->NextBatch(&chunk, batch_param_.batch_size)) {
+      if (NextChunk(batch_param_.batch_size, &reader)) {
         inst_order_.clear();
         inst_index_ = 0;
         DType* data_dptr = static_cast<DType*>(out->data[0].data().dptr_);
         real_t* label_dptr = static_cast<real_t*>(out->data[1].data().dptr_);
         if (!legacy_shuffle_) {
-          n_to_out = ParseChunk(data_dptr, label_dptr, current_size, &chunk);
+          n_to_out = ParseChunk(data_dptr, label_dptr, current_size, reader);
         } else {
-          n_to_out = ParseChunk(NULL, NULL, batch_param_.batch_size, &chunk);
+          n_to_out = ParseChunk(NULL, NULL, batch_param_.batch_size, reader);
         }
         // Count number of parsed images that do not fit into current out
         n_parsed_ = inst_order_.size();
@@ -318,7 +507,7 @@ inline bool ImageRecordIOParser2<DType>::ParseNext(DataBatch *out) {
         CHECK(!overflow) << "number of input images must be bigger than the batch size";
         if (batch_param_.round_batch != 0) {
           overflow = true;
-          source_->BeforeFirst();
+          RewindSource();
         } else {
           current_size = batch_param_.batch_size;
         }
@@ -352,6 +541,31 @@ inline bool ImageRecordIOParser2<DType>::ParseNext(DataBatch *out) {
   return true;
 }
 
+template<typename DType>
+inline void ImageRecordIOParser2<DType>::InitBatchData(std::vector<NDArray>* data) {
+  // This assumes that DataInst given by
+  // InstVector contains only 2 elements in
+  // data vector (operator[] implementation)
+  data->resize(2);
+
+  std::vector<index_t> shape_vec;
+  shape_vec.push_back(batch_param_.batch_size);
+  for (index_t dim = 0; dim < param_.data_shape.ndim(); ++dim) {
+    shape_vec.push_back(param_.data_shape[dim]);
+  }
+  TShape data_shape(shape_vec.begin(), shape_vec.end());
+
+  shape_vec.clear();
+  shape_vec.push_back(batch_param_.batch_size);
+  shape_vec.push_back(param_.label_width);
+  TShape label_shape(shape_vec.begin(), shape_vec.end());
+
+  data->at(0) = NDArray(data_shape, Context::CPUPinned(0), false,
+    mshadow::DataType<DType>::kFlag);
+  data->at(1) = NDArray(label_shape, Context::CPUPinned(0), false,
+    mshadow::DataType<real_t>::kFlag);
+}
+
 #if MXNET_USE_OPENCV
 template<typename DType>
 template<int n_channels>
@@ -436,7 +650,7 @@ bool is_jpeg(unsigned char * file) {
 }
 
 template<typename DType>
-cv::Mat ImageRecordIOParser2<DType>::TJimdecode(cv::Mat image, int color) {
+cv::Mat ImageRecordIOParser2<DType>::TJimdecode(cv::Mat image, int color, int min_edge) {
   unsigned char* jpeg = image.ptr();
   size_t jpeg_size = image.rows * image.cols;
 
@@ -453,8 +667,21 @@ cv::Mat ImageRecordIOParser2<DType>::TJimdecode(cv::Mat image, int color) {
                                 &w, &h, &subsamp);
   if (err != 0) {
     // If it is a malformed JPEG then fall back to OpenCV
+    tjDestroy(handle);
     return cv::imdecode(image, color);
   }
+  const int denom = JPEGScaleDenom(h, w, min_edge);
+  if (denom > 1) {
+    int num_factors;
+    tjscalingfactor* factors = tjGetScalingFactors(&num_factors);
+    for (int i = 0; factors != NULL && i < num_factors; ++i) {
+      if (factors[i].num == 1 && factors[i].denom == denom) {
+        w = TJSCALED(w, factors[i]);
+        h = TJSCALED(h, factors[i]);
+        break;
+      }
+    }
+  }
   cv::Mat ret = cv::Mat(h, w, color ? CV_8UC3 : CV_8UC1);
   err = tjDecompress2(handle,
                       jpeg,
@@ -465,30 +692,210 @@ cv::Mat ImageRecordIOParser2<DType>::TJimdecode(cv::Mat image, int color) {
                       h,
                       color ? TJPF_BGR : TJPF_GRAY,
                       0);
+  tjDestroy(handle);
   if (err != 0) {
     // If it is a malformed JPEG then fall back to OpenCV
     return cv::imdecode(image, color);
   }
-  tjDestroy(handle);
   return ret;
 }
 #endif
+
+template<typename DType>
+inline cv::Mat ImageRecordIOParser2<DType>::DecodeImage(const ImageRecordIO& rec) {
+  cv::Mat res;
+  cv::Mat buf(1, rec.content_size, CV_8U, rec.content);
+  switch (param_.data_shape[0]) {
+   case 1:
+#if MXNET_USE_LIBJPEG_TURBO
+    res = TJimdecode(buf, 0, decode_min_edge_);
+#else
+    res = cv::imdecode(buf, 0);
 #endif
+    break;
+   case 3:
+#if MXNET_USE_LIBJPEG_TURBO
+    res = TJimdecode(buf, 1, decode_min_edge_);
+#else
+    res = cv::imdecode(buf, 1);
+#endif
+    break;
+   case 4:
+    // -1 to keep the number of channel of the encoded image, and not force gray or color.
+    res = cv::imdecode(buf, -1);
+    CHECK_EQ(res.channels(), 4)
+      << "Invalid image with index " << rec.image_index()
+      << ". Expected 4 channels, got " << res.channels();
+    break;
+   default:
+    LOG(FATAL) << "Invalid output shape " << param_.data_shape;
+  }
+  return res;
+}
+
+template<typename DType>
+inline std::vector<float> ImageRecordIOParser2<DType>::LoadLabel(const ImageRecordIO& rec) {
+  std::vector<float> label_buf;
+  if (label_map_ != nullptr) {
+    label_buf = label_map_->FindCopy(rec.image_index());
+  } else if (rec.label != NULL) {
+    CHECK_EQ(param_.label_width, rec.num_label)
+      << "rec file provide " << rec.num_label << "-dimensional label "
+         "but label_width is set to " << param_.label_width;
+    label_buf.assign(rec.label, rec.label + rec.num_label);
+  } else {
+    CHECK_EQ(param_.label_width, 1)
+      << "label_width must be 1 unless an imglist is provided "
+         "or the rec file is packed with multi dimensional label";
+    label_buf.assign(&rec.header.label, &rec.header.label + 1);
+  }
+  return label_buf;
+}
+
+template<typename DType>
+inline void ImageRecordIOParser2<DType>::DrawNormalize(common::RANDOM_ENGINE* prnd,
+  bool* is_mirrored, float* contrast_scaled, float* illumination_scaled) {
+  std::uniform_real_distribution<float> rand_uniform(0, 1);
+  std::bernoulli_distribution coin_flip(0.5);
+  *is_mirrored = (normalize_param_.rand_mirror && coin_flip(*prnd))
+                 || normalize_param_.mirror;
+  *contrast_scaled = 1;
+  *illumination_scaled = 0;
+  if (!std::is_same<DType, uint8_t>::value) {
+    *contrast_scaled =
+      (rand_uniform(*prnd) * normalize_param_.max_random_contrast * 2
+      - normalize_param_.max_random_contrast + 1)*normalize_param_.scale;
+    *illumination_scaled =
+      (rand_uniform(*prnd) * normalize_param_.max_random_illumination * 2
+      - normalize_param_.max_random_illumination) * normalize_param_.scale;
+  }
+}
+
+template<typename DType>
+inline void ImageRecordIOParser2<DType>::CopyImage(const cv::Mat& res,
+  mshadow::Tensor<cpu, 3, DType>* data, const bool is_mirrored, const float contrast_scaled,
+  const float illumination_scaled) {
+  // For RGB or RGBA data, swap the B and R channel:
+  // OpenCV store as BGR (or BGRA) and we want RGB (or RGBA)
+  const int n_channels = res.channels();
+  if (n_channels == 1) {
+    ProcessImage<1>(res, data, is_mirrored, contrast_scaled, illumination_scaled);
+  } else if (n_channels == 3) {
+    ProcessImage<3>(res, data, is_mirrored, contrast_scaled, illumination_scaled);
+  } else if (n_channels == 4) {
+    ProcessImage<4>(res, data, is_mirrored, contrast_scaled, illumination_scaled);
+  }
+}
+
+template<typename DType>
+inline void ImageRecordIOParser2<DType>::RemapImage(const cv::Mat& src,
+  const cv::Rect_<float>& window, mshadow::Tensor<cpu, 3, DType>* data,
+  const bool is_mirrored, const float contrast_scaled, const float illumination_scaled) {
+  // same normalization as ProcessImage
+  RemapNormalizer norm;
+  if (!std::is_same<DType, uint8_t>::value) {
+    const float stds[4] = {normalize_param_.std_r, normalize_param_.std_g,
+                           normalize_param_.std_b, normalize_param_.std_a};
+    const float means[4] = {normalize_param_.mean_r, normalize_param_.mean_g,
+                            normalize_param_.mean_b, normalize_param_.mean_a};
+    norm.enabled = true;
+    for (int k = 0; k < 4; ++k) {
+      norm.mult[k] = contrast_scaled / stds[k];
+      norm.bias[k] = illumination_scaled / stds[k];
+      norm.mean[k] = meanfile_ready_ ? 0.0f : means[k];
+    }
+    if (meanfile_ready_) {
+      norm.mean_img = meanimg_.dptr_;
+    }
+  }
+  CHECK_EQ(data->size(0), static_cast<index_t>(src.channels()));
+  io::RemapImage(src, window, is_mirrored, norm, data->size(1), data->size(2), data->dptr_);
+}
+#endif
+
+template<typename DType>
+inline bool ImageRecordIOParser2<DType>::NextChunk(size_t max_records, RecordReader* reader) {
+  if (mmap_ == nullptr && pread_ == nullptr) {
+    bool has_data = max_records != 0 ? source_->NextBatch(&chunk_, max_records)
+                                     : source_->NextChunk(&chunk_);
+    if (!has_data) return false;
+    auto chunk_reader = std::make_shared<dmlc::RecordIOChunkReader>(chunk_, 0, 1);
+    *reader = [chunk_reader](dmlc::InputSplit::Blob* blob) {
+      return chunk_reader->NextRecord(blob);
+    };
+    return true;
+  }
+  if (record_pos_ == record_order_.size()) return false;
+  // records are views into the mapping, so chunks only bound the work per call
+  if (max_records == 0) max_records = batch_param_.batch_size;
+  const size_t end = std::min(record_order_.size(), record_pos_ + max_records);
+  if (pread_ != nullptr) {
+    pread_->ReadRecords(&record_order_[record_pos_], end - record_pos_, &pread_records_);
+    record_pos_ = end;
+    auto pos = std::make_shared<size_t>(0);
+    *reader = [this, pos](dmlc::InputSplit::Blob* blob) {
+      if (*pos == pread_records_.size()) return false;
+      *blob = pread_records_[(*pos)++];
+      return true;
+    };
+    return true;
+  }
+  auto pos = std::make_shared<size_t>(record_pos_);
+  record_pos_ = end;
+  split_records_.clear();
+  *reader = [this, pos, end](dmlc::InputSplit::Blob* blob) {
+    if (*pos == end) return false;
+    std::string buf;
+    mmap_->GetRecord(record_order_[(*pos)++], blob, &buf);
+    if (!buf.empty()) {
+      split_records_.push_back(std::move(buf));
+      blob->dptr = &split_records_.back()[0];
+    }
+    return true;
+  };
+  return true;
+}
+
+template<typename DType>
+inline void ImageRecordIOParser2<DType>::RewindSource(void) {
+  if (mmap_ == nullptr && pread_ == nullptr) {
+    source_->BeforeFirst();
+    return;
+  }
+  record_pos_ = 0;
+  // records of the part, balanced by count like indexed_recordio
+  const size_t begin = num_records_ * param_.part_index / param_.num_parts;
+  const size_t end = num_records_ * (param_.part_index + 1) / param_.num_parts;
+  if (param_.global_shuffle && record_param_.shuffle) {
+    // every part draws the same permutation of all records and reads its slice
+    std::vector<size_t> order(num_records_);
+    std::iota(order.begin(), order.end(), 0);
+    common::RANDOM_ENGINE rnd(record_param_.seed + kRandMagic * epoch_++);
+    std::shuffle(order.begin(), order.end(), rnd);
+    record_order_.assign(order.begin() + begin, order.begin() + end);
+    return;
+  }
+  if (record_order_.empty()) {
+    record_order_.resize(end - begin);
+    std::iota(record_order_.begin(), record_order_.end(), begin);
+  }
+  if (record_param_.shuffle) {
+    std::shuffle(record_order_.begin(), record_order_.end(), rnd_);
+  }
+}
 
 // Returns the number of images that are put into output
 template<typename DType>
 inline unsigned ImageRecordIOParser2<DType>::ParseChunk(DType* data_dptr, real_t* label_dptr,
-  const unsigned current_size, dmlc::InputSplit::Blob * chunk) {
+  const unsigned current_size, const RecordReader& reader) {
   temp_.resize(param_.preprocess_threads);
 #if MXNET_USE_OPENCV
   // save opencv out
-  dmlc::RecordIOChunkReader reader(*chunk, 0, 1);
   unsigned gl_idx = current_size;
   #pragma omp parallel num_threads(param_.preprocess_threads)
   {
     CHECK(omp_get_num_threads() == param_.preprocess_threads);
     unsigned int tid = omp_get_thread_num();
-    // dmlc::RecordIOChunkReader reader(*chunk, tid, param_.preprocess_threads);
     ImageRecordIO rec;
     dmlc::InputSplit::Blob blob;
     // image data
@@ -499,7 +906,7 @@ inline unsigned ImageRecordIOParser2<DType>::ParseChunk(DType* data_dptr, real_t
       unsigned idx;
       #pragma omp critical
       {
-        reader_has_data = reader.NextRecord(&blob);
+        reader_has_data = reader(&blob);
         if (reader_has_data) {
           idx = gl_idx++;
           if (idx >= batch_param_.batch_size) {
@@ -509,86 +916,39 @@ inline unsigned ImageRecordIOParser2<DType>::ParseChunk(DType* data_dptr, real_t
       }
       if (!reader_has_data) break;
       // Opencv decode and augments
-      cv::Mat res;
       rec.Load(blob.dptr, blob.size);
-      cv::Mat buf(1, rec.content_size, CV_8U, rec.content);
-      switch (param_.data_shape[0]) {
-       case 1:
-#if MXNET_USE_LIBJPEG_TURBO
-        res = TJimdecode(buf, 0);
-#else
-        res = cv::imdecode(buf, 0);
-#endif
-        break;
-       case 3:
-#if MXNET_USE_LIBJPEG_TURBO
-        res = TJimdecode(buf, 1);
-#else
-        res = cv::imdecode(buf, 1);
-#endif
-        break;
-       case 4:
-        // -1 to keep the number of channel of the encoded image, and not force gray or color.
-        res = cv::imdecode(buf, -1);
-        CHECK_EQ(res.channels(), 4)
-          << "Invalid image with index " << rec.image_index()
-          << ". Expected 4 channels, got " << res.channels();
-        break;
-       default:
-        LOG(FATAL) << "Invalid output shape " << param_.data_shape;
-      }
+      cv::Mat res = DecodeImage(rec);
       const int n_channels = res.channels();
       // load label before augmentations
-      std::vector<float> label_buf;
-      if (label_map_ != nullptr) {
-        label_buf = label_map_->FindCopy(rec.image_index());
-      } else if (rec.label != NULL) {
-        CHECK_EQ(param_.label_width, rec.num_label)
-          << "rec file provide " << rec.num_label << "-dimensional label "
-             "but label_width is set to " << param_.label_width;
-        label_buf.assign(rec.label, rec.label + rec.num_label);
+      std::vector<float> label_buf = LoadLabel(rec);
+      cv::Rect_<float> window;
+      if (fused_augment_) {
+        window = augmenters_[tid][0]->SampleWindow(res.rows, res.cols, prnds_[tid].get());
       } else {
-        CHECK_EQ(param_.label_width, 1)
-          << "label_width must be 1 unless an imglist is provided "
-             "or the rec file is packed with multi dimensional label";
-        label_buf.assign(&rec.header.label, &rec.header.label + 1);
-      }
-      for (auto& aug : augmenters_[tid]) {
-        res = aug->Process(res, &label_buf, prnds_[tid].get());
+        for (auto& aug : augmenters_[tid]) {
+          res = aug->Process(res, &label_buf, prnds_[tid].get());
+        }
       }
+      const int rows = fused_augment_ ? param_.data_shape[1] : res.rows;
+      const int cols = fused_augment_ ? param_.data_shape[2] : res.cols;
       mshadow::Tensor<cpu, 3, DType> data;
       if (idx < batch_param_.batch_size) {
         data = mshadow::Tensor<cpu, 3, DType>(data_dptr + idx*unit_size_[0],
-          mshadow::Shape3(n_channels, res.rows, res.cols));
+          mshadow::Shape3(n_channels, rows, cols));
       } else {
         out_tmp.Push(static_cast<unsigned>(rec.image_index()),
-                 mshadow::Shape3(n_channels, res.rows, res.cols),
+                 mshadow::Shape3(n_channels, rows, cols),
                  mshadow::Shape1(param_.label_width));
         data = out_tmp.data().Back();
       }
 
-      std::uniform_real_distribution<float> rand_uniform(0, 1);
-      std::bernoulli_distribution coin_flip(0.5);
-      bool is_mirrored = (normalize_param_.rand_mirror && coin_flip(*(prnds_[tid])))
-                         || normalize_param_.mirror;
-      float contrast_scaled = 1;
-      float illumination_scaled = 0;
-      if (!std::is_same<DType, uint8_t>::value) {
-        contrast_scaled =
-          (rand_uniform(*(prnds_[tid])) * normalize_param_.max_random_contrast * 2
-          - normalize_param_.max_random_contrast + 1)*normalize_param_.scale;
-        illumination_scaled =
-          (rand_uniform(*(prnds_[tid])) * normalize_param_.max_random_illumination * 2
-          - normalize_param_.max_random_illumination) * normalize_param_.scale;
-      }
-      // For RGB or RGBA data, swap the B and R channel:
-      // OpenCV store as BGR (or BGRA) and we want RGB (or RGBA)
-      if (n_channels == 1) {
-        ProcessImage<1>(res, &data, is_mirrored, contrast_scaled, illumination_scaled);
-      } else if (n_channels == 3) {
-        ProcessImage<3>(res, &data, is_mirrored, contrast_scaled, illumination_scaled);
-      } else if (n_channels == 4) {
-        ProcessImage<4>(res, &data, is_mirrored, contrast_scaled, illumination_scaled);
+      bool is_mirrored;
+      float contrast_scaled, illumination_scaled;
+      DrawNormalize(prnds_[tid].get(), &is_mirrored, &contrast_scaled, &illumination_scaled);
+      if (fused_augment_) {
+        RemapImage(res, window, &data, is_mirrored, contrast_scaled, illumination_scaled);
+      } else {
+        CopyImage(res, &data, is_mirrored, contrast_scaled, illumination_scaled);
       }
 
       mshadow::Tensor<cpu, 1, real_t> label;
@@ -611,6 +971,298 @@ inline unsigned ImageRecordIOParser2<DType>::ParseChunk(DType* data_dptr, real_t
 #endif
 }
 
+#if MXNET_USE_OPENCV
+template<typename DType>
+inline bool ImageRecordIOParser2<DType>::NextPipelineBatch(DataBatch *out) {
+  CHECK(source_ != nullptr || mmap_ != nullptr || pread_ != nullptr);
+  if (pipeline_threads_.empty()) {
+    StartPipeline();
+  }
+  PipelineBatch* slot = &batch_slots_[next_batch_ % batch_slots_.size()];
+  bool last_batch;
+  {
+    std::unique_lock<std::mutex> lock(batch_mutex_);
+    batch_cond_.wait(lock, [this, slot]() {
+      return pipeline_error_ || next_batch_ == end_batch_ ||
+          slot->filled == ExpectedBatchSize(next_batch_);
+    });
+    if (pipeline_error_) {
+      std::exception_ptr error = pipeline_error_;
+      lock.unlock();
+      StopPipeline();
+      std::rethrow_exception(error);
+    }
+    if (next_batch_ == end_batch_) {
+      if (param_.verbose) {
+        const double elapsed = dmlc::GetTime() - pipeline_start_;
+        for (const PipelineStageStats* stats :
+             {&read_stats_, &decode_stats_, &augment_stats_, &batch_stats_}) {
+          LOG(INFO) << "ImageRecordIOParser2 pipeline " << stats->Describe(elapsed);
+        }
+      }
+      return false;
+    }
+    last_batch = next_batch_ + 1 == end_batch_;
+  }
+  // the stages are done with this slot, hand its arrays out and
+  // take over the recycled ones of out
+  out->data.swap(slot->data);
+  out->index.swap(slot->index);
+  out->num_batch_padd = last_batch ? last_pad_ : 0;
+  ResetBatchSlot(slot);
+  {
+    std::lock_guard<std::mutex> lock(batch_mutex_);
+    ++next_batch_;
+  }
+  batch_cond_.notify_all();
+  return true;
+}
+
+template<typename DType>
+inline void ImageRecordIOParser2<DType>::ResetBatchSlot(PipelineBatch* slot) {
+  if (slot->data.size() == 0) {
+    InitBatchData(&slot->data);
+  }
+  slot->index.resize(batch_param_.batch_size);
+  slot->data_dptr = static_cast<DType*>(slot->data[0].data().dptr_);
+  slot->label_dptr = static_cast<real_t*>(slot->data[1].data().dptr_);
+  slot->filled = 0;
+}
+
+template<typename DType>
+inline void ImageRecordIOParser2<DType>::StartPipeline(void) {
+  // batch i is assembled in slot i % prefetch_buffer, the reader stays
+  // at most that many batches ahead of the consumer
+  batch_slots_.resize(std::max<size_t>(prefetch_param_.prefetch_buffer, 1));
+  for (PipelineBatch& slot : batch_slots_) {
+    ResetBatchSlot(&slot);
+  }
+  next_batch_ = 0;
+  end_batch_ = std::numeric_limits<unsigned>::max();
+  last_size_ = 0;
+  last_pad_ = 0;
+  stop_ = false;
+  pipeline_error_ = nullptr;
+  const size_t capacity = pipeline_param_.pipeline_queue_size;
+  record_queue_.reset(new PipelineQueue<PipelineRecord>(capacity, 1));
+  decoded_queue_.reset(new PipelineQueue<PipelineImage>(capacity,
+                                                        pipeline_param_.decode_threads));
+  augmented_queue_.reset(new PipelineQueue<PipelineImage>(capacity,
+                                                          pipeline_param_.augment_threads));
+  read_stats_.Reset(1);
+  decode_stats_.Reset(pipeline_param_.decode_threads);
+  augment_stats_.Reset(pipeline_param_.augment_threads);
+  batch_stats_.Reset(pipeline_param_.batch_threads);
+  pipeline_start_ = dmlc::GetTime();
+
+  pipeline_threads_.emplace_back([this]() { RunStage([this]() { ReadStage(); }); });
+  for (int i = 0; i < pipeline_param_.decode_threads; ++i) {
+    pipeline_threads_.emplace_back([this]() { RunStage([this]() { DecodeStage(); }); });
+  }
+  for (int i = 0; i < pipeline_param_.augment_threads; ++i) {
+    pipeline_threads_.emplace_back([this, i]() { RunStage([this, i]() { AugmentStage(i); }); });
+  }
+  for (int i = 0; i < pipeline_param_.batch_threads; ++i) {
+    pipeline_threads_.emplace_back([this]() { RunStage([this]() { BatchStage(); }); });
+  }
+}
+
+template<typename DType>
+inline void ImageRecordIOParser2<DType>::StopPipeline(void) {
+  if (pipeline_threads_.empty()) return;
+  {
+    std::lock_guard<std::mutex> lock(batch_mutex_);
+    stop_ = true;
+  }
+  batch_cond_.notify_all();
+  record_queue_->Kill();
+  decoded_queue_->Kill();
+  augmented_queue_->Kill();
+  for (std::thread& thread : pipeline_threads_) {
+    thread.join();
+  }
+  pipeline_threads_.clear();
+}
+
+template<typename DType>
+template<typename FStage>
+inline void ImageRecordIOParser2<DType>::RunStage(FStage stage) {
+  try {
+    stage();
+  } catch (...) {
+    {
+      std::lock_guard<std::mutex> lock(batch_mutex_);
+      if (!pipeline_error_) {
+        pipeline_error_ = std::current_exception();
+      }
+      stop_ = true;
+    }
+    batch_cond_.notify_all();
+    record_queue_->Kill();
+    decoded_queue_->Kill();
+    augmented_queue_->Kill();
+  }
+}
+
+template<typename DType>
+inline bool ImageRecordIOParser2<DType>::ReadPendingRecords(void) {
+  RecordReader reader;
+  const double start = dmlc::GetTime();
+  if (!NextChunk(batch_param_.batch_size, &reader)) {
+    return false;
+  }
+  // records in the mapping are passed as views, others are copied
+  // out since the chunk is reused by the next read
+  std::vector<PipelineRecord> records;
+  dmlc::InputSplit::Blob blob;
+  while (reader(&blob)) {
+    PipelineRecord record;
+    if (mmap_ != nullptr && mmap_->Contains(blob.dptr)) {
+      record.dptr = static_cast<char*>(blob.dptr);
+      record.size = blob.size;
+    } else {
+      record.data.assign(static_cast<const char*>(blob.dptr), blob.size);
+      record.dptr = nullptr;
+      record.size = 0;
+    }
+    records.push_back(std::move(record));
+  }
+  if (legacy_shuffle_) {
+    std::shuffle(records.begin(), records.end(), rnd_);
+  }
+  for (PipelineRecord& record : records) {
+    pending_.push_back(std::move(record));
+  }
+  read_stats_.Add(start, records.size());
+  return true;
+}
+
+template<typename DType>
+inline void ImageRecordIOParser2<DType>::ReadStage(void) {
+  const unsigned batch_size = batch_param_.batch_size;
+  const unsigned window = batch_slots_.size();
+  unsigned seq = 0, num_wrapped = 0;
+  bool wrapped = false;
+  while (!wrapped || seq % batch_size != 0) {
+    if (pending_.empty()) {
+      if (ReadPendingRecords()) continue;
+      if (wrapped || seq % batch_size == 0 || batch_param_.round_batch == 0) break;
+      // fill the last batch with the head of the next epoch, which then
+      // continues after these records
+      wrapped = true;
+      overflow = true;
+      RewindSource();
+      continue;
+    }
+    {
+      std::unique_lock<std::mutex> lock(batch_mutex_);
+      batch_cond_.wait(lock, [this, seq, batch_size, window]() {
+        return stop_ || seq / batch_size < next_batch_ + window;
+      });
+      if (stop_) return;
+    }
+    PipelineRecord record = std::move(pending_.front());
+    pending_.pop_front();
+    record.seq = seq;
+    if (!record_queue_->Push(std::move(record))) return;
+    ++seq;
+    if (wrapped) ++num_wrapped;
+  }
+  CHECK(!wrapped || seq % batch_size == 0)
+      << "number of input images must be bigger than the batch size";
+  {
+    std::lock_guard<std::mutex> lock(batch_mutex_);
+    end_batch_ = (seq + batch_size - 1) / batch_size;
+    last_size_ = seq % batch_size == 0 ? batch_size : seq % batch_size;
+    last_pad_ = wrapped ? num_wrapped : batch_size - last_size_;
+  }
+  batch_cond_.notify_all();
+  record_queue_->ProducerDone();
+}
+
+template<typename DType>
+inline void ImageRecordIOParser2<DType>::DecodeStage(void) {
+  ImageRecordIO rec;
+  PipelineRecord record;
+  while (record_queue_->Pop(&record)) {
+    const double start = dmlc::GetTime();
+    if (record.dptr != nullptr) {
+      rec.Load(record.dptr, record.size);
+    } else {
+      rec.Load(&record.data[0], record.data.size());
+    }
+    PipelineImage image;
+    image.seq = record.seq;
+    image.index = rec.image_index();
+    image.image = DecodeImage(rec);
+    image.label = LoadLabel(rec);
+    decode_stats_.Add(start);
+    if (!decoded_queue_->Push(std::move(image))) return;
+  }
+  decoded_queue_->ProducerDone();
+}
+
+template<typename DType>
+inline void ImageRecordIOParser2<DType>::AugmentStage(int tid) {
+  PipelineImage image;
+  while (decoded_queue_->Pop(&image)) {
+    const double start = dmlc::GetTime();
+    if (fused_augment_) {
+      image.window = augmenters_[tid][0]->SampleWindow(image.image.rows, image.image.cols,
+                                                       prnds_[tid].get());
+    } else {
+      for (auto& aug : augmenters_[tid]) {
+        image.image = aug->Process(image.image, &image.label, prnds_[tid].get());
+      }
+    }
+    DrawNormalize(prnds_[tid].get(), &image.is_mirrored, &image.contrast_scaled,
+                  &image.illumination_scaled);
+    augment_stats_.Add(start);
+    if (!augmented_queue_->Push(std::move(image))) return;
+  }
+  augmented_queue_->ProducerDone();
+}
+
+template<typename DType>
+inline void ImageRecordIOParser2<DType>::BatchStage(void) {
+  const unsigned batch_size = batch_param_.batch_size;
+  PipelineImage image;
+  while (augmented_queue_->Pop(&image)) {
+    const double start = dmlc::GetTime();
+    const unsigned batch = image.seq / batch_size;
+    const unsigned pos = image.seq % batch_size;
+    PipelineBatch& slot = batch_slots_[batch % batch_slots_.size()];
+    const cv::Mat& res = image.image;
+    if (fused_augment_) {
+      mshadow::Tensor<cpu, 3, DType> data(slot.data_dptr + pos * unit_size_[0],
+        mshadow::Shape3(res.channels(), param_.data_shape[1], param_.data_shape[2]));
+      RemapImage(res, image.window, &data, image.is_mirrored, image.contrast_scaled,
+                 image.illumination_scaled);
+    } else {
+      CHECK_EQ(static_cast<size_t>(res.channels()) * res.rows * res.cols, unit_size_[0])
+        << "Augmented image with index " << image.index << " does not match data_shape "
+        << param_.data_shape;
+      mshadow::Tensor<cpu, 3, DType> data(slot.data_dptr + pos * unit_size_[0],
+        mshadow::Shape3(res.channels(), res.rows, res.cols));
+      CopyImage(res, &data, image.is_mirrored, image.contrast_scaled,
+                image.illumination_scaled);
+    }
+    mshadow::Tensor<cpu, 1, real_t> label(slot.label_dptr + pos * unit_size_[1],
+      mshadow::Shape1(param_.label_width));
+    mshadow::Copy(label, mshadow::Tensor<cpu, 1>(dmlc::BeginPtr(image.label),
+      mshadow::Shape1(image.label.size())));
+    slot.index[pos] = image.index;
+    batch_stats_.Add(start);
+    bool complete;
+    {
+      std::lock_guard<std::mutex> lock(batch_mutex_);
+      complete = ++slot.filled == ExpectedBatchSize(batch);
+    }
+    if (complete) batch_cond_.notify_all();
+  }
+}
+#endif
+
 // create mean image.
 template<typename DType>
 inline void ImageRecordIOParser2<DType>::CreateMeanImg(void) {
@@ -619,12 +1271,12 @@ inline void ImageRecordIOParser2<DType>::CreateMeanImg(void) {
                 << ": create mean image, this will take some time...";
     }
     double start = dmlc::GetTime();
-    dmlc::InputSplit::Blob chunk;
+    RecordReader reader;
     size_t imcnt = 0;  // NOLINT(*)
-    while (source_->NextChunk(&chunk)) {
+    while (NextChunk(0, &reader)) {
       inst_order_.clear();
       // Parse chunk w/o putting anything in out
-      ParseChunk(NULL, NULL, batch_param_.batch_size, &chunk);
+      ParseChunk(NULL, NULL, batch_param_.batch_size, reader);
       for (unsigned i = 0; i < inst_order_.size(); ++i) {
         std::pair<unsigned, unsigned> place = inst_order_[i];
         mshadow::Tensor<cpu, 3> outimg =
@@ -656,6 +1308,9 @@ inline void ImageRecordIOParser2<DType>::CreateMeanImg(void) {
       LOG(INFO) << "Save mean image to " << normalize_param_.mean_img << "..";
     }
     meanfile_ready_ = true;
+    // the pass over the records is not an epoch. draw the permutation of Init again, as
+    // the parts which load the mean image do, so that their slices still match
+    epoch_ = 0;
     this->BeforeFirst();
 }
 
@@ -748,8 +1403,16 @@ Example::
   ...
   data_iter.reset() # To restart the iterator from the beginning.
 
+By default each chunk of records is decoded and augmented by ``preprocess_threads``
+threads at once. With ``pipeline=True`` reading, decoding, augmentation and batch
+assembly instead run as separate stages with ``decode_threads``, ``augment_threads``
+and ``batch_threads`` threads, connected by queues of ``pipeline_queue_size``
+items, and the throughput of each stage is logged at the end of every epoch when
+``verbose`` is set.
+
 )code" ADD_FILELINE)
 .add_arguments(ImageRecParserParam::__FIELDS__())
+.add_arguments(ImageRecPipelineParam::__FIELDS__())
 .add_arguments(ImageRecordParam::__FIELDS__())
 .add_arguments(BatchParam::__FIELDS__())
 .add_arguments(PrefetcherParam::__FIELDS__())
@@ -767,6 +1430,7 @@ the data type instead of ``float``.
 
 )code" ADD_FILELINE)
 .add_arguments(ImageRecParserParam::__FIELDS__())
+.add_arguments(ImageRecPipelineParam::__FIELDS__())
 .add_arguments(ImageRecordParam::__FIELDS__())
 .add_arguments(BatchParam::__FIELDS__())
 .add_arguments(PrefetcherParam::__FIELDS__())
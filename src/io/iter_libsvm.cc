@@ -26,8 +26,11 @@
 #include <dmlc/logging.h>
 #include <dmlc/parameter.h>
 #include <dmlc/data.h>
+#include <sstream>
 #include "./iter_sparse_prefetcher.h"
 #include "./iter_sparse_batchloader.h"
+#include "./iter_text_block.h"
+#include "./row_cache.h"
 
 namespace mxnet {
 namespace io {
@@ -72,16 +75,11 @@ class LibSVMIter: public SparseIIterator<DataInst> {
   // intialize iterator loads data in
   virtual void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) {
     param_.InitAllowUnknown(kwargs);
+    cache_param_.InitAllowUnknown(kwargs);
     CHECK_EQ(param_.data_shape.ndim(), 1) << "dimension of data_shape is expected to be 1";
     CHECK_GT(param_.num_parts, 0) << "number of parts should be positive";
     CHECK_GE(param_.part_index, 0) << "part index should be non-negative";
-    data_parser_.reset(dmlc::Parser<uint64_t>::Create(param_.data_libsvm.c_str(),
-                                                      param_.part_index,
-                                                      param_.num_parts, "libsvm"));
     if (param_.label_libsvm != "NULL") {
-      label_parser_.reset(dmlc::Parser<uint64_t>::Create(param_.label_libsvm.c_str(),
-                                                         param_.part_index,
-                                                         param_.num_parts, "libsvm"));
       CHECK_GT(param_.label_shape.Size(), 1)
         << "label_shape is not expected to be (1,) when param_.label_libsvm is set.";
     } else {
@@ -95,12 +93,27 @@ class LibSVMIter: public SparseIIterator<DataInst> {
       // only data is of CSRStorage in libsvm format.
       out_.data.resize(4);
     }
+    if (this->InitCache()) return;
+    data_parser_.reset(dmlc::Parser<uint64_t>::Create(param_.data_libsvm.c_str(),
+                                                      param_.part_index,
+                                                      param_.num_parts, "libsvm"));
+    if (param_.label_libsvm != "NULL") {
+      label_parser_.reset(dmlc::Parser<uint64_t>::Create(param_.label_libsvm.c_str(),
+                                                         param_.part_index,
+                                                         param_.num_parts, "libsvm"));
+    }
+    cache_.BeginPass();
   }
 
   virtual void BeforeFirst() {
-    data_parser_->BeforeFirst();
-    if (label_parser_.get() != nullptr) {
-      label_parser_->BeforeFirst();
+    if (cache_.reading()) {
+      cache_.reader().BeforeFirst();
+    } else {
+      data_parser_->BeforeFirst();
+      if (label_parser_.get() != nullptr) {
+        label_parser_->BeforeFirst();
+      }
+      cache_.BeginPass();
     }
     data_ptr_ = label_ptr_ = 0;
     data_size_ = label_size_ = 0;
@@ -110,9 +123,12 @@ class LibSVMIter: public SparseIIterator<DataInst> {
 
   virtual bool Next() {
     if (end_) return false;
+    if (cache_.reading()) return this->NextFromCache();
     while (data_ptr_ >= data_size_) {
       if (!data_parser_->Next()) {
-        end_ = true; return false;
+        end_ = true;
+        cache_.EndPass();
+        return false;
       }
       data_ptr_ = 0;
       data_size_ = data_parser_->Value().size;
@@ -141,6 +157,12 @@ class LibSVMIter: public SparseIIterator<DataInst> {
     } else {
       out_.data[3] = AsScalarLabelBlob(data_row);
     }
+    // the indptr placeholders are not cached
+    cache_row_.clear();
+    for (size_t i = 0; i < out_.data.size(); ++i) {
+      if (i != 2 && i != 5) cache_row_.push_back(out_.data[i]);
+    }
+    cache_.Append(cache_row_);
     return true;
   }
 
@@ -159,6 +181,46 @@ class LibSVMIter: public SparseIIterator<DataInst> {
   }
 
  private:
+  // open the row cache, returns whether the rows can be read from it
+  inline bool InitCache() {
+    std::vector<RowCacheArray> arrays;
+    arrays.push_back({mshadow::kFloat32, -1});
+    arrays.push_back({mshadow::kInt64, -1});
+    std::ostringstream signature;
+    signature << "libsvm " << param_.data_libsvm << ' ' << param_.data_shape << ' '
+              << param_.part_index << '/' << param_.num_parts
+              << row_cache::InputStamp(param_.data_libsvm);
+    if (param_.label_libsvm != "NULL") {
+      arrays.push_back({mshadow::kFloat32, -1});
+      arrays.push_back({mshadow::kInt64, -1});
+      signature << ' ' << param_.label_libsvm << ' ' << param_.label_shape
+                << row_cache::InputStamp(param_.label_libsvm);
+    } else {
+      arrays.push_back({mshadow::kFloat32, 1});
+    }
+    return cache_.Init(cache_param_, signature.str(), arrays);
+  }
+
+  inline bool NextFromCache() {
+    RowCacheReader& reader = cache_.reader();
+    if (!reader.Next()) {
+      end_ = true; return false;
+    }
+    out_.index = inst_counter_++;
+    const TBlob indptr(nullptr, mshadow::Shape1(0), cpu::kDevMask, mshadow::kInt64);
+    out_.data[0] = reader.Value(0, mshadow::Shape1(reader.Length(0)));
+    out_.data[1] = reader.Value(1, mshadow::Shape1(reader.Length(1)));
+    out_.data[2] = indptr;
+    if (param_.label_libsvm != "NULL") {
+      out_.data[3] = reader.Value(2, mshadow::Shape1(reader.Length(2)));
+      out_.data[4] = reader.Value(3, mshadow::Shape1(reader.Length(3)));
+      out_.data[5] = indptr;
+    } else {
+      out_.data[3] = reader.Value(2, mshadow::Shape1(1));
+    }
+    return true;
+  }
+
   inline TBlob AsDataBlob(const dmlc::Row<uint64_t>& row) {
     const real_t* ptr = row.value;
     TShape shape(mshadow::Shape1(row.length));
@@ -181,6 +243,10 @@ class LibSVMIter: public SparseIIterator<DataInst> {
   }
 
   LibSVMIterParam param_;
+  RowCacheParam cache_param_;
+  // binary cache of the parsed rows
+  RowCache cache_;
+  std::vector<TBlob> cache_row_;
   // output instance
   DataInst out_;
   // internal instance counter
@@ -195,6 +261,223 @@ class LibSVMIter: public SparseIIterator<DataInst> {
 };
 
 
+/*! \brief CSR arrays of one batch */
+struct CSRBatchBuffer {
+  std::vector<real_t> value;
+  std::vector<int64_t> index;
+  std::vector<int64_t> indptr;
+  inline void Clear() {
+    value.clear();
+    index.clear();
+    indptr.assign(1, 0);
+  }
+  // append rows [begin, end) of a parsed block
+  inline void Append(const TextRowBlock<real_t>& blk, size_t begin, size_t end) {
+    value.insert(value.end(), blk.value.begin() + blk.offset[begin],
+                 blk.value.begin() + blk.offset[end]);
+    index.insert(index.end(), blk.index.begin() + blk.offset[begin],
+                 blk.index.begin() + blk.offset[end]);
+    for (size_t i = begin; i < end; ++i) {
+      indptr.push_back(indptr.back() + blk.Length(i));
+    }
+  }
+};
+
+/*!
+ * \brief LibSVM iterator that parses chunks of the files on several threads and
+ *  appends the parsed rows directly to the CSR arrays of the batch, without going
+ *  through DataInst
+ */
+class LibSVMBlockIter: public SparseIIterator<TBlobBatch> {
+ public:
+  virtual ~LibSVMBlockIter() {
+    delete[] out_.inst_index;
+  }
+
+  virtual void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) {
+    param_.InitAllowUnknown(kwargs);
+    batch_param_.InitAllowUnknown(kwargs);
+    block_param_.InitAllowUnknown(kwargs);
+    CHECK_EQ(param_.data_shape.ndim(), 1) << "dimension of data_shape is expected to be 1";
+    CHECK_GT(param_.num_parts, 0) << "number of parts should be positive";
+    CHECK_GE(param_.part_index, 0) << "part index should be non-negative";
+    if (batch_param_.round_batch == 0) {
+      LOG(FATAL) << "sparse batch loader doesn't support round_batch == false yet";
+    }
+    data_reader_.reset(new TextBlockReader<real_t>(
+        param_.data_libsvm, param_.part_index, param_.num_parts,
+        TextBlockReader<real_t>::kLibSVM, block_param_));
+    if (param_.label_libsvm != "NULL") {
+      label_reader_.reset(new TextBlockReader<real_t>(
+          param_.label_libsvm, param_.part_index, param_.num_parts,
+          TextBlockReader<real_t>::kLibSVM, block_param_));
+      CHECK_GT(param_.label_shape.Size(), 1)
+        << "label_shape is not expected to be (1,) when param_.label_libsvm is set.";
+    } else {
+      CHECK_EQ(param_.label_shape.Size(), 1)
+        << "label_shape is expected to be (1,) when param_.label_libsvm is NULL";
+    }
+    out_.inst_index = new unsigned[batch_param_.batch_size];
+    out_.batch_size = batch_param_.batch_size;
+    dense_label_.resize(batch_param_.batch_size);
+  }
+
+  virtual void BeforeFirst() {
+    if (num_overflow_ == 0) {
+      // otherwise, the readers were already rewound to fill the last batch
+      this->Rewind();
+    } else {
+      num_overflow_ = 0;
+    }
+  }
+
+  virtual bool Next() {
+    out_.num_batch_padd = 0;
+    // if overflown from previous round, directly return false, until before first is called
+    if (num_overflow_ != 0) return false;
+    const size_t batch_size = batch_param_.batch_size;
+    data_.Clear();
+    label_.Clear();
+    const size_t top = this->Fill(0);
+    if (top == 0) return false;
+    if (top != batch_size) {
+      this->Rewind();
+      CHECK_EQ(this->Fill(top), batch_size) << "number of input must be bigger than batch size";
+      num_overflow_ = batch_size - top;
+      out_.num_batch_padd = num_overflow_;
+    }
+    this->SetOutput();
+    return true;
+  }
+
+  virtual const TBlobBatch &Value(void) const {
+    return out_;
+  }
+
+  virtual const NDArrayStorageType GetStorageType(bool is_data) const {
+    if (is_data) return kCSRStorage;
+    return param_.label_shape.Size() > 1 ? kCSRStorage : kDefaultStorage;
+  }
+
+  virtual const TShape GetShape(bool is_data) const {
+    TShape inst_shape = is_data ? param_.data_shape : param_.label_shape;
+    std::vector<index_t> shape_vec;
+    shape_vec.push_back(batch_param_.batch_size);
+    for (index_t dim = 0; dim < inst_shape.ndim(); ++dim) {
+      shape_vec.push_back(inst_shape[dim]);
+    }
+    return TShape(shape_vec.begin(), shape_vec.end());
+  }
+
+ private:
+  inline void Rewind() {
+    data_reader_->BeforeFirst();
+    if (label_reader_.get() != nullptr) {
+      label_reader_->BeforeFirst();
+    }
+    inst_counter_ = 0;
+  }
+
+  // append rows to the batch starting at position top, returns the new top
+  inline size_t Fill(size_t top) {
+    const size_t n = data_reader_->Take(batch_param_.batch_size - top,
+      [this, top](const TextRowBlock<real_t>& blk, size_t begin, size_t end, size_t pos) {
+        data_.Append(blk, begin, end);
+        std::copy(blk.label.begin() + begin, blk.label.begin() + end,
+                  dense_label_.begin() + top + pos);
+      });
+    for (size_t i = top; i < top + n; ++i) {
+      out_.inst_index[i] = inst_counter_++;
+    }
+    if (label_reader_.get() != nullptr && n != 0) {
+      CHECK_EQ(label_reader_->Take(n,
+        [this](const TextRowBlock<real_t>& blk, size_t begin, size_t end, size_t pos) {
+          label_.Append(blk, begin, end);
+        }), n) << "Data LibSVM's row is smaller than the number of rows in label_libsvm";
+    }
+    return top + n;
+  }
+
+  inline void SetOutput() {
+    out_.data.clear();
+    AddCSROutput(&data_);
+    if (label_reader_.get() != nullptr) {
+      AddCSROutput(&label_);
+    } else {
+      out_.data.push_back(TBlob(dense_label_.data(), mshadow::Shape1(dense_label_.size()),
+                                cpu::kDevMask));
+    }
+  }
+
+  inline void AddCSROutput(CSRBatchBuffer* buf) {
+    out_.data.push_back(TBlob(buf->value.data(), mshadow::Shape1(buf->value.size()),
+                              cpu::kDevMask));
+    out_.data.push_back(TBlob(buf->index.data(), mshadow::Shape1(buf->index.size()),
+                              cpu::kDevMask));
+    out_.data.push_back(TBlob(buf->indptr.data(), mshadow::Shape1(buf->indptr.size()),
+                              cpu::kDevMask));
+  }
+
+  LibSVMIterParam param_;
+  BatchParam batch_param_;
+  TextBlockParam block_param_;
+  /*! \brief output batch */
+  TBlobBatch out_;
+  /*! \brief CSR arrays of the data and the label */
+  CSRBatchBuffer data_, label_;
+  /*! \brief labels read from the data file */
+  std::vector<real_t> dense_label_;
+  /*! \brief number of instances read from the next round to fill the last batch */
+  size_t num_overflow_{0};
+  // internal instance counter
+  unsigned inst_counter_{0};
+  std::unique_ptr<TextBlockReader<real_t> > data_reader_;
+  std::unique_ptr<TextBlockReader<real_t> > label_reader_;
+};
+
+/*! \brief batch iterator choosing between row by row and block-parallel parsing */
+class LibSVMBatchIter: public SparseIIterator<TBlobBatch> {
+ public:
+  virtual void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) {
+    block_param_.InitAllowUnknown(kwargs);
+    cache_param_.InitAllowUnknown(kwargs);
+    CHECK(cache_param_.cache_file.empty() || block_param_.parse_threads == 0)
+        << "cache_file is only supported with parse_threads = 0";
+    if (block_param_.parse_threads == 0) {
+      loader_.reset(new SparseBatchLoader(new LibSVMIter()));
+    } else {
+      loader_.reset(new LibSVMBlockIter());
+    }
+    loader_->Init(kwargs);
+  }
+
+  virtual void BeforeFirst() {
+    loader_->BeforeFirst();
+  }
+
+  virtual bool Next() {
+    return loader_->Next();
+  }
+
+  virtual const TBlobBatch &Value(void) const {
+    return loader_->Value();
+  }
+
+  virtual const NDArrayStorageType GetStorageType(bool is_data) const {
+    return loader_->GetStorageType(is_data);
+  }
+
+  virtual const TShape GetShape(bool is_data) const {
+    return loader_->GetShape(is_data);
+  }
+
+ private:
+  TextBlockParam block_param_;
+  RowCacheParam cache_param_;
+  std::unique_ptr<SparseIIterator<TBlobBatch> > loader_;
+};
+
+
 DMLC_REGISTER_PARAMETER(LibSVMIterParam);
 
 MXNET_REGISTER_IO_ITER(LibSVMIter)
@@ -224,6 +507,15 @@ When `num_parts` and `part_index` are provided, the data is split into `num_part
 and the iterator only reads the `part_index`-th partition. However, the partitions are not
 guaranteed to be even.
 
+If `parse_threads` is positive, the files are read in chunks of `parse_chunk_size` MB,
+each chunk is parsed by `parse_threads` threads and the rows are appended directly to
+the `csr` arrays of the batch. The batches are the same as with the default row by row parsing.
+
+If `cache_file` is set, the parsed rows are written to this local binary file during the
+first complete pass, and the following passes read them from a memory mapping of the file
+without parsing the LibSVM files again. The cache is rebuilt when the arguments, or the size
+or modification time of local input files, change. `cache_file` requires `parse_threads` = 0.
+
 ``reset()`` is expected to be called only after a complete pass of data.
 
 Example::
@@ -298,11 +590,13 @@ Example::
 )code" ADD_FILELINE)
 .add_arguments(LibSVMIterParam::__FIELDS__())
 .add_arguments(BatchParam::__FIELDS__())
+.add_arguments(TextBlockParam::__FIELDS__())
+.add_arguments(RowCacheParam::__FIELDS__())
 .add_arguments(PrefetcherParam::__FIELDS__())
+.add_arguments(PrefetchDepthParam::__FIELDS__())
 .set_body([]() {
     return new SparsePrefetcherIter(
-        new SparseBatchLoader(
-            new LibSVMIter()));
+        new LibSVMBatchIter());
   });
 
 }  // namespace io
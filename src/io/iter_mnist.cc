@@ -265,6 +265,7 @@ One can download the dataset from http://yann.lecun.com/exdb/mnist/
 )code" ADD_FILELINE)
 .add_arguments(MNISTParam::__FIELDS__())
 .add_arguments(PrefetcherParam::__FIELDS__())
+.add_arguments(PrefetchDepthParam::__FIELDS__())
 .set_body([]() {
     return new PrefetcherIter(new MNISTIter());
   });
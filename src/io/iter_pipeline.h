@@ -0,0 +1,143 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ *  Copyright (c) 2018 by Contributors
+ * \file iter_pipeline.h
+ * \brief bounded queues and counters connecting the stages of a data pipeline
+ */
+#ifndef MXNET_IO_ITER_PIPELINE_H_
+#define MXNET_IO_ITER_PIPELINE_H_
+
+#include <dmlc/logging.h>
+#include <dmlc/timer.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <utility>
+
+namespace mxnet {
+namespace io {
+/*!
+ * \brief Bounded blocking queue between two stages of a pipeline.
+ *  The queue is closed once all its producers are done, after which Pop
+ *  drains the remaining items. Kill wakes up and fails all waiting calls.
+ */
+template<typename T>
+class PipelineQueue {
+ public:
+  PipelineQueue(size_t capacity, int num_producers)
+      : capacity_(capacity), num_producers_(num_producers) {
+    CHECK_GT(capacity, 0U);
+  }
+  /*!
+   * \brief push an item, blocking while the queue is full
+   * \return false if the queue was killed
+   */
+  bool Push(T&& item) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_full_.wait(lock, [this]() { return killed_ || items_.size() < capacity_; });
+    if (killed_) return false;
+    items_.push_back(std::move(item));
+    not_empty_.notify_one();
+    return true;
+  }
+  /*!
+   * \brief pop an item, blocking while the queue is empty and open
+   * \return false if the queue was killed, or is closed and empty
+   */
+  bool Pop(T* item) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_empty_.wait(lock, [this]() {
+      return killed_ || !items_.empty() || num_producers_ == 0;
+    });
+    if (killed_ || items_.empty()) return false;
+    *item = std::move(items_.front());
+    items_.pop_front();
+    not_full_.notify_one();
+    return true;
+  }
+  /*! \brief mark one producer as done, the queue is closed after the last one */
+  void ProducerDone() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    CHECK_GT(num_producers_, 0);
+    if (--num_producers_ == 0) not_empty_.notify_all();
+  }
+  /*! \brief abort all waiting and future calls */
+  void Kill() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    killed_ = true;
+    not_full_.notify_all();
+    not_empty_.notify_all();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable not_full_, not_empty_;
+  std::deque<T> items_;
+  size_t capacity_;
+  int num_producers_;
+  bool killed_{false};
+};
+
+/*! \brief throughput counters of a pipeline stage */
+struct PipelineStageStats {
+  /*! \brief name of the stage */
+  const char* name;
+  /*! \brief number of threads of the stage */
+  int num_threads{0};
+  /*! \brief number of items processed */
+  std::atomic<uint64_t> items{0};
+  /*! \brief time spent processing items by all threads, in microseconds */
+  std::atomic<uint64_t> busy_us{0};
+
+  explicit PipelineStageStats(const char* name) : name(name) {}
+  /*! \brief reset the counters */
+  void Reset(int threads) {
+    num_threads = threads;
+    items = 0;
+    busy_us = 0;
+  }
+  /*! \brief record items processed since start, as returned by dmlc::GetTime */
+  void Add(double start, uint64_t num_items = 1) {
+    busy_us += static_cast<uint64_t>((dmlc::GetTime() - start) * 1e6);
+    items += num_items;
+  }
+  /*!
+   * \brief describe the throughput of the stage over a period
+   * \param seconds wall time of the period
+   */
+  std::string Describe(double seconds) const {
+    const double busy = busy_us * 1e-6;
+    std::ostringstream os;
+    os << name << ": " << items << " items on " << num_threads << " threads, "
+       << (seconds > 0 ? items / seconds : 0) << " items/sec, "
+       << (busy > 0 ? items / busy : 0) << " items/sec per busy thread, "
+       << (seconds > 0 && num_threads > 0 ? 100 * busy / (seconds * num_threads) : 0)
+       << "% busy";
+    return os.str();
+  }
+};
+
+}  // namespace io
+}  // namespace mxnet
+#endif  // MXNET_IO_ITER_PIPELINE_H_
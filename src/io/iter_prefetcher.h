@@ -32,7 +32,13 @@
 #include <dmlc/threadediter.h>
 #include <dmlc/optional.h>
 #include <mshadow/tensor.h>
+#include <atomic>
+#include <chrono>
 #include <climits>
+#include <cmath>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 #include <utility>
 #include <string>
 #include <vector>
@@ -40,6 +46,7 @@
 #include <algorithm>
 #include "./inst_vector.h"
 #include "./image_iter_common.h"
+#include "../profiler/profiler.h"
 
 namespace mxnet {
 namespace io {
@@ -56,6 +63,8 @@ class PrefetcherIter : public IIterator<DataBatch> {
       delete batch;
     }
     delete out_;
+    // release a producer waiting for the depth to drop
+    this->InterruptProducer();
     iter.Destroy();
   }
 
@@ -63,10 +72,24 @@ class PrefetcherIter : public IIterator<DataBatch> {
     std::vector<std::pair<std::string, std::string> > kwargs_left;
     // init image rec param
     kwargs_left = param_.InitAllowUnknown(kwargs);
-    // maximum prefetch threaded iter internal size
-    const int kMaxPrefetchBuffer = 16;
+    depth_param_.InitAllowUnknown(kwargs);
     // init thread iter
     iter.set_max_capacity(kMaxPrefetchBuffer);
+    max_depth_ = kMaxPrefetchBuffer;
+    target_depth_ = std::min<int64_t>(std::max<size_t>(param_.prefetch_buffer, 1), max_depth_);
+    static profiler::ProfileDomain domain("PrefetcherIter");
+    // number the counters of each iterator, so that e.g. the ones of the train and
+    // validation iterators can be told apart
+    static std::atomic<int> num_iters(0);
+    const std::string id = ":" + std::to_string(num_iters++);
+    depth_counter_.reset(new profiler::ProfileCounter(("prefetch_depth" + id).c_str(),
+                                                      &domain));
+    queue_counter_.reset(new profiler::ProfileCounter(("prefetch_queue" + id).c_str(),
+                                                      &domain));
+    wait_counter_.reset(new profiler::ProfileCounter(("prefetch_wait_us" + id).c_str(),
+                                                     &domain));
+    produce_counter_.reset(new profiler::ProfileCounter(("prefetch_load_us" + id).c_str(),
+                                                        &domain));
   }
 
   virtual void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) {
@@ -74,6 +97,8 @@ class PrefetcherIter : public IIterator<DataBatch> {
     // use the kwarg to init batch loader
     loader_->Init(kwargs);
     iter.Init([this](DataBatch **dptr) {
+        const bool allocate = *dptr == nullptr;
+        this->BeginLoad();
         if (!loader_->Next()) return false;
         const TBlobBatch& batch = loader_->Value();
         if (*dptr == nullptr) {
@@ -106,12 +131,14 @@ class PrefetcherIter : public IIterator<DataBatch> {
                     batch.inst_index + batch.batch_size,
                     (*dptr)->index.begin());
         }
+        this->EndLoad(allocate);
        return true;
       },
-      [this]() { loader_->BeforeFirst(); });
+      [this]() { loader_->BeforeFirst(); this->ResetDepth(); });
   }
 
   virtual void BeforeFirst(void) {
+    this->InterruptProducer();
     iter.BeforeFirst();
   }
 
@@ -127,17 +154,149 @@ class PrefetcherIter : public IIterator<DataBatch> {
         arr.WaitToWrite();
       }
       recycle_queue_.pop();
-      iter.Recycle(&old_batch);
+      if (depth_param_.adaptive_prefetch && num_allocated_.load() > this->BatchesInUse()) {
+        // the depth dropped, give the memory back instead of keeping the batch around
+        delete old_batch;
+        --num_allocated_;
+      } else {
+        iter.Recycle(&old_batch);
+      }
+    }
+    const auto start = Clock::now();
+    if (consume_start_ != Clock::time_point()) {
+      consume_us_.Add(MicroSeconds(consume_start_, start));
     }
-    return iter.Next(&out_);
+    const bool ret = iter.Next(&out_);
+    consume_start_ = Clock::now();
+    if (ret) this->Consumed(MicroSeconds(start, consume_start_));
+    return ret;
   }
   virtual const DataBatch &Value(void) const {
     return *out_;
   }
 
  protected:
+  /*! \brief maximum prefetch threaded iter internal size */
+  static const int kMaxPrefetchBuffer = 16;
+  typedef std::chrono::steady_clock Clock;
+  /*! \brief running mean and mean deviation of a duration */
+  struct RunningTime {
+    std::atomic<double> mean{0}, dev{0};
+    inline void Add(double us) {
+      const double kDecay = 0.1;
+      const double m = mean.load();
+      if (m == 0) {
+        mean.store(us);
+        return;
+      }
+      dev.store(dev.load() + kDecay * (std::fabs(us - m) - dev.load()));
+      mean.store(m + kDecay * (us - m));
+    }
+  };
+  static inline double MicroSeconds(Clock::time_point begin, Clock::time_point end) {
+    return std::chrono::duration<double, std::micro>(end - begin).count();
+  }
+
+  // consumer side: number of batches needed at the current depth, which are the
+  // target_depth_ batches loaded ahead (including the one being loaded), the batch
+  // returned by Next and the prefetch_buffer batches waiting to be recycled. Beyond
+  // it, a recycled batch is dropped: the producer can still reach the target depth
+  // with the remaining ones, and allocates a new batch if the depth grows again.
+  // target_depth_ only changes on the consumer thread, and num_allocated_ only grows
+  // concurrently, so a stale read can only keep a batch that could have been dropped.
+  inline int64_t BatchesInUse() const {
+    return target_depth_.load() + static_cast<int64_t>(param_.prefetch_buffer) + 1;
+  }
+  // producer side: wait until fewer batches than the target depth are ahead
+  inline void BeginLoad() {
+    if (depth_param_.adaptive_prefetch) {
+      std::unique_lock<std::mutex> lock(depth_mutex_);
+      depth_cond_.wait(lock, [this]() {
+          return interrupt_ || num_produced_ - num_consumed_ < target_depth_.load();
+        });
+    }
+    load_start_ = Clock::now();
+  }
+  // producer side: count a batch that was loaded
+  inline void EndLoad(bool allocated) {
+    load_us_.Add(MicroSeconds(load_start_, Clock::now()));
+    if (allocated) ++num_allocated_;
+    std::lock_guard<std::mutex> lock(depth_mutex_);
+    ++num_produced_;
+  }
+  // producer side: the threaded iter dropped the batches loaded ahead
+  inline void ResetDepth() {
+    std::lock_guard<std::mutex> lock(depth_mutex_);
+    num_produced_ = num_consumed_ = 0;
+    interrupt_ = false;
+  }
+  // let a producer waiting in BeginLoad go on, so it can handle a reset or exit
+  inline void InterruptProducer() {
+    {
+      std::lock_guard<std::mutex> lock(depth_mutex_);
+      interrupt_ = true;
+    }
+    depth_cond_.notify_all();
+  }
+  // consumer side: account for a batch taken after waiting wait_us for it
+  inline void Consumed(double wait_us) {
+    int64_t ahead;
+    {
+      std::lock_guard<std::mutex> lock(depth_mutex_);
+      ++num_consumed_;
+      ahead = num_produced_ - num_consumed_;
+    }
+    if (depth_param_.adaptive_prefetch) this->AdaptDepth(wait_us);
+    // counters emit profiler events, only update them while profiling
+    if (profiler::Profiler::Get()->GetState() == profiler::Profiler::kRunning) {
+      *depth_counter_ = target_depth_.load();
+      *queue_counter_ = std::max<int64_t>(ahead, 0);
+      *wait_counter_ += static_cast<int64_t>(wait_us);
+      *produce_counter_ = static_cast<uint64_t>(load_us_.mean.load());
+    }
+  }
+  // grow the depth when the consumer waited, shrink it after a window without waiting,
+  // but keep enough batches ahead to cover slow loads at the measured consuming rate
+  inline void AdaptDepth(double wait_us) {
+    const int kShrinkWindow = 64;
+    if (max_depth_ == kMaxPrefetchBuffer && depth_param_.prefetch_memory != 0) {
+      size_t bytes = 0;
+      for (const NDArray& arr : out_->data) {
+        bytes += arr.shape().Size() * mshadow::mshadow_sizeof(arr.dtype());
+      }
+      const size_t budget = depth_param_.prefetch_memory << 20UL;
+      max_depth_ = std::max<int64_t>(1, std::min<int64_t>(kMaxPrefetchBuffer,
+                                                          budget / std::max<size_t>(bytes, 1)));
+      target_depth_ = std::min(target_depth_.load(), max_depth_);
+    }
+    const double consume_us = consume_us_.mean.load();
+    int64_t min_depth = 1;
+    if (consume_us > 0) {
+      const double slow_load_us = load_us_.mean.load() + 2 * load_us_.dev.load();
+      min_depth = std::min<int64_t>(max_depth_, std::ceil(slow_load_us / consume_us));
+      min_depth = std::max<int64_t>(min_depth, 1);
+    }
+    int64_t depth = target_depth_.load();
+    if (wait_us > 50 && wait_us > 0.05 * consume_us) {
+      depth = std::min(depth + 1, max_depth_);
+      calm_batches_ = 0;
+    } else if (++calm_batches_ >= kShrinkWindow) {
+      depth = std::max(depth - 1, min_depth);
+      calm_batches_ = 0;
+    }
+    if (depth != target_depth_.load()) {
+      {
+        std::lock_guard<std::mutex> lock(depth_mutex_);
+        target_depth_ = depth;
+      }
+      depth_cond_.notify_all();
+    }
+  }
+
   /*! \brief prefetcher parameters */
   PrefetcherParam param_;
+  /*! \brief adaptive depth parameters */
+  PrefetchDepthParam depth_param_;
   /*! \brief backend thread */
   dmlc::ThreadedIter<DataBatch> iter;
   /*! \brief internal batch loader */
@@ -148,6 +307,25 @@ class PrefetcherIter : public IIterator<DataBatch> {
   DataBatch *out_;
   /*! \brief queue to be recycled */
   std::queue<DataBatch*> recycle_queue_;
+  /*! \brief batches loaded and taken since the last reset, guarded by depth_mutex_ */
+  int64_t num_produced_{0}, num_consumed_{0};
+  /*! \brief whether a waiting producer should go on regardless of the depth */
+  bool interrupt_{false};
+  std::mutex depth_mutex_;
+  std::condition_variable depth_cond_;
+  /*! \brief number of batches the producer may load ahead, and its upper bound */
+  std::atomic<int64_t> target_depth_{1};
+  int64_t max_depth_{kMaxPrefetchBuffer};
+  /*! \brief number of batches taken since the depth last changed */
+  int calm_batches_{0};
+  /*! \brief number of batches allocated by the producer */
+  std::atomic<int64_t> num_allocated_{0};
+  /*! \brief time to load a batch, and time the consumer spends between two batches */
+  RunningTime load_us_, consume_us_;
+  Clock::time_point load_start_, consume_start_;
+  /*! \brief profiler counters */
+  std::unique_ptr<profiler::ProfileCounter> depth_counter_, queue_counter_;
+  std::unique_ptr<profiler::ProfileCounter> wait_counter_, produce_counter_;
 };
 }  // namespace io
 }  // namespace mxnet
@@ -0,0 +1,165 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ *  Copyright (c) 2018 by Contributors
+ * \file iter_shm_ring.cc
+ * \brief define an iterator reading batches pushed by other processes
+ *  through a shared memory ring
+ */
+#include <mxnet/io.h>
+#include <mxnet/ndarray.h>
+#include <dmlc/base.h>
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "./shm_ring.h"
+
+namespace mxnet {
+namespace io {
+// shared memory ring parameters
+struct ShmRingIterParam : public dmlc::Parameter<ShmRingIterParam> {
+  /*! \brief name of the shared memory segment */
+  std::string name;
+  /*! \brief number of slots */
+  int num_slots;
+  /*! \brief capacity of a slot in bytes */
+  uint64_t slot_size;
+  /*! \brief number of processes pushing batches */
+  int num_producers;
+  // declare parameters
+  DMLC_DECLARE_PARAMETER(ShmRingIterParam) {
+    DMLC_DECLARE_FIELD(name)
+        .describe("Name of the shared memory segment the producers open.");
+    DMLC_DECLARE_FIELD(num_slots).set_lower_bound(2).set_default(8)
+        .describe("Number of batches that can be in flight between the producers "
+                  "and the iterator.");
+    DMLC_DECLARE_FIELD(slot_size)
+        .describe("Capacity in bytes of one slot, which must hold all the arrays of a batch.");
+    DMLC_DECLARE_FIELD(num_producers).set_lower_bound(1).set_default(1)
+        .describe("Number of producer processes. An epoch ends once every producer "
+                  "pushed its end of epoch marker.");
+  }
+};
+
+/*!
+ * \brief iterator over the batches pushed to a shared memory ring.
+ *  The arrays of a batch are views of its slot, which is given back to the
+ *  producers on the next call to Next.
+ */
+class ShmRingIter : public IIterator<DataBatch> {
+ public:
+  virtual ~ShmRingIter() {
+    this->ReleaseSlot();
+  }
+
+  virtual void Init(const std::vector<std::pair<std::string, std::string> >& kwargs) {
+    param_.InitAllowUnknown(kwargs);
+    ring_.reset(new ShmRing(param_.name, param_.num_slots, param_.slot_size));
+  }
+
+  virtual void BeforeFirst() {
+    this->ReleaseSlot();
+    // skip the rest of an epoch that was not read to the end
+    if (started_) {
+      while (this->NextSlot()) this->ReleaseSlot();
+    }
+    started_ = false;
+    num_ended_ = 0;
+  }
+
+  virtual bool Next() {
+    this->ReleaseSlot();
+    if (!this->NextSlot()) return false;
+    started_ = true;
+    const shm_ring::BatchDesc& desc = *slot_.desc;
+    out_.data.resize(desc.num_arrays);
+    for (uint32_t i = 0; i < desc.num_arrays; ++i) {
+      const shm_ring::ArrayDesc& array = desc.arrays[i];
+      TShape shape(array.shape, array.shape + array.ndim);
+      out_.data[i] = NDArray(TBlob(slot_.payload + array.offset, shape,
+                                   cpu::kDevMask, array.type_flag, 0), 0);
+    }
+    out_.num_batch_padd = desc.num_batch_padd;
+    return true;
+  }
+
+  virtual const DataBatch &Value(void) const {
+    return out_;
+  }
+
+ private:
+  // read slots until one holds a batch, counting the end of epoch markers
+  inline bool NextSlot() {
+    while (num_ended_ < param_.num_producers) {
+      CHECK(ring_->AcquireRead(&slot_)) << "Shared memory ring " << param_.name << " closed";
+      has_slot_ = true;
+      if (!slot_.desc->end_of_epoch) return true;
+      ++num_ended_;
+      this->ReleaseSlot();
+    }
+    return false;
+  }
+
+  // give the current slot back, once pending reads of the batch are done
+  inline void ReleaseSlot() {
+    if (!has_slot_) return;
+    for (NDArray& arr : out_.data) arr.WaitToWrite();
+    out_.data.clear();
+    ring_->ReleaseRead(slot_);
+    has_slot_ = false;
+  }
+
+  ShmRingIterParam param_;
+  std::unique_ptr<ShmRing> ring_;
+  /*! \brief slot holding the current batch */
+  ShmRing::Slot slot_;
+  bool has_slot_{false};
+  /*! \brief whether a batch of the current epoch was read */
+  bool started_{false};
+  /*! \brief number of producers that ended the current epoch */
+  int num_ended_{0};
+  DataBatch out_;
+};
+
+DMLC_REGISTER_PARAMETER(ShmRingIterParam);
+
+MXNET_REGISTER_IO_ITER(ShmRingIter)
+.describe(R"code(Returns an iterator over batches pushed by other processes.
+
+The iterator creates a named shared memory segment holding `num_slots` slots of
+`slot_size` bytes. Producer processes open the segment by `name` with ``MXShmRingOpen``,
+push batches with ``MXShmRingPush`` and mark the end of each epoch with
+``MXShmRingPushEndOfEpoch``. The slots are mapped once and recycled, so passing a
+batch costs one copy into the slot and no system call.
+
+The first array of a batch is returned as data and the second as label. The arrays
+are views of the slot, which is reused after the next call to ``next()``.
+Calling ``reset()`` in the middle of an epoch skips its remaining batches.
+)code" ADD_FILELINE)
+.add_arguments(ShmRingIterParam::__FIELDS__())
+.set_body([]() {
+    return new ShmRingIter();
+  });
+
+}  // namespace io
+}  // namespace mxnet
@@ -57,6 +57,8 @@ class SparsePrefetcherIter : public PrefetcherIter {
     // use the kwarg to init batch loader
     sparse_loader_->Init(kwargs);
     iter.Init([this](DataBatch **dptr) {
+        const bool allocate = *dptr == nullptr;
+        this->BeginLoad();
         if (!sparse_loader_->Next()) return false;
         const TBlobBatch& batch = sparse_loader_->Value();
         if (*dptr == nullptr) {
@@ -114,9 +116,10 @@ class SparsePrefetcherIter : public PrefetcherIter {
                     batch.inst_index + batch.batch_size,
                     (*dptr)->index.begin());
         }
+        this->EndLoad(allocate);
        return true;
       },
-      [this]() { sparse_loader_->BeforeFirst(); });
+      [this]() { sparse_loader_->BeforeFirst(); this->ResetDepth(); });
   }
 
   virtual void BeforeFirst(void) {
@@ -0,0 +1,273 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ *  Copyright (c) 2018 by Contributors
+ * \file iter_text_block.h
+ * \brief block-parallel parsing of CSV and LibSVM text into row blocks
+ */
+#ifndef MXNET_IO_ITER_TEXT_BLOCK_H_
+#define MXNET_IO_ITER_TEXT_BLOCK_H_
+
+#include <dmlc/base.h>
+#include <dmlc/io.h>
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <mxnet/base.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace mxnet {
+namespace io {
+// Define block-parallel text parser parameters
+struct TextBlockParam : public dmlc::Parameter<TextBlockParam> {
+  /*! \brief number of threads parsing a chunk, 0 means row-by-row parsing */
+  int parse_threads;
+  /*! \brief size of a chunk in MB */
+  int parse_chunk_size;
+  // declare parameters
+  DMLC_DECLARE_PARAMETER(TextBlockParam) {
+    DMLC_DECLARE_FIELD(parse_threads).set_lower_bound(0).set_default(0)
+        .describe("The number of threads parsing each chunk of the input file. "
+                  "If positive, rows are parsed block by block in parallel and written "
+                  "directly into the batch, otherwise the file is parsed row by row.");
+    DMLC_DECLARE_FIELD(parse_chunk_size).set_lower_bound(1).set_default(32)
+        .describe("The size in MB of a chunk read from the input file. "
+                  "Only valid if parse_threads is positive.");
+  }
+};
+
+/*! \brief rows parsed from one range of a chunk */
+template<typename DType>
+struct TextRowBlock {
+  /*! \brief start of each row in value and index, with one extra end entry */
+  std::vector<size_t> offset;
+  /*! \brief label of each row, LibSVM only */
+  std::vector<real_t> label;
+  /*! \brief values of all rows */
+  std::vector<DType> value;
+  /*! \brief column indices of all values, LibSVM only */
+  std::vector<int64_t> index;
+  /*! \brief number of rows */
+  inline size_t Size() const {
+    return offset.size() - 1;
+  }
+  /*! \brief number of values in row i */
+  inline size_t Length(size_t i) const {
+    return offset[i + 1] - offset[i];
+  }
+  inline void Clear() {
+    offset.assign(1, 0);
+    label.clear();
+    value.clear();
+    index.clear();
+  }
+};
+
+/*!
+ * \brief reads a text file chunk by chunk and parses every chunk on several
+ *  threads, each thread taking a line-aligned range of the chunk.
+ *  The rows are handed out in file order.
+ */
+template<typename DType>
+class TextBlockReader {
+ public:
+  /*! \brief supported text formats */
+  enum Format {kCSV, kLibSVM};
+
+  TextBlockReader(const std::string& uri, unsigned part_index, unsigned num_parts,
+                  Format format, const TextBlockParam& param)
+      : format_(format), nthread_(std::max(param.parse_threads, 1)) {
+    source_.reset(dmlc::InputSplit::Create(uri.c_str(), part_index, num_parts, "text"));
+    source_->HintChunkSize(static_cast<size_t>(param.parse_chunk_size) << 20UL);
+    blocks_.resize(nthread_);
+  }
+
+  inline void BeforeFirst() {
+    source_->BeforeFirst();
+    for (auto& blk : blocks_) blk.Clear();
+    block_ = row_ = 0;
+  }
+
+  /*!
+   * \brief take up to n rows, calling run(block, begin, end, dst) for each
+   *  run of rows that is contiguous in one block, where dst is the position
+   *  of the first row of the run among the taken rows
+   * \return the number of rows taken, less than n at the end of the file
+   */
+  template<typename FRun>
+  inline size_t Take(size_t n, FRun run) {
+    size_t taken = 0;
+    while (taken < n && this->Ensure()) {
+      const TextRowBlock<DType>& blk = blocks_[block_];
+      const size_t m = std::min(n - taken, blk.Size() - row_);
+      run(blk, row_, row_ + m, taken);
+      row_ += m;
+      taken += m;
+    }
+    return taken;
+  }
+
+ private:
+  // make sure the cursor points at a row, loading the next chunk if needed
+  inline bool Ensure() {
+    while (true) {
+      while (block_ < blocks_.size() && row_ >= blocks_[block_].Size()) {
+        ++block_;
+        row_ = 0;
+      }
+      if (block_ < blocks_.size()) return true;
+      if (!this->LoadChunk()) return false;
+    }
+  }
+
+  // read the next chunk and parse its ranges in parallel
+  inline bool LoadChunk() {
+    dmlc::InputSplit::Blob chunk;
+    if (!source_->NextChunk(&chunk)) return false;
+    const char* begin = static_cast<const char*>(chunk.dptr);
+    const char* end = begin + chunk.size;
+    std::vector<const char*> bounds(nthread_ + 1);
+    bounds[0] = begin;
+    bounds[nthread_] = end;
+    for (int t = 1; t < nthread_; ++t) {
+      const char* p = std::max(begin + chunk.size * t / nthread_, bounds[t - 1]);
+      while (p != end && *p != '\n' && *p != '\r') ++p;
+      bounds[t] = p;
+    }
+    // parse errors are rethrown outside of the parallel region
+    std::exception_ptr error = nullptr;
+    #pragma omp parallel for num_threads(nthread_)
+    for (int t = 0; t < nthread_; ++t) {
+      try {
+        blocks_[t].Clear();
+        this->ParseRange(bounds[t], bounds[t + 1], &blocks_[t]);
+      } catch (...) {
+        #pragma omp critical
+        {
+          if (error == nullptr) error = std::current_exception();
+        }
+      }
+    }
+    if (error != nullptr) std::rethrow_exception(error);
+    block_ = row_ = 0;
+    return true;
+  }
+
+  inline void ParseRange(const char* begin, const char* end, TextRowBlock<DType>* out) const {
+    const char* p = begin;
+    while (p != end) {
+      while (p != end && (*p == '\n' || *p == '\r')) ++p;
+      if (p == end) break;
+      const char* lend = p;
+      while (lend != end && *lend != '\n' && *lend != '\r') ++lend;
+      if (format_ == kCSV) {
+        ParseCSVLine(p, lend, out);
+      } else {
+        ParseLibSVMLine(p, lend, out);
+      }
+      out->offset.push_back(out->value.size());
+      p = lend;
+    }
+  }
+
+  // comma separated values
+  static inline void ParseCSVLine(const char* begin, const char* end, TextRowBlock<DType>* out) {
+    const char* p = begin;
+    while (p != end) {
+      const char* q = p;
+      while (q != end && *q != ',') ++q;
+      out->value.push_back(ParseNumber<DType>(p, q));
+      p = (q == end) ? end : q + 1;
+    }
+  }
+
+  // label[:weight] followed by index[:value] tokens, values default to 1
+  static inline void ParseLibSVMLine(const char* begin, const char* end,
+                                     TextRowBlock<DType>* out) {
+    const char* p = begin;
+    bool head = true;
+    while (true) {
+      while (p != end && IsBlank(*p)) ++p;
+      if (p == end) break;
+      const char* q = p;
+      while (q != end && !IsBlank(*q)) ++q;
+      const char* colon = std::find(p, q, ':');
+      if (head) {
+        out->label.push_back(ParseNumber<real_t>(p, colon));
+        head = false;
+      } else if (!(q - p > 4 && std::strncmp(p, "qid:", 4) == 0)) {
+        out->index.push_back(ParseNumber<int64_t>(p, colon));
+        out->value.push_back(colon == q ? DType(1) : ParseNumber<DType>(colon + 1, q));
+      }
+      p = q;
+    }
+    if (head) out->label.push_back(0.0f);
+  }
+
+  static inline bool IsBlank(char c) {
+    return c == ' ' || c == '\t';
+  }
+
+  // the chunk is not null terminated, so copy the token before converting it.
+  // Blanks around the number are allowed, anything else is an error.
+  template<typename VType>
+  static inline VType ParseNumber(const char* begin, const char* end) {
+    char buf[128];
+    const size_t len = static_cast<size_t>(end - begin);
+    if (len >= sizeof(buf)) {
+      LOG(FATAL) << "Number too long in text input: \"" << std::string(begin, end) << "\"";
+    }
+    std::memcpy(buf, begin, len);
+    buf[len] = '\0';
+    char* endptr = buf;
+    VType ret;
+    if (std::is_integral<VType>::value) {
+      ret = static_cast<VType>(std::strtoll(buf, &endptr, 10));
+    } else {
+      ret = static_cast<VType>(std::strtod(buf, &endptr));
+    }
+    const char* p = endptr;
+    while (IsBlank(*p)) ++p;
+    if (endptr == buf || *p != '\0') {
+      LOG(FATAL) << "Invalid number in text input: \"" << std::string(begin, end) << "\"";
+    }
+    return ret;
+  }
+
+  /*! \brief format of the file */
+  Format format_;
+  /*! \brief number of parsing threads */
+  int nthread_;
+  /*! \brief input source */
+  std::unique_ptr<dmlc::InputSplit> source_;
+  /*! \brief rows of the current chunk, one block per thread */
+  std::vector<TextRowBlock<DType> > blocks_;
+  /*! \brief cursor into the current chunk */
+  size_t block_{0}, row_{0};
+};
+}  // namespace io
+}  // namespace mxnet
+#endif  // MXNET_IO_ITER_TEXT_BLOCK_H_
@@ -0,0 +1,184 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ *  Copyright (c) 2018 by Contributors
+ * \file mmap_recordio.h
+ * \brief read records of a RecordIO file in place through a memory mapping
+ */
+#ifndef MXNET_IO_MMAP_RECORDIO_H_
+#define MXNET_IO_MMAP_RECORDIO_H_
+
+#include <dmlc/io.h>
+#include <dmlc/logging.h>
+#include <dmlc/recordio.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mxnet {
+namespace io {
+/*!
+ * \brief read the record offsets of a RecordIO file from its index file
+ *  written by tools/im2rec.py
+ * \param path_idx path of the .idx file
+ * \param file_size size of the .rec file, to validate the offsets
+ * \return offsets in file order
+ */
+inline std::vector<size_t> LoadRecordOffsets(const std::string& path_idx, size_t file_size) {
+  std::unique_ptr<dmlc::Stream> fi(dmlc::Stream::Create(path_idx.c_str(), "r"));
+  dmlc::istream is(fi.get());
+  std::vector<size_t> offsets;
+  size_t key, offset;
+  while (is >> key >> offset) {
+    CHECK_LT(offset, file_size) << "Invalid offset " << offset << " of record " << key
+                                << " in " << path_idx;
+    offsets.push_back(offset);
+  }
+  // keep records in file order
+  std::sort(offsets.begin(), offsets.end());
+  return offsets;
+}
+
+// check the RecordIO header at data and return the content that follows it
+inline const char* ReadRecordHeader(const char* data, size_t size,
+                                    uint32_t* cflag, uint32_t* clen) {
+  using dmlc::RecordIOWriter;
+  CHECK_LE(2 * sizeof(uint32_t), size) << "Truncated RecordIO file";
+  uint32_t header[2];
+  std::memcpy(header, data, sizeof(header));
+  CHECK(header[0] == RecordIOWriter::kMagic) << "Invalid RecordIO magic";
+  *cflag = RecordIOWriter::DecodeFlag(header[1]);
+  *clen = RecordIOWriter::DecodeLength(header[1]);
+  CHECK_LE(sizeof(header) + *clen, size) << "Truncated RecordIO file";
+  return data + sizeof(header);
+}
+
+/*!
+ * \brief decode the record that starts at data
+ * \param data start of the record in memory
+ * \param size number of valid bytes from data on
+ * \param out set to the content of the record
+ * \param buf storage for records split by the writer, left untouched otherwise
+ */
+inline void DecodeRecord(const char* data, size_t size,
+                         dmlc::InputSplit::Blob* out, std::string* buf) {
+  uint32_t cflag, clen;
+  const char* content = ReadRecordHeader(data, size, &cflag, &clen);
+  if (cflag == 0) {
+    out->dptr = const_cast<char*>(content);
+    out->size = clen;
+    return;
+  }
+  CHECK_EQ(cflag, 1U) << "Invalid RecordIO part";
+  // parts are separated by the magic number the writer cut them at
+  const uint32_t magic = dmlc::RecordIOWriter::kMagic;
+  buf->assign(content, clen);
+  size_t pos = 0;
+  while (cflag != 3U) {
+    pos += 2 * sizeof(uint32_t) + ((clen + 3U) & ~3U);
+    CHECK_LE(pos, size) << "Truncated RecordIO file";
+    content = ReadRecordHeader(data + pos, size - pos, &cflag, &clen);
+    CHECK(cflag == 2U || cflag == 3U) << "Invalid RecordIO part";
+    buf->append(reinterpret_cast<const char*>(&magic), sizeof(magic));
+    buf->append(content, clen);
+  }
+  out->dptr = &(*buf)[0];
+  out->size = buf->size();
+}
+
+/*!
+ * \brief Read-only memory mapping of a local RecordIO file.
+ *  Record offsets are taken from the index file written by tools/im2rec.py,
+ *  so records can be accessed in any order without scanning the file.
+ *  Records are returned as views into the mapping, except for the rare
+ *  records that were split by the writer, which are assembled in a buffer.
+ */
+class MMapRecordIO {
+ public:
+  /*!
+   * \brief map a RecordIO file
+   * \param path_rec path of the .rec file
+   * \param path_idx path of its .idx file
+   */
+  MMapRecordIO(const std::string& path_rec, const std::string& path_idx) {
+#ifndef _WIN32
+    fd_ = open(path_rec.c_str(), O_RDONLY);
+    CHECK_NE(fd_, -1) << "Failed to open " << path_rec << ": " << strerror(errno);
+    struct stat st;
+    CHECK_EQ(fstat(fd_, &st), 0) << "Failed to stat " << path_rec << ": " << strerror(errno);
+    size_ = st.st_size;
+    if (size_ != 0) {
+      void* addr = mmap(NULL, size_, PROT_READ, MAP_SHARED, fd_, 0);
+      CHECK_NE(addr, MAP_FAILED) << "Failed to map " << path_rec << ": " << strerror(errno);
+      addr_ = static_cast<char*>(addr);
+    }
+#else
+    LOG(FATAL) << "Memory mapped RecordIO is not supported on Windows";
+#endif
+    offsets_ = LoadRecordOffsets(path_idx, size_);
+  }
+  ~MMapRecordIO() {
+#ifndef _WIN32
+    if (addr_ != nullptr) munmap(addr_, size_);
+    if (fd_ != -1) close(fd_);
+#endif
+  }
+  /*! \brief number of records */
+  size_t Size() const {
+    return offsets_.size();
+  }
+  /*! \brief whether ptr points into the mapping */
+  bool Contains(const void* ptr) const {
+    const char* p = static_cast<const char*>(ptr);
+    return p >= addr_ && p < addr_ + size_;
+  }
+  /*!
+   * \brief get the i-th record in file order
+   * \param i index of the record
+   * \param out set to the content of the record
+   * \param buf storage for records split by the writer, left untouched otherwise
+   */
+  void GetRecord(size_t i, dmlc::InputSplit::Blob* out, std::string* buf) const {
+    const size_t offset = offsets_.at(i);
+    DecodeRecord(addr_ + offset, size_ - offset, out, buf);
+  }
+
+ private:
+  /*! \brief file descriptor of the mapped file */
+  int fd_{-1};
+  /*! \brief start and size of the mapping */
+  char* addr_{nullptr};
+  size_t size_{0};
+  /*! \brief offsets of the records, in file order */
+  std::vector<size_t> offsets_;
+};
+
+}  // namespace io
+}  // namespace mxnet
+#endif  // MXNET_IO_MMAP_RECORDIO_H_
@@ -0,0 +1,180 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ *  Copyright (c) 2018 by Contributors
+ * \file pread_recordio.h
+ * \brief read sets of records of a RecordIO file with sorted, coalesced positioned reads
+ */
+#ifndef MXNET_IO_PREAD_RECORDIO_H_
+#define MXNET_IO_PREAD_RECORDIO_H_
+
+#include <dmlc/io.h>
+#include <dmlc/logging.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <numeric>
+#include <string>
+#include <vector>
+#include "./mmap_recordio.h"
+
+namespace mxnet {
+namespace io {
+/*!
+ * \brief Random access reader of a local RecordIO file.
+ *  Record offsets are taken from the index file, so any set of records can
+ *  be read without scanning the file. A set is read in file order, with
+ *  records that are close to each other merged into one pread, so that a
+ *  shuffled epoch costs few more reads than a sequential one when records
+ *  are small.
+ */
+class PReadRecordIO {
+ public:
+  /*! \brief records closer than this are read together, the gap is read and dropped */
+  static const size_t kMaxGap = 64 << 10;
+  /*! \brief upper bound of the size of a merged read */
+  static const size_t kMaxRead = 16 << 20;
+  /*!
+   * \brief open a RecordIO file
+   * \param path_rec path of the .rec file
+   * \param path_idx path of its .idx file
+   */
+  PReadRecordIO(const std::string& path_rec, const std::string& path_idx) {
+#ifndef _WIN32
+    fd_ = open(path_rec.c_str(), O_RDONLY);
+    CHECK_NE(fd_, -1) << "Failed to open " << path_rec << ": " << strerror(errno);
+    struct stat st;
+    CHECK_EQ(fstat(fd_, &st), 0) << "Failed to stat " << path_rec << ": " << strerror(errno);
+    size_ = st.st_size;
+#else
+    LOG(FATAL) << "Positioned reads of RecordIO files are not supported on Windows";
+#endif
+    offsets_ = LoadRecordOffsets(path_idx, size_);
+  }
+  ~PReadRecordIO() {
+#ifndef _WIN32
+    if (fd_ != -1) close(fd_);
+#endif
+  }
+  /*! \brief number of records */
+  size_t Size() const {
+    return offsets_.size();
+  }
+  /*!
+   * \brief read a set of records
+   * \param ids indices of the records, in any order such as a shuffled permutation;
+   *  the reads are planned over the records sorted by offset
+   * \param n number of records
+   * \param out set to the contents of the records, in the order of ids. They stay
+   *  valid until the next call.
+   */
+  void ReadRecords(const size_t* ids, size_t n, std::vector<dmlc::InputSplit::Blob>* out) {
+    // plan the reads over the records sorted by offset
+    sorted_.resize(n);
+    std::iota(sorted_.begin(), sorted_.end(), 0);
+    std::sort(sorted_.begin(), sorted_.end(), [this, ids](size_t a, size_t b) {
+        return offsets_.at(ids[a]) < offsets_.at(ids[b]);
+      });
+    reads_.clear();
+    start_.resize(n);
+    size_t buf_size = 0;
+    for (size_t k : sorted_) {
+      const size_t begin = offsets_[ids[k]];
+      const size_t end = this->RecordEnd(ids[k]);
+      if (reads_.empty() || begin > reads_.back().end + kMaxGap ||
+          end - reads_.back().begin > kMaxRead) {
+        if (!reads_.empty()) buf_size += reads_.back().end - reads_.back().begin;
+        reads_.push_back({begin, end, buf_size});
+      } else {
+        reads_.back().end = std::max(reads_.back().end, end);
+      }
+      start_[k] = reads_.back().buf_begin + (begin - reads_.back().begin);
+    }
+    if (!reads_.empty()) buf_size += reads_.back().end - reads_.back().begin;
+    buf_.resize(buf_size);
+    for (const Read& r : reads_) {
+      this->PRead(&buf_[r.buf_begin], r.end - r.begin, r.begin);
+    }
+    // decode, assembling the records split by the writer
+    out->resize(n);
+    split_records_.clear();
+    std::string split;
+    for (size_t k = 0; k < n; ++k) {
+      const size_t size = this->RecordEnd(ids[k]) - offsets_[ids[k]];
+      DecodeRecord(&buf_[start_[k]], size, &(*out)[k], &split);
+      if (!split.empty()) {
+        split_records_.push_back(std::move(split));
+        split.clear();
+        (*out)[k].dptr = &split_records_.back()[0];
+      }
+    }
+  }
+  /*! \brief number of preads issued by the last ReadRecords */
+  size_t NumReads() const {
+    return reads_.size();
+  }
+
+ private:
+  struct Read {
+    size_t begin, end;
+    size_t buf_begin;
+  };
+  // a record ends where the next one starts
+  size_t RecordEnd(size_t i) const {
+    return i + 1 < offsets_.size() ? offsets_[i + 1] : size_;
+  }
+  void PRead(char* dst, size_t size, size_t offset) const {
+#ifndef _WIN32
+    while (size != 0) {
+      const ssize_t ret = pread(fd_, dst, size, offset);
+      if (ret == -1 && errno == EINTR) continue;
+      CHECK_GT(ret, 0) << "Failed to read RecordIO file at offset " << offset << ": "
+                       << (ret == 0 ? "unexpected end of file" : strerror(errno));
+      dst += ret;
+      size -= ret;
+      offset += ret;
+    }
+#endif
+  }
+
+  /*! \brief file descriptor */
+  int fd_{-1};
+  size_t size_{0};
+  /*! \brief offsets of the records, in file order */
+  std::vector<size_t> offsets_;
+  /*! \brief positions of the last read records sorted by offset, and their starts in buf_ */
+  std::vector<size_t> sorted_, start_;
+  /*! \brief merged reads of the last call */
+  std::vector<Read> reads_;
+  /*! \brief data of the merged reads */
+  std::vector<char> buf_;
+  /*! \brief records of the last call that were split by the writer */
+  std::deque<std::string> split_records_;
+};
+
+}  // namespace io
+}  // namespace mxnet
+#endif  // MXNET_IO_PREAD_RECORDIO_H_
@@ -0,0 +1,471 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ *  Copyright (c) 2018 by Contributors
+ * \file row_cache.h
+ * \brief binary cache of parsed rows, written on the first pass over a text
+ *  file and memory mapped on the following passes
+ */
+#ifndef MXNET_IO_ROW_CACHE_H_
+#define MXNET_IO_ROW_CACHE_H_
+
+#include <dmlc/logging.h>
+#include <dmlc/parameter.h>
+#include <mxnet/base.h>
+#include <mshadow/base.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace mxnet {
+namespace io {
+// Define row cache parameters
+struct RowCacheParam : public dmlc::Parameter<RowCacheParam> {
+  /*! \brief path of the binary cache */
+  std::string cache_file;
+  // declare parameters
+  DMLC_DECLARE_PARAMETER(RowCacheParam) {
+    DMLC_DECLARE_FIELD(cache_file).set_default("")
+        .describe("Path of a local binary cache of the parsed rows. The cache is written "
+                  "during the first complete pass over the data, and later passes read "
+                  "the rows from its memory mapping instead of parsing the text again. "
+                  "An existing cache is reused if it was built with the same arguments "
+                  "and local input files of the same size and modification time. "
+                  "Remove the cache when remote input files change.");
+  }
+};
+
+/*! \brief description of one array stored per row */
+struct RowCacheArray {
+  /*! \brief mshadow type flag of the elements */
+  int32_t type_flag;
+  /*! \brief number of elements in each row, or -1 if it varies */
+  int32_t row_len;
+};
+
+/*!
+ * \brief Layout of a cache file, all fields are 8 byte aligned.
+ *  header: magic, version, number of arrays, number of rows, number of chunks,
+ *          signature length and signature, RowCacheArray of each array
+ *  chunk:  number of rows, number of elements of each array, then for each
+ *          array the row offsets if its row length varies and its elements
+ */
+namespace row_cache {
+const uint64_t kMagic = 0x4548434157524d58UL;  // "XMRWACHE"
+const uint32_t kVersion = 1;
+// number of rows buffered before a chunk is written
+const size_t kChunkRows = 1UL << 16;
+inline size_t Align8(size_t size) {
+  return (size + 7UL) & ~7UL;
+}
+/*!
+ * \brief size and modification time of each file of a ';' separated list of
+ *  input URIs, to be added to a cache signature. Files which are not local
+ *  are only identified by the URI in the signature. For a directory, its own
+ *  modification time changes when files are added or removed, not when they
+ *  are rewritten in place.
+ */
+inline std::string InputStamp(const std::string& uris) {
+  std::ostringstream os;
+  std::istringstream is(uris);
+  std::string uri;
+  while (std::getline(is, uri, ';')) {
+    // drop the dmlc URI arguments and cache suffix
+    uri = uri.substr(0, uri.find_first_of("?#"));
+    if (uri.empty()) continue;
+    if (uri.compare(0, 7, "file://") == 0) uri = uri.substr(7);
+#ifndef _WIN32
+    struct stat st;
+    if (uri.find("://") == std::string::npos && stat(uri.c_str(), &st) == 0) {
+      os << ' ' << st.st_size << ':' << st.st_mtime;
+      continue;
+    }
+#endif
+    os << " -";
+  }
+  return os.str();
+}
+}  // namespace row_cache
+
+/*!
+ * \brief appends rows to a temporary file next to the cache, which is moved
+ *  into place by Finish once all rows are written. The temporary file has a
+ *  unique name, so concurrent writers of the same cache do not interfere.
+ */
+class RowCacheWriter {
+ public:
+  RowCacheWriter(const std::string& path, const std::string& signature,
+                 const std::vector<RowCacheArray>& arrays)
+      : path_(path), tmp_path_(path + ".tmp"), arrays_(arrays),
+        data_(arrays.size()), offsets_(arrays.size()) {
+#ifndef _WIN32
+    tmp_path_ += ".XXXXXX";
+    const int fd = mkstemp(&tmp_path_[0]);
+    CHECK_GE(fd, 0) << "Failed to create " << tmp_path_ << ": " << strerror(errno);
+    // mkstemp creates the file readable by the owner only
+    fchmod(fd, 0644);
+    fp_ = fdopen(fd, "wb");
+#else
+    fp_ = std::fopen(tmp_path_.c_str(), "wb");
+#endif
+    CHECK(fp_ != nullptr) << "Failed to open " << tmp_path_ << ": " << strerror(errno);
+    const uint64_t sig_len = signature.size();
+    WriteHeader(0, 0);
+    Write(&sig_len, sizeof(sig_len));
+    Write(signature.data(), signature.size());
+    Pad(signature.size());
+    Write(arrays_.data(), arrays_.size() * sizeof(RowCacheArray));
+    this->ClearChunk();
+  }
+  ~RowCacheWriter() {
+    if (fp_ != nullptr) {
+      std::fclose(fp_);
+      std::remove(tmp_path_.c_str());
+    }
+  }
+  /*! \brief append one row, with one blob per array */
+  inline void Append(const std::vector<TBlob>& row) {
+    CHECK_EQ(row.size(), arrays_.size());
+    for (size_t k = 0; k < row.size(); ++k) {
+      CHECK_EQ(row[k].type_flag_, arrays_[k].type_flag);
+      const size_t nbytes = row[k].Size() * mshadow::mshadow_sizeof(row[k].type_flag_);
+      if (arrays_[k].row_len < 0) {
+        offsets_[k].push_back(offsets_[k].back() + row[k].Size());
+      } else {
+        CHECK_EQ(row[k].Size(), static_cast<size_t>(arrays_[k].row_len));
+      }
+      const char* src = static_cast<const char*>(row[k].dptr_);
+      data_[k].insert(data_[k].end(), src, src + nbytes);
+    }
+    if (++chunk_rows_ == row_cache::kChunkRows) this->FlushChunk();
+  }
+  /*! \brief write the remaining rows and move the file into place */
+  inline void Finish() {
+    this->FlushChunk();
+    CHECK_EQ(std::fseek(fp_, 0, SEEK_SET), 0);
+    WriteHeader(num_rows_, num_chunks_);
+    CHECK_EQ(std::fclose(fp_), 0) << "Failed to write " << tmp_path_;
+    fp_ = nullptr;
+    CHECK_EQ(std::rename(tmp_path_.c_str(), path_.c_str()), 0)
+        << "Failed to move " << tmp_path_ << " to " << path_ << ": " << strerror(errno);
+  }
+  /*! \brief path of the temporary file */
+  inline const std::string& tmp_path() const {
+    return tmp_path_;
+  }
+
+ private:
+  inline void Write(const void* ptr, size_t size) {
+    if (size == 0) return;
+    CHECK_EQ(std::fwrite(ptr, 1, size, fp_), size) << "Failed to write " << tmp_path_;
+  }
+  inline void Pad(size_t size) {
+    const char zeros[8] = {0};
+    Write(zeros, row_cache::Align8(size) - size);
+  }
+  inline void WriteHeader(uint64_t num_rows, uint64_t num_chunks) {
+    const uint64_t magic = row_cache::kMagic;
+    const uint32_t head[2] = {row_cache::kVersion, static_cast<uint32_t>(arrays_.size())};
+    Write(&magic, sizeof(magic));
+    Write(head, sizeof(head));
+    Write(&num_rows, sizeof(num_rows));
+    Write(&num_chunks, sizeof(num_chunks));
+  }
+  inline void ClearChunk() {
+    chunk_rows_ = 0;
+    for (size_t k = 0; k < arrays_.size(); ++k) {
+      data_[k].clear();
+      offsets_[k].assign(1, 0);
+    }
+  }
+  inline void FlushChunk() {
+    if (chunk_rows_ == 0) return;
+    const uint64_t nrows = chunk_rows_;
+    Write(&nrows, sizeof(nrows));
+    for (size_t k = 0; k < arrays_.size(); ++k) {
+      const uint64_t nelem = data_[k].size() / mshadow::mshadow_sizeof(arrays_[k].type_flag);
+      Write(&nelem, sizeof(nelem));
+    }
+    for (size_t k = 0; k < arrays_.size(); ++k) {
+      if (arrays_[k].row_len < 0) {
+        Write(offsets_[k].data(), offsets_[k].size() * sizeof(uint64_t));
+      }
+      Write(data_[k].data(), data_[k].size());
+      Pad(data_[k].size());
+    }
+    num_rows_ += chunk_rows_;
+    num_chunks_ += 1;
+    this->ClearChunk();
+  }
+
+  std::string path_, tmp_path_;
+  std::vector<RowCacheArray> arrays_;
+  std::FILE* fp_{nullptr};
+  /*! \brief elements and row offsets of the current chunk */
+  std::vector<std::vector<char> > data_;
+  std::vector<std::vector<uint64_t> > offsets_;
+  size_t chunk_rows_{0};
+  uint64_t num_rows_{0}, num_chunks_{0};
+};
+
+/*!
+ * \brief reads the rows of a cache file in place through a read-only memory
+ *  mapping, so a pass over the cache costs little more than a memory copy
+ */
+class RowCacheReader {
+ public:
+  ~RowCacheReader() {
+    this->Close();
+  }
+  /*!
+   * \brief map a cache file
+   * \return false if the file does not exist, is incomplete or was written
+   *  with another signature or other arrays
+   */
+  inline bool Open(const std::string& path, const std::string& signature,
+                   const std::vector<RowCacheArray>& arrays) {
+    this->Close();
+#ifndef _WIN32
+    fd_ = open(path.c_str(), O_RDONLY);
+    if (fd_ == -1) return false;
+    struct stat st;
+    CHECK_EQ(fstat(fd_, &st), 0) << "Failed to stat " << path << ": " << strerror(errno);
+    size_ = st.st_size;
+    if (size_ != 0) {
+      void* addr = mmap(NULL, size_, PROT_READ, MAP_SHARED, fd_, 0);
+      CHECK_NE(addr, MAP_FAILED) << "Failed to map " << path << ": " << strerror(errno);
+      addr_ = static_cast<char*>(addr);
+    }
+#else
+    LOG(FATAL) << "Row cache is not supported on Windows";
+#endif
+    if (!this->Parse(signature, arrays)) {
+      LOG(INFO) << "Ignoring invalid cache " << path << " or one built with other arguments";
+      this->Close();
+      return false;
+    }
+    arrays_ = arrays;
+    this->BeforeFirst();
+    return true;
+  }
+  /*! \brief total number of rows */
+  inline size_t Size() const {
+    return num_rows_;
+  }
+  inline void BeforeFirst() {
+    chunk_ = 0;
+    row_ = 0;
+    run_ = 0;
+  }
+  /*! \brief move to the next row */
+  inline bool Next() {
+    return this->NextRun(1) != 0;
+  }
+  /*!
+   * \brief move to the next run of at most max_rows consecutive rows, all in
+   *  one chunk so that fixed length arrays of the run are contiguous
+   * \return number of rows in the run, 0 at the end
+   */
+  inline size_t NextRun(size_t max_rows) {
+    row_ += run_;
+    while (chunk_ < chunks_.size() && row_ >= chunks_[chunk_].num_rows) {
+      ++chunk_;
+      row_ = 0;
+    }
+    if (chunk_ == chunks_.size()) {
+      run_ = 0;
+    } else {
+      run_ = std::min<size_t>(max_rows, chunks_[chunk_].num_rows - row_);
+    }
+    return run_;
+  }
+  /*! \brief array k of the current row, viewed in the mapping */
+  inline TBlob Value(size_t k, const TShape& shape) const {
+    const Chunk& c = chunks_[chunk_];
+    const size_t esize = mshadow::mshadow_sizeof(arrays_[k].type_flag);
+    size_t begin;
+    if (arrays_[k].row_len < 0) {
+      begin = c.offsets[k][row_];
+    } else {
+      begin = row_ * arrays_[k].row_len;
+    }
+    return TBlob(const_cast<char*>(c.data[k]) + begin * esize, shape,
+                 cpu::kDevMask, arrays_[k].type_flag, 0);
+  }
+  /*! \brief number of elements of array k in the current row */
+  inline size_t Length(size_t k) const {
+    if (arrays_[k].row_len >= 0) return arrays_[k].row_len;
+    const uint64_t* offsets = chunks_[chunk_].offsets[k];
+    return offsets[row_ + 1] - offsets[row_];
+  }
+
+ private:
+  struct Chunk {
+    uint64_t num_rows;
+    std::vector<const uint64_t*> offsets;
+    std::vector<const char*> data;
+  };
+
+  // check the header and locate the chunks
+  inline bool Parse(const std::string& signature, const std::vector<RowCacheArray>& arrays) {
+    size_t pos = 0;
+    uint64_t magic, num_chunks, sig_len;
+    uint32_t head[2];
+    if (!Read(&pos, &magic, sizeof(magic)) || magic != row_cache::kMagic) return false;
+    if (!Read(&pos, head, sizeof(head)) || head[0] != row_cache::kVersion ||
+        head[1] != arrays.size()) return false;
+    if (!Read(&pos, &num_rows_, sizeof(num_rows_)) ||
+        !Read(&pos, &num_chunks, sizeof(num_chunks)) ||
+        !Read(&pos, &sig_len, sizeof(sig_len))) return false;
+    if (sig_len != signature.size() || pos + sig_len > size_ ||
+        std::memcmp(addr_ + pos, signature.data(), sig_len) != 0) return false;
+    pos += row_cache::Align8(sig_len);
+    for (const RowCacheArray& a : arrays) {
+      RowCacheArray stored;
+      if (!Read(&pos, &stored, sizeof(stored)) || stored.type_flag != a.type_flag ||
+          stored.row_len != a.row_len) return false;
+    }
+    uint64_t total_rows = 0;
+    chunks_.resize(num_chunks);
+    for (Chunk& c : chunks_) {
+      std::vector<uint64_t> nelem(arrays.size());
+      if (!Read(&pos, &c.num_rows, sizeof(c.num_rows)) ||
+          !Read(&pos, nelem.data(), nelem.size() * sizeof(uint64_t))) return false;
+      c.offsets.assign(arrays.size(), nullptr);
+      c.data.resize(arrays.size());
+      for (size_t k = 0; k < arrays.size(); ++k) {
+        if (arrays[k].row_len < 0) {
+          c.offsets[k] = reinterpret_cast<const uint64_t*>(addr_ + pos);
+          pos += (c.num_rows + 1) * sizeof(uint64_t);
+        }
+        c.data[k] = addr_ + pos;
+        pos += row_cache::Align8(nelem[k] * mshadow::mshadow_sizeof(arrays[k].type_flag));
+        if (pos > size_) return false;
+      }
+      total_rows += c.num_rows;
+    }
+    return total_rows == num_rows_ && pos == size_;
+  }
+
+  inline bool Read(size_t* pos, void* dst, size_t size) const {
+    if (*pos + size > size_) return false;
+    std::memcpy(dst, addr_ + *pos, size);
+    *pos += size;
+    return true;
+  }
+
+  inline void Close() {
+#ifndef _WIN32
+    if (addr_ != nullptr) munmap(addr_, size_);
+    if (fd_ != -1) close(fd_);
+#endif
+    addr_ = nullptr;
+    fd_ = -1;
+    size_ = 0;
+    chunks_.clear();
+  }
+
+  /*! \brief file descriptor of the mapped file */
+  int fd_{-1};
+  /*! \brief start and size of the mapping */
+  char* addr_{nullptr};
+  size_t size_{0};
+  uint64_t num_rows_{0};
+  std::vector<RowCacheArray> arrays_;
+  std::vector<Chunk> chunks_;
+  /*! \brief cursor: first row and number of rows of the current run */
+  size_t chunk_{0}, row_{0}, run_{0};
+};
+
+/*!
+ * \brief cache of the rows of a text iterator: while the text is parsed the
+ *  rows are appended to a new cache file, and once a pass completes the
+ *  iterator switches to reading the rows from the cache
+ */
+class RowCache {
+ public:
+  /*!
+   * \brief set up the cache
+   * \return whether a complete cache with the same signature can be read
+   */
+  inline bool Init(const RowCacheParam& param, const std::string& signature,
+                   const std::vector<RowCacheArray>& arrays) {
+    path_ = param.cache_file;
+    signature_ = signature;
+    arrays_ = arrays;
+    if (path_.empty()) return false;
+    reading_ = reader_.Open(path_, signature_, arrays_);
+    if (reading_) LOG(INFO) << "Reading " << reader_.Size() << " rows from cache " << path_;
+    return reading_;
+  }
+  /*! \brief whether rows are read from the cache */
+  inline bool reading() const {
+    return reading_;
+  }
+  /*! \brief whether the rows of the current pass are written to the cache */
+  inline bool writing() const {
+    return writer_.get() != nullptr;
+  }
+  inline RowCacheReader& reader() {
+    return reader_;
+  }
+  /*! \brief start a pass over the text, dropping the rows of an incomplete pass */
+  inline void BeginPass() {
+    writer_.reset();
+    if (!path_.empty() && !reading_) {
+      writer_.reset(new RowCacheWriter(path_, signature_, arrays_));
+    }
+  }
+  /*! \brief append a row parsed from the text */
+  inline void Append(const std::vector<TBlob>& row) {
+    if (writer_.get() != nullptr) writer_->Append(row);
+  }
+  /*! \brief the pass over the text completed, read the cache from now on */
+  inline void EndPass() {
+    if (writer_.get() == nullptr) return;
+    writer_->Finish();
+    writer_.reset();
+    CHECK(reader_.Open(path_, signature_, arrays_)) << "Failed to read back cache " << path_;
+    reading_ = true;
+    LOG(INFO) << "Wrote " << reader_.Size() << " rows to cache " << path_;
+  }
+
+ private:
+  std::string path_, signature_;
+  std::vector<RowCacheArray> arrays_;
+  bool reading_{false};
+  RowCacheReader reader_;
+  std::unique_ptr<RowCacheWriter> writer_;
+};
+
+}  // namespace io
+}  // namespace mxnet
+#endif  // MXNET_IO_ROW_CACHE_H_
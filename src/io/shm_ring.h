@@ -0,0 +1,327 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ *  Copyright (c) 2018 by Contributors
+ * \file shm_ring.h
+ * \brief a ring of pre-mapped shared memory slots passing batches between processes
+ */
+#ifndef MXNET_IO_SHM_RING_H_
+#define MXNET_IO_SHM_RING_H_
+
+#include <dmlc/logging.h>
+#include <mxnet/tensor_blob.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mxnet {
+namespace io {
+namespace shm_ring {
+const uint64_t kMagic = 0x474e495248534d58UL;  // "XMSHRING"
+/*! \brief maximum number of arrays in a batch */
+const int kMaxArrays = 8;
+/*! \brief maximum number of dimensions of an array */
+const int kMaxDim = 6;
+/*! \brief alignment of the slots and of the arrays in a slot */
+const size_t kAlign = 64;
+inline size_t Align(size_t size) {
+  return (size + kAlign - 1) & ~(kAlign - 1);
+}
+/*! \brief an array stored in a slot */
+struct ArrayDesc {
+  int32_t type_flag;
+  int32_t ndim;
+  int64_t shape[kMaxDim];
+  /*! \brief position of the first byte from the start of the slot payload */
+  uint64_t offset;
+  uint64_t nbytes;
+};
+/*! \brief the batch stored in a slot */
+struct BatchDesc {
+  uint32_t num_arrays;
+  int32_t num_batch_padd;
+  /*! \brief whether the slot marks the end of an epoch of one producer */
+  uint32_t end_of_epoch;
+  uint32_t reserved;
+  ArrayDesc arrays[kMaxArrays];
+};
+/*!
+ * \brief control block at the start of the mapping. The slots form a bounded
+ *  multi-producer multi-consumer queue: a slot with sequence number t accepts
+ *  the write of ticket t, and holds the batch of ticket t until its sequence
+ *  number is advanced by a full lap when the reader releases it.
+ */
+struct Header {
+  uint64_t magic;
+  uint64_t num_slots;
+  uint64_t slot_size;
+  /*! \brief set when the creator goes away */
+  std::atomic<uint32_t> closed;
+  alignas(kAlign) std::atomic<uint64_t> head;
+  alignas(kAlign) std::atomic<uint64_t> tail;
+};
+/*! \brief control word of a slot, on its own cache line */
+struct SlotControl {
+  alignas(kAlign) std::atomic<uint64_t> seq;
+};
+}  // namespace shm_ring
+
+/*!
+ * \brief A fixed pool of slots in one named shared memory segment.
+ *  The segment is created and mapped once, and slots are recycled between
+ *  producer and consumer processes, so moving a batch costs one copy into the
+ *  slot and no system call. Waiting for a slot spins briefly and then sleeps.
+ */
+class ShmRing {
+ public:
+  /*! \brief a slot held by a writer or a reader */
+  struct Slot {
+    uint64_t ticket{0};
+    shm_ring::BatchDesc* desc{nullptr};
+    char* payload{nullptr};
+  };
+  /*!
+   * \brief create a new ring, replacing any segment with the same name
+   * \param name name of the segment
+   * \param num_slots number of slots
+   * \param slot_size capacity in bytes of the payload of a slot
+   */
+  ShmRing(const std::string& name, size_t num_slots, size_t slot_size)
+      : name_(ShmName(name)), owner_(true) {
+    using namespace shm_ring;
+    CHECK_GT(num_slots, 0U) << "A shared memory ring needs at least one slot";
+    slot_size = Align(slot_size);
+    size_ = SlotsOffset(num_slots) + num_slots * SlotStride(slot_size);
+#ifndef _WIN32
+    shm_unlink(name_.c_str());
+    int fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0666);
+    CHECK_NE(fd, -1) << "Failed to create shared memory " << name_ << ": " << strerror(errno);
+    CHECK_EQ(ftruncate(fd, size_), 0) << "Failed to resize shared memory " << name_
+                                      << ": " << strerror(errno);
+    this->Map(fd);
+#else
+    LOG(FATAL) << "Shared memory ring is not supported on Windows";
+#endif
+    header_ = new (addr_) Header();
+    header_->num_slots = num_slots;
+    header_->slot_size = slot_size;
+    header_->closed.store(0);
+    header_->head.store(0);
+    header_->tail.store(0);
+    for (size_t i = 0; i < num_slots; ++i) {
+      new (Control(i)) SlotControl();
+      Control(i)->seq.store(i);
+    }
+    // publish the layout last, so openers never see a partial header
+    std::atomic_thread_fence(std::memory_order_release);
+    header_->magic = kMagic;
+  }
+  /*!
+   * \brief attach to an existing ring
+   * \param name name of the segment
+   */
+  explicit ShmRing(const std::string& name) : name_(ShmName(name)), owner_(false) {
+    using namespace shm_ring;
+#ifndef _WIN32
+    int fd = shm_open(name_.c_str(), O_RDWR, 0666);
+    CHECK_NE(fd, -1) << "Failed to open shared memory " << name_ << ": " << strerror(errno);
+    struct stat st;
+    CHECK_EQ(fstat(fd, &st), 0) << "Failed to stat shared memory " << name_;
+    size_ = st.st_size;
+    CHECK_GE(size_, sizeof(Header)) << "Invalid shared memory ring " << name_;
+    this->Map(fd);
+#else
+    LOG(FATAL) << "Shared memory ring is not supported on Windows";
+#endif
+    header_ = reinterpret_cast<Header*>(addr_);
+    CHECK(header_->magic == kMagic) << "Invalid shared memory ring " << name_;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    CHECK_EQ(size_, SlotsOffset(header_->num_slots) +
+             header_->num_slots * SlotStride(header_->slot_size))
+        << "Invalid shared memory ring " << name_;
+  }
+  ~ShmRing() {
+#ifndef _WIN32
+    if (owner_) {
+      header_->closed.store(1);
+      shm_unlink(name_.c_str());
+    }
+    munmap(addr_, size_);
+#endif
+  }
+  /*! \brief capacity in bytes of the payload of a slot */
+  inline size_t slot_size() const {
+    return header_->slot_size;
+  }
+  /*! \brief whether the creator of the ring went away */
+  inline bool closed() const {
+    return header_->closed.load() != 0;
+  }
+  /*! \brief wait for a free slot, returns false if the ring is closed */
+  inline bool AcquireWrite(Slot* slot) {
+    slot->ticket = header_->head.fetch_add(1);
+    shm_ring::SlotControl* ctrl = Control(slot->ticket % header_->num_slots);
+    const uint64_t ticket = slot->ticket;
+    if (!Wait([ctrl, ticket]() { return ctrl->seq.load(std::memory_order_acquire) == ticket; })) {
+      return false;
+    }
+    this->FillSlot(slot);
+    return true;
+  }
+  /*! \brief hand a written slot to the readers */
+  inline void CommitWrite(const Slot& slot) {
+    Control(slot.ticket % header_->num_slots)->seq.store(slot.ticket + 1,
+                                                         std::memory_order_release);
+  }
+  /*! \brief wait for a written slot, returns false if the ring is closed */
+  inline bool AcquireRead(Slot* slot) {
+    slot->ticket = header_->tail.fetch_add(1);
+    shm_ring::SlotControl* ctrl = Control(slot->ticket % header_->num_slots);
+    const uint64_t ready = slot->ticket + 1;
+    if (!Wait([ctrl, ready]() { return ctrl->seq.load(std::memory_order_acquire) == ready; })) {
+      return false;
+    }
+    this->FillSlot(slot);
+    return true;
+  }
+  /*! \brief give a read slot back to the writers */
+  inline void ReleaseRead(const Slot& slot) {
+    Control(slot.ticket % header_->num_slots)->seq.store(slot.ticket + header_->num_slots,
+                                                         std::memory_order_release);
+  }
+
+ /*!
+   * \brief copy a batch into a free slot
+   * \param arrays contiguous cpu arrays of the batch
+   * \param num_batch_padd number of padded instances in the batch
+   * \return false if the ring is closed
+   */
+  inline bool Push(const std::vector<TBlob>& arrays, int num_batch_padd) {
+    using namespace shm_ring;
+    CHECK_LE(arrays.size(), static_cast<size_t>(kMaxArrays))
+        << "A batch in a shared memory ring holds at most " << kMaxArrays << " arrays";
+    // check the size before taking a ticket, a ticket must always be committed
+    size_t total = 0;
+    for (const TBlob& blob : arrays) {
+      CHECK_LE(blob.ndim(), kMaxDim)
+          << "Arrays in a shared memory ring have at most " << kMaxDim << " dimensions";
+      total = Align(total + blob.Size() * mshadow::mshadow_sizeof(blob.type_flag_));
+    }
+    CHECK_LE(total, this->slot_size()) << "A batch of " << total << " bytes does not fit "
+                                       << "in a slot of " << this->slot_size() << " bytes";
+    Slot slot;
+    if (!this->AcquireWrite(&slot)) return false;
+    slot.desc->num_arrays = arrays.size();
+    slot.desc->num_batch_padd = num_batch_padd;
+    slot.desc->end_of_epoch = 0;
+    size_t offset = 0;
+    for (size_t i = 0; i < arrays.size(); ++i) {
+      const TBlob& blob = arrays[i];
+      ArrayDesc& array = slot.desc->arrays[i];
+      array.type_flag = blob.type_flag_;
+      array.ndim = blob.ndim();
+      for (int k = 0; k < array.ndim; ++k) array.shape[k] = blob.shape_[k];
+      array.offset = offset;
+      array.nbytes = blob.Size() * mshadow::mshadow_sizeof(blob.type_flag_);
+      std::memcpy(slot.payload + offset, blob.dptr_, array.nbytes);
+      offset = Align(offset + array.nbytes);
+    }
+    this->CommitWrite(slot);
+    return true;
+  }
+  /*! \brief tell the readers that this producer finished an epoch */
+  inline bool PushEndOfEpoch() {
+    Slot slot;
+    if (!this->AcquireWrite(&slot)) return false;
+    slot.desc->num_arrays = 0;
+    slot.desc->num_batch_padd = 0;
+    slot.desc->end_of_epoch = 1;
+    this->CommitWrite(slot);
+    return true;
+  }
+
+ private:
+  static inline std::string ShmName(const std::string& name) {
+    CHECK(!name.empty()) << "The shared memory ring needs a name";
+    return name[0] == '/' ? name : "/" + name;
+  }
+  static inline size_t SlotsOffset(size_t num_slots) {
+    return shm_ring::Align(sizeof(shm_ring::Header)) +
+        num_slots * sizeof(shm_ring::SlotControl);
+  }
+  static inline size_t SlotStride(size_t slot_size) {
+    return shm_ring::Align(sizeof(shm_ring::BatchDesc)) + slot_size;
+  }
+  inline shm_ring::SlotControl* Control(size_t i) const {
+    return reinterpret_cast<shm_ring::SlotControl*>(
+        addr_ + shm_ring::Align(sizeof(shm_ring::Header))) + i;
+  }
+  inline void FillSlot(Slot* slot) const {
+    char* base = addr_ + SlotsOffset(header_->num_slots) +
+        (slot->ticket % header_->num_slots) * SlotStride(header_->slot_size);
+    slot->desc = reinterpret_cast<shm_ring::BatchDesc*>(base);
+    slot->payload = base + shm_ring::Align(sizeof(shm_ring::BatchDesc));
+  }
+#ifndef _WIN32
+  inline void Map(int fd) {
+    void* addr = mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    CHECK_NE(addr, MAP_FAILED) << "Failed to map shared memory " << name_
+                               << ": " << strerror(errno);
+    close(fd);
+    addr_ = static_cast<char*>(addr);
+  }
+#endif
+  // spin, then yield, then sleep until pred holds or the ring is closed
+  template<typename FPred>
+  inline bool Wait(FPred pred) const {
+    for (int i = 0; !pred(); i = std::min(i + 1, 1024)) {
+      if (this->closed()) return false;
+      if (i < 64) continue;
+      if (i < 128) {
+        std::this_thread::yield();
+      } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(i < 1024 ? 20 : 500));
+      }
+    }
+    return true;
+  }
+
+  std::string name_;
+  bool owner_;
+  char* addr_{nullptr};
+  size_t size_{0};
+  shm_ring::Header* header_{nullptr};
+};
+
+}  // namespace io
+}  // namespace mxnet
+#endif  // MXNET_IO_SHM_RING_H_
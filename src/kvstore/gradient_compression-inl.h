@@ -25,6 +25,10 @@
 #ifndef MXNET_KVSTORE_GRADIENT_COMPRESSION_INL_H_
 #define MXNET_KVSTORE_GRADIENT_COMPRESSION_INL_H_
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <vector>
 #include "../operator/mxnet_op.h"
 
@@ -138,16 +142,206 @@ void Dequantize2BitKernelLaunch(mshadow::Stream<xpu> *s, const std::vector<mxnet
           threshold);               // positive threshold
 }
 
-inline void Quantize2BitImpl(mshadow::Stream<mshadow::cpu> *s,
+// these cpu functions are defined in gradient_compression.cc, vectorized with
+// AVX2 or AVX-512 where the cpu supports it
+void Quantize2BitImpl(mshadow::Stream<mshadow::cpu> *s, const std::vector<mxnet::TBlob> &inputs,
+                      const float threshold);
+void Dequantize2BitImpl(mshadow::Stream<mshadow::cpu> *s, const std::vector<mxnet::TBlob> &inputs,
+                        const float threshold);
+
+// number of values in a block of topk and 1bit compression
+const int kCompressBlockSize = 1024;
+// a 1bit block is its scale followed by one word of 32 signs per 32 values
+const int kOneBitBlockLen = 1 + kCompressBlockSize / 32;
+
+inline int TopKPerBlock(const float ratio) {
+  return std::max(1, static_cast<int>(std::round(kCompressBlockSize * ratio)));
+}
+
+struct quantize_topk {
+  MSHADOW_CINLINE static void Map(int block_id,
+                                  int original_size,
+                                  int k,
+                                  float *out,
+                                  float *grad,
+                                  float *residual) {
+    // a block is sent as k pairs of (index in the block, value)
+    float *compr_block = out + block_id * 2 * k;
+    const int start = block_id * kCompressBlockSize;
+    const int n = std::min(kCompressBlockSize, original_size - start);
+    float *block = residual + start;
+    int order[kCompressBlockSize];
+    for (int j = 0; j < n; ++j) {
+      block[j] += grad[start + j];
+      order[j] = j;
+    }
+    const int kept = std::min(k, n);
+    std::nth_element(order, order + kept - 1, order + n, [block](int a, int b) {
+        return std::abs(block[a]) > std::abs(block[b]);
+      });
+    for (int j = 0; j < kept; ++j) {
+      compr_block[2 * j] = static_cast<float>(order[j]);
+      compr_block[2 * j + 1] = block[order[j]];
+      // the values sent leave the residual
+      block[order[j]] = 0;
+    }
+    // padding of a short last block adds zero to its first value
+    std::fill(compr_block + 2 * kept, compr_block + 2 * k, 0.0f);
+  }
+};
+
+struct dequantize_topk {
+  MSHADOW_CINLINE static void Map(int block_id,
+                                  int original_size,
+                                  int k,
+                                  float *out,
+                                  float *in) {
+    const float *compr_block = in + block_id * 2 * k;
+    const int start = block_id * kCompressBlockSize;
+    const int n = std::min(kCompressBlockSize, original_size - start);
+    float *block = out + start;
+    std::fill(block, block + n, 0.0f);
+    for (int j = 0; j < k; ++j) {
+      block[static_cast<int>(compr_block[2 * j])] += compr_block[2 * j + 1];
+    }
+  }
+};
+
+struct quantize_1bit {
+  MSHADOW_CINLINE static void Map(int block_id,
+                                  int original_size,
+                                  float *out,
+                                  float *grad,
+                                  float *residual) {
+    float *compr_block = out + block_id * kOneBitBlockLen;
+    const int start = block_id * kCompressBlockSize;
+    const int n = std::min(kCompressBlockSize, original_size - start);
+    float *block = residual + start;
+    float sum = 0;
+    for (int j = 0; j < n; ++j) {
+      block[j] += grad[start + j];
+      sum += std::abs(block[j]);
+    }
+    // the scale keeps the mean magnitude of the block
+    const float scale = sum / n;
+    compr_block[0] = scale;
+    for (int w = 0; w < kCompressBlockSize / 32; ++w) {
+      uint32_t word = 0;
+      const int end = std::min(32 * w + 32, n);
+      for (int j = 32 * w; j < end; ++j) {
+        if (block[j] >= 0) {
+          word |= 1u << (j & 31);
+          block[j] -= scale;
+        } else {
+          block[j] += scale;
+        }
+      }
+      std::memcpy(compr_block + 1 + w, &word, sizeof(word));
+    }
+  }
+};
+
+struct dequantize_1bit {
+  MSHADOW_CINLINE static void Map(int block_id,
+                                  int original_size,
+                                  float *out,
+                                  float *in) {
+    const float *compr_block = in + block_id * kOneBitBlockLen;
+    const int start = block_id * kCompressBlockSize;
+    const int n = std::min(kCompressBlockSize, original_size - start);
+    const float scale = compr_block[0];
+    float *block = out + start;
+    for (int w = 0; w < kCompressBlockSize / 32; ++w) {
+      uint32_t word;
+      std::memcpy(&word, compr_block + 1 + w, sizeof(word));
+      const int end = std::min(32 * w + 32, n);
+      for (int j = 32 * w; j < end; ++j) {
+        block[j] = ((word >> (j & 31)) & 1) ? scale : -scale;
+      }
+    }
+  }
+};
+
+struct quantize_fp16 {
+  MSHADOW_CINLINE static void Map(int i,
+                                  int original_size,
+                                  float *out,
+                                  float *grad) {
+    // element i of the compressed array holds values 2i and 2i+1
+    using mshadow::half::half_t;
+    const half_t pair[2] = {half_t(grad[2 * i]),
+                            half_t(2 * i + 1 < original_size ? grad[2 * i + 1] : 0.0f)};
+    std::memcpy(out + i, pair, sizeof(pair));
+  }
+};
+
+struct dequantize_fp16 {
+  MSHADOW_CINLINE static void Map(int i,
+                                  int original_size,
+                                  float *out,
+                                  float *in) {
+    using mshadow::half::half_t;
+    half_t pair[2];
+    std::memcpy(pair, in + i, sizeof(pair));
+    out[2 * i] = static_cast<float>(pair[0]);
+    if (2 * i + 1 < original_size) out[2 * i + 1] = static_cast<float>(pair[1]);
+  }
+};
+
+inline int NumCompressBlocks(const int original_size) {
+  return (original_size + kCompressBlockSize - 1) / kCompressBlockSize;
+}
+
+// the cpu kernels below take {original, residual, compressed} to quantize
+// and {compressed, original} to dequantize, like the 2bit ones
+inline void QuantizeTopKImpl(mshadow::Stream<mshadow::cpu> *s,
                              const std::vector<mxnet::TBlob> &inputs,
-                             const float threshold) {
-  Quantize2BitKernelLaunch(s, inputs, threshold);
+                             const float ratio) {
+  const int original_size = inputs[0].Size();
+  mxnet::op::mxnet_op::Kernel<quantize_topk, mshadow::cpu>
+    ::Launch(s, NumCompressBlocks(original_size), original_size, TopKPerBlock(ratio),
+             inputs[2].dptr<float>(), inputs[0].dptr<float>(), inputs[1].dptr<float>());
 }
 
-inline void Dequantize2BitImpl(mshadow::Stream<mshadow::cpu> *s,
+inline void DequantizeTopKImpl(mshadow::Stream<mshadow::cpu> *s,
                                const std::vector<mxnet::TBlob> &inputs,
-                               const float threshold) {
-  Dequantize2BitKernelLaunch(s, inputs, threshold);
+                               const float ratio) {
+  const int original_size = inputs[1].Size();
+  mxnet::op::mxnet_op::Kernel<dequantize_topk, mshadow::cpu>
+    ::Launch(s, NumCompressBlocks(original_size), original_size, TopKPerBlock(ratio),
+             inputs[1].dptr<float>(), inputs[0].dptr<float>());
+}
+
+inline void Quantize1BitImpl(mshadow::Stream<mshadow::cpu> *s,
+                             const std::vector<mxnet::TBlob> &inputs) {
+  const int original_size = inputs[0].Size();
+  mxnet::op::mxnet_op::Kernel<quantize_1bit, mshadow::cpu>
+    ::Launch(s, NumCompressBlocks(original_size), original_size,
+             inputs[2].dptr<float>(), inputs[0].dptr<float>(), inputs[1].dptr<float>());
+}
+
+inline void Dequantize1BitImpl(mshadow::Stream<mshadow::cpu> *s,
+                               const std::vector<mxnet::TBlob> &inputs) {
+  const int original_size = inputs[1].Size();
+  mxnet::op::mxnet_op::Kernel<dequantize_1bit, mshadow::cpu>
+    ::Launch(s, NumCompressBlocks(original_size), original_size,
+             inputs[1].dptr<float>(), inputs[0].dptr<float>());
+}
+
+inline void QuantizeFP16Impl(mshadow::Stream<mshadow::cpu> *s,
+                             const std::vector<mxnet::TBlob> &inputs) {
+  const int original_size = inputs[0].Size();
+  mxnet::op::mxnet_op::Kernel<quantize_fp16, mshadow::cpu>
+    ::Launch(s, (original_size + 1) / 2, original_size,
+             inputs[2].dptr<float>(), inputs[0].dptr<float>());
+}
+
+inline void DequantizeFP16Impl(mshadow::Stream<mshadow::cpu> *s,
+                               const std::vector<mxnet::TBlob> &inputs) {
+  const int original_size = inputs[1].Size();
+  mxnet::op::mxnet_op::Kernel<dequantize_fp16, mshadow::cpu>
+    ::Launch(s, (original_size + 1) / 2, original_size,
+             inputs[1].dptr<float>(), inputs[0].dptr<float>());
 }
 }  // namespace kvstore
 }  // namespace mxnet
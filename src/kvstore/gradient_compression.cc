@@ -23,16 +23,280 @@
  * \author Rahul Huilgol
  */
 
+#include <dmlc/omp.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <vector>
 #include "kvstore_local.h"
 #include "gradient_compression.h"
 #include "gradient_compression-inl.h"
+#include "../engine/openmp.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MXNET_GC_X86 1
+#include <immintrin.h>
+#else
+#define MXNET_GC_X86 0
+#endif
 
 namespace mxnet {
 namespace kvstore {
 
 DMLC_REGISTER_PARAMETER(GradientCompressionParam);
 
+/*
+ * The cpu 2bit kernels work on words of the compressed array, each holding the codes of
+ * 16 values. The comparisons and residual updates of a word are vectorized, and the codes
+ * are put together from the masks of the values that are set and that are positive.
+ */
+namespace {
+const int kTwoBitWord = 16;
+
+// spreads the mask of four values to bits 6, 4, 2 and 0 of a byte
+const uint8_t kSpread[16] = {0x00, 0x40, 0x10, 0x50, 0x04, 0x44, 0x14, 0x54,
+                             0x01, 0x41, 0x11, 0x51, 0x05, 0x45, 0x15, 0x55};
+
+// the four values of each byte of codes, in units of the threshold
+struct TwoBitDecodeTable {
+  float values[256][4];
+  TwoBitDecodeTable() {
+    for (int byte = 0; byte < 256; ++byte) {
+      for (int k = 0; k < 4; ++k) {
+        const int code = (byte >> (6 - 2 * k)) & 3;
+        values[byte][k] = code == 3 ? 1.0f : (code == 2 ? -1.0f : 0.0f);
+      }
+    }
+  }
+};
+
+const TwoBitDecodeTable& DecodeTable() {
+  static TwoBitDecodeTable table;
+  return table;
+}
+
+// stores a word given the masks of its values that are set (11 or 10) and positive (11)
+inline void StoreTwoBitWord(uint32_t set, uint32_t pos, float *out) {
+  uint8_t bytes[4];
+  for (int b = 0; b < 4; ++b) {
+    bytes[b] = (kSpread[(set >> (4 * b)) & 15] << 1) | kSpread[(pos >> (4 * b)) & 15];
+  }
+  std::memcpy(out, bytes, sizeof(bytes));
+}
+
+// quantizes the n <= 16 values of a word
+inline void QuantizeTwoBitWord(const float *grad, float *residual, int n,
+                               const float threshold, float *out) {
+  uint32_t set = 0, pos = 0;
+  for (int j = 0; j < n; ++j) {
+    residual[j] += grad[j];
+    if (residual[j] >= threshold) {
+      set |= 1u << j;
+      pos |= 1u << j;
+      residual[j] -= threshold;
+    } else if (residual[j] <= -threshold) {
+      set |= 1u << j;
+      residual[j] += threshold;
+    }
+  }
+  StoreTwoBitWord(set, pos, out);
+}
+
+inline void DequantizeTwoBitWord(const float *in, int n, const float threshold,
+                                 const TwoBitDecodeTable& table, float *out) {
+  uint8_t bytes[4];
+  std::memcpy(bytes, in, sizeof(bytes));
+  for (int j = 0; j < n; ++j) {
+    out[j] = table.values[bytes[j >> 2]][j & 3] * threshold;
+  }
+}
+
+// the kernels below handle the full words [begin, end)
+typedef void (*Quantize2BitWords)(const float *grad, float *residual, float *out,
+                                  int64_t begin, int64_t end, const float threshold);
+typedef void (*Dequantize2BitWords)(const float *in, float *out, int64_t begin, int64_t end,
+                                    const float threshold, const TwoBitDecodeTable& table);
+
+void Quantize2BitScalar(const float *grad, float *residual, float *out,
+                        int64_t begin, int64_t end, const float threshold) {
+  for (int64_t w = begin; w < end; ++w) {
+    const int64_t start = w * kTwoBitWord;
+    QuantizeTwoBitWord(grad + start, residual + start, kTwoBitWord, threshold, out + w);
+  }
+}
+
+void Dequantize2BitScalar(const float *in, float *out, int64_t begin, int64_t end,
+                          const float threshold, const TwoBitDecodeTable& table) {
+  for (int64_t w = begin; w < end; ++w) {
+    DequantizeTwoBitWord(in + w, kTwoBitWord, threshold, table, out + w * kTwoBitWord);
+  }
+}
+
+#if MXNET_GC_X86
+__attribute__((target("avx2")))
+void Quantize2BitAVX2(const float *grad, float *residual, float *out,
+                      int64_t begin, int64_t end, const float threshold) {
+  const __m256 pos_th = _mm256_set1_ps(threshold), neg_th = _mm256_set1_ps(-threshold);
+  for (int64_t w = begin; w < end; ++w) {
+    uint32_t set = 0, pos = 0;
+    for (int half = 0; half < 2; ++half) {
+      const int64_t start = w * kTwoBitWord + 8 * half;
+      __m256 r = _mm256_add_ps(_mm256_loadu_ps(residual + start),
+                               _mm256_loadu_ps(grad + start));
+      const __m256 p = _mm256_cmp_ps(r, pos_th, _CMP_GE_OQ);
+      const __m256 n = _mm256_cmp_ps(r, neg_th, _CMP_LE_OQ);
+      r = _mm256_blendv_ps(r, _mm256_sub_ps(r, pos_th), p);
+      r = _mm256_blendv_ps(r, _mm256_add_ps(r, pos_th), n);
+      _mm256_storeu_ps(residual + start, r);
+      set |= static_cast<uint32_t>(_mm256_movemask_ps(_mm256_or_ps(p, n))) << (8 * half);
+      pos |= static_cast<uint32_t>(_mm256_movemask_ps(p)) << (8 * half);
+    }
+    StoreTwoBitWord(set, pos, out + w);
+  }
+}
+
+__attribute__((target("avx2")))
+void Dequantize2BitAVX2(const float *in, float *out, int64_t begin, int64_t end,
+                        const float threshold, const TwoBitDecodeTable& table) {
+  const __m256 th = _mm256_set1_ps(threshold);
+  for (int64_t w = begin; w < end; ++w) {
+    uint8_t bytes[4];
+    std::memcpy(bytes, in + w, sizeof(bytes));
+    for (int half = 0; half < 2; ++half) {
+      const __m128 lo = _mm_loadu_ps(table.values[bytes[2 * half]]);
+      const __m128 hi = _mm_loadu_ps(table.values[bytes[2 * half + 1]]);
+      const __m256 v = _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+      _mm256_storeu_ps(out + w * kTwoBitWord + 8 * half, _mm256_mul_ps(v, th));
+    }
+  }
+}
+
+__attribute__((target("avx512f")))
+void Quantize2BitAVX512(const float *grad, float *residual, float *out,
+                        int64_t begin, int64_t end, const float threshold) {
+  const __m512 pos_th = _mm512_set1_ps(threshold), neg_th = _mm512_set1_ps(-threshold);
+  for (int64_t w = begin; w < end; ++w) {
+    const int64_t start = w * kTwoBitWord;
+    __m512 r = _mm512_add_ps(_mm512_loadu_ps(residual + start), _mm512_loadu_ps(grad + start));
+    const __mmask16 p = _mm512_cmp_ps_mask(r, pos_th, _CMP_GE_OQ);
+    const __mmask16 n = _mm512_cmp_ps_mask(r, neg_th, _CMP_LE_OQ);
+    r = _mm512_mask_sub_ps(r, p, r, pos_th);
+    r = _mm512_mask_add_ps(r, n, r, pos_th);
+    _mm512_storeu_ps(residual + start, r);
+    StoreTwoBitWord(static_cast<uint32_t>(p | n), static_cast<uint32_t>(p), out + w);
+  }
+}
+
+__attribute__((target("avx512f")))
+void Dequantize2BitAVX512(const float *in, float *out, int64_t begin, int64_t end,
+                          const float threshold, const TwoBitDecodeTable& table) {
+  const __m512 th = _mm512_set1_ps(threshold);
+  for (int64_t w = begin; w < end; ++w) {
+    uint8_t bytes[4];
+    std::memcpy(bytes, in + w, sizeof(bytes));
+    __m512 v = _mm512_castps128_ps512(_mm_loadu_ps(table.values[bytes[0]]));
+    v = _mm512_insertf32x4(v, _mm_loadu_ps(table.values[bytes[1]]), 1);
+    v = _mm512_insertf32x4(v, _mm_loadu_ps(table.values[bytes[2]]), 2);
+    v = _mm512_insertf32x4(v, _mm_loadu_ps(table.values[bytes[3]]), 3);
+    _mm512_storeu_ps(out + w * kTwoBitWord, _mm512_mul_ps(v, th));
+  }
+}
+#endif  // MXNET_GC_X86
+
+// the widest vector instructions the cpu supports: 0 none, 1 AVX2, 2 AVX-512
+int TwoBitSimdLevel() {
+#if MXNET_GC_X86
+  static const int level = []() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return 2;
+    if (__builtin_cpu_supports("avx2")) return 1;
+    return 0;
+  }();
+  return level;
+#else
+  return 0;
+#endif
+}
+
+Quantize2BitWords SelectQuantize2Bit() {
+#if MXNET_GC_X86
+  switch (TwoBitSimdLevel()) {
+    case 2: return Quantize2BitAVX512;
+    case 1: return Quantize2BitAVX2;
+  }
+#endif
+  return Quantize2BitScalar;
+}
+
+Dequantize2BitWords SelectDequantize2Bit() {
+#if MXNET_GC_X86
+  switch (TwoBitSimdLevel()) {
+    case 2: return Dequantize2BitAVX512;
+    case 1: return Dequantize2BitAVX2;
+  }
+#endif
+  return Dequantize2BitScalar;
+}
+
+// runs func on contiguous ranges of words in parallel, at least 4096 words per thread
+template<typename Func>
+void ParallelWords(const int64_t num_words, Func func) {
+  const int64_t kMinWords = 4096;
+  const int omp_threads = static_cast<int>(std::min<int64_t>(
+      engine::OpenMP::Get()->GetRecommendedOMPThreadCount(),
+      std::max<int64_t>(1, num_words / kMinWords)));
+  if (omp_threads < 2) {
+    func(0, num_words);
+    return;
+  }
+  #pragma omp parallel for num_threads(omp_threads)
+  for (int t = 0; t < omp_threads; ++t) {
+    func(num_words * t / omp_threads, num_words * (t + 1) / omp_threads);
+  }
+}
+}  // namespace
+
+void Quantize2BitImpl(mshadow::Stream<mshadow::cpu> *s, const std::vector<mxnet::TBlob> &inputs,
+                      const float threshold) {
+  const int64_t original_size = inputs[0].Size();
+  const int64_t compressed_size = inputs[2].Size();
+  const float *grad = inputs[0].dptr<float>();
+  float *residual = inputs[1].dptr<float>();
+  float *out = inputs[2].dptr<float>();
+  const int64_t full_words = original_size / kTwoBitWord;
+  const Quantize2BitWords quantize = SelectQuantize2Bit();
+  ParallelWords(full_words, [=](int64_t begin, int64_t end) {
+      quantize(grad, residual, out, begin, end, threshold);
+    });
+  int64_t num_words = full_words;
+  if (original_size % kTwoBitWord != 0) {
+    const int64_t start = full_words * kTwoBitWord;
+    QuantizeTwoBitWord(grad + start, residual + start, original_size - start, threshold,
+                       out + full_words);
+    ++num_words;
+  }
+  // words past the original values are zero
+  if (compressed_size > num_words) std::fill(out + num_words, out + compressed_size, 0.0f);
+}
+
+void Dequantize2BitImpl(mshadow::Stream<mshadow::cpu> *s, const std::vector<mxnet::TBlob> &inputs,
+                        const float threshold) {
+  const int64_t original_size = inputs[1].Size();
+  const float *in = inputs[0].dptr<float>();
+  float *out = inputs[1].dptr<float>();
+  const TwoBitDecodeTable& table = DecodeTable();
+  const int64_t full_words = original_size / kTwoBitWord;
+  const Dequantize2BitWords dequantize = SelectDequantize2Bit();
+  ParallelWords(full_words, [=, &table](int64_t begin, int64_t end) {
+      dequantize(in, out, begin, end, threshold, table);
+    });
+  if (original_size % kTwoBitWord != 0) {
+    const int64_t start = full_words * kTwoBitWord;
+    DequantizeTwoBitWord(in + full_words, original_size - start, threshold, table,
+                         out + start);
+  }
+}
+
 GradientCompression::GradientCompression() {
   type_ = CompressionType::kNone;
 }
@@ -44,6 +308,13 @@ void GradientCompression::SetParams(const std::vector<std::pair<std::string, std
   CHECK_GT(params.threshold, 0) << "threshold must be greater than 0";
   if (params.type == "2bit") {
     SetTwoBitCompression(params.threshold);
+  } else if (params.type == "topk") {
+    CHECK(params.ratio > 0 && params.ratio < 0.5) << "ratio must be in (0, 0.5)";
+    SetTopKCompression(params.ratio);
+  } else if (params.type == "1bit") {
+    SetOneBitCompression();
+  } else if (params.type == "fp16") {
+    SetFP16Compression();
   } else {
     LOG(FATAL) << "Unknown type for gradient compression " << params.type;
   }
@@ -62,11 +333,26 @@ void GradientCompression::SetTwoBitCompression(const float threshold) {
   threshold_ = threshold;
 }
 
+void GradientCompression::SetTopKCompression(const float ratio) {
+  type_ = CompressionType::kTopK;
+  ratio_ = ratio;
+}
+
+void GradientCompression::SetOneBitCompression() {
+  type_ = CompressionType::kOneBit;
+}
+
+void GradientCompression::SetFP16Compression() {
+  type_ = CompressionType::kFP16;
+}
+
 std::string GradientCompression::EncodeParams() {
   using namespace std;  // to reduce length of next line
   string rval = get_type_str();
   if (type_ == CompressionType::kTwoBit) {
     rval += "," + to_string(threshold_);
+  } else if (type_ == CompressionType::kTopK) {
+    rval += ",," + to_string(ratio_);
   }
   return rval;
 }
@@ -80,22 +366,49 @@ void GradientCompression::DecodeParams(const std::string &s) {
       threshold_ = stof(elems[1]);
     }
   }
+  if (elems.size() > 2) {
+    if (!elems[2].empty()) {
+      ratio_ = stof(elems[2]);
+    }
+  }
 }
 
-int GradientCompression::GetCompressionFactor() {
-  if (type_ == CompressionType::kTwoBit) {
-    return 16;
-  } else {
-    LOG(FATAL) << "Unsupported compression type: " << get_type_str();
-    return 0;
+int GradientCompression::GetBlockSize() {
+  switch (type_) {
+    case CompressionType::kTwoBit:
+      return 16;
+    case CompressionType::kTopK:
+    case CompressionType::kOneBit:
+      return kCompressBlockSize;
+    case CompressionType::kFP16:
+      return 2;
+    default:
+      LOG(FATAL) << "Unsupported compression type: " << get_type_str();
+      return 0;
+  }
+}
+
+int GradientCompression::GetCompressedBlockSize() {
+  switch (type_) {
+    case CompressionType::kTwoBit:
+    case CompressionType::kFP16:
+      return 1;
+    case CompressionType::kTopK:
+      return 2 * TopKPerBlock(ratio_);
+    case CompressionType::kOneBit:
+      return kOneBitBlockLen;
+    default:
+      LOG(FATAL) << "Unsupported compression type: " << get_type_str();
+      return 0;
   }
 }
 
 int64_t GradientCompression::GetCompressedSize(const int64_t original_size) {
-  const int bits = GetCompressionFactor();
-  return ((original_size % bits == 0) ?
-          original_size / bits :
-          original_size / bits + 1);
+  const int block = GetBlockSize();
+  const int64_t num_blocks = (original_size % block == 0) ?
+                             original_size / block :
+                             original_size / block + 1;
+  return num_blocks * GetCompressedBlockSize();
 }
 
 void GradientCompression::Quantize(const mxnet::NDArray &from, mxnet::NDArray *to,
@@ -130,6 +443,23 @@ void GradientCompression::Quantize(const mxnet::NDArray &from, mxnet::NDArray *t
     LOG(FATAL) << MXNET_GPU_NOT_ENABLED_ERROR;
 #endif
     }
+  } else if (type_ != CompressionType::kNone) {
+    CHECK(a == mshadow::cpu::kDevMask && b == mshadow::cpu::kDevMask)
+      << "Only 2bit gradient compression is supported on gpu";
+    const CompressionType type = type_;
+    const float ratio = ratio_;
+    mxnet::Engine::Get()->PushSync([from, to, residual, type, ratio](mxnet::RunContext ctx) {
+      std::vector<mxnet::TBlob> inputs = {from.data(), residual->data(), to->data()};
+      mshadow::Stream<mshadow::cpu> *s = ctx.get_stream<mshadow::cpu>();
+      if (type == CompressionType::kTopK) {
+        QuantizeTopKImpl(s, inputs, ratio);
+      } else if (type == CompressionType::kOneBit) {
+        Quantize1BitImpl(s, inputs);
+      } else {
+        QuantizeFP16Impl(s, inputs);
+      }
+    }, from.ctx(), {from.var()}, {to->var(), residual->var()},
+    mxnet::FnProperty::kNormal, priority, "QuantizeCPU");
   } else {
     LOG(FATAL) << "Unsupported quantization of type " << get_type_str();
   }
@@ -166,6 +496,23 @@ void GradientCompression::Dequantize(const mxnet::NDArray &from, mxnet::NDArray
       LOG(FATAL) << MXNET_GPU_NOT_ENABLED_ERROR;
 #endif
     }
+  } else if (type_ != CompressionType::kNone) {
+    CHECK(a == mshadow::cpu::kDevMask && b == mshadow::cpu::kDevMask)
+      << "Only 2bit gradient compression is supported on gpu";
+    const CompressionType type = type_;
+    const float ratio = ratio_;
+    mxnet::Engine::Get()->PushSync([from, to, type, ratio](mxnet::RunContext ctx) {
+      std::vector<mxnet::TBlob> inputs = {from.data(), to->data()};
+      mshadow::Stream<mshadow::cpu> *s = ctx.get_stream<mshadow::cpu>();
+      if (type == CompressionType::kTopK) {
+        DequantizeTopKImpl(s, inputs, ratio);
+      } else if (type == CompressionType::kOneBit) {
+        Dequantize1BitImpl(s, inputs);
+      } else {
+        DequantizeFP16Impl(s, inputs);
+      }
+    }, from.ctx(), {from.var()}, {to->var()},
+    mxnet::FnProperty::kNormal, priority, "DequantizeCPU");
   } else {
     LOG(FATAL) << "Unsupported dequantization of type " << get_type_str();
   }
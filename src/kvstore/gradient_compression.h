@@ -35,17 +35,21 @@ namespace mxnet {
 namespace kvstore {
 
 enum class CompressionType {
-  kNone, kTwoBit
+  kNone, kTwoBit, kTopK, kOneBit, kFP16
 };
 
 struct GradientCompressionParam : public dmlc::Parameter<GradientCompressionParam> {
   std::string type;
   float threshold;
+  float ratio;
   DMLC_DECLARE_PARAMETER(GradientCompressionParam) {
     DMLC_DECLARE_FIELD(type)
-      .describe("Type of gradient compression to use, like `2bit` for example");
+      .describe("Type of gradient compression to use, one of `2bit`, `topk`, `1bit` "
+                "and `fp16`");
     DMLC_DECLARE_FIELD(threshold).set_default(0.5)
       .describe("Threshold to use for 2bit gradient compression");
+    DMLC_DECLARE_FIELD(ratio).set_default(0.01)
+      .describe("Fraction of the values of each block that topk gradient compression sends");
   }
 };
 
@@ -78,6 +82,24 @@ class GradientCompression {
    */
   void SetTwoBitCompression(const float threshold);
 
+  /*!
+   * \brief sets top-k gradient compression, which sends the largest values of each block
+   * of the gradient after adding the residual, and keeps the rest in the residual
+   * \param ratio fraction of the values of a block that are sent
+   */
+  void SetTopKCompression(const float ratio);
+
+  /*!
+   * \brief sets 1bit gradient compression, which sends the sign of each value after adding
+   * the residual and one scale per block, the mean absolute value of the block
+   */
+  void SetOneBitCompression();
+
+  /*!
+   * \brief sets fp16 gradient compression, which casts the gradient to float16
+   */
+  void SetFP16Compression();
+
   /*!
    * \brief encodes parameters of gc into a string
    */
@@ -89,10 +111,15 @@ class GradientCompression {
   void DecodeParams(const std::string &s);
 
   /*!
-   * \brief returns compression factor, which is the factor by which size of gradient
-   * reduces when using a particular type of compression
+   * \brief returns the number of original values that are compressed together as a block.
+   * a compressed array can only be split between servers at block boundaries
+   */
+  int GetBlockSize();
+
+  /*!
+   * \brief returns the number of elements a block takes in the compressed array
    */
-  int GetCompressionFactor();
+  int GetCompressedBlockSize();
 
   /*!
    * \brief returns the size of compressed gradients given an original sized gradient array
@@ -132,6 +159,11 @@ class GradientCompression {
    * all negative gradients will be thresholded to -1*`threshold_`
    */
   float threshold_ = 0;
+
+  /*!
+   * \brief denotes the fraction of the values of a block sent by top-k compression
+   */
+  float ratio_ = 0;
 };
 }  // namespace kvstore
 }  // namespace mxnet
@@ -25,9 +25,16 @@
 #ifndef MXNET_KVSTORE_KVSTORE_DIST_H_
 #define MXNET_KVSTORE_KVSTORE_DIST_H_
 #include <string>
+#include <sstream>
 #include <vector>
 #include <algorithm>
 #include <utility>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <thread>
 #include "./kvstore_local.h"
 #include "mxnet/engine.h"
 #include "ps/ps.h"
@@ -35,6 +42,9 @@
 namespace mxnet {
 namespace kvstore {
 
+/*! \brief fusion buckets use the keys from this one on, user keys stay below it */
+static const int kFusionKeyBase = 1 << 17;
+
 /**
  * \brief distributed kvstore
  *
@@ -57,9 +67,13 @@ class KVStoreDist : public KVStoreLocal {
     }
     bigarray_bound_ = dmlc::GetEnv("MXNET_KVSTORE_BIGARRAY_BOUND", 1000 * 1000);
     log_verbose_ = dmlc::GetEnv("MXNET_KVSTORE_DIST_ROW_SPARSE_VERBOSE", false);
+    fusion_bucket_size_ = dmlc::GetEnv("MXNET_KVSTORE_FUSION_BUCKET_SIZE", 0);
+    fusion_cycle_ = std::chrono::milliseconds(
+        dmlc::GetEnv("MXNET_KVSTORE_FUSION_CYCLE_TIME", 5));
   }
 
   virtual ~KVStoreDist() {
+    StopFusion();
     Engine::Get()->WaitForAll();
     customer_id_ = 0;
     if (IsWorkerNode()) {
@@ -86,7 +100,11 @@ class KVStoreDist : public KVStoreLocal {
 
   void SetGradientCompression(const std::vector<std::pair<std::string, std::string> >
                               & kwargs) override {
-    KVStoreLocal::SetGradientCompression(kwargs);
+    CHECK(buckets_.empty()) << "Gradient compression needs to be set before keys are "
+                            << "initialized when MXNET_KVSTORE_FUSION_BUCKET_SIZE is set";
+    // the workers quantize the merged gradients on cpu, see Push_, so unlike
+    // KVStoreLocal every type works with device comm
+    gradient_compression_->SetParams(kwargs);
     if (get_rank() == 0) {
       SendCommandToServers(static_cast<int>(CommandType::kSetGradientCompression),
                            gradient_compression_->EncodeParams());
@@ -169,6 +187,60 @@ class KVStoreDist : public KVStoreLocal {
     PSKV pull;
   };
 
+  /**
+   * \brief a pull of a fused key waiting for the round of its bucket
+   */
+  struct FusedPull {
+    NDArray recv;
+    size_t offset;
+    Engine::CallbackOnComplete cb;
+  };
+  /**
+   * \brief the pushes of a bucket that are sent together, and the pulls served
+   * from the value of the bucket pulled after them
+   */
+  struct FusionRound {
+    // pulled and num_pulls are guarded by fusion_mu_, the rest by mu
+    std::vector<bool> pulled;
+    int num_pulls = 0;
+    std::mutex mu;
+    bool done = false;
+    NDArray data;
+    std::vector<FusedPull> waiting;
+  };
+  struct FusionBucket {
+    int key;
+    int dtype;
+    // number of elements of the members, the mask follows them
+    size_t size = 0;
+    std::vector<int> members;
+    // offsets of the members in buf
+    std::vector<size_t> offsets;
+    // members pushed in this round and in the last one
+    std::vector<bool> pushed;
+    std::vector<bool> expected;
+    // sync mode: set once a member is pushed a second time, and the members pushed
+    // before that, see PushFused
+    bool learned = false;
+    std::vector<bool> seen;
+    int num_pushed = 0;
+    int priority = 0;
+    std::chrono::steady_clock::time_point start;
+    NDArray buf;
+    // the round that pushes and pulls join, and the last round pulled
+    std::shared_ptr<FusionRound> round;
+    std::shared_ptr<FusionRound> latest;
+
+    size_t Length() const { return size + members.size(); }
+  };
+  struct FusionSlot {
+    size_t bucket;
+    size_t index;
+    size_t offset;
+    size_t size;
+    TShape shape;
+  };
+
   /**
    * \brief cache all key partitions
    *
@@ -193,6 +265,9 @@ class KVStoreDist : public KVStoreLocal {
     for (size_t i = 0; i < keys.size(); ++i) {
       comm_->Init(keys[i], values[i].storage_type(), values[i].shape(), values[i].dtype());
     }
+    if (fusion_bucket_size_ > 0) {
+      AssignBuckets(keys, values);
+    }
     if (get_rank() == 0 && this->ps_worker_->get_customer()->customer_id() == 0) {
       Push_(keys, values, 0, false);
       // wait until the push is finished
@@ -200,6 +275,9 @@ class KVStoreDist : public KVStoreLocal {
         comm_buf_[key].WaitToWrite();
         compr_buf_[key].WaitToWrite();
       }
+      for (const FusionBucket& bucket : buckets_) {
+        bucket.buf.WaitToWrite();
+      }
     } else {
       // do nothing
     }
@@ -224,6 +302,11 @@ class KVStoreDist : public KVStoreLocal {
 
     for (size_t i = 0; i < uniq_keys.size(); ++i) {
       int key = uniq_keys[i];
+      auto fused = fused_.find(key);
+      if (fused != fused_.end()) {
+        PullFused(key, fused->second, grouped_vals[i], priority);
+        continue;
+      }
       // use the same array for merging to guarantee that pull always happens
       // after the previous push on this key
       auto& recv_buf = comm_buf_[key];
@@ -235,39 +318,43 @@ class KVStoreDist : public KVStoreLocal {
         recv_buf = NDArray(grouped_vals[i][0]->shape(), pinned_ctx_,
                            true, grouped_vals[i][0]->dtype());
       }
-      auto pull_from_servers = [this, key, recv_buf](
-          RunContext rctx, Engine::CallbackOnComplete cb) {
-        // convert to ps keys
-        size_t size = recv_buf.shape().Size();
-        const int dtype = recv_buf.dtype();
-        const int num_bytes = mshadow::mshadow_sizeof(dtype);
-        PSKV& pskv = (gradient_compression_->get_type() == CompressionType::kNone) ?
-                      EncodeDefaultKey(key, size, num_bytes) :
-                      EncodeCompressedKey(key, size, false, num_bytes);
-        char* data = static_cast<char*> (recv_buf.data().dptr_);
-        // false means not to delete data when SArray is deleted
-        auto vals = new ps::SArray<char>(data, size * num_bytes, false);
-        // issue pull
-        RequestType mode = (gradient_compression_->get_type() != CompressionType::kNone) ?
-                  RequestType::kCompressedPushPull : RequestType::kDefaultPushPull;
-        const int cmd = GetCommandType(mode, dtype);
-        CHECK_NOTNULL(ps_worker_)->ZPull(
-          pskv.keys, vals, &pskv.lens, cmd, [vals, cb](){ delete vals; cb(); });
-      };
-
-      CHECK_NOTNULL(Engine::Get())->PushAsync(
-          pull_from_servers,
-          pinned_ctx_,
-          {},
-          {recv_buf.var()},
-          FnProperty::kNormal,
-          priority,
-          "KVStoreDistDefaultStoragePull");
-
+      PullDefault(key, recv_buf, priority);
       comm_->Broadcast(key, recv_buf, grouped_vals[i], priority);
     }
   }
 
+  // pull a dense value from the servers into recv_buf
+  void PullDefault(int key, const NDArray& recv_buf, int priority) {
+    auto pull_from_servers = [this, key, recv_buf](
+        RunContext rctx, Engine::CallbackOnComplete cb) {
+      // convert to ps keys
+      size_t size = recv_buf.shape().Size();
+      const int dtype = recv_buf.dtype();
+      const int num_bytes = mshadow::mshadow_sizeof(dtype);
+      PSKV& pskv = (gradient_compression_->get_type() == CompressionType::kNone) ?
+                    EncodeDefaultKey(key, size, num_bytes) :
+                    EncodeCompressedKey(key, size, false, num_bytes);
+      char* data = static_cast<char*> (recv_buf.data().dptr_);
+      // false means not to delete data when SArray is deleted
+      auto vals = new ps::SArray<char>(data, size * num_bytes, false);
+      // issue pull
+      RequestType mode = (gradient_compression_->get_type() != CompressionType::kNone) ?
+                RequestType::kCompressedPushPull : RequestType::kDefaultPushPull;
+      const int cmd = GetCommandType(mode, dtype);
+      CHECK_NOTNULL(ps_worker_)->ZPull(
+        pskv.keys, vals, &pskv.lens, cmd, [vals, cb](){ delete vals; cb(); });
+    };
+
+    CHECK_NOTNULL(Engine::Get())->PushAsync(
+        pull_from_servers,
+        pinned_ctx_,
+        {},
+        {recv_buf.var()},
+        FnProperty::kNormal,
+        priority,
+        "KVStoreDistDefaultStoragePull");
+  }
+
   void PullRowSparseImpl(const std::vector<int>& keys,
                          const std::vector<std::pair<NDArray*, NDArray>>& val_rowids,
                          int priority = 0) override {
@@ -317,6 +404,7 @@ class KVStoreDist : public KVStoreLocal {
     std::vector<std::vector<NDArray> > grouped_vals;
     GroupKVPairsPush(keys, values, &uniq_keys, &grouped_vals, false);
 
+    bool has_fused = false;
     for (size_t i = 0; i < uniq_keys.size(); ++i) {
       // merge over devices
       int key = uniq_keys[i];
@@ -324,6 +412,12 @@ class KVStoreDist : public KVStoreLocal {
       NDArray merged = do_merge ? comm_->Reduce(key, vals, priority) : vals[0];
 
       const auto storage_type = merged.storage_type();
+      auto fused = fused_.find(key);
+      if (fused != fused_.end()) {
+        PushFused(fused->second, merged, priority, do_merge);
+        has_fused = true;
+        continue;
+      }
       auto &comm_buf = comm_buf_[key];
       if (merged.ctx().dev_mask() == cpu::kDevMask) {
         // Start of a push doesn't guarantee that the previous pushes are completed.
@@ -373,6 +467,13 @@ class KVStoreDist : public KVStoreLocal {
         LOG(FATAL) << "unknown storage type";
       }
     }
+    if (has_fused && IsSyncMode()) {
+      // the servers merge the n-th push of a bucket from each worker, so a round
+      // needs to hold the same pushes on every worker however fast they are. until
+      // a bucket knows the members pushed in an iteration, its rounds end here
+      std::lock_guard<std::mutex> lk(fusion_mu_);
+      FlushPushedBuckets([](const FusionBucket& bucket) { return !bucket.learned; });
+    }
   }
 
   void PushCompressed(int key, const NDArray& comm_buf, const PSKV& pskv, int priority) {
@@ -383,7 +484,9 @@ class KVStoreDist : public KVStoreLocal {
 
     // Init the small buffer and residual_ buffer for quantize
     if (small_buf.is_none()) {
-      small_buf = NDArray(TShape{pskv.size}, comm_buf.ctx(), false, dtype);
+      // pskv.size is in bytes
+      const int64_t small_size = pskv.size / mshadow::mshadow_sizeof(dtype);
+      small_buf = NDArray(TShape{small_size}, comm_buf.ctx(), false, dtype);
       res_buf = NDArray(TShape{static_cast<int64_t>(original_size)}, comm_buf.ctx(), false, dtype);
       res_buf = 0;
     }
@@ -433,6 +536,279 @@ class KVStoreDist : public KVStoreLocal {
         "KVStoreDistDefaultPush");
   }
 
+  /**
+   * \brief assign the small dense keys of an Init call to fusion buckets in init order,
+   * so that a bucket holds adjacent layers whose gradients are ready close in time.
+   * a bucket is a flat value of its members followed by a mask of the members pushed.
+   */
+  void AssignBuckets(const std::vector<int>& keys, const std::vector<NDArray>& values) {
+    if (gradient_compression_->get_type() != CompressionType::kNone) return;
+    std::lock_guard<std::mutex> lk(fusion_mu_);
+    const size_t first = buckets_.size();
+    std::unordered_map<int, size_t> open;  // the bucket being filled for each dtype
+    std::unordered_map<size_t, std::string> layouts;
+    for (size_t i = 0; i < keys.size(); ++i) {
+      const int key = keys[i];
+      CHECK_LT(key, kFusionKeyBase) << "keys need to be less than " << kFusionKeyBase
+                                    << " when MXNET_KVSTORE_FUSION_BUCKET_SIZE is set";
+      const NDArray& value = values[i];
+      const int dtype = value.dtype();
+      const size_t size = value.shape().Size();
+      // a bucket goes to a single server, see EncodeDefaultKey
+      const size_t max_size = std::min(fusion_bucket_size_ / mshadow::mshadow_sizeof(dtype),
+                                       bigarray_bound_ - 1);
+      if (value.storage_type() != kDefaultStorage || size + 1 > max_size) continue;
+      auto it = open.find(dtype);
+      if (it == open.end() ||
+          buckets_[it->second].Length() + size + 1 > max_size) {
+        FusionBucket bucket;
+        bucket.key = kFusionKeyBase + static_cast<int>(buckets_.size());
+        bucket.dtype = dtype;
+        open[dtype] = buckets_.size();
+        it = open.find(dtype);
+        buckets_.push_back(std::move(bucket));
+      }
+      FusionBucket& bucket = buckets_[it->second];
+      fused_[key] = FusionSlot{it->second, bucket.members.size(), bucket.size, size,
+                               value.shape()};
+      std::ostringstream layout;
+      layout << ' ' << key << ' ' << bucket.size << ' ' << value.shape().ndim();
+      for (const auto dim : value.shape()) layout << ' ' << dim;
+      layouts[it->second] += layout.str();
+      bucket.members.push_back(key);
+      bucket.offsets.push_back(bucket.size);
+      bucket.size += size;
+    }
+    const bool send_layout =
+        get_rank() == 0 && ps_worker_->get_customer()->customer_id() == 0;
+    for (size_t b = first; b < buckets_.size(); ++b) {
+      FusionBucket& bucket = buckets_[b];
+      bucket.pushed.assign(bucket.members.size(), false);
+      bucket.expected.assign(bucket.members.size(), true);
+      bucket.seen.assign(bucket.members.size(), false);
+      bucket.buf = NDArray(TShape{static_cast<int64_t>(bucket.Length())}, pinned_ctx_,
+                           false, bucket.dtype);
+      if (send_layout) {
+        // the servers update the members of a bucket one by one
+        SendCommandToServers(static_cast<int>(CommandType::kSetFusionLayout),
+                             std::to_string(bucket.key) + ' ' +
+                             std::to_string(bucket.members.size()) + layouts[b]);
+      }
+    }
+    // the sync rounds must not depend on time, see PushFused
+    if (!buckets_.empty() && !fusion_thread_ && !IsSyncMode()) {
+      fusion_thread_.reset(new std::thread(&KVStoreDist::FusionLoop, this));
+    }
+  }
+
+  /**
+   * \brief copy a pushed value into its bucket, the bucket is sent once its round is
+   * complete. in sync mode the rounds only depend on the order of the pushes, so
+   * that they line up on all workers: the first push calls after init end a round
+   * each, as Push_ flushes them. once a member is pushed again, the members pushed
+   * until then are expected in every round and rounds end when they are all pushed.
+   * a push of init does not count, as only one worker makes it
+   */
+  void PushFused(const FusionSlot& slot, const NDArray& merged, int priority, bool learn) {
+    std::lock_guard<std::mutex> lk(fusion_mu_);
+    FusionBucket& bucket = buckets_[slot.bucket];
+    const bool sync = IsSyncMode();
+    if (sync && learn && !bucket.learned) {
+      if (bucket.seen[slot.index]) {
+        bucket.learned = true;
+        bucket.expected = bucket.seen;
+      } else {
+        bucket.seen[slot.index] = true;
+      }
+    }
+    // a key pushed again starts the next round of its bucket
+    if (bucket.pushed[slot.index]) FlushBucket(&bucket);
+    if (bucket.num_pushed == 0) {
+      bucket.priority = priority;
+      bucket.start = std::chrono::steady_clock::now();
+      bucket.latest.reset();
+    }
+    NDArray slice = bucket.buf.Slice(slot.offset, slot.offset + slot.size);
+    CopyFromTo(merged.Reshape(slice.shape()), &slice, priority);
+    bucket.priority = std::max(bucket.priority, priority);
+    bucket.pushed[slot.index] = true;
+    ++bucket.num_pushed;
+    // Push_ ends these rounds
+    if (sync && !bucket.learned) return;
+    // complete once the members pushed in the last round are pushed again
+    for (size_t i = 0; i < bucket.members.size(); ++i) {
+      if (bucket.expected[i] && !bucket.pushed[i]) return;
+    }
+    FlushBucket(&bucket);
+  }
+
+  // pull a fused key, served from the value of its bucket at the end of the round
+  void PullFused(int key, const FusionSlot& slot, const std::vector<NDArray*>& vals,
+                 int priority) {
+    auto& recv_buf = comm_buf_[key];
+    if (recv_buf.is_none()) {
+      recv_buf = NDArray(slot.shape, pinned_ctx_, false, vals[0]->dtype());
+    }
+    std::shared_ptr<FusionRound> round;
+    {
+      std::lock_guard<std::mutex> lk(fusion_mu_);
+      FusionBucket& bucket = buckets_[slot.bucket];
+      // nothing pushed since the last round, its value serves one pull of each member
+      if (bucket.num_pushed == 0 && bucket.latest &&
+          !bucket.latest->pulled[slot.index]) {
+        round = bucket.latest;
+      } else {
+        if (!bucket.round) {
+          bucket.round = std::make_shared<FusionRound>();
+          bucket.round->pulled.assign(bucket.members.size(), false);
+        }
+        round = bucket.round;
+      }
+      round->pulled[slot.index] = true;
+      ++round->num_pulls;
+      if (bucket.num_pushed == 0 && round != bucket.latest) {
+        // nothing to send, pull the bucket right away
+        bucket.priority = priority;
+        FlushBucket(&bucket);
+      }
+    }
+    const size_t offset = slot.offset;
+    // hold recv_buf until the round is pulled, so readers of the key wait for it
+    Engine::Get()->PushAsync(
+      [round, recv_buf, offset](RunContext rctx, Engine::CallbackOnComplete cb) {
+        FusedPull pull{recv_buf, offset, cb};
+        {
+          std::lock_guard<std::mutex> lk(round->mu);
+          if (!round->done) {
+            round->waiting.push_back(pull);
+            return;
+          }
+        }
+        DeliverFusedPull(round->data, pull);
+      },
+      pinned_ctx_,
+      {},
+      {recv_buf.var()},
+      FnProperty::kNormal,
+      priority,
+      "KVStoreDistFusedPull");
+    comm_->Broadcast(key, recv_buf, vals, priority);
+  }
+
+  static void DeliverFusedPull(const NDArray& data, const FusedPull& pull) {
+    const size_t num_bytes = mshadow::mshadow_sizeof(data.dtype());
+    std::memcpy(pull.recv.data().dptr_,
+                static_cast<char*>(data.data().dptr_) + pull.offset * num_bytes,
+                pull.recv.shape().Size() * num_bytes);
+    pull.cb();
+  }
+
+  // whether the servers merge the pushes of all workers, see KVStore::Create
+  bool IsSyncMode() const {
+    return type_.find("_async") == std::string::npos;
+  }
+
+  /**
+   * \brief send the pushed members of a bucket with the mask of them, then pull the
+   * bucket if any pull joined the round. requires fusion_mu_
+   */
+  void FlushBucket(FusionBucket* bucket) {
+    const int priority = bucket->priority;
+    if (bucket->num_pushed > 0) {
+      // zero the members not pushed, the servers may sum the whole bucket
+      NDArray buf = bucket->buf;
+      const size_t size = bucket->size;
+      const std::vector<size_t> offsets = bucket->offsets;
+      const std::vector<bool> pushed = bucket->pushed;
+      Engine::Get()->PushSync([buf, size, offsets, pushed](RunContext rctx) {
+          MSHADOW_TYPE_SWITCH(buf.dtype(), DType, {
+            DType* dptr = buf.data().dptr<DType>();
+            for (size_t i = 0; i < pushed.size(); ++i) {
+              if (!pushed[i]) {
+                const size_t end = i + 1 < offsets.size() ? offsets[i + 1] : size;
+                std::fill(dptr + offsets[i], dptr + end, DType(0));
+              }
+              dptr[size + i] = static_cast<DType>(pushed[i] ? 1.0f : 0.0f);
+            }
+          });
+        }, pinned_ctx_, {}, {buf.var()}, FnProperty::kNormal, priority,
+        "KVStoreDistFusionMask");
+      PSKV& pskv = EncodeDefaultKey(bucket->key, bucket->Length(),
+                                    mshadow::mshadow_sizeof(bucket->dtype));
+      PushDefault(bucket->key, bucket->buf, pskv, priority);
+      bucket->expected = bucket->pushed;
+      bucket->pushed.assign(bucket->members.size(), false);
+      bucket->num_pushed = 0;
+    }
+    std::shared_ptr<FusionRound> round = bucket->round;
+    bucket->round.reset();
+    if (!round) return;
+    // the pull waits for the push, as both use buf. the value is copied out of buf
+    // since pulls may start after the next round is written into buf
+    PullDefault(bucket->key, bucket->buf, priority);
+    NDArray data(bucket->buf.shape(), pinned_ctx_, false, bucket->dtype);
+    CopyFromTo(bucket->buf, &data, priority);
+    Engine::Get()->PushAsync(
+      [round, data](RunContext rctx, Engine::CallbackOnComplete cb) {
+        std::vector<FusedPull> waiting;
+        {
+          std::lock_guard<std::mutex> lk(round->mu);
+          round->data = data;
+          round->done = true;
+          waiting.swap(round->waiting);
+        }
+        for (const auto& pull : waiting) DeliverFusedPull(data, pull);
+        cb();
+      },
+      pinned_ctx_,
+      {data.var()},
+      {},
+      FnProperty::kNormal,
+      priority,
+      "KVStoreDistFusionDeliver");
+    bucket->latest = round;
+  }
+
+  // send the incomplete buckets whose round is older than the cycle time
+  void FusionLoop() {
+    std::unique_lock<std::mutex> lk(fusion_mu_);
+    while (!fusion_stop_) {
+      fusion_cv_.wait_for(lk, fusion_cycle_);
+      const auto now = std::chrono::steady_clock::now();
+      FlushPushedBuckets([this, now](const FusionBucket& bucket) {
+          return now - bucket.start >= fusion_cycle_;
+        });
+    }
+  }
+
+  /**
+   * \brief send the buckets with pushes that pass the filter, the ones with the higher
+   * priority first. requires fusion_mu_
+   */
+  void FlushPushedBuckets(const std::function<bool(const FusionBucket&)>& filter = nullptr) {
+    std::vector<FusionBucket*> due;
+    for (auto& bucket : buckets_) {
+      if (bucket.num_pushed > 0 && (!filter || filter(bucket))) due.push_back(&bucket);
+    }
+    std::sort(due.begin(), due.end(), [](const FusionBucket* a, const FusionBucket* b) {
+        return a->priority > b->priority;
+      });
+    for (FusionBucket* bucket : due) FlushBucket(bucket);
+  }
+
+  // flush the open rounds and stop the fusion thread
+  void StopFusion() {
+    {
+      std::lock_guard<std::mutex> lk(fusion_mu_);
+      FlushPushedBuckets();
+      fusion_stop_ = true;
+    }
+    if (!fusion_thread_) return;
+    fusion_cv_.notify_all();
+    fusion_thread_->join();
+    fusion_thread_.reset();
+  }
+
   // push row sparse gradient
   void PushRowSparse(int key, const NDArray &send_buf, int priority) {
     using namespace rowsparse;
@@ -627,9 +1003,12 @@ class KVStoreDist : public KVStoreLocal {
         push_pskv.size = compr_size;
         pull_pskv.size = original_size;
       } else {
-        // partition it to all servers
+        // partition it to all servers, at block boundaries of the compressed array
         push_pskv.size = 0;
         pull_pskv.size = 0;
+        const size_t block = gradient_compression_->GetBlockSize();
+        const size_t compr_block = gradient_compression_->GetCompressedBlockSize();
+        const size_t num_blocks = compr_num_elem / compr_block;
 
         for (int i = 0; i < num_servers; ++i) {
           size_t part_compr, part_orig;
@@ -637,10 +1016,11 @@ class KVStoreDist : public KVStoreLocal {
             part_compr = compr_num_elem - push_pskv.size;
             part_orig = original_num_elem - pull_pskv.size;
           } else {
-            part_compr =
-              static_cast<size_t> (round(static_cast<double>(compr_num_elem)/num_servers*(i+1))) -
-              static_cast<size_t> (round(static_cast<double>(compr_num_elem)/num_servers*(i)));
-            part_orig = part_compr * gradient_compression_->GetCompressionFactor();
+            const size_t part_blocks =
+              static_cast<size_t> (round(static_cast<double>(num_blocks)/num_servers*(i+1))) -
+              static_cast<size_t> (round(static_cast<double>(num_blocks)/num_servers*(i)));
+            part_compr = part_blocks * compr_block;
+            part_orig = part_blocks * block;
           }
 
           // meta info
@@ -762,6 +1142,21 @@ class KVStoreDist : public KVStoreLocal {
    */
   std::unordered_map<int, NDArray> residual_;
   bool log_verbose_;
+
+  /**
+   * \brief max bytes of a fusion bucket, 0 disables fusion
+   */
+  size_t fusion_bucket_size_;
+  /**
+   * \brief an incomplete bucket is sent once its round is older than this
+   */
+  std::chrono::milliseconds fusion_cycle_;
+  std::vector<FusionBucket> buckets_;
+  std::unordered_map<int, FusionSlot> fused_;
+  std::mutex fusion_mu_;
+  std::condition_variable fusion_cv_;
+  bool fusion_stop_ = false;
+  std::unique_ptr<std::thread> fusion_thread_;
 };
 
 }  // namespace kvstore
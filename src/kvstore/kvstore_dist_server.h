@@ -29,12 +29,15 @@
 #include <ps/ps.h>
 #include <queue>
 #include <string>
+#include <sstream>
 #include <mutex>
 #include <condition_variable>
 #include <memory>
 #include <functional>
 #include <future>
+#include <unordered_map>
 #include <vector>
+#include "./sharded_executor.h"
 #include "../profiler/profiler.h"
 #include "../operator/tensor/elemwise_binary_op-inl.h"
 #include "../operator/tensor/init_op.h"
@@ -45,7 +48,7 @@ namespace kvstore {
 // maintain same order in frontend.
 enum class CommandType {
   kController, kSetMultiPrecision, kStopServer, kSyncMode,
-  kSetGradientCompression, kSetProfilerParams
+  kSetGradientCompression, kSetProfilerParams, kSetFusionLayout
 };
 
 enum class RequestType {
@@ -164,10 +167,16 @@ class KVStoreDistServer {
     sync_mode_ = false;
     gradient_compression_ = std::make_shared<GradientCompression>();
     log_verbose_ = dmlc::GetEnv("MXNET_KVSTORE_DIST_ROW_SPARSE_VERBOSE", false);
+    const int num_threads = dmlc::GetEnv("MXNET_KVSTORE_SERVER_THREADS", 0);
+    if (num_threads > 0) {
+      update_exec_.reset(new ShardedExecutor(num_threads));
+    }
   }
 
   ~KVStoreDistServer() {
     profiler::Profiler::Get()->SetState(profiler::Profiler::ProfilerState(0));
+    // the update threads respond through ps_server_
+    update_exec_.reset();
     delete ps_server_;
   }
 
@@ -200,6 +209,7 @@ class KVStoreDistServer {
     CommandType recved_type = static_cast<CommandType>(recved.head);
     switch (recved_type) {
       case CommandType::kStopServer:
+        if (update_exec_) update_exec_->Stop();
         exec_.Stop();
         break;
       case CommandType::kSyncMode:
@@ -214,9 +224,15 @@ class KVStoreDistServer {
                                                   (recved.body.back() - '0'),
                                       recved.body);
         break;
+      case CommandType::kSetFusionLayout:
+        SetFusionLayout(recved.body);
+        break;
       case CommandType::kSetMultiPrecision:
         // uses value 1 for message id from frontend
         if (!multi_precision_) {
+          // the update threads access the values of store_ without store_mu_, so let
+          // them finish first. requests are only queued to them from this thread
+          if (update_exec_) update_exec_->Wait();
           multi_precision_ = true;
           CreateMultiPrecisionCopies();
         }
@@ -233,12 +249,34 @@ class KVStoreDistServer {
     app->Response(recved);
   }
 
+  /*
+   * A fusion bucket packs several small keys of a worker into one flat value.
+   * The layout body is "bucket num_members (key offset ndim dim...)*".
+   */
+  void SetFusionLayout(const std::string& body) {
+    std::istringstream is(body);
+    int bucket, num_members;
+    is >> bucket >> num_members;
+    std::vector<FusedKey> members(num_members);
+    for (auto& member : members) {
+      int ndim;
+      is >> member.key >> member.offset >> ndim;
+      std::vector<int64_t> dims(ndim);
+      for (auto& dim : dims) is >> dim;
+      member.shape = TShape(dims.begin(), dims.end());
+    }
+    CHECK(!is.fail()) << "invalid fusion layout " << body;
+    std::lock_guard<std::mutex> lk(store_mu_);
+    fusion_layout_[bucket] = std::move(members);
+  }
+
   /*
    * For keys already initialized, if necessary create stored_realt.
    * This will only be used if by some wrong usage of kvstore,
    * some keys are initialized before optimizer is set.
    */
   void CreateMultiPrecisionCopies() {
+    std::lock_guard<std::mutex> lk(store_mu_);
     for (auto const &stored_entry : store_) {
       const int key = stored_entry.first;
       const NDArray &stored = stored_entry.second;
@@ -325,6 +363,25 @@ class KVStoreDistServer {
   void DataHandleEx(const ps::KVMeta& req_meta,
                     const ps::KVPairs<char>& req_data,
                     ps::KVServer<char>* server) {
+    if (!update_exec_) {
+      DataHandle(req_meta, req_data, server);
+      return;
+    }
+    // shard the requests by key over the update threads, which keeps the
+    // requests of a key in order. compressed pushes carry the key second.
+    DataHandleType type = DepairDataHandleType(req_meta.cmd);
+    const size_t pos = type.requestType == RequestType::kCompressedPushPull &&
+                       req_meta.push && req_data.keys.size() > 1 ? 1 : 0;
+    CHECK_GT(req_data.keys.size(), pos);
+    const int key = DecodeKey(req_data.keys[pos]);
+    update_exec_->Exec(key, [this, req_meta, req_data, server]() {
+        DataHandle(req_meta, req_data, server);
+      });
+  }
+
+  void DataHandle(const ps::KVMeta& req_meta,
+                  const ps::KVPairs<char>& req_data,
+                  ps::KVServer<char>* server) {
     DataHandleType type = DepairDataHandleType(req_meta.cmd);
     switch (type.requestType) {
       case RequestType::kRowSparsePushPull:
@@ -343,17 +400,67 @@ class KVStoreDistServer {
     return multi_precision_ && type.dtype != mshadow::kFloat32;
   }
 
+  inline void RunUpdater(const int key, const NDArray& update, NDArray* stored) {
+    CHECK(updater_);
+    const std::vector<FusedKey>* members = nullptr;
+    {
+      std::lock_guard<std::mutex> lk(store_mu_);
+      auto it = fusion_layout_.find(key);
+      if (it != fusion_layout_.end()) members = &it->second;
+    }
+    if (members) {
+      // the updater keeps per key state, so update each member of a bucket on its
+      // own slice of the flat value. the mask after the members tells which of them
+      // were pushed, the others are left as they are
+      const FusedKey& last = members->back();
+      const size_t mask_offset = last.offset + last.shape.Size();
+      std::vector<bool> pushed(members->size());
+      update.WaitToRead();
+      MSHADOW_TYPE_SWITCH(update.dtype(), DType, {
+        const DType* mask = update.data().dptr<DType>() + mask_offset;
+        for (size_t i = 0; i < pushed.size(); ++i) {
+          pushed[i] = static_cast<float>(mask[i]) != 0.0f;
+        }
+      });
+      for (size_t i = 0; i < members->size(); ++i) {
+        if (!pushed[i]) continue;
+        const FusedKey& member = (*members)[i];
+        const size_t end = member.offset + member.shape.Size();
+        NDArray member_update = update.Slice(member.offset, end).Reshape(member.shape);
+        NDArray member_stored = stored->Slice(member.offset, end).Reshape(member.shape);
+        RunUpdater(member.key, member_update, &member_stored);
+      }
+      return;
+    }
+    // let the main thread to execute updater_, which is necessary for python. this
+    // also serializes the calls from the update threads, which only merge in parallel
+    exec_.Exec([this, key, &update, stored]() {
+        updater_(key, update, stored);
+      });
+  }
+
+  /**
+   * \brief find or insert the entry of a key, the update threads insert
+   * keys concurrently. references to the entries stay valid.
+   */
+  template<typename V>
+  inline V& Entry(std::unordered_map<int, V>* map, const int key) {
+    std::lock_guard<std::mutex> lk(store_mu_);
+    return (*map)[key];
+  }
+
+  // the stored value that updates apply to, the float32 copy in multi precision mode
+  inline NDArray& UpdatedStore(const DataHandleType type, const int key) {
+    return has_multi_precision_copy(type) ? Entry(&store_realt_, key) : Entry(&store_, key);
+  }
+
   inline void ApplyUpdates(const DataHandleType type, const int key,
                            UpdateBuf *update_buf, ps::KVServer<char>* server) {
     if (!sync_mode_ || update_buf->request.size() == (size_t) ps::NumWorkers()) {
-      // let the main thread to execute updater_, which is necessary for python
-      auto& stored = has_multi_precision_copy(type) ? store_realt_[key] : store_[key];
+      auto& stored = UpdatedStore(type, key);
       auto& update =  sync_mode_ ? update_buf->merged : update_buf->temp_array;
       if (updater_) {
-        exec_.Exec([this, key, &update, &stored](){
-          CHECK(updater_);
-          updater_(key, update, &stored);
-        });
+        RunUpdater(key, update, &stored);
       } else {
         CHECK(sync_mode_) << "Updater needs to be set for async mode";
         // if no updater, just copy
@@ -367,7 +474,7 @@ class KVStoreDistServer {
         server->Response(req);
       }
       update_buf->request.clear();
-      if (has_multi_precision_copy(type)) CopyFromTo(stored, store_[key]);
+      if (has_multi_precision_copy(type)) CopyFromTo(stored, Entry(&store_, key));
       stored.WaitToRead();
     } else {
       update_buf->merged.WaitToRead();
@@ -419,7 +526,7 @@ class KVStoreDistServer {
       server->Response(req_meta, response);
       return;
     }
-    const NDArray& stored = store_[master_key];
+    const NDArray& stored = Entry(&store_, master_key);
     if (has_multi_precision_copy(type)) stored.WaitToRead();
     CHECK(!stored.is_none()) << "init " << master_key << " first";
     auto shape = stored.shape();
@@ -453,7 +560,7 @@ class KVStoreDistServer {
                            const ps::KVMeta& req_meta,
                            const ps::KVPairs<char>& req_data,
                            ps::KVServer<char>* server) {
-    auto& stored = has_multi_precision_copy(type) ? store_realt_[master_key] : store_[master_key];
+    auto& stored = UpdatedStore(type, master_key);
     int dtype = type.dtype;
     int num_bytes = mshadow::mshadow_sizeof(dtype);
     auto unit_len = req_data.lens[1] / num_bytes;
@@ -469,7 +576,7 @@ class KVStoreDistServer {
     stored = NDArray(kRowSparseStorage, dshape, Context(), true,
                      has_multi_precision_copy(type) ? mshadow::kFloat32 : type.dtype);
     if (has_multi_precision_copy(type)) {
-      store_[master_key] = NDArray(kRowSparseStorage, dshape, Context(), true, type.dtype);
+      Entry(&store_, master_key) = NDArray(kRowSparseStorage, dshape, Context(), true, type.dtype);
     }
     Engine::Get()->PushAsync(
     [this, recved, stored, type](RunContext ctx, Engine::CallbackOnComplete on_complete) {
@@ -489,8 +596,8 @@ class KVStoreDistServer {
     }, recved.ctx(), {recved.var()}, {stored.var()},
     FnProperty::kNormal, 0, PROFILER_MESSAGE_FUNCNAME);
     if (has_multi_precision_copy(type)) {
-      CopyFromTo(stored, store_[master_key]);
-      store_[master_key].WaitToRead();
+      CopyFromTo(stored, Entry(&store_, master_key));
+      Entry(&store_, master_key).WaitToRead();
     }
     stored.WaitToRead();
     server->Response(req_meta);
@@ -501,7 +608,7 @@ class KVStoreDistServer {
                            ps::KVServer<char>* server) {
     int master_key = DecodeKey(req_data.keys[0]);
     auto num_rows = req_data.keys.size() - 1;
-    auto& stored = store_[master_key];
+    auto& stored = Entry(&store_, master_key);
     if (req_meta.push) {
       CHECK_GT(req_data.lens.size(), 0) << "req_data.lens cannot be empty";
       CHECK_EQ(req_data.lens[0], 0);
@@ -513,7 +620,7 @@ class KVStoreDistServer {
         return;
       } else {
         if (log_verbose_) LOG(INFO) << "push: " << master_key << " " << req_data.keys;
-        auto& updates = update_buf_[master_key];
+        auto& updates = Entry(&update_buf_, master_key);
         if (sync_mode_ && updates.merged.is_none()) {
           updates.merged = NDArray(kRowSparseStorage, stored.shape(), Context(), true,
                                    has_multi_precision_copy(type) ? mshadow::kFloat32 : type.dtype);
@@ -585,7 +692,7 @@ class KVStoreDistServer {
                               const ps::KVPairs<char> &req_data,
                               ps::KVServer<char>* server) {
     ps::KVPairs<char> response;
-    const NDArray& stored = store_[key];
+    const NDArray& stored = Entry(&store_, key);
     CHECK(!stored.is_none()) << "init " << key << " first";
 
     // as server returns when store_realt is ready in this case
@@ -617,14 +724,14 @@ class KVStoreDistServer {
 
       int original_size = DecodeKey(req_data.keys[0]);
       int key = DecodeKey(req_data.keys[1]);
-      auto& stored = store_[key];
+      auto& stored = Entry(&store_, key);
 
       size_t ds[] = {(size_t)req_data.lens[1] / mshadow::mshadow_sizeof(type.dtype)};
       TShape dshape(ds, ds + 1);
       TBlob recv_blob(reinterpret_cast<real_t*>(req_data.vals.data()), dshape, cpu::kDevMask);
       NDArray recved = NDArray(recv_blob, 0);
 
-      NDArray decomp_buf = decomp_buf_[key];
+      NDArray decomp_buf = Entry(&decomp_buf_, key);
       dshape = TShape{(int64_t) original_size};
 
       if (decomp_buf.is_none()) {
@@ -638,7 +745,7 @@ class KVStoreDistServer {
         stored.WaitToRead();
       } else if (sync_mode_) {
         // synced push
-        auto& merged = update_buf_[key];
+        auto& merged = Entry(&update_buf_, key);
         if (merged.merged.is_none()) {
           merged.merged = NDArray(dshape, Context());
         }
@@ -653,10 +760,7 @@ class KVStoreDistServer {
       } else {
         // async push
         gradient_compression_->Dequantize(recved, &decomp_buf, 0);
-        exec_.Exec([this, key, &decomp_buf, &stored]() {
-          CHECK(updater_);
-          updater_(key, decomp_buf, &stored);
-        });
+        RunUpdater(key, decomp_buf, &stored);
         server->Response(req_meta);
         stored.WaitToRead();
       }
@@ -678,7 +782,7 @@ class KVStoreDistServer {
       CHECK_EQ(req_data.vals.size(), (size_t)req_data.lens[0]);
     }
     int key = DecodeKey(req_data.keys[0]);
-    auto& stored = has_multi_precision_copy(type) ? store_realt_[key] : store_[key];
+    auto& stored = UpdatedStore(type, key);
     // there used several WaitToRead, this is because \a recved's memory
     // could be deallocated when this function returns. so we need to make sure
     // the operators with \a NDArray are actually finished
@@ -697,14 +801,14 @@ class KVStoreDistServer {
         CopyFromTo(recved, &stored, 0);
         server->Response(req_meta);
         if (has_multi_precision_copy(type)) {
-          auto& stored_dtype = store_[key];
+          auto& stored_dtype = Entry(&store_, key);
           stored_dtype = NDArray(dshape, Context(), false, type.dtype);
           CopyFromTo(stored, stored_dtype);
           stored_dtype.WaitToRead();
         }
         stored.WaitToRead();
       } else {
-        auto &updates = update_buf_[key];
+        auto &updates = Entry(&update_buf_, key);
         if (sync_mode_ && updates.merged.is_none()) {
           updates.merged = NDArray(dshape, Context(), false,
                                    has_multi_precision_copy(type) ? mshadow::kFloat32 : type.dtype);
@@ -771,7 +875,26 @@ class KVStoreDistServer {
    */
   std::unordered_map<int, NDArray> decomp_buf_;
 
+  struct FusedKey {
+    int key;
+    size_t offset;
+    TShape shape;
+  };
+  /**
+   * \brief members of each fusion bucket, set by kSetFusionLayout
+   */
+  std::unordered_map<int, std::vector<FusedKey>> fusion_layout_;
+  /**
+   * \brief guards inserting into the maps above
+   */
+  std::mutex store_mu_;
+
   Executor exec_;
+  /**
+   * \brief runs the data handlers sharded by key if MXNET_KVSTORE_SERVER_THREADS > 0,
+   * otherwise they run on the thread of ps_server_
+   */
+  std::unique_ptr<ShardedExecutor> update_exec_;
   ps::KVServer<char>* ps_server_;
 
   // whether to LOG verbose information
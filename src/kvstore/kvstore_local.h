@@ -166,6 +166,14 @@ class KVStoreLocal : public KVStore {
 
   void SetGradientCompression(const std::vector<std::pair<std::string, std::string> >
                               & kwargs) override {
+    if (dynamic_cast<CommDevice*>(comm_) != nullptr) {
+      // the device comm quantizes the gradients on the gpus that hold them, and only
+      // 2bit compression has gpu kernels. check before changing the type in use
+      GradientCompression gc;
+      gc.SetParams(kwargs);
+      CHECK(gc.get_type() == CompressionType::kTwoBit)
+        << "Only 2bit gradient compression is supported by device kvstores";
+    }
     gradient_compression_->SetParams(kwargs);
   }
 
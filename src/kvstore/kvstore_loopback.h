@@ -0,0 +1,227 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file kvstore_loopback.h
+ * \brief run a whole dist kvstore cluster on the local host
+ */
+#ifndef MXNET_KVSTORE_KVSTORE_LOOPBACK_H_
+#define MXNET_KVSTORE_KVSTORE_LOOPBACK_H_
+#include <dmlc/logging.h>
+#include <mxnet/kvstore.h>
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+extern char **environ;
+#endif
+
+namespace mxnet {
+namespace kvstore {
+
+/**
+ * \brief a ps-lite cluster on 127.0.0.1, like tools/launch.py --launcher local.
+ *
+ * ps-lite keeps the role of a node in process wide singletons, so every
+ * node is a process. The program calling Run is started again for the
+ * scheduler, every server and every worker, with the DMLC_* variables set.
+ * In those copies the same call of Run plays the role of the node and exits,
+ * so the code before it must take the same path, e.g. run the same test.
+ * Calls of Run before it return 0 right away.
+ */
+class LoopbackCluster {
+ public:
+  /**
+   * \brief function run by every worker process
+   */
+  typedef std::function<void()> Worker;
+
+  LoopbackCluster(int num_servers, int num_workers)
+      : num_servers_(num_servers), num_workers_(num_workers) {
+    CHECK_GT(num_servers, 0);
+    CHECK_GT(num_workers, 0);
+  }
+
+  /**
+   * \brief set an environment variable of all nodes, e.g. MXNET_KVSTORE_BIGARRAY_BOUND
+   */
+  void SetEnv(const std::string& name, const std::string& value) {
+    env_.emplace_back(name, value);
+  }
+
+  /**
+   * \brief set the command line the nodes are started with, /proc/self/cmdline by default
+   */
+  void SetArgs(const std::vector<std::string>& args) {
+    args_ = args;
+  }
+
+  /**
+   * \brief whether this process is a node started by a LoopbackCluster
+   */
+  static bool IsNode() {
+    return std::getenv("MXNET_KVSTORE_LOOPBACK") != nullptr;
+  }
+
+  /**
+   * \brief start the cluster and wait for all nodes to exit. in a node, run the
+   * role of the node and exit the process instead.
+   * \return number of nodes that failed
+   */
+  int Run(const Worker& worker) {
+#ifndef _WIN32
+    // calls of Run in this process, to find the cluster of a node
+    static int num_runs = 0;
+    const int run = num_runs++;
+    if (IsNode()) {
+      if (std::atoi(std::getenv("MXNET_KVSTORE_LOOPBACK")) != run) return 0;
+      RunNode(worker);
+    }
+    std::vector<std::string> args = args_;
+    if (args.empty()) args = SelfArgs();
+    const int port = FreePort();
+    std::vector<pid_t> pids;
+    pids.push_back(Spawn(args, run, "scheduler", port));
+    for (int i = 0; i < num_servers_; ++i) pids.push_back(Spawn(args, run, "server", port));
+    for (int i = 0; i < num_workers_; ++i) pids.push_back(Spawn(args, run, "worker", port));
+    int num_failed = 0;
+    for (pid_t pid : pids) {
+      int status = 0;
+      while (waitpid(pid, &status, 0) == -1 && errno == EINTR) {}
+      if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) ++num_failed;
+    }
+    return num_failed;
+#else
+    LOG(FATAL) << "LoopbackCluster is not supported on Windows";
+    return num_servers_ + num_workers_ + 1;
+#endif
+  }
+
+ private:
+#ifndef _WIN32
+  // play the role given by DMLC_ROLE and exit
+  static void RunNode(const Worker& worker) {
+    if (KVStore::IsWorkerNode()) {
+      worker();
+    } else {
+      std::unique_ptr<KVStore> kv(KVStore::Create("dist"));
+      kv->RunServer([](int, const std::string&) {});
+    }
+    std::cout.flush();
+    std::fflush(nullptr);
+    _exit(0);
+  }
+
+  // start a node, with the environment of this process and the cluster
+  pid_t Spawn(const std::vector<std::string>& args, int run, const std::string& role,
+              int port) {
+    std::vector<std::pair<std::string, std::string> > vars = {
+      {"MXNET_KVSTORE_LOOPBACK", std::to_string(run)},
+      {"DMLC_ROLE", role},
+      {"DMLC_PS_ROOT_URI", "127.0.0.1"},
+      {"DMLC_PS_ROOT_PORT", std::to_string(port)},
+      {"DMLC_NODE_HOST", "127.0.0.1"},
+      {"DMLC_NUM_SERVER", std::to_string(num_servers_)},
+      {"DMLC_NUM_WORKER", std::to_string(num_workers_)}};
+    vars.insert(vars.end(), env_.begin(), env_.end());
+    std::vector<std::string> env;
+    for (char** e = environ; *e != nullptr; ++e) {
+      const std::string entry(*e);
+      bool overridden = false;
+      for (const auto& var : vars) {
+        overridden = overridden || entry.compare(0, var.first.size() + 1, var.first + "=") == 0;
+      }
+      if (!overridden) env.push_back(entry);
+    }
+    for (const auto& var : vars) env.push_back(var.first + "=" + var.second);
+    // build the arrays before forking, the child only calls execve
+    std::vector<char*> argv, envp;
+    for (const std::string& arg : args) argv.push_back(const_cast<char*>(arg.c_str()));
+    argv.push_back(nullptr);
+    for (const std::string& var : env) envp.push_back(const_cast<char*>(var.c_str()));
+    envp.push_back(nullptr);
+    pid_t pid = fork();
+    CHECK_NE(pid, -1) << "Failed to fork: " << strerror(errno);
+    if (pid == 0) {
+      execve("/proc/self/exe", argv.data(), envp.data());
+      _exit(127);
+    }
+    return pid;
+  }
+
+  // command line of this process
+  static std::vector<std::string> SelfArgs() {
+    std::ifstream is("/proc/self/cmdline");
+    std::string cmdline((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+    std::vector<std::string> args;
+    size_t begin = 0;
+    for (size_t i = 0; i < cmdline.size(); ++i) {
+      if (cmdline[i] == '\0') {
+        args.push_back(cmdline.substr(begin, i - begin));
+        begin = i + 1;
+      }
+    }
+    return args;
+  }
+
+  // a port of 127.0.0.1 that is free now, for the scheduler
+  static int FreePort() {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    CHECK_NE(fd, -1) << "Failed to create a socket: " << strerror(errno);
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    socklen_t len = sizeof(addr);
+    CHECK_EQ(bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0)
+        << "Failed to bind a socket: " << strerror(errno);
+    CHECK_EQ(getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len), 0);
+    close(fd);
+    return ntohs(addr.sin_port);
+  }
+#endif
+
+  int num_servers_, num_workers_;
+  std::vector<std::pair<std::string, std::string> > env_;
+  std::vector<std::string> args_;
+};
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_KVSTORE_LOOPBACK_H_
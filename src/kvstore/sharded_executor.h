@@ -0,0 +1,143 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file sharded_executor.h
+ * \brief run functions on a pool of threads, keeping the order within a shard
+ */
+#ifndef MXNET_KVSTORE_SHARDED_EXECUTOR_H_
+#define MXNET_KVSTORE_SHARDED_EXECUTOR_H_
+#include <dmlc/logging.h>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace mxnet {
+namespace kvstore {
+
+/**
+ * \brief executor that runs functions on a fixed pool of threads. Each shard
+ *  is served by one thread, so functions of the same shard run one at a time
+ *  in the order they were submitted, while different shards run in parallel.
+ */
+class ShardedExecutor {
+ public:
+  /**
+   * \brief function
+   */
+  typedef std::function<void()> Func;
+
+  /**
+   * \brief start the threads
+   * \param num_threads number of threads, shards are spread over them
+   */
+  explicit ShardedExecutor(int num_threads) {
+    CHECK_GT(num_threads, 0);
+    for (int i = 0; i < num_threads; ++i) {
+      queues_.emplace_back(new Queue());
+    }
+    for (int i = 0; i < num_threads; ++i) {
+      Queue* queue = queues_[i].get();
+      threads_.emplace_back([queue]() { Run(queue); });
+    }
+  }
+
+  ~ShardedExecutor() {
+    Stop();
+  }
+
+  /**
+   * \brief number of threads
+   */
+  int num_threads() const {
+    return static_cast<int>(queues_.size());
+  }
+
+  /**
+   * \brief queue a function on the thread of a shard, returns immediately. threadsafe
+   */
+  void Exec(size_t shard, const Func& func) {
+    Queue* queue = queues_[shard % queues_.size()].get();
+    std::lock_guard<std::mutex> lk(queue->mu);
+    CHECK(!queue->stop) << "ShardedExecutor is stopped";
+    queue->funcs.push(func);
+    queue->cond.notify_one();
+  }
+
+  /**
+   * \brief block until the functions queued so far have run. threadsafe
+   */
+  void Wait() {
+    for (auto& queue : queues_) {
+      std::unique_lock<std::mutex> lk(queue->mu);
+      queue->idle.wait(lk, [&queue]() { return queue->funcs.empty() && !queue->running; });
+    }
+  }
+
+  /**
+   * \brief run the queued functions, then stop the threads
+   */
+  void Stop() {
+    for (auto& queue : queues_) {
+      std::lock_guard<std::mutex> lk(queue->mu);
+      queue->stop = true;
+      queue->cond.notify_one();
+    }
+    for (std::thread& thread : threads_) {
+      if (thread.joinable()) thread.join();
+    }
+  }
+
+ private:
+  struct Queue {
+    std::mutex mu;
+    std::condition_variable cond, idle;
+    std::queue<Func> funcs;
+    bool running{false};
+    bool stop{false};
+  };
+
+  static void Run(Queue* queue) {
+    std::unique_lock<std::mutex> lk(queue->mu);
+    while (true) {
+      queue->cond.wait(lk, [queue]() { return !queue->funcs.empty() || queue->stop; });
+      if (queue->funcs.empty()) break;
+      Func func = std::move(queue->funcs.front());
+      queue->funcs.pop();
+      queue->running = true;
+      lk.unlock();
+      func();
+      lk.lock();
+      queue->running = false;
+      if (queue->funcs.empty()) queue->idle.notify_all();
+    }
+  }
+
+  std::vector<std::unique_ptr<Queue> > queues_;
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace kvstore
+}  // namespace mxnet
+#endif  // MXNET_KVSTORE_SHARDED_EXECUTOR_H_
@@ -23,6 +23,7 @@
 #include <string>
 #include <vector>
 #include "./profiler.h"
+#include "../storage/storage_manager.h"
 
 namespace mxnet {
 namespace storage {
@@ -71,6 +72,25 @@ class DeviceStorageProfiler {
     }
   }
 
+  /*!
+   * \brief Called after an allocation or deallocation in order to record pool occupancy
+   * \param ctx Context of the device owning the pool
+   * \param manager Storage manager of the device
+   */
+  void OnPoolUpdate(const Context &ctx, StorageManager *manager) {
+    profiler::Profiler *prof = profiler::Profiler::Get();
+    if (prof->IsProfiling(profiler::Profiler::kMemory)) {
+      size_t used_bytes, pooled_bytes;
+      if (manager->GetPoolStats(&used_bytes, &pooled_bytes)) {
+        Init();
+        const size_t idx = prof->DeviceIndex(ctx.dev_type, ctx.dev_id);
+        CHECK_LT(idx, pool_used_counters_.size()) << "Invalid device index: " << idx;
+        *pool_used_counters_[idx] = used_bytes;
+        *pool_free_counters_[idx] = pooled_bytes;
+      }
+    }
+  }
+
  private:
   /*!
    * \brief Lazy initialization.  No locks occur except for on the first pass
@@ -83,6 +103,19 @@ class DeviceStorageProfiler {
       if (mem_counters_.empty()) {
         profiler::Profiler *prof = profiler::Profiler::Get();
         const size_t device_count = prof->DeviceCount();
+        pool_used_counters_.reserve(device_count);
+        pool_free_counters_.reserve(device_count);
+        for (size_t i = 0, n = device_count; i < n; ++i) {
+          std::string name = "Pool Used: ";
+          name += prof->DeviceName(i);
+          pool_used_counters_.emplace_back(
+            std::make_shared<profiler::ProfileCounter>(name.c_str(), &domain_));
+          name = "Pool Free: ";
+          name += prof->DeviceName(i);
+          pool_free_counters_.emplace_back(
+            std::make_shared<profiler::ProfileCounter>(name.c_str(), &domain_));
+        }
+        // filled last, as its emptiness guards the lazy init
         mem_counters_.reserve(device_count);
         for (size_t i = 0, n = device_count; i < n; ++i) {
           std::string name = "Memory: ";
@@ -100,6 +133,10 @@ class DeviceStorageProfiler {
   std::mutex init_mutex_;
   /*! \brief Constant-sized vector of memory profile counters */
   std::vector<std::shared_ptr<profiler::ProfileCounter>> mem_counters_;
+  /*! \brief Bytes held by each device's memory pool, including cached chunks */
+  std::vector<std::shared_ptr<profiler::ProfileCounter>> pool_used_counters_;
+  /*! \brief Bytes cached for reuse in each device's memory pool */
+  std::vector<std::shared_ptr<profiler::ProfileCounter>> pool_free_counters_;
 };
 
 }  // namespace storage
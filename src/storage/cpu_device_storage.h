@@ -44,6 +44,12 @@ class CPUDeviceStorage {
    * \return Pointer to the storage.
    */
   inline static void* Alloc(size_t size);
+  /*!
+   * \brief Aligned allocation on CPU which reports failure instead of aborting.
+   * \param size Size to allocate.
+   * \return Pointer to the storage, or nullptr if the allocation failed.
+   */
+  inline static void* TryAlloc(size_t size);
   /*!
    * \brief Deallocation.
    * \param ptr Pointer to deallocate.
@@ -64,13 +70,18 @@ class CPUDeviceStorage {
 };  // class CPUDeviceStorage
 
 inline void* CPUDeviceStorage::Alloc(size_t size) {
+  void* ptr = TryAlloc(size);
+  if (ptr == nullptr && size != 0) LOG(FATAL) << "Failed to allocate CPU Memory";
+  return ptr;
+}
+
+inline void* CPUDeviceStorage::TryAlloc(size_t size) {
   void* ptr;
 #if _MSC_VER
   ptr = _aligned_malloc(size, alignment_);
-  if (ptr == NULL) LOG(FATAL) << "Failed to allocate CPU Memory";
 #else
   int ret = posix_memalign(&ptr, alignment_, size);
-  if (ret != 0) LOG(FATAL) << "Failed to allocate CPU Memory";
+  if (ret != 0) ptr = nullptr;
 #endif
   return ptr;
 }
@@ -33,11 +33,14 @@
 #include <mxnet/storage.h>
 #include <unordered_map>
 #include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <vector>
 #include <mutex>
 #include <new>
 #include "./storage_manager.h"
 #include "../common/cuda_utils.h"
+#include "../common/numa.h"
 #include "../common/utils.h"
 
 
@@ -66,7 +69,7 @@ class GPUPooledStorageManager final : public StorageManager {
    * \brief Default destructor.
    */
   ~GPUPooledStorageManager() {
-    ReleaseAll();
+    ReleaseAllNoLock();
   }
 
   void Alloc(Storage::Handle* handle) override;
@@ -77,6 +80,11 @@ class GPUPooledStorageManager final : public StorageManager {
     DirectFreeNoLock(handle);
   }
 
+  void ReleaseAll() override {
+    std::lock_guard<std::mutex> lock(Storage::Get()->GetMutex(Context::kGPU));
+    ReleaseAllNoLock();
+  }
+
  private:
   void DirectFreeNoLock(Storage::Handle handle) {
     cudaError_t err = cudaFree(handle.dptr);
@@ -89,7 +97,7 @@ class GPUPooledStorageManager final : public StorageManager {
   }
 
  private:
-  void ReleaseAll();
+  void ReleaseAllNoLock();
   // used memory
   size_t used_memory_ = 0;
   // page size
@@ -111,7 +119,7 @@ void GPUPooledStorageManager::Alloc(Storage::Handle* handle) {
     size_t free, total;
     cudaMemGetInfo(&free, &total);
     if (free <= total * reserve_ / 100 || size > free - total * reserve_ / 100)
-      ReleaseAll();
+      ReleaseAllNoLock();
 
     void* ret = nullptr;
     cudaError_t e = cudaMalloc(&ret, size);
@@ -135,7 +143,7 @@ void GPUPooledStorageManager::Free(Storage::Handle handle) {
   reuse_pool.push_back(handle.dptr);
 }
 
-void GPUPooledStorageManager::ReleaseAll() {
+void GPUPooledStorageManager::ReleaseAllNoLock() {
   for (auto&& i : memory_pool_) {
     for (auto&& j : i.second) {
       Storage::Handle handle;
@@ -194,7 +202,7 @@ class GPUPooledRoundedStorageManager final : public StorageManager {
    * \brief Default destructor.
    */
   ~GPUPooledRoundedStorageManager() {
-    ReleaseAll();
+    ReleaseAllNoLock();
   }
 
   void Alloc(Storage::Handle* handle) override;
@@ -205,6 +213,11 @@ class GPUPooledRoundedStorageManager final : public StorageManager {
     DirectFreeNoLock(handle);
   }
 
+  void ReleaseAll() override {
+    std::lock_guard<std::mutex> lock(Storage::Get()->GetMutex(Context::kGPU));
+    ReleaseAllNoLock();
+  }
+
  private:
   inline int div_pow2_round_up(size_t s, int divisor_log2) {
     // (1025, 10) -> 2
@@ -238,7 +251,7 @@ class GPUPooledRoundedStorageManager final : public StorageManager {
   }
 
  private:
-  void ReleaseAll();
+  void ReleaseAllNoLock();
   // number of devices
   const int NDEV = 32;
   // log2 of maximum page size. 16GB
@@ -267,7 +280,7 @@ void GPUPooledRoundedStorageManager::Alloc(Storage::Handle* handle) {
     size_t free, total;
     cudaMemGetInfo(&free, &total);
     if (free <= total * reserve_ / 100 || size > free - total * reserve_ / 100)
-      ReleaseAll();
+      ReleaseAllNoLock();
 
     void* ret = nullptr;
     cudaError_t e = cudaMalloc(&ret, size);
@@ -290,7 +303,7 @@ void GPUPooledRoundedStorageManager::Free(Storage::Handle handle) {
   reuse_pool.push_back(handle.dptr);
 }
 
-void GPUPooledRoundedStorageManager::ReleaseAll() {
+void GPUPooledRoundedStorageManager::ReleaseAllNoLock() {
   for (size_t i = 0; i < memory_pool_.size(); i++) {
     int size = get_size(i);
     for (auto& j : memory_pool_[i]) {
@@ -305,6 +318,224 @@ void GPUPooledRoundedStorageManager::ReleaseAll() {
 
 #endif  // MXNET_USE_CUDA
 
+/*!
+ * \brief Storage manager with a memory pool on cpu. Memory chunks are cached in size-class
+ * buckets and handed out again instead of going back to the allocator.
+ *
+ * Two bucketing strategies are supported, selected through MXNET_CPU_MEM_POOL_TYPE:
+ *  - "Naive": exact size match after rounding up to MXNET_CPU_MEM_POOL_PAGE_SIZE, as in
+ *    GPUPooledStorageManager.
+ *  - "Round": nearest pow2 rounding up to 2^MXNET_CPU_MEM_POOL_ROUND_LINEAR_CUTOFF and
+ *    nearest multiple of it beyond, as in GPUPooledRoundedStorageManager.
+ *
+ * The pool never caches more than MXNET_CPU_MEM_POOL_LIMIT megabytes (0 means unbounded);
+ * chunks freed beyond that are returned directly. All cached chunks are released when an
+ * allocation fails, or when available system memory falls below MXNET_CPU_MEM_POOL_RESERVE
+ * percent of the total. Available memory is MemAvailable from /proc/meminfo, re-read at most
+ * every MXNET_CPU_MEM_POOL_RESERVE_INTERVAL milliseconds or kMissesPerCheck pool misses.
+ *
+ * With NUMA-aware placement, one pool is created per node and freshly allocated chunks are
+ * bound to that node, so reused chunks never cross sockets. Each pool has its own lock, so
+ * workers of different nodes do not contend on allocation.
+ */
+template <class DeviceStorage>
+class CPUPooledStorageManager final : public StorageManager {
+ public:
+  /*!
+   * \brief Constructor.
+   * \param rounded whether to use rounded size classes instead of exact size match.
+   * \param numa_node NUMA node new chunks are bound to, or -1 for no binding.
+   */
+  explicit CPUPooledStorageManager(bool rounded, int numa_node = -1)
+    : rounded_(rounded), numa_node_(numa_node) {
+    reserve_ = dmlc::GetEnv("MXNET_CPU_MEM_POOL_RESERVE", 5);
+    limit_ = dmlc::GetEnv("MXNET_CPU_MEM_POOL_LIMIT", static_cast<size_t>(0)) << 20;
+    page_size_ = dmlc::GetEnv("MXNET_CPU_MEM_POOL_PAGE_SIZE", 4096);
+    cut_off_ = dmlc::GetEnv("MXNET_CPU_MEM_POOL_ROUND_LINEAR_CUTOFF", 24);
+    check_interval_ = std::chrono::milliseconds(
+        dmlc::GetEnv("MXNET_CPU_MEM_POOL_RESERVE_INTERVAL", 100));
+    if (page_size_ < 32 || page_size_ != 1ul << common::ilog2ul(page_size_ - 1)) {
+      LOG(FATAL) << "MXNET_CPU_MEM_POOL_PAGE_SIZE must be a power of 2 no smaller than 32. "
+                 << "Got: " << page_size_ << ".";
+    }
+    if (cut_off_ < 20 || cut_off_ > LOG2_MAX_MEM) {
+      LOG(FATAL) << "MXNET_CPU_MEM_POOL_ROUND_LINEAR_CUTOFF cannot be set to a value "
+                 << "smaller than 20 or greater than " << LOG2_MAX_MEM << ". Got: "
+                 << cut_off_ << ".";
+    }
+  }
+  /*!
+   * \brief Default destructor.
+   */
+  ~CPUPooledStorageManager() {
+    ReleaseAllNoLock();
+  }
+
+  void Alloc(Storage::Handle* handle) override;
+  void Free(Storage::Handle handle) override;
+
+  void DirectFree(Storage::Handle handle) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    DirectFreeNoLock(handle.dptr, RoundSize(handle.size));
+  }
+
+  void ReleaseAll() override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ReleaseAllNoLock();
+  }
+
+  bool GetPoolStats(size_t* used_bytes, size_t* pooled_bytes) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    *used_bytes = used_memory_;
+    *pooled_bytes = pooled_memory_;
+    return true;
+  }
+
+ private:
+  inline size_t RoundSize(size_t s) const {
+    if (!rounded_) {
+      return (std::max(s, page_size_) + page_size_ - 1) & ~(page_size_ - 1);
+    }
+    if (s <= page_size_) return page_size_;
+    size_t log_size = common::ilog2ul(s - 1);
+    if (log_size <= cut_off_) return 1ul << log_size;
+    // nearest multiple of 2^cut_off_
+    return ((s + (1ul << cut_off_) - 1) >> cut_off_) << cut_off_;
+  }
+
+  /*!
+   * \brief Whether allocating size bytes would leave less than reserve_ percent of system
+   *  memory available. Between two reads of /proc/meminfo, the bytes allocated on pool
+   *  misses are deducted from the last reading.
+   */
+  inline bool UnderPressure(size_t size) {
+    auto now = std::chrono::steady_clock::now();
+    if (misses_ >= kMissesPerCheck || now - checked_at_ >= check_interval_) {
+      if (!ReadMemInfo(&mem_total_, &mem_available_)) mem_total_ = 0;
+      checked_at_ = now;
+      misses_ = 0;
+    }
+    ++misses_;
+    if (mem_total_ == 0) return false;
+    size_t reserve = mem_total_ * reserve_ / 100;
+    bool pressure = mem_available_ <= reserve || size > mem_available_ - reserve;
+    mem_available_ -= std::min(size, mem_available_);
+    return pressure;
+  }
+
+  /*!
+   * \brief Read MemTotal and MemAvailable in bytes from /proc/meminfo.
+   * \return false if either is missing, e.g. outside Linux or on kernels before 3.14.
+   */
+  static bool ReadMemInfo(size_t* total, size_t* available) {
+    FILE* fp = std::fopen("/proc/meminfo", "r");
+    if (fp == nullptr) return false;
+    char line[256];
+    unsigned long kb;  // NOLINT(runtime/int)
+    int found = 0;
+    while (found != 3 && std::fgets(line, sizeof(line), fp) != nullptr) {
+      if (std::sscanf(line, "MemTotal: %lu kB", &kb) == 1) {
+        *total = static_cast<size_t>(kb) << 10;
+        found |= 1;
+      } else if (std::sscanf(line, "MemAvailable: %lu kB", &kb) == 1) {
+        *available = static_cast<size_t>(kb) << 10;
+        found |= 2;
+      }
+    }
+    std::fclose(fp);
+    return found == 3;
+  }
+
+  void DirectFreeNoLock(void* dptr, size_t size) {
+    DeviceStorage::Free(dptr);
+    used_memory_ -= size;
+  }
+
+  void ReleaseAllNoLock() {
+    for (auto&& i : memory_pool_) {
+      for (auto&& j : i.second) {
+        DirectFreeNoLock(j, i.first);
+      }
+    }
+    memory_pool_.clear();
+    pooled_memory_ = 0;
+  }
+
+  // log2 of maximum chunk size. 16GB
+  const size_t LOG2_MAX_MEM = 34;
+  // whether size classes are rounded or exact
+  const bool rounded_;
+  // NUMA node owning this pool, -1 if none
+  const int numa_node_;
+  // bytes obtained from the device, including cached chunks
+  size_t used_memory_ = 0;
+  // bytes cached in the pool
+  size_t pooled_memory_ = 0;
+  // maximum number of bytes cached in the pool, 0 for no limit
+  size_t limit_;
+  // page size
+  size_t page_size_;
+  // log2 of memory size before switching from exponential to linear rounding
+  size_t cut_off_;
+  // percentage of system memory to keep available
+  int reserve_;
+  // pool misses after which /proc/meminfo is re-read regardless of check_interval_
+  static const int kMissesPerCheck = 64;
+  // minimum time between two reads of /proc/meminfo
+  std::chrono::steady_clock::duration check_interval_;
+  // time of the last read of /proc/meminfo
+  std::chrono::steady_clock::time_point checked_at_;
+  // pool misses since the last read
+  int misses_ = kMissesPerCheck;
+  // system memory in bytes, 0 if unknown
+  size_t mem_total_ = 0;
+  // available system memory in bytes, less the bytes allocated since the last read
+  size_t mem_available_ = 0;
+  // memory pool, keyed by rounded size
+  std::unordered_map<size_t, std::vector<void*>> memory_pool_;
+  // protects the pool and the counters above
+  std::mutex mutex_;
+  DISALLOW_COPY_AND_ASSIGN(CPUPooledStorageManager);
+};  // class CPUPooledStorageManager
+
+template <class DeviceStorage>
+void CPUPooledStorageManager<DeviceStorage>::Alloc(Storage::Handle* handle) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t size = RoundSize(handle->size);
+  auto&& reuse_it = memory_pool_.find(size);
+  if (reuse_it != memory_pool_.end() && reuse_it->second.size() != 0) {
+    auto&& reuse_pool = reuse_it->second;
+    handle->dptr = reuse_pool.back();
+    reuse_pool.pop_back();
+    pooled_memory_ -= size;
+    return;
+  }
+  if (pooled_memory_ > 0 && UnderPressure(size)) ReleaseAllNoLock();
+  void* ret = DeviceStorage::TryAlloc(size);
+  if (ret == nullptr && pooled_memory_ > 0) {
+    ReleaseAllNoLock();
+    ret = DeviceStorage::TryAlloc(size);
+  }
+  if (ret == nullptr) {
+    LOG(FATAL) << "Failed to allocate CPU Memory of size " << size << " bytes";
+  }
+  if (numa_node_ >= 0) common::NUMATopology::Get()->BindMemory(ret, size, numa_node_);
+  used_memory_ += size;
+  handle->dptr = ret;
+}
+
+template <class DeviceStorage>
+void CPUPooledStorageManager<DeviceStorage>::Free(Storage::Handle handle) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t size = RoundSize(handle.size);
+  if (limit_ != 0 && pooled_memory_ + size > limit_) {
+    DirectFreeNoLock(handle.dptr, size);
+    return;
+  }
+  memory_pool_[size].push_back(handle.dptr);
+  pooled_memory_ += size;
+}
+
 }  // namespace storage
 }  // namespace mxnet
 
@@ -28,6 +28,7 @@
 #include "./cpu_device_storage.h"
 #include "./pinned_memory_storage.h"
 #include "../common/lazy_alloc_array.h"
+#include "../common/numa.h"
 #include "../profiler/storage_profiler.h"
 
 namespace mxnet {
@@ -39,6 +40,7 @@ class StorageImpl : public Storage {
   void Free(Handle handle) override;
   void DirectFree(Handle handle) override;
   void SharedIncrementRefCount(Handle handle) override;
+  void ReleaseAll(Context ctx) override;
   StorageImpl() {}
   virtual ~StorageImpl() = default;
 
@@ -48,6 +50,17 @@ class StorageImpl : public Storage {
   static int num_gpu_device;
 #endif  // MXNET_USE_CUDA
 
+  /*!
+   * \brief Index of the storage manager serving a context. With NUMA-aware placement
+   *  every node has its own CPU arena, otherwise all CPU contexts share one.
+   */
+  static int ManagerIndex(const Context& ctx) {
+    if (ctx.dev_type == Context::kCPU && common::NUMATopology::Get()->enabled()) {
+      return common::NUMATopology::Get()->NodeOf(ctx);
+    }
+    return ctx.real_dev_id();
+  }
+
   static void ActivateDevice(Context ctx) {
     switch (ctx.dev_type) {
       case Context::kCPU:
@@ -84,11 +97,31 @@ void StorageImpl::Alloc(Storage::Handle* handle) {
   // space already recycled, ignore request
   auto&& device = storage_managers_.at(handle->ctx.dev_type);
   std::shared_ptr<storage::StorageManager> manager = device.Get(
-      handle->ctx.real_dev_id(), [handle]() {
+      ManagerIndex(handle->ctx), [handle]() {
         storage::StorageManager *ptr = nullptr;
         switch (handle->ctx.dev_type) {
           case Context::kCPU: {
-            ptr = new storage::NaiveStorageManager<storage::CPUDeviceStorage>();
+            // NUMA arenas are pooled by default so that each chunk is only bound once;
+            // unpooled arenas rely on first touch from the node's pinned workers.
+            const bool numa = common::NUMATopology::Get()->enabled();
+            const int numa_node = numa ? ManagerIndex(handle->ctx) : -1;
+            const char *type = getenv("MXNET_CPU_MEM_POOL_TYPE");
+            std::string strategy = type != nullptr ? type : (numa ? "Naive" : "Unpooled");
+
+            if (strategy == "Round") {
+              ptr = new storage::CPUPooledStorageManager<storage::CPUDeviceStorage>(
+                  true, numa_node);
+              LOG(INFO) << "Using CPUPooledStorageManager with rounded size classes.";
+            } else if (strategy == "Naive") {
+              ptr = new storage::CPUPooledStorageManager<storage::CPUDeviceStorage>(
+                  false, numa_node);
+              LOG(INFO) << "Using CPUPooledStorageManager.";
+            } else {
+              if (strategy != "Unpooled") {
+                LOG(FATAL) << "Unknown CPU memory pool strategy specified: " << strategy << ".";
+              }
+              ptr = new storage::NaiveStorageManager<storage::CPUDeviceStorage>();
+            }
             break;
           }
           case Context::kCPUShared: {
@@ -146,32 +179,47 @@ void StorageImpl::Alloc(Storage::Handle* handle) {
   this->ActivateDevice(handle->ctx);
   manager->Alloc(handle);
   profiler_.OnAlloc(*handle);
+  profiler_.OnPoolUpdate(handle->ctx, manager.get());
 }
 
 void StorageImpl::Free(Storage::Handle handle) {
   const Context &ctx = handle.ctx;
   auto&& device = storage_managers_.at(ctx.dev_type);
   std::shared_ptr<storage::StorageManager> manager = device.Get(
-      ctx.real_dev_id(), []() {
+      ManagerIndex(ctx), []() {
         LOG(FATAL) <<  "Cannot Free space to a device you have not allocated";
         return nullptr;
       });
   this->ActivateDevice(ctx);
   manager->Free(handle);
   profiler_.OnFree(handle);
+  profiler_.OnPoolUpdate(ctx, manager.get());
 }
 
 void StorageImpl::DirectFree(Storage::Handle handle) {
   const Context &ctx = handle.ctx;
   auto&& device = storage_managers_.at(ctx.dev_type);
   std::shared_ptr<storage::StorageManager> manager = device.Get(
-      ctx.real_dev_id(), []() {
+      ManagerIndex(ctx), []() {
         LOG(FATAL) <<  "Cannot Free space to a device you have not allocated";
         return nullptr;
       });
   this->ActivateDevice(ctx);
   manager->DirectFree(handle);
   profiler_.OnFree(handle);
+  profiler_.OnPoolUpdate(ctx, manager.get());
+}
+
+void StorageImpl::ReleaseAll(Context ctx) {
+  auto&& device = storage_managers_.at(ctx.dev_type);
+  std::shared_ptr<storage::StorageManager> manager = device.Get(
+      ManagerIndex(ctx), []() {
+        LOG(FATAL) << "Cannot release memory of a device you have not allocated";
+        return nullptr;
+      });
+  this->ActivateDevice(ctx);
+  manager->ReleaseAll();
+  profiler_.OnPoolUpdate(ctx, manager.get());
 }
 
 void StorageImpl::SharedIncrementRefCount(Storage::Handle handle) {
@@ -55,6 +55,20 @@ class StorageManager {
    * \param size Size of the storage.
    */
   virtual void DirectFree(Storage::Handle handle) = 0;
+  /*!
+   * \brief Return all cached chunks to the device.
+   *  Managers which do not pool memory have nothing to release.
+   */
+  virtual void ReleaseAll() {}
+  /*!
+   * \brief Query pool occupancy.
+   * \param used_bytes Bytes currently obtained from the device, including cached chunks.
+   * \param pooled_bytes Bytes currently cached in the pool for reuse.
+   * \return Whether the manager pools memory at all.
+   */
+  virtual bool GetPoolStats(size_t* used_bytes, size_t* pooled_bytes) {
+    return false;
+  }
   /*!
    * \brief Destructor.
    */
@@ -0,0 +1,105 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file engine_perf.cc
+ * \brief Push-to-execute latency and throughput of the threaded engines on small CPU ops
+ */
+#include <gtest/gtest.h>
+#include <dmlc/logging.h>
+#include <mxnet/engine.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "../src/engine/engine_impl.h"
+#include "../include/test_util.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct EnginePerfResult {
+  /*! \brief operations executed per second */
+  double ops_per_sec;
+  /*! \brief mean time between push and start of execution, in microseconds */
+  double mean_latency_us;
+};
+
+/*!
+ * \brief Push num_ops tiny ops on CPU, each writing one of num_vars variables round-robin,
+ *  so that up to num_vars ops are independent at any time.
+ */
+EnginePerfResult RunEnginePerf(mxnet::Engine *engine, int num_ops, int num_vars) {
+  using namespace mxnet;
+  std::vector<Engine::VarHandle> vars;
+  for (int i = 0; i < num_vars; ++i) {
+    vars.push_back(engine->NewVariable());
+  }
+  std::vector<int64_t> latency_ns(num_ops, 0);
+  std::atomic<int> executed(0);
+  const Clock::time_point start = Clock::now();
+  for (int i = 0; i < num_ops; ++i) {
+    const Clock::time_point pushed = Clock::now();
+    engine->PushSync([i, pushed, &latency_ns, &executed](RunContext ctx) {
+        latency_ns[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now() - pushed).count();
+        ++executed;
+      }, Context::CPU(), {}, {vars[i % num_vars]}, FnProperty::kNormal, 0, "EnginePerfOp");
+  }
+  engine->WaitForAll();
+  const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+  EXPECT_EQ(executed.load(), num_ops);
+  for (auto var : vars) {
+    engine->DeleteVariable([](RunContext) {}, Context::CPU(), var);
+  }
+  engine->WaitForAll();
+  double total_latency = 0;
+  for (int64_t l : latency_ns) total_latency += l;
+  return {num_ops / elapsed, total_latency / num_ops / 1000.0};
+}
+
+}  // namespace
+
+/*!
+ * \brief Compare engines on many small independent and dependent CPU ops
+ */
+TEST(ENGINE_PERF, SmallOpThroughput) {
+  const int num_ops = mxnet::test::performance_run ? 1000000 : 20000;
+  const std::vector<int> num_vars = {1, 8, 64};
+  const std::vector<std::string> names = {"ThreadedEnginePooled", "ThreadedEnginePerDevice",
+                                          "ThreadedEngineWorkStealing"};
+  std::vector<mxnet::Engine*> engines = {
+    mxnet::engine::CreateThreadedEnginePooled(),
+    mxnet::engine::CreateThreadedEnginePerDevice(),
+    mxnet::engine::CreateThreadedEngineWorkStealing()
+  };
+  for (int nvar : num_vars) {
+    for (size_t i = 0; i < engines.size(); ++i) {
+      // warm up thread pools and object pools
+      RunEnginePerf(engines[i], num_ops / 10, nvar);
+      const EnginePerfResult res = RunEnginePerf(engines[i], num_ops, nvar);
+      LOG(INFO) << names[i] << "\tvars: " << nvar
+                << "\tops/sec: " << res.ops_per_sec
+                << "\tpush-to-execute: " << res.mean_latency_us << " us";
+    }
+  }
+}
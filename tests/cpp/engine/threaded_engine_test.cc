@@ -122,12 +122,14 @@ double EvaluateWorloads(const std::vector<Workload>& workloads,
 }
 
 TEST(Engine, start_stop) {
-  const int num_engine = 3;
+  const int num_engine = 4;
   std::vector<mxnet::Engine*> engine(num_engine);
   engine[0] = mxnet::engine::CreateNaiveEngine();
   engine[1] = mxnet::engine::CreateThreadedEnginePooled();
   engine[2] = mxnet::engine::CreateThreadedEnginePerDevice();
-  std::string type_names[3] = {"NaiveEngine", "ThreadedEnginePooled", "ThreadedEnginePerDevice"};
+  engine[3] = mxnet::engine::CreateThreadedEngineWorkStealing();
+  std::string type_names[4] = {"NaiveEngine", "ThreadedEnginePooled", "ThreadedEnginePerDevice",
+                               "ThreadedEngineWorkStealing"};
 
   for (int i = 0; i < num_engine; ++i) {
     LOG(INFO) << "Stopping: " << type_names[i];
@@ -141,7 +143,7 @@ TEST(Engine, start_stop) {
 TEST(Engine, RandSumExpr) {
   std::vector<Workload> workloads;
   int num_repeat = 5;
-  const int num_engine = 4;
+  const int num_engine = 5;
 
   std::vector<double> t(num_engine, 0.0);
   std::vector<mxnet::Engine*> engine(num_engine);
@@ -150,6 +152,7 @@ TEST(Engine, RandSumExpr) {
   engine[1] = mxnet::engine::CreateNaiveEngine();
   engine[2] = mxnet::engine::CreateThreadedEnginePooled();
   engine[3] = mxnet::engine::CreateThreadedEnginePerDevice();
+  engine[4] = mxnet::engine::CreateThreadedEngineWorkStealing();
 
   for (int repeat = 0; repeat < num_repeat; ++repeat) {
     srand(time(NULL) + repeat);
@@ -172,6 +175,55 @@ TEST(Engine, RandSumExpr) {
   LOG(INFO) << "NaiveEngine\t\t"  << t[1] << " sec";
   LOG(INFO) << "ThreadedEnginePooled\t" << t[2] << " sec";
   LOG(INFO) << "ThreadedEnginePerDevice\t" << t[3] << " sec";
+  LOG(INFO) << "ThreadedEngineWorkStealing\t" << t[4] << " sec";
+}
+
+/*!
+ * \brief Bulked ops must keep the order of dependent ops, whether their chains
+ *  are pushed as separate engine ops or as one.
+ */
+TEST(Engine, BulkDependencyGroups) {
+  const int num_engine = 3;
+  std::vector<mxnet::Engine*> engine(num_engine);
+  engine[0] = mxnet::engine::CreateThreadedEnginePooled();
+  engine[1] = mxnet::engine::CreateThreadedEnginePerDevice();
+  engine[2] = mxnet::engine::CreateThreadedEngineWorkStealing();
+  const int chain_length = 6;
+
+  for (int i = 0; i < num_engine; ++i) {
+    // two independent chains, then an op joining them and a short chain on its result
+    std::vector<int> data(3, 0);
+    std::vector<mxnet::Engine::VarHandle> vars(3);
+    for (auto& var : vars) var = engine[i]->NewVariable();
+    const int old_bulk_size = engine[i]->set_bulk_size(4 * chain_length);
+    for (int step = 0; step < chain_length; ++step) {
+      for (int c = 0; c < 2; ++c) {
+        engine[i]->PushSync([&data, c, step](mxnet::RunContext) {
+            EXPECT_EQ(data[c], step);
+            ++data[c];
+          }, mxnet::Context::CPU(), {}, {vars[c]});
+      }
+    }
+    engine[i]->PushSync([&data](mxnet::RunContext) {
+        data[2] = data[0] + data[1];
+      }, mxnet::Context::CPU(), {vars[0], vars[1]}, {vars[2]});
+    engine[i]->PushSync([&data](mxnet::RunContext) {
+        data[0] = -1;
+      }, mxnet::Context::CPU(), {}, {vars[0]});
+    engine[i]->PushSync([&data](mxnet::RunContext) {
+        data[2] *= 2;
+      }, mxnet::Context::CPU(), {}, {vars[2]});
+    engine[i]->set_bulk_size(old_bulk_size);
+    engine[i]->WaitForAll();
+
+    EXPECT_EQ(data[0], -1);
+    EXPECT_EQ(data[1], chain_length);
+    EXPECT_EQ(data[2], 4 * chain_length);
+    for (auto var : vars) {
+      engine[i]->DeleteVariable([](mxnet::RunContext) {}, mxnet::Context::CPU(), var);
+    }
+    engine[i]->WaitForAll();
+  }
 }
 
 void Foo(mxnet::RunContext, int i) { printf("The fox says %d\n", i); }
@@ -0,0 +1,258 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file threaded_var_test.cc
+ * \brief stress test and throughput of ThreadedVar dependency tracking
+ */
+#include <gtest/gtest.h>
+#include <dmlc/logging.h>
+#include <dmlc/timer.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../src/engine/threaded_engine.h"
+#include "../include/test_util.h"
+
+using mxnet::engine::OprBlock;
+using mxnet::engine::ThreadedVar;
+using mxnet::engine::VersionedVarBlock;
+
+namespace {
+
+/*!
+ * \brief The mutex based ThreadedVar queue, kept as the baseline for the throughput test.
+ */
+class MutexThreadedVar {
+ public:
+  explicit MutexThreadedVar(VersionedVarBlock* head) : head_{head} {}
+
+  void AppendReadDependency(OprBlock* opr_block) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    if (pending_write_ == nullptr) {
+      ++num_pending_reads_;
+      opr_block->decr_wait();
+    } else {
+      auto&& new_var_block = VersionedVarBlock::New();
+      head_->next = new_var_block;
+      head_->trigger = opr_block;
+      head_ = new_var_block;
+    }
+  }
+
+  void AppendWriteDependency(OprBlock* opr_block) {
+    auto&& new_var_block = VersionedVarBlock::New();
+    std::lock_guard<std::mutex> lock{mutex_};
+    head_->next = new_var_block;
+    head_->trigger = opr_block;
+    head_->write = true;
+    if (pending_write_ == nullptr) {
+      pending_write_ = head_;
+      if (num_pending_reads_ == 0) {
+        opr_block->decr_wait();
+        num_pending_reads_ = kWriteTriggered;
+      }
+    }
+    head_ = new_var_block;
+  }
+
+  template <typename Dispatcher>
+  void CompleteReadDependency(Dispatcher dispatcher) {
+    OprBlock *trigger = nullptr;
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      if (--num_pending_reads_ == 0) {
+        if (pending_write_ != nullptr) {
+          trigger = pending_write_->trigger;
+          num_pending_reads_ = kWriteTriggered;
+        }
+      }
+    }
+    if (trigger != nullptr && trigger->decr_wait() == 0) {
+      dispatcher(trigger);
+    }
+  }
+
+  template <typename Dispatcher>
+  bool CompleteWriteDependency(Dispatcher dispatcher) {
+    VersionedVarBlock *old_pending_write, *end_of_read_chain;
+    OprBlock* trigger_write = nullptr;
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      old_pending_write = pending_write_;
+      end_of_read_chain = old_pending_write->next;
+      num_pending_reads_ = 0;
+      while (end_of_read_chain != head_ && end_of_read_chain->write == false) {
+        ++num_pending_reads_;
+        end_of_read_chain = end_of_read_chain->next;
+      }
+      if (end_of_read_chain == head_) {
+        pending_write_ = nullptr;
+      } else {
+        pending_write_ = end_of_read_chain;
+        if (num_pending_reads_ == 0) {
+          num_pending_reads_ = kWriteTriggered;
+          trigger_write = end_of_read_chain->trigger;
+        }
+      }
+    }
+    VersionedVarBlock *cur_head = old_pending_write->next;
+    VersionedVarBlock::Delete(old_pending_write);
+    while (cur_head != end_of_read_chain) {
+      if (cur_head->trigger->decr_wait() == 0) {
+        dispatcher(cur_head->trigger);
+      }
+      auto prev = cur_head;
+      cur_head = cur_head->next;
+      VersionedVarBlock::Delete(prev);
+    }
+    if (trigger_write != nullptr && trigger_write->decr_wait() == 0) {
+      dispatcher(trigger_write);
+    }
+    return false;
+  }
+
+ private:
+  static constexpr int kWriteTriggered = -1;
+  std::mutex mutex_;
+  int num_pending_reads_{0};
+  VersionedVarBlock* head_{nullptr};
+  VersionedVarBlock* pending_write_{nullptr};
+};
+
+/*! \brief an operation of the workload, indexed by OprBlock::priority */
+struct VarTestOp {
+  bool write;
+  int expected_version;
+};
+
+/*!
+ * \brief Run num_threads threads which each append num_ops operations on a shared variable
+ *  and execute whatever becomes ready, like engine workers do.
+ * \param check_order serialize appends to know the version each operation must observe.
+ * \return number of ordering violations observed
+ */
+template<typename VarType>
+int RunVarWorkload(int num_threads, int num_ops, double write_ratio, bool check_order,
+                   double *seconds) {
+  VarType var(VersionedVarBlock::New());
+  std::vector<VarTestOp> ops(num_threads * num_ops);
+  std::mt19937 gen(42);
+  std::bernoulli_distribution is_write(write_ratio);
+  for (auto& op : ops) op.write = is_write(gen);
+
+  std::mutex append_mutex;
+  int pushed_writes = 0;
+  std::atomic<int> version(0);
+  std::atomic<int> running_reads(0), running_writes(0), violations(0), completed(0);
+
+  auto execute = [&](OprBlock *blk, std::vector<OprBlock*> *ready) {
+    const VarTestOp& op = ops[blk->priority];
+    auto dispatch = [ready](OprBlock *next) { ready->push_back(next); };
+    if (op.write) {
+      if (++running_writes != 1 || running_reads.load() != 0) ++violations;
+      if (check_order && version.load() != op.expected_version) ++violations;
+      ++version;
+      --running_writes;
+      var.CompleteWriteDependency(dispatch);
+    } else {
+      ++running_reads;
+      if (running_writes.load() != 0) ++violations;
+      if (check_order && version.load() != op.expected_version) ++violations;
+      --running_reads;
+      var.CompleteReadDependency(dispatch);
+    }
+    OprBlock::Delete(blk);
+    ++completed;
+  };
+
+  auto worker = [&](int tid) {
+    std::vector<OprBlock*> ready;
+    for (int i = 0; i < num_ops; ++i) {
+      const int idx = tid * num_ops + i;
+      OprBlock *blk = OprBlock::New();
+      blk->wait = 2;
+      blk->priority = idx;
+      std::unique_lock<std::mutex> lock(append_mutex, std::defer_lock);
+      if (check_order) {
+        lock.lock();
+        ops[idx].expected_version = pushed_writes;
+        if (ops[idx].write) ++pushed_writes;
+      }
+      if (ops[idx].write) {
+        var.AppendWriteDependency(blk);
+      } else {
+        var.AppendReadDependency(blk);
+      }
+      if (check_order) lock.unlock();
+      if (blk->decr_wait() == 0) ready.push_back(blk);
+      while (!ready.empty()) {
+        OprBlock *next = ready.back();
+        ready.pop_back();
+        execute(next, &ready);
+      }
+    }
+  };
+
+  const double start = dmlc::GetTime();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_threads; ++i) threads.emplace_back(worker, i);
+  for (auto& t : threads) t.join();
+  *seconds = dmlc::GetTime() - start;
+  EXPECT_EQ(completed.load(), num_threads * num_ops);
+  return violations.load();
+}
+
+}  // namespace
+
+TEST(ThreadedVar, StressOrdering) {
+  const int num_ops = mxnet::test::performance_run ? 200000 : 20000;
+  double seconds;
+  for (double write_ratio : {0.0, 0.05, 0.5, 1.0}) {
+    for (int num_threads : {1, 4, 16}) {
+      EXPECT_EQ(RunVarWorkload<ThreadedVar>(num_threads, num_ops, write_ratio, true, &seconds), 0)
+        << "threads: " << num_threads << " write ratio: " << write_ratio;
+      EXPECT_EQ(RunVarWorkload<ThreadedVar>(num_threads, num_ops, write_ratio, false, &seconds), 0)
+        << "threads: " << num_threads << " write ratio: " << write_ratio;
+    }
+  }
+}
+
+TEST(ThreadedVar, Throughput) {
+  const int num_ops = mxnet::test::performance_run ? 1000000 : 50000;
+  const int max_threads = std::max(2u, std::thread::hardware_concurrency());
+  for (double write_ratio : {0.0, 0.1, 0.5}) {
+    for (int num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+      double mutex_sec, atomic_sec;
+      EXPECT_EQ(RunVarWorkload<MutexThreadedVar>(num_threads, num_ops, write_ratio,
+                                                 false, &mutex_sec), 0);
+      EXPECT_EQ(RunVarWorkload<ThreadedVar>(num_threads, num_ops, write_ratio,
+                                            false, &atomic_sec), 0);
+      const double total = static_cast<double>(num_threads) * num_ops;
+      LOG(INFO) << "threads: " << num_threads << "\twrite ratio: " << write_ratio
+                << "\tmutex: " << total / mutex_sec << " ops/sec"
+                << "\tatomic: " << total / atomic_sec << " ops/sec";
+    }
+  }
+}
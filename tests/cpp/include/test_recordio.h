@@ -0,0 +1,99 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ *  Copyright (c) 2018 by Contributors
+ * \file test_recordio.h
+ * \brief RecordIO files for the tests of the RecordIO readers
+ */
+#ifndef TEST_RECORDIO_H_
+#define TEST_RECORDIO_H_
+
+#include <dmlc/io.h>
+#include <dmlc/recordio.h>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mxnet {
+namespace test {
+
+/*! \brief index of the record split by the writer in SplitMagicRecords */
+const size_t kSplitRecord = 2;
+
+/*!
+ * \brief records covering the corner cases of the format: an empty record, and a
+ *  record containing the magic number, which the writer splits in several parts
+ */
+inline std::vector<std::string> SplitMagicRecords() {
+  const uint32_t magic = dmlc::RecordIOWriter::kMagic;
+  const std::string magic_bytes(reinterpret_cast<const char*>(&magic), sizeof(magic));
+  return {"first", "", "head" + magic_bytes + "tailtail" + magic_bytes + "end"};
+}
+
+/*!
+ * \brief a RecordIO file with its index, removed when going out of scope
+ */
+class RecordIOFiles {
+ public:
+  /*!
+   * \brief write the files
+   * \param name base name of the files, ".rec" and ".idx" are appended
+   * \param records contents of the records
+   * \param reverse_index whether to list the records in the index from last to first
+   */
+  RecordIOFiles(const std::string& name, const std::vector<std::string>& records,
+                bool reverse_index = false)
+      : rec_(name + ".rec"), idx_(name + ".idx") {
+    std::unique_ptr<dmlc::Stream> fo(dmlc::Stream::Create(rec_.c_str(), "w"));
+    std::unique_ptr<dmlc::Stream> fidx(dmlc::Stream::Create(idx_.c_str(), "w"));
+    dmlc::ostream os(fidx.get());
+    dmlc::RecordIOWriter writer(fo.get());
+    std::vector<size_t> offsets;
+    for (const std::string& record : records) {
+      offsets.push_back(writer.Tell());
+      writer.WriteRecord(record);
+    }
+    for (size_t k = 0; k < records.size(); ++k) {
+      const size_t i = reverse_index ? records.size() - 1 - k : k;
+      os << i << '\t' << offsets[i] << '\n';
+    }
+  }
+  ~RecordIOFiles() {
+    std::remove(rec_.c_str());
+    std::remove(idx_.c_str());
+  }
+  /*! \brief path of the record file */
+  const std::string& rec() const {
+    return rec_;
+  }
+  /*! \brief path of the index file */
+  const std::string& idx() const {
+    return idx_;
+  }
+
+ private:
+  std::string rec_, idx_;
+};
+
+}  // namespace test
+}  // namespace mxnet
+
+#endif  // TEST_RECORDIO_H_
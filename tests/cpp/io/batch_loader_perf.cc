@@ -0,0 +1,179 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ *  Copyright (c) 2018 by Contributors
+ * \file batch_loader_perf.cc
+ * \brief batch assembly from runs against single instances, and records/sec through
+ *  BatchLoader + PrefetcherIter
+ */
+#include <gtest/gtest.h>
+#include <dmlc/timer.h>
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../include/test_util.h"
+#include "../../src/io/iter_batchloader.h"
+#include "../../src/io/iter_prefetcher.h"
+
+using namespace mxnet;
+
+namespace {
+typedef std::vector<std::pair<std::string, std::string> > KWArgs;
+
+// in-memory rows stored contiguously in blocks of block_rows, like parsed text
+class SyntheticIter : public io::RunIIterator<DataInst> {
+ public:
+  SyntheticIter(size_t num_rows, size_t row_len, size_t block_rows)
+      : num_rows_(num_rows), row_len_(row_len), block_rows_(block_rows),
+        data_(num_rows * row_len), label_(num_rows) {
+    for (size_t i = 0; i < data_.size(); ++i) data_[i] = static_cast<float>(i % 9973);
+    for (size_t i = 0; i < num_rows; ++i) label_[i] = static_cast<float>(i);
+    out_.data.resize(2);
+    run_out_.data.resize(2);
+  }
+  void Init(const KWArgs& kwargs) override {}
+  void BeforeFirst() override {
+    pos_ = 0;
+    run_ = 0;
+  }
+  bool Next() override {
+    if (this->NextRun(1) == 0) return false;
+    out_.index = pos_;
+    out_.data[0] = TBlob(&data_[pos_ * row_len_], mshadow::Shape1(row_len_), cpu::kDevMask);
+    out_.data[1] = TBlob(&label_[pos_], mshadow::Shape1(1), cpu::kDevMask);
+    return true;
+  }
+  const DataInst& Value() const override {
+    return out_;
+  }
+  size_t NextRun(size_t max_size) override {
+    pos_ += run_;
+    const size_t block_end = std::min(num_rows_, (pos_ / block_rows_ + 1) * block_rows_);
+    run_ = std::min(max_size, block_end - pos_);
+    if (run_ == 0) return 0;
+    run_out_.index = pos_;
+    run_out_.data[0] = TBlob(&data_[pos_ * row_len_], mshadow::Shape2(run_, row_len_),
+                             cpu::kDevMask);
+    run_out_.data[1] = TBlob(&label_[pos_], mshadow::Shape2(run_, 1), cpu::kDevMask);
+    return run_;
+  }
+  const DataInst& RunValue() const override {
+    return run_out_;
+  }
+
+ private:
+  size_t num_rows_, row_len_, block_rows_;
+  std::vector<float> data_, label_;
+  DataInst out_, run_out_;
+  size_t pos_{0}, run_{0};
+};
+
+io::BatchLoader* CreateLoader(SyntheticIter* base, bool runs) {
+  if (runs) return new io::BatchLoader(base);
+  return new io::BatchLoader(static_cast<IIterator<DataInst>*>(base));
+}
+
+KWArgs LoaderArgs(size_t batch_size, bool round_batch) {
+  return {{"batch_size", std::to_string(batch_size)},
+          {"round_batch", round_batch ? "1" : "0"}};
+}
+}  // namespace
+
+/*!
+ * \brief batches assembled from runs match the ones assembled instance by instance,
+ *  including the padding at the end of an epoch
+ */
+TEST(BATCH_LOADER, RunsMatchInstances) {
+  for (bool round_batch : {false, true}) {
+    std::unique_ptr<io::BatchLoader> ref(CreateLoader(new SyntheticIter(103, 5, 7), false));
+    std::unique_ptr<io::BatchLoader> run(CreateLoader(new SyntheticIter(103, 5, 7), true));
+    ref->Init(LoaderArgs(16, round_batch));
+    run->Init(LoaderArgs(16, round_batch));
+    for (int epoch = 0; epoch < 3; ++epoch) {
+      ref->BeforeFirst();
+      run->BeforeFirst();
+      size_t num_batches = 0;
+      while (true) {
+        const bool has_ref = ref->Next();
+        ASSERT_EQ(has_ref, run->Next());
+        if (!has_ref) break;
+        ++num_batches;
+        const TBlobBatch& a = ref->Value();
+        const TBlobBatch& b = run->Value();
+        ASSERT_EQ(a.num_batch_padd, b.num_batch_padd);
+        ASSERT_EQ(a.data.size(), b.data.size());
+        const size_t valid = a.batch_size - (round_batch ? 0 : a.num_batch_padd);
+        for (size_t i = 0; i < valid; ++i) {
+          ASSERT_EQ(a.inst_index[i], b.inst_index[i]);
+        }
+        for (size_t k = 0; k < a.data.size(); ++k) {
+          ASSERT_EQ(a.data[k].shape_, b.data[k].shape_);
+          const size_t row = a.data[k].shape_.Size() / a.batch_size;
+          const float* pa = a.data[k].dptr<float>();
+          const float* pb = b.data[k].dptr<float>();
+          for (size_t i = 0; i < valid * row; ++i) {
+            ASSERT_EQ(pa[i], pb[i]);
+          }
+        }
+      }
+      // with round_batch the later epochs start after the rows used as padding
+      if (!round_batch || epoch == 0) EXPECT_EQ(num_batches, 7U);
+    }
+  }
+}
+
+/*!
+ * \brief records/sec through BatchLoader + PrefetcherIter, instance by instance
+ *  and from runs, at larger sizes with --perf
+ */
+TEST(BATCH_LOADER, TimingCPU) {
+  std::vector<size_t> row_lens = {64};
+  if (test::performance_run) {
+    row_lens = {16, 256, 4096};
+  }
+  const size_t num_rows = test::performance_run ? 200000 : 4096;
+  const size_t batch_size = 256;
+  for (size_t row_len : row_lens) {
+    double rate[2];
+    for (bool runs : {false, true}) {
+      io::PrefetcherIter iter(CreateLoader(new SyntheticIter(num_rows, row_len, 4096), runs));
+      iter.Init(LoaderArgs(batch_size, false));
+      const int epochs = 3;
+      size_t records = 0;
+      const double start = dmlc::GetTime();
+      for (int epoch = 0; epoch < epochs; ++epoch) {
+        iter.BeforeFirst();
+        while (iter.Next()) {
+          const DataBatch& batch = iter.Value();
+          records += batch.data[0].shape()[0] - batch.num_batch_padd;
+        }
+      }
+      EXPECT_EQ(records, num_rows * epochs);
+      rate[runs] = records / (dmlc::GetTime() - start);
+    }
+    std::cout << "Rows of " << row_len << " floats, batch " << batch_size << ": "
+              << std::fixed << std::setprecision(0) << rate[0]
+              << " records/sec by instance, " << rate[1] << " records/sec by run" << std::endl;
+  }
+}
@@ -0,0 +1,122 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ *  Copyright (c) 2018 by Contributors
+ * \file global_shuffle_test.cc
+ * \brief test the slices ImageRecordIter parts read with global_shuffle
+ */
+#if MXNET_USE_OPENCV && !defined(_WIN32)
+#include <gtest/gtest.h>
+#include <mxnet/io.h>
+#include <opencv2/opencv.hpp>
+#include <cstdio>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../include/test_recordio.h"
+#include "../../src/io/image_recordio.h"
+
+using namespace mxnet;
+
+namespace {
+const int kNumRecords = 40;
+const int kNumParts = 3;
+const int kBatchSize = 4;
+
+// small images labeled with their index
+std::vector<std::string> LabeledImages() {
+  std::vector<std::string> records;
+  for (int i = 0; i < kNumRecords; ++i) {
+    io::ImageRecordIO rec;
+    rec.header.label = static_cast<float>(i);
+    rec.header.image_id[0] = i;
+    std::string record;
+    rec.SaveHeader(&record);
+    std::vector<uchar> png;
+    cv::imencode(".png", cv::Mat(8, 8, CV_8UC3, cv::Scalar(i, 2 * i, 3 * i)), png);
+    record.append(png.begin(), png.end());
+    records.push_back(record);
+  }
+  return records;
+}
+
+// labels of the records an iterator returns in an epoch, without the padding
+std::vector<int> ReadEpoch(IIterator<DataBatch>* iter) {
+  std::vector<int> labels;
+  iter->BeforeFirst();
+  while (iter->Next()) {
+    const DataBatch& batch = iter->Value();
+    batch.data[1].WaitToRead();
+    const real_t* label = batch.data[1].data().dptr<real_t>();
+    for (int i = 0; i < kBatchSize - batch.num_batch_padd; ++i) {
+      labels.push_back(static_cast<int>(label[i]));
+    }
+  }
+  return labels;
+}
+}  // namespace
+
+/*!
+ * \brief every part draws the same permutation, so the parts are disjoint and cover all
+ *  records in each epoch. the first part creates the mean image and the others load
+ *  it, which must not change the permutations they draw
+ */
+TEST(ImageRecordIter, GlobalShuffleParts) {
+  test::RecordIOFiles files("global_shuffle_test", LabeledImages());
+  const std::string mean_img = "global_shuffle_test_mean.bin";
+  std::remove(mean_img.c_str());
+  std::vector<std::unique_ptr<IIterator<DataBatch> > > iters;
+  for (int part = 0; part < kNumParts; ++part) {
+    iters.emplace_back(dmlc::Registry<DataIteratorReg>::Find("ImageRecordIter")->body());
+    iters.back()->Init({{"path_imgrec", files.rec()}, {"path_imgidx", files.idx()},
+                        {"data_shape", "(3,8,8)"}, {"batch_size", std::to_string(kBatchSize)},
+                        {"shuffle", "1"}, {"global_shuffle", "1"}, {"seed", "7"},
+                        {"num_parts", std::to_string(kNumParts)},
+                        {"part_index", std::to_string(part)}, {"round_batch", "0"},
+                        {"mean_img", mean_img}, {"preprocess_threads", "1"},
+                        {"verbose", "0"}});
+  }
+  std::vector<std::vector<int> > first_epoch;
+  for (int epoch = 0; epoch < 2; ++epoch) {
+    std::set<int> seen;
+    size_t num_read = 0;
+    for (int part = 0; part < kNumParts; ++part) {
+      const std::vector<int> labels = ReadEpoch(iters[part].get());
+      EXPECT_EQ(labels.size(), static_cast<size_t>(kNumRecords * (part + 1) / kNumParts -
+                                                   kNumRecords * part / kNumParts));
+      seen.insert(labels.begin(), labels.end());
+      num_read += labels.size();
+      if (epoch == 0) {
+        first_epoch.push_back(labels);
+      } else {
+        EXPECT_NE(labels, first_epoch[part]) << "part " << part;
+      }
+    }
+    EXPECT_EQ(num_read, static_cast<size_t>(kNumRecords));
+    EXPECT_EQ(seen.size(), static_cast<size_t>(kNumRecords));
+    EXPECT_EQ(*seen.begin(), 0);
+    EXPECT_EQ(*seen.rbegin(), kNumRecords - 1);
+  }
+  iters.clear();
+  std::remove(mean_img.c_str());
+}
+#endif  // MXNET_USE_OPENCV && !defined(_WIN32)
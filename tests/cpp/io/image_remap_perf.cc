@@ -0,0 +1,209 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ *  Copyright (c) 2018 by Contributors
+ * \file image_remap_perf.cc
+ * \brief per image latency of the fused crop/resize/normalize path against OpenCV calls
+ */
+#if MXNET_USE_OPENCV
+#include <gtest/gtest.h>
+#include <dmlc/timer.h>
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../include/test_util.h"
+#include "../../src/io/image_augmenter.h"
+#include "../../src/io/image_remap.h"
+
+using namespace mxnet;
+
+namespace {
+const int kOutRows = 224, kOutCols = 224;
+
+// resize the shorter edge, center crop, then mirror and normalize into CHW like ProcessImage
+void ChainedAugment(const cv::Mat& src, int resize, const io::RemapNormalizer& norm,
+                    bool mirror, float* out) {
+  cv::Mat res;
+  const int rows = src.rows > src.cols ? resize * src.rows / src.cols : resize;
+  const int cols = src.rows > src.cols ? resize : resize * src.cols / src.rows;
+  cv::resize(src, res, cv::Size(cols, rows), 0, 0, cv::INTER_LINEAR);
+  cv::Rect roi((res.cols - kOutCols) / 2, (res.rows - kOutRows) / 2, kOutCols, kOutRows);
+  res = res(roi);
+  const int swap[3] = {2, 1, 0};
+  for (int i = 0; i < kOutRows; ++i) {
+    const uchar* p = res.ptr<uchar>(i);
+    for (int j = 0; j < kOutCols; ++j) {
+      const int oj = mirror ? kOutCols - 1 - j : j;
+      for (int k = 0; k < 3; ++k) {
+        // the mean image is in unmirrored order, like in ImageNormalizeIter
+        const float mean = norm.mean_img != nullptr ?
+            norm.mean_img[(k * kOutRows + i) * kOutCols + j] : norm.mean[k];
+        out[(k * kOutRows + i) * kOutCols + oj] =
+            (p[j * 3 + swap[k]] - mean) * norm.mult[k] + norm.bias[k];
+      }
+    }
+  }
+}
+
+// the window of ChainedAugment in the source, with the rounding of SampleWindow
+cv::Rect_<float> CenterWindow(const cv::Mat& src, int resize) {
+  const int rows = src.rows > src.cols ? resize * src.rows / src.cols : resize;
+  const int cols = src.rows > src.cols ? resize : resize * src.cols / src.rows;
+  const float scale_x = static_cast<float>(src.cols) / cols;
+  const float scale_y = static_cast<float>(src.rows) / rows;
+  return cv::Rect_<float>((cols - kOutCols) / 2 * scale_x, (rows - kOutRows) / 2 * scale_y,
+                          kOutCols * scale_x, kOutRows * scale_y);
+}
+}  // namespace
+
+/*!
+ * \brief compare the fused remap with resize + crop + normalize on a random image
+ */
+TEST(IMAGE_REMAP, MatchesChainedAugment) {
+  cv::Mat src(300, 400, CV_8UC3);
+  cv::randu(src, cv::Scalar::all(0), cv::Scalar::all(255));
+  io::RemapNormalizer norm;
+  norm.enabled = true;
+  for (int k = 0; k < 3; ++k) {
+    norm.mean[k] = 120.0f + k;
+    norm.mult[k] = 1.0f / 58.0f;
+  }
+  for (int resize : {300, 256, 360}) {
+    // without resizing both paths copy the same pixels, otherwise the chained
+    // path rounds the resized image to 8 bits with fixed-point weights
+    const float tolerance = resize == 300 ? 1e-4f : 1.5f * norm.mult[0];
+    for (bool mirror : {false, true}) {
+      std::vector<float> expected(3 * kOutRows * kOutCols), actual(expected.size());
+      ChainedAugment(src, resize, norm, mirror, expected.data());
+      io::RemapImage(src, CenterWindow(src, resize), mirror, norm, kOutRows, kOutCols,
+                     actual.data());
+      for (size_t i = 0; i < expected.size(); ++i) {
+        ASSERT_NEAR(expected[i], actual[i], tolerance) << "resize " << resize;
+      }
+    }
+  }
+}
+
+/*!
+ * \brief SampleWindow consumes the same random draws as Process and picks the window
+ *  Process crops, for configurations where Process resamples the source once
+ */
+TEST(IMAGE_REMAP, SampleWindowMatchesProcess) {
+  cv::Mat src(300, 400, CV_8UC3);
+  cv::randu(src, cv::Scalar::all(0), cv::Scalar::all(255));
+  const std::vector<std::vector<std::pair<std::string, std::string>>> configs = {
+    {{"resize", "256"}, {"rand_crop", "1"}},
+    {{"random_resized_crop", "1"}, {"min_random_area", "0.3"},
+     {"min_aspect_ratio", "0.75"}, {"max_aspect_ratio", "1.33"}},
+    {{"min_crop_size", "200"}, {"max_crop_size", "280"}, {"rand_crop", "1"}}
+  };
+  io::RemapNormalizer norm;
+  std::vector<float> actual(3 * kOutRows * kOutCols);
+  std::vector<float> label;
+  for (auto kwargs : configs) {
+    kwargs.emplace_back("data_shape", "(3," + std::to_string(kOutRows) + "," +
+                                      std::to_string(kOutCols) + ")");
+    std::unique_ptr<io::ImageAugmenter> aug(io::ImageAugmenter::Create("aug_default"));
+    aug->Init(kwargs);
+    ASSERT_TRUE(aug->SupportsWindow());
+    for (unsigned seed = 0; seed < 8; ++seed) {
+      common::RANDOM_ENGINE process_rnd(seed), window_rnd(seed);
+      cv::Mat expected = aug->Process(src, &label, &process_rnd);
+      const cv::Rect_<float> window = aug->SampleWindow(src.rows, src.cols, &window_rnd);
+      ASSERT_TRUE(process_rnd == window_rnd) << kwargs[0].first << ", seed " << seed;
+      ASSERT_EQ(expected.rows, kOutRows);
+      ASSERT_EQ(expected.cols, kOutCols);
+      io::RemapImage(src, window, false, norm, kOutRows, kOutCols, actual.data());
+      // when upscaling, cv::resize clamps the outermost taps to the cropped image while
+      // RemapImage reads the neighbouring source pixels, so borders are left out
+      for (int i = 1; i < kOutRows - 1; ++i) {
+        for (int j = 1; j < kOutCols - 1; ++j) {
+          const cv::Vec3b& p = expected.at<cv::Vec3b>(i, j);
+          for (int k = 0; k < 3; ++k) {
+            ASSERT_NEAR(p[2 - k], actual[(k * kOutRows + i) * kOutCols + j], 1.5f)
+                << kwargs[0].first << ", seed " << seed;
+          }
+        }
+      }
+    }
+  }
+}
+
+/*!
+ * \brief the mean image is subtracted before mirroring in both paths
+ */
+TEST(IMAGE_REMAP, MirrorWithMeanImage) {
+  cv::Mat src(300, 400, CV_8UC3);
+  cv::randu(src, cv::Scalar::all(0), cv::Scalar::all(255));
+  std::vector<float> mean_img(3 * kOutRows * kOutCols);
+  for (size_t i = 0; i < mean_img.size(); ++i) {
+    mean_img[i] = static_cast<float>(i % 251);
+  }
+  io::RemapNormalizer norm;
+  norm.enabled = true;
+  norm.mean_img = mean_img.data();
+  for (bool mirror : {false, true}) {
+    std::vector<float> expected(3 * kOutRows * kOutCols), actual(expected.size());
+    ChainedAugment(src, 300, norm, mirror, expected.data());
+    io::RemapImage(src, CenterWindow(src, 300), mirror, norm, kOutRows, kOutCols,
+                   actual.data());
+    for (size_t i = 0; i < expected.size(); ++i) {
+      ASSERT_NEAR(expected[i], actual[i], 1e-3);
+    }
+  }
+}
+
+/*!
+ * \brief per image latency of both paths, at ImageNet-like sizes with --perf
+ */
+TEST(IMAGE_REMAP, TimingCPU) {
+  std::vector<cv::Size> sizes = {{500, 375}};
+  if (test::performance_run) {
+    sizes = {{500, 375}, {1024, 768}, {2048, 1536}};
+  }
+  const int runs = test::performance_run ? 200 : 10;
+  io::RemapNormalizer norm;
+  norm.enabled = true;
+  std::vector<float> out(3 * kOutRows * kOutCols);
+  for (const cv::Size& size : sizes) {
+    cv::Mat src(size, CV_8UC3);
+    cv::randu(src, cv::Scalar::all(0), cv::Scalar::all(255));
+    double start = dmlc::GetTime();
+    for (int i = 0; i < runs; ++i) {
+      ChainedAugment(src, 256, norm, i % 2, out.data());
+    }
+    const double chained = (dmlc::GetTime() - start) / runs;
+    start = dmlc::GetTime();
+    for (int i = 0; i < runs; ++i) {
+      io::RemapImage(src, CenterWindow(src, 256), i % 2, norm, kOutRows, kOutCols, out.data());
+    }
+    const double fused = (dmlc::GetTime() - start) / runs;
+    std::cout << "Image " << size.width << "x" << size.height << " -> "
+              << kOutCols << "x" << kOutRows << ": chained " << std::fixed
+              << std::setprecision(1) << chained * 1e6 << " us, fused " << fused * 1e6
+              << " us per image" << std::endl;
+  }
+}
+#endif  // MXNET_USE_OPENCV
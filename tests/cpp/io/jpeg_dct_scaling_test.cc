@@ -0,0 +1,181 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ *  Copyright (c) 2018 by Contributors
+ * \file jpeg_dct_scaling_test.cc
+ * \brief DCT scale chosen for jpeg_dct_scaling and the decode time it saves
+ */
+#if MXNET_USE_OPENCV
+#include <gtest/gtest.h>
+#include <dmlc/timer.h>
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#if MXNET_USE_LIBJPEG_TURBO
+#include <turbojpeg.h>
+#endif
+#include "../include/test_util.h"
+#include "../../src/io/image_augmenter.h"
+#include "../../src/io/image_iter_common.h"
+
+using namespace mxnet;
+
+namespace {
+typedef std::vector<std::pair<std::string, std::string>> Kwargs;
+
+std::unique_ptr<io::ImageAugmenter> CreateAugmenter(Kwargs kwargs) {
+  kwargs.emplace_back("data_shape", "(3,224,224)");
+  std::unique_ptr<io::ImageAugmenter> aug(io::ImageAugmenter::Create("aug_default"));
+  aug->Init(kwargs);
+  return aug;
+}
+
+int Scaled(int edge, int denom) {
+  return (edge + denom - 1) / denom;
+}
+}  // namespace
+
+/*!
+ * \brief the shortest source edge each augmentation can be decoded to
+ */
+TEST(JPEG_DCT_SCALING, MinSourceEdge) {
+  EXPECT_EQ(CreateAugmenter({{"resize", "256"}})->MinSourceEdge(), 256);
+  EXPECT_EQ(CreateAugmenter({{"resize", "256"}, {"rand_crop", "1"}})->MinSourceEdge(), 256);
+  // the scale is applied after resizing the shorter edge
+  EXPECT_EQ(CreateAugmenter({{"resize", "256"}, {"max_random_scale", "1.2"},
+                             {"min_random_scale", "0.8"}})->MinSourceEdge(), 256);
+  // crops without resizing are taken from the source resolution
+  EXPECT_EQ(CreateAugmenter({{"rand_crop", "1"}})->MinSourceEdge(), 0);
+  EXPECT_EQ(CreateAugmenter({{"max_random_scale", "1.2"}})->MinSourceEdge(), 0);
+  EXPECT_EQ(CreateAugmenter({{"max_crop_size", "300"}, {"min_crop_size", "200"},
+                             {"rand_crop", "1"}})->MinSourceEdge(), 0);
+  const Kwargs rrc = {{"random_resized_crop", "1"}, {"min_random_area", "0.08"},
+                      {"min_aspect_ratio", "0.75"}, {"max_aspect_ratio", "1.33"}};
+  EXPECT_EQ(CreateAugmenter(rrc)->MinSourceEdge(),
+            static_cast<int>(std::ceil(224 * std::sqrt(1.0f / 0.75f / 0.08f))));
+  Kwargs rotated = rrc;
+  rotated.emplace_back("max_rotate_angle", "10");
+  EXPECT_EQ(CreateAugmenter(rotated)->MinSourceEdge(), 0);
+  Kwargs padded = rrc;
+  padded.emplace_back("pad", "4");
+  EXPECT_EQ(CreateAugmenter(padded)->MinSourceEdge(), 0);
+}
+
+/*!
+ * \brief the strongest scale that keeps the shorter edge at min_edge, and never
+ *  a crop window below the output size
+ */
+TEST(JPEG_DCT_SCALING, ScaleChoice) {
+  EXPECT_EQ(io::JPEGScaleDenom(375, 500, 0), 1);
+  EXPECT_EQ(io::JPEGScaleDenom(375, 500, 256), 1);
+  EXPECT_EQ(io::JPEGScaleDenom(375, 500, 189), 1);
+  EXPECT_EQ(io::JPEGScaleDenom(375, 500, 188), 2);
+  EXPECT_EQ(io::JPEGScaleDenom(1536, 2048, 256), 4);
+  EXPECT_EQ(io::JPEGScaleDenom(2048, 1536, 192), 8);
+  // an edge of 2047 scales to 256 since the scaled size is rounded up
+  EXPECT_EQ(io::JPEGScaleDenom(2047, 3000, 256), 8);
+  EXPECT_EQ(io::JPEGScaleDenom(2040, 3000, 256), 4);
+
+  const std::vector<Kwargs> configs = {
+    {{"resize", "256"}},
+    {{"resize", "256"}, {"rand_crop", "1"}},
+    {{"resize", "224"}, {"rand_crop", "1"}},
+    {{"resize", "256"}, {"max_random_scale", "1.2"}, {"min_random_scale", "0.8"}},
+    {{"random_resized_crop", "1"}, {"min_random_area", "0.08"},
+     {"min_aspect_ratio", "0.75"}, {"max_aspect_ratio", "1.33"}},
+    {{"random_resized_crop", "1"}, {"min_random_area", "0.5"},
+     {"min_aspect_ratio", "0.5"}, {"max_aspect_ratio", "2"}},
+    {{"random_resized_crop", "1"}, {"min_random_area", "0.9"}}
+  };
+  const std::vector<cv::Size> sizes = {{500, 375}, {375, 500}, {1024, 768}, {2048, 1536},
+                                       {4000, 3000}, {3000, 300}, {200, 150}};
+  for (const Kwargs& kwargs : configs) {
+    std::unique_ptr<io::ImageAugmenter> aug = CreateAugmenter(kwargs);
+    const int min_edge = aug->MinSourceEdge();
+    ASSERT_GT(min_edge, 0) << kwargs[0].first << "=" << kwargs[0].second;
+    for (const cv::Size& size : sizes) {
+      const int denom = io::JPEGScaleDenom(size.height, size.width, min_edge);
+      const int rows = Scaled(size.height, denom), cols = Scaled(size.width, denom);
+      const int edge = std::min(size.height, size.width);
+      if (denom > 1) {
+        ASSERT_GE(std::min(rows, cols), min_edge) << size;
+      }
+      if (denom < 8) {
+        // the next scale would go below min_edge
+        ASSERT_TRUE(edge < min_edge || Scaled(edge, denom * 2) < min_edge) << size;
+      }
+      if (edge < min_edge || !aug->SupportsWindow()) continue;
+      // the window is cropped out of the decoded image and resized to the output,
+      // it must not be upscaled where the full size image would not be
+      for (unsigned seed = 0; seed < 32; ++seed) {
+        common::RANDOM_ENGINE rnd(seed);
+        const cv::Rect_<float> window = aug->SampleWindow(rows, cols, &rnd);
+        ASSERT_GE(window.width, 224 - 1.0f) << size << ", seed " << seed;
+        ASSERT_GE(window.height, 224 - 1.0f) << size << ", seed " << seed;
+      }
+    }
+  }
+}
+
+#if MXNET_USE_LIBJPEG_TURBO
+/*!
+ * \brief decode time at full size and at the scale chosen for resize=256, with --perf
+ *  at ImageNet-like sizes
+ */
+TEST(JPEG_DCT_SCALING, TimingCPU) {
+  std::vector<cv::Size> sizes = {{500, 375}};
+  if (test::performance_run) {
+    sizes = {{500, 375}, {1024, 768}, {2048, 1536}, {4000, 3000}};
+  }
+  const int runs = test::performance_run ? 100 : 5;
+  tjhandle handle = tjInitDecompress();
+  for (const cv::Size& size : sizes) {
+    // smooth the noise so the file size is closer to a photo
+    cv::Mat src(size, CV_8UC3);
+    cv::randu(src, cv::Scalar::all(0), cv::Scalar::all(255));
+    cv::GaussianBlur(src, src, cv::Size(7, 7), 0);
+    std::vector<uchar> jpeg;
+    ASSERT_TRUE(cv::imencode(".jpg", src, jpeg, {cv::IMWRITE_JPEG_QUALITY, 90}));
+    const int denom = io::JPEGScaleDenom(size.height, size.width, 256);
+    std::vector<double> times;
+    for (int d : {1, denom}) {
+      const int rows = Scaled(size.height, d), cols = Scaled(size.width, d);
+      cv::Mat out(rows, cols, CV_8UC3);
+      const double start = dmlc::GetTime();
+      for (int i = 0; i < runs; ++i) {
+        ASSERT_EQ(tjDecompress2(handle, jpeg.data(), jpeg.size(), out.ptr(), cols, 0, rows,
+                                TJPF_BGR, 0), 0);
+      }
+      times.push_back((dmlc::GetTime() - start) / runs);
+    }
+    std::cout << size << ": full size " << std::fixed << std::setprecision(3)
+              << times[0] * 1000 << " ms, 1/" << denom << " scale " << times[1] * 1000
+              << " ms per image" << std::endl;
+  }
+  tjDestroy(handle);
+}
+#endif  // MXNET_USE_LIBJPEG_TURBO
+#endif  // MXNET_USE_OPENCV
@@ -0,0 +1,49 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ *  Copyright (c) 2018 by Contributors
+ * \file mmap_recordio_test.cc
+ * \brief test reading RecordIO files through a memory mapping
+ */
+#include <gtest/gtest.h>
+#include <dmlc/io.h>
+#include <string>
+#include <vector>
+#include "../include/test_recordio.h"
+#include "../../src/io/mmap_recordio.h"
+
+#ifndef _WIN32
+TEST(MMapRecordIO, ReadsRecordsInPlace) {
+  std::vector<std::string> records = mxnet::test::SplitMagicRecords();
+  records.push_back(std::string(1001, 'x'));
+  // write the index out of order, records are still returned in file order
+  mxnet::test::RecordIOFiles files("mmap_recordio_test", records, true);
+  mxnet::io::MMapRecordIO mmap(files.rec(), files.idx());
+  ASSERT_EQ(mmap.Size(), records.size());
+  for (size_t i = 0; i < records.size(); ++i) {
+    dmlc::InputSplit::Blob blob;
+    std::string buf;
+    mmap.GetRecord(i, &blob, &buf);
+    EXPECT_EQ(std::string(static_cast<char*>(blob.dptr), blob.size), records[i]);
+    // only the split record is copied
+    EXPECT_EQ(mmap.Contains(blob.dptr), i != mxnet::test::kSplitRecord);
+  }
+}
+#endif  // _WIN32
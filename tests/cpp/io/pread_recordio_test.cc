@@ -0,0 +1,59 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ *  Copyright (c) 2018 by Contributors
+ * \file pread_recordio_test.cc
+ * \brief test reading sets of RecordIO records with coalesced positioned reads
+ */
+#include <gtest/gtest.h>
+#include <dmlc/io.h>
+#include <string>
+#include <vector>
+#include "../include/test_recordio.h"
+#include "../../src/io/pread_recordio.h"
+
+#ifndef _WIN32
+TEST(PReadRecordIO, ReadsRecordsInRequestedOrder) {
+  // the large record puts the last one out of reach of the first merged read
+  std::vector<std::string> records = mxnet::test::SplitMagicRecords();
+  records.push_back(std::string(mxnet::io::PReadRecordIO::kMaxGap + 1, 'x'));
+  records.push_back("last");
+  mxnet::test::RecordIOFiles files("pread_recordio_test", records);
+  mxnet::io::PReadRecordIO reader(files.rec(), files.idx());
+  ASSERT_EQ(reader.Size(), records.size());
+  std::vector<dmlc::InputSplit::Blob> blobs;
+  const std::vector<size_t> ids = {4, 2, 0, 1};
+  reader.ReadRecords(ids.data(), ids.size(), &blobs);
+  ASSERT_EQ(blobs.size(), ids.size());
+  for (size_t k = 0; k < ids.size(); ++k) {
+    EXPECT_EQ(std::string(static_cast<char*>(blobs[k].dptr), blobs[k].size),
+              records[ids[k]]);
+  }
+  // the first three records are merged, skipping the large one splits the reads
+  EXPECT_EQ(reader.NumReads(), 2U);
+  const std::vector<size_t> all = {3, 1, 2, 0, 4};
+  reader.ReadRecords(all.data(), all.size(), &blobs);
+  for (size_t k = 0; k < all.size(); ++k) {
+    EXPECT_EQ(std::string(static_cast<char*>(blobs[k].dptr), blobs[k].size),
+              records[all[k]]);
+  }
+  EXPECT_EQ(reader.NumReads(), 1U);
+}
+#endif  // _WIN32
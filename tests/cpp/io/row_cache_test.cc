@@ -0,0 +1,115 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ *  Copyright (c) 2018 by Contributors
+ * \file row_cache_test.cc
+ * \brief test writing and memory mapping the binary row cache
+ */
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "../../src/io/row_cache.h"
+
+#ifndef _WIN32
+TEST(RowCache, RoundTrip) {
+  using mxnet::io::RowCacheArray;
+  const std::string path = "row_cache_test.bin";
+  // a dense array of two values per row and a sparse array of varying length
+  const std::vector<RowCacheArray> arrays = {{mshadow::kFloat32, 2}, {mshadow::kInt64, -1}};
+  // enough rows for several chunks
+  const size_t num_rows = (1UL << 16) * 2 + 5;
+  {
+    mxnet::io::RowCacheWriter writer(path, "signature", arrays);
+    std::vector<float> dense(2);
+    std::vector<int64_t> sparse;
+    for (size_t i = 0; i < num_rows; ++i) {
+      dense[0] = static_cast<float>(i);
+      dense[1] = -static_cast<float>(i);
+      sparse.assign(i % 4, static_cast<int64_t>(i));
+      std::vector<mxnet::TBlob> row = {
+        mxnet::TBlob(dense.data(), mshadow::Shape1(2), mxnet::cpu::kDevMask),
+        mxnet::TBlob(sparse.data(), mshadow::Shape1(sparse.size()), mxnet::cpu::kDevMask)};
+      writer.Append(row);
+    }
+    writer.Finish();
+  }
+  mxnet::io::RowCacheReader reader;
+  EXPECT_FALSE(reader.Open(path, "other signature", arrays));
+  ASSERT_TRUE(reader.Open(path, "signature", arrays));
+  ASSERT_EQ(reader.Size(), num_rows);
+  for (int pass = 0; pass < 2; ++pass) {
+    reader.BeforeFirst();
+    size_t i = 0;
+    while (reader.Next()) {
+      ASSERT_EQ(reader.Length(0), 2U);
+      const float* dense = reader.Value(0, mshadow::Shape1(2)).dptr<float>();
+      EXPECT_EQ(dense[0], static_cast<float>(i));
+      EXPECT_EQ(dense[1], -static_cast<float>(i));
+      ASSERT_EQ(reader.Length(1), i % 4);
+      const int64_t* sparse = reader.Value(1, mshadow::Shape1(i % 4)).dptr<int64_t>();
+      for (size_t j = 0; j < i % 4; ++j) {
+        EXPECT_EQ(sparse[j], static_cast<int64_t>(i));
+      }
+      ++i;
+    }
+    EXPECT_EQ(i, num_rows);
+  }
+  std::remove(path.c_str());
+}
+
+TEST(RowCache, IncompleteCacheIsDropped) {
+  using mxnet::io::RowCacheArray;
+  const std::string path = "row_cache_incomplete_test.bin";
+  const std::vector<RowCacheArray> arrays = {{mshadow::kFloat32, 1}};
+  std::string tmp_path;
+  {
+    mxnet::io::RowCacheWriter writer(path, "signature", arrays);
+    // a second writer of the same cache gets its own temporary file
+    mxnet::io::RowCacheWriter other(path, "signature", arrays);
+    EXPECT_NE(writer.tmp_path(), other.tmp_path());
+    tmp_path = writer.tmp_path();
+    float value = 1.0f;
+    writer.Append({mxnet::TBlob(&value, mshadow::Shape1(1), mxnet::cpu::kDevMask)});
+  }
+  mxnet::io::RowCacheReader reader;
+  EXPECT_FALSE(reader.Open(path, "signature", arrays));
+  EXPECT_EQ(std::fopen(tmp_path.c_str(), "rb"), nullptr);
+}
+
+TEST(RowCache, InputStampTracksFileChanges) {
+  using mxnet::io::row_cache::InputStamp;
+  const std::string path = "row_cache_input_test.csv";
+  std::FILE* fp = std::fopen(path.c_str(), "w");
+  ASSERT_NE(fp, nullptr);
+  std::fputs("1,2\n", fp);
+  std::fclose(fp);
+  const std::string stamp = InputStamp(path);
+  EXPECT_EQ(InputStamp(path + "?format=csv"), stamp);
+  fp = std::fopen(path.c_str(), "a");
+  ASSERT_NE(fp, nullptr);
+  std::fputs("3,4\n", fp);
+  std::fclose(fp);
+  EXPECT_NE(InputStamp(path), stamp);
+  EXPECT_EQ(InputStamp(path + ";" + path), InputStamp(path) + InputStamp(path));
+  std::remove(path.c_str());
+  EXPECT_EQ(InputStamp("s3://bucket/data.csv"), " -");
+}
+#endif  // _WIN32
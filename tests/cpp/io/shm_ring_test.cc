@@ -0,0 +1,92 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ *  Copyright (c) 2018 by Contributors
+ * \file shm_ring_test.cc
+ * \brief test passing batches between processes through a shared memory ring
+ */
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <string>
+#include <vector>
+#include "../../src/io/shm_ring.h"
+
+#ifdef __linux__
+TEST(ShmRing, PassesBatchesBetweenProcesses) {
+  using mxnet::io::ShmRing;
+  const std::string name = "mx_shm_ring_test_" + std::to_string(getpid());
+  const int num_producers = 2, num_batches = 100;
+  // fewer slots than batches, so the slots are recycled
+  ShmRing ring(name, 4, 1024);
+  std::vector<pid_t> children;
+  for (int p = 0; p < num_producers; ++p) {
+    pid_t pid = fork();
+    ASSERT_NE(pid, -1);
+    if (pid == 0) {
+      ShmRing producer(name);
+      std::vector<float> data(16);
+      std::vector<int32_t> label(4);
+      for (int b = 0; b < num_batches; ++b) {
+        for (size_t i = 0; i < data.size(); ++i) data[i] = p * 1000 + b + i;
+        for (size_t i = 0; i < label.size(); ++i) label[i] = p;
+        std::vector<mxnet::TBlob> arrays = {
+          mxnet::TBlob(data.data(), mshadow::Shape2(4, 4), mxnet::cpu::kDevMask),
+          mxnet::TBlob(label.data(), mshadow::Shape1(4), mxnet::cpu::kDevMask)};
+        if (!producer.Push(arrays, b % 3)) _exit(1);
+      }
+      _exit(producer.PushEndOfEpoch() ? 0 : 1);
+    }
+    children.push_back(pid);
+  }
+  std::vector<int> next_batch(num_producers, 0);
+  int num_ended = 0;
+  while (num_ended < num_producers) {
+    ShmRing::Slot slot;
+    ASSERT_TRUE(ring.AcquireRead(&slot));
+    if (slot.desc->end_of_epoch) {
+      ++num_ended;
+    } else {
+      ASSERT_EQ(slot.desc->num_arrays, 2U);
+      const mxnet::io::shm_ring::ArrayDesc& data = slot.desc->arrays[0];
+      const mxnet::io::shm_ring::ArrayDesc& label = slot.desc->arrays[1];
+      ASSERT_EQ(data.ndim, 2);
+      EXPECT_EQ(data.shape[0], 4);
+      EXPECT_EQ(data.type_flag, mshadow::kFloat32);
+      EXPECT_EQ(label.type_flag, mshadow::kInt32);
+      const float* values = reinterpret_cast<const float*>(slot.payload + data.offset);
+      const int32_t p = reinterpret_cast<const int32_t*>(slot.payload + label.offset)[0];
+      ASSERT_GE(p, 0);
+      ASSERT_LT(p, num_producers);
+      // batches of one producer arrive in order
+      const int b = next_batch[p]++;
+      EXPECT_EQ(slot.desc->num_batch_padd, b % 3);
+      for (int i = 0; i < 16; ++i) EXPECT_EQ(values[i], p * 1000 + b + i);
+    }
+    ring.ReleaseRead(slot);
+  }
+  for (int p = 0; p < num_producers; ++p) {
+    EXPECT_EQ(next_batch[p], num_batches);
+    int status = 0;
+    ASSERT_EQ(waitpid(children[p], &status, 0), children[p]);
+    EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+}
+#endif  // __linux__
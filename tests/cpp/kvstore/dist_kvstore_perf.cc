@@ -0,0 +1,280 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file dist_kvstore_perf.cc
+ * \brief push/pull throughput and latency of the dist kvstore on a loopback cluster
+ */
+#if MXNET_USE_DIST_KVSTORE && !defined(_WIN32)
+#include <gtest/gtest.h>
+#include <dmlc/timer.h>
+#include <mxnet/kvstore.h>
+#include <mxnet/ndarray.h>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "../include/test_util.h"
+#include "../../src/kvstore/kvstore_loopback.h"
+
+using namespace mxnet;
+
+namespace {
+const int kNumWorkers = 2;
+const int kRowLen = 64;
+
+// print a result line on the first worker
+void Report(KVStore* kv, const std::string& what, size_t bytes, int iters, double elapsed) {
+  if (kv->get_rank() != 0) return;
+  std::cout << "  " << std::setw(28) << std::left << what << std::right << std::fixed
+            << std::setprecision(1) << std::setw(10) << 2.0 * bytes * iters / elapsed / 1e6
+            << " MB/s" << std::setprecision(3) << std::setw(10) << elapsed / iters * 1e3
+            << " ms per push+pull" << std::endl;
+}
+
+// push and pull dense arrays of each size
+void DenseWorker(KVStore* kv, const std::vector<int64_t>& sizes, int iters) {
+  for (size_t i = 0; i < sizes.size(); ++i) {
+    const int key = static_cast<int>(i);
+    NDArray value(TShape{sizes[i]}, Context::CPU()), out(TShape{sizes[i]}, Context::CPU());
+    value = 1.0f;
+    kv->Init({key}, {value});
+    kv->Barrier();
+    const double start = dmlc::GetTime();
+    for (int it = 0; it < iters; ++it) {
+      kv->Push({key}, {value});
+      kv->Pull({key}, {&out});
+      out.WaitToRead();
+    }
+    const double elapsed = dmlc::GetTime() - start;
+    Report(kv, "dense " + std::to_string(sizes[i]) + " floats", sizes[i] * sizeof(real_t),
+           iters, elapsed);
+  }
+}
+
+// push and pull a tenth of the rows of row sparse arrays of each size
+void RowSparseWorker(KVStore* kv, const std::vector<int64_t>& sizes, int iters) {
+  for (size_t i = 0; i < sizes.size(); ++i) {
+    const int key = static_cast<int>(100 + i);
+    const int64_t num_rows = std::max<int64_t>(sizes[i] / kRowLen, 10);
+    const int64_t nnr = num_rows / 10;
+    const TShape shape{num_rows, kRowLen};
+    std::vector<real_t> init_data(num_rows * kRowLen, 1.0f), grad_data(nnr * kRowLen, 1.0f);
+    std::vector<int64_t> all_rows(num_rows), rows(nnr);
+    std::iota(all_rows.begin(), all_rows.end(), 0);
+    for (int64_t r = 0; r < nnr; ++r) rows[r] = r * 10;
+    NDArray init(kRowSparseStorage, shape,
+                 TBlob(init_data.data(), TShape{num_rows, kRowLen}, cpu::kDevMask),
+                 {TBlob(all_rows.data(), TShape{num_rows}, cpu::kDevMask)}, 0);
+    NDArray grad(kRowSparseStorage, shape,
+                 TBlob(grad_data.data(), TShape{nnr, kRowLen}, cpu::kDevMask),
+                 {TBlob(rows.data(), TShape{nnr}, cpu::kDevMask)}, 0);
+    NDArray row_ids(TBlob(rows.data(), TShape{nnr}, cpu::kDevMask), 0);
+    NDArray out(kRowSparseStorage, shape, Context::CPU());
+    kv->Init({key}, {init});
+    kv->Barrier();
+    const double start = dmlc::GetTime();
+    for (int it = 0; it < iters; ++it) {
+      kv->Push({key}, {grad});
+      kv->PullRowSparse({key}, {{&out, row_ids}});
+      out.WaitToRead();
+    }
+    const double elapsed = dmlc::GetTime() - start;
+    Report(kv, "row_sparse " + std::to_string(num_rows) + "x" + std::to_string(kRowLen),
+           nnr * kRowLen * sizeof(real_t), iters, elapsed);
+  }
+  // the arrays above view the vectors, finish with them before returning
+  Engine::Get()->WaitForAll();
+}
+
+// push and pull many small keys one after another, as the gluon trainer does
+void SmallKeysWorker(KVStore* kv, int first_key, int num_keys, int64_t size, int iters) {
+  std::vector<int> keys(num_keys);
+  std::iota(keys.begin(), keys.end(), first_key);
+  std::vector<NDArray> values, outs;
+  for (int i = 0; i < num_keys; ++i) {
+    values.emplace_back(TShape{size}, Context::CPU());
+    values.back() = 1.0f;
+    outs.emplace_back(TShape{size}, Context::CPU());
+  }
+  kv->Init(keys, values);
+  kv->Barrier();
+  const double start = dmlc::GetTime();
+  for (int it = 0; it < iters; ++it) {
+    for (int i = 0; i < num_keys; ++i) {
+      kv->Push({keys[i]}, {values[i]}, -i);
+      kv->Pull({keys[i]}, {&outs[i]}, -i);
+    }
+    for (auto& out : outs) out.WaitToRead();
+  }
+  const double elapsed = dmlc::GetTime() - start;
+  // without an updater the servers store the sum of the pushes of the workers
+  for (auto& out : outs) {
+    const real_t* data = out.data().dptr<real_t>();
+    for (int64_t j = 0; j < size; ++j) CHECK_EQ(data[j], kNumWorkers);
+  }
+  Report(kv, std::to_string(num_keys) + " keys of " + std::to_string(size) + " floats",
+         num_keys * size * sizeof(real_t), iters, elapsed);
+}
+
+// the second worker pushes the even keys only or one key per call, and waits several
+// fusion cycles before each push. the servers sum the pushes of each iteration
+void UnevenPushWorker(KVStore* kv, int first_key, int num_keys, bool one_per_call,
+                      int iters) {
+  const int64_t size = 1 << 8;
+  const bool second = kv->get_rank() == 1;
+  std::vector<int> keys(num_keys);
+  std::iota(keys.begin(), keys.end(), first_key);
+  std::vector<NDArray> values, outs;
+  for (int i = 0; i < num_keys; ++i) {
+    values.emplace_back(TShape{size}, Context::CPU());
+    values.back() = 0.0f;
+    outs.emplace_back(TShape{size}, Context::CPU());
+  }
+  kv->Init(keys, values);
+  kv->Barrier();
+  for (int it = 1; it <= iters; ++it) {
+    std::vector<int> push_keys;
+    std::vector<NDArray> push_values;
+    for (int i = 0; i < num_keys; ++i) {
+      if (second && !one_per_call && i % 2 != 0) continue;
+      values[i] = static_cast<real_t>((kv->get_rank() + 1) * it);
+      push_keys.push_back(keys[i]);
+      push_values.push_back(values[i]);
+    }
+    const auto wait = [second]() {
+      if (second) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    };
+    if (one_per_call) {
+      for (size_t i = 0; i < push_keys.size(); ++i) {
+        wait();
+        kv->Push({push_keys[i]}, {push_values[i]});
+      }
+    } else {
+      wait();
+      kv->Push(push_keys, push_values);
+    }
+    for (int i = 0; i < num_keys; ++i) kv->Pull({keys[i]}, {&outs[i]});
+    for (int i = 0; i < num_keys; ++i) {
+      const real_t expected = (one_per_call || i % 2 == 0) ? 3 * it : it;
+      const real_t* data = outs[i].data().dptr<real_t>();
+      for (int64_t j = 0; j < size; ++j) CHECK_EQ(data[j], expected) << "key " << keys[i];
+    }
+  }
+}
+}  // namespace
+
+/*!
+ * \brief dist_sync push/pull on a loopback cluster of 1 server and 2 workers, for
+ *  several key sizes, MXNET_KVSTORE_BIGARRAY_BOUND values, row sparse and dense
+ *  arrays and with and without 2bit compression, larger with --perf
+ */
+TEST(DistKVStore, LoopbackTiming) {
+  std::vector<int64_t> sizes = {1 << 10, 1 << 16};
+  if (test::performance_run) {
+    sizes = {1 << 10, 1 << 14, 1 << 18, 1 << 22};
+  }
+  const int iters = test::performance_run ? 100 : 5;
+  const ::testing::TestInfo* info = ::testing::UnitTest::GetInstance()->current_test_info();
+  std::vector<std::string> args = {"dist_kvstore_perf", std::string("--gtest_filter=") +
+                                   info->test_case_name() + "." + info->name()};
+  if (test::performance_run) args.push_back("--perf");
+  for (int num_servers : {1, 2}) {
+    for (const char* bound : {"1000000", "10000"}) {
+      for (bool compressed : {false, true}) {
+        kvstore::LoopbackCluster cluster(num_servers, kNumWorkers);
+        cluster.SetArgs(args);
+        cluster.SetEnv("MXNET_KVSTORE_BIGARRAY_BOUND", bound);
+        const int num_failed = cluster.Run([&]() {
+            std::unique_ptr<KVStore> kv(KVStore::Create("dist_sync"));
+            if (kv->get_rank() == 0) {
+              std::cout << num_servers << " servers, " << kNumWorkers << " workers, "
+                        << "MXNET_KVSTORE_BIGARRAY_BOUND=" << bound
+                        << (compressed ? ", 2bit compression" : "") << std::endl;
+            }
+            if (compressed) {
+              kv->SetGradientCompression({{"type", "2bit"}, {"threshold", "0.5"}});
+            }
+            DenseWorker(kv.get(), sizes, iters);
+            // gradient compression only applies to dense arrays
+            if (!compressed) RowSparseWorker(kv.get(), sizes, iters);
+          });
+        EXPECT_EQ(num_failed, 0);
+      }
+    }
+  }
+}
+
+/*!
+ * \brief dist_sync push/pull of many small keys with and without fusing them into
+ *  buckets of MXNET_KVSTORE_FUSION_BUCKET_SIZE bytes
+ */
+TEST(DistKVStore, LoopbackFusionTiming) {
+  const int num_keys = test::performance_run ? 256 : 32;
+  const int iters = test::performance_run ? 100 : 5;
+  const ::testing::TestInfo* info = ::testing::UnitTest::GetInstance()->current_test_info();
+  std::vector<std::string> args = {"dist_kvstore_perf", std::string("--gtest_filter=") +
+                                   info->test_case_name() + "." + info->name()};
+  if (test::performance_run) args.push_back("--perf");
+  for (const char* bucket_size : {"0", "65536", "4194304"}) {
+    kvstore::LoopbackCluster cluster(1, kNumWorkers);
+    cluster.SetArgs(args);
+    cluster.SetEnv("MXNET_KVSTORE_FUSION_BUCKET_SIZE", bucket_size);
+    const int num_failed = cluster.Run([&]() {
+        std::unique_ptr<KVStore> kv(KVStore::Create("dist_sync"));
+        if (kv->get_rank() == 0) {
+          std::cout << "MXNET_KVSTORE_FUSION_BUCKET_SIZE=" << bucket_size << std::endl;
+        }
+        SmallKeysWorker(kv.get(), 1000, num_keys, 1 << 8, iters);
+        SmallKeysWorker(kv.get(), 2000, num_keys, 1 << 12, iters);
+      });
+    EXPECT_EQ(num_failed, 0);
+  }
+}
+
+/*!
+ * \brief dist_sync fusion with workers that push different keys at different speeds,
+ *  each push of a bucket needs to be summed with the pushes of the same iteration
+ */
+TEST(DistKVStore, LoopbackFusionUneven) {
+  const ::testing::TestInfo* info = ::testing::UnitTest::GetInstance()->current_test_info();
+  std::vector<std::string> args = {"dist_kvstore_perf", std::string("--gtest_filter=") +
+                                   info->test_case_name() + "." + info->name()};
+  for (const char* bucket_size : {"4096", "65536"}) {
+    kvstore::LoopbackCluster cluster(1, kNumWorkers);
+    cluster.SetArgs(args);
+    cluster.SetEnv("MXNET_KVSTORE_FUSION_BUCKET_SIZE", bucket_size);
+    cluster.SetEnv("MXNET_KVSTORE_FUSION_CYCLE_TIME", "1");
+    const int num_failed = cluster.Run([&]() {
+        std::unique_ptr<KVStore> kv(KVStore::Create("dist_sync"));
+        // with 3 keys a bucket of 4096 bytes, each bucket holds an even key
+        UnevenPushWorker(kv.get(), 1000, 15, false, 5);
+        UnevenPushWorker(kv.get(), 2000, 15, true, 5);
+      });
+    EXPECT_EQ(num_failed, 0);
+  }
+}
+#endif  // MXNET_USE_DIST_KVSTORE && !defined(_WIN32)
@@ -0,0 +1,194 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file gradient_compression_perf.cc
+ * \brief error feedback of the gradient compression types, and their compression
+ *  ratio and encode/decode GB/s on cpu
+ */
+#include <gtest/gtest.h>
+#include <dmlc/timer.h>
+#include <mxnet/ndarray.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../include/test_util.h"
+#include "../../src/kvstore/gradient_compression.h"
+
+using namespace mxnet;
+
+namespace {
+const std::vector<std::vector<std::pair<std::string, std::string> > > kCompressions = {
+  {{"type", "2bit"}, {"threshold", "0.5"}},
+  {{"type", "topk"}, {"ratio", "0.01"}},
+  {{"type", "1bit"}},
+  {{"type", "fp16"}},
+};
+
+std::vector<real_t> RandomGradient(size_t size) {
+  std::mt19937 gen(17);
+  std::normal_distribution<real_t> dist(0, 1);
+  std::vector<real_t> grad(size);
+  for (real_t& v : grad) v = dist(gen);
+  return grad;
+}
+
+std::vector<real_t> ToVector(const NDArray& arr) {
+  std::vector<real_t> out(arr.shape().Size());
+  arr.SyncCopyToCPU(out.data(), out.size());
+  return out;
+}
+
+// value by value 2bit quantization, as the generic kernel did it
+void Quantize2BitReference(const std::vector<real_t>& grad, std::vector<real_t>* residual,
+                           std::vector<uint8_t>* out, real_t threshold) {
+  const uint8_t posbits[] = {0xc0, 0x30, 0x0c, 0x03};
+  const uint8_t negbits[] = {0x80, 0x20, 0x08, 0x02};
+  std::fill(out->begin(), out->end(), 0);
+  for (size_t i = 0; i < grad.size(); ++i) {
+    (*residual)[i] += grad[i];
+    if ((*residual)[i] >= threshold) {
+      (*out)[i >> 2] |= posbits[i & 3];
+      (*residual)[i] -= threshold;
+    } else if ((*residual)[i] <= -threshold) {
+      (*out)[i >> 2] |= negbits[i & 3];
+      (*residual)[i] += threshold;
+    }
+  }
+}
+}  // namespace
+
+/*!
+ * \brief the vectorized and threaded 2bit kernels give the same codes, residuals and
+ *  decoded values as quantizing value by value
+ */
+TEST(GradientCompression, TwoBitMatchesReference) {
+  const real_t threshold = 0.5f;
+  for (const int64_t size : {int64_t(7), int64_t(16 * 5000 + 9), int64_t(1 << 20)}) {
+    std::vector<real_t> grad_data = RandomGradient(size);
+    // values right at the thresholds
+    for (int64_t i = 0; i < size; i += 37) grad_data[i] = (i % 2) ? threshold : -threshold;
+    kvstore::GradientCompression gc;
+    gc.SetParams({{"type", "2bit"}, {"threshold", "0.5"}});
+    const int64_t compressed_size = gc.GetCompressedSize(size);
+    NDArray grad(TShape{size}, Context::CPU()), residual(TShape{size}, Context::CPU());
+    NDArray compressed(TShape{compressed_size}, Context::CPU());
+    NDArray decoded(TShape{size}, Context::CPU());
+    grad.SyncCopyFromCPU(grad_data.data(), size);
+    residual = 0.0f;
+    std::vector<real_t> ref_residual(size, 0.0f);
+    std::vector<uint8_t> ref_codes(compressed_size * sizeof(real_t));
+    for (int round = 0; round < 3; ++round) {
+      gc.Quantize(grad, &compressed, &residual, 0);
+      gc.Dequantize(compressed, &decoded, 0);
+      Quantize2BitReference(grad_data, &ref_residual, &ref_codes, threshold);
+      const std::vector<real_t> codes = ToVector(compressed), res = ToVector(residual);
+      const std::vector<real_t> out = ToVector(decoded);
+      ASSERT_EQ(std::memcmp(codes.data(), ref_codes.data(), ref_codes.size()), 0)
+        << "size " << size << " round " << round;
+      ASSERT_EQ(std::memcmp(res.data(), ref_residual.data(), size * sizeof(real_t)), 0)
+        << "size " << size << " round " << round;
+      for (int64_t i = 0; i < size; ++i) {
+        const int code = (ref_codes[i >> 2] >> (6 - 2 * (i & 3))) & 3;
+        const real_t expected = code == 3 ? threshold : (code == 2 ? -threshold : 0.0f);
+        ASSERT_EQ(out[i], expected) << "size " << size << " value " << i;
+      }
+    }
+  }
+}
+
+/*!
+ * \brief what is not sent stays in the residual: decoded + residual after a push
+ *  equals gradient + residual before it. fp16 keeps no residual and rounds instead
+ */
+TEST(GradientCompression, ErrorFeedback) {
+  // not a multiple of any block size
+  const int64_t size = 3 * 1024 + 77;
+  const std::vector<real_t> grad_data = RandomGradient(size);
+  for (const auto& params : kCompressions) {
+    kvstore::GradientCompression gc;
+    gc.SetParams(params);
+    NDArray grad(TShape{size}, Context::CPU()), residual(TShape{size}, Context::CPU());
+    NDArray decoded(TShape{size}, Context::CPU());
+    NDArray compressed(TShape{gc.GetCompressedSize(size)}, Context::CPU());
+    grad.SyncCopyFromCPU(grad_data.data(), size);
+    residual = 0.0f;
+    for (int round = 0; round < 3; ++round) {
+      const std::vector<real_t> before = ToVector(residual);
+      gc.Quantize(grad, &compressed, &residual, 0);
+      gc.Dequantize(compressed, &decoded, 0);
+      const std::vector<real_t> after = ToVector(residual), out = ToVector(decoded);
+      for (int64_t i = 0; i < size; ++i) {
+        if (params[0].second == "fp16") {
+          ASSERT_NEAR(out[i], grad_data[i], 1e-3 * std::abs(grad_data[i]) + 1e-6);
+        } else {
+          ASSERT_NEAR(out[i] + after[i], grad_data[i] + before[i], 1e-4)
+            << params[0].second << " round " << round << " value " << i;
+        }
+      }
+    }
+  }
+}
+
+/*!
+ * \brief compression ratio and encode/decode GB/s of the original gradient for each
+ *  type, larger with --perf
+ */
+TEST(GradientCompression, TimingCPU) {
+  std::vector<int64_t> sizes = {1 << 16, 1 << 20};
+  if (test::performance_run) {
+    sizes = {1 << 16, 1 << 20, 1 << 24, 1 << 26};
+  }
+  const int iters = test::performance_run ? 20 : 2;
+  for (const int64_t size : sizes) {
+    const std::vector<real_t> grad_data = RandomGradient(size);
+    for (const auto& params : kCompressions) {
+      kvstore::GradientCompression gc;
+      gc.SetParams(params);
+      const int64_t compressed_size = gc.GetCompressedSize(size);
+      NDArray grad(TShape{size}, Context::CPU()), residual(TShape{size}, Context::CPU());
+      NDArray decoded(TShape{size}, Context::CPU());
+      NDArray compressed(TShape{compressed_size}, Context::CPU());
+      grad.SyncCopyFromCPU(grad_data.data(), size);
+      residual = 0.0f;
+      residual.WaitToRead();
+      double start = dmlc::GetTime();
+      for (int i = 0; i < iters; ++i) gc.Quantize(grad, &compressed, &residual, 0);
+      compressed.WaitToRead();
+      const double encode = dmlc::GetTime() - start;
+      start = dmlc::GetTime();
+      for (int i = 0; i < iters; ++i) gc.Dequantize(compressed, &decoded, 0);
+      decoded.WaitToRead();
+      const double decode = dmlc::GetTime() - start;
+      const double bytes = static_cast<double>(size) * sizeof(real_t) * iters;
+      std::cout << std::setw(5) << params[0].second << std::setw(10) << size << " floats: "
+                << std::fixed << std::setprecision(1) << std::setw(6)
+                << static_cast<double>(size) / compressed_size << "x smaller, encode "
+                << std::setprecision(2) << bytes / encode / 1e9 << " GB/s, decode "
+                << bytes / decode / 1e9 << " GB/s" << std::endl;
+    }
+  }
+}
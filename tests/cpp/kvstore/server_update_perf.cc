@@ -0,0 +1,143 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*!
+ * Copyright (c) 2018 by Contributors
+ * \file server_update_perf.cc
+ * \brief ordering of the sharded executor, and updates/sec of server style
+ *  merges and serialized updates against the number of update threads
+ */
+#include <gtest/gtest.h>
+#include <dmlc/timer.h>
+#include <mxnet/ndarray.h>
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "../include/test_util.h"
+#include "../../src/kvstore/sharded_executor.h"
+
+using namespace mxnet;
+
+/*!
+ * \brief functions of a shard run in submission order
+ */
+TEST(ShardedExecutor, KeepsShardOrder) {
+  const int num_shards = 13, per_shard = 200;
+  std::vector<std::vector<int> > seen(num_shards);
+  {
+    kvstore::ShardedExecutor exec(4);
+    for (int i = 0; i < per_shard; ++i) {
+      for (int shard = 0; shard < num_shards; ++shard) {
+        exec.Exec(shard, [&seen, shard, i]() { seen[shard].push_back(i); });
+      }
+    }
+    exec.Wait();
+    for (int shard = 0; shard < num_shards; ++shard) {
+      ASSERT_EQ(seen[shard].size(), static_cast<size_t>(per_shard));
+      for (int i = 0; i < per_shard; ++i) {
+        EXPECT_EQ(seen[shard][i], i);
+      }
+    }
+  }
+}
+
+namespace {
+// merge buffer and weight of a key, as kept by KVStoreDistServer in sync mode
+struct KeyState {
+  NDArray merged, stored;
+  int num_pushed{0};
+};
+
+// merge a push like DataHandleDefault, and update once all workers pushed. like
+// RunUpdater, the update runs on the single main thread and the caller waits for it
+void PushKey(KeyState* state, const NDArray& recved, int num_workers,
+             kvstore::ShardedExecutor* main_thread) {
+  if (state->num_pushed == 0) {
+    CopyFromTo(recved, &state->merged);
+  } else {
+    state->merged += recved;
+  }
+  if (++state->num_pushed == num_workers) {
+    state->num_pushed = 0;
+    std::promise<void> updated;
+    main_thread->Exec(0, [state, &updated]() {
+        // plain sgd step standing in for the updater
+        state->merged *= 0.01f;
+        state->stored -= state->merged;
+        state->stored.WaitToRead();
+        updated.set_value();
+      });
+    updated.get_future().wait();
+  } else {
+    state->merged.WaitToRead();
+  }
+}
+}  // namespace
+
+/*!
+ * \brief server updates/sec with 1 to N update threads, larger with --perf. only the
+ *  merges run on the update threads, the updates are serialized as in the server
+ */
+TEST(ShardedExecutor, ServerUpdateTiming) {
+  const int num_keys = test::performance_run ? 64 : 8;
+  const int key_size = test::performance_run ? 1 << 20 : 1 << 12;
+  const int num_workers = 4, rounds = test::performance_run ? 10 : 2;
+  const int max_threads = std::max<int>(1, std::thread::hardware_concurrency());
+  std::vector<NDArray> recved(num_workers);
+  for (int w = 0; w < num_workers; ++w) {
+    recved[w] = NDArray(TShape{key_size}, Context::CPU());
+    recved[w] = static_cast<real_t>(w + 1);
+  }
+  for (int num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+    std::vector<KeyState> states(num_keys);
+    for (KeyState& state : states) {
+      state.merged = NDArray(TShape{key_size}, Context::CPU());
+      state.stored = NDArray(TShape{key_size}, Context::CPU());
+      state.stored = 0.0f;
+    }
+    kvstore::ShardedExecutor main_thread(1);
+    kvstore::ShardedExecutor exec(num_threads);
+    const double start = dmlc::GetTime();
+    for (int r = 0; r < rounds; ++r) {
+      for (int w = 0; w < num_workers; ++w) {
+        for (int key = 0; key < num_keys; ++key) {
+          KeyState* state = &states[key];
+          const NDArray& push = recved[w];
+          exec.Exec(key, [state, push, num_workers, &main_thread]() {
+              PushKey(state, push, num_workers, &main_thread);
+            });
+        }
+      }
+    }
+    exec.Wait();
+    const double elapsed = dmlc::GetTime() - start;
+    // every round adds 0.01 * (1 + ... + num_workers) to each weight
+    std::vector<real_t> weight(key_size);
+    states[0].stored.SyncCopyToCPU(weight.data(), weight.size());
+    EXPECT_NEAR(weight[0], -0.01f * rounds * num_workers * (num_workers + 1) / 2, 1e-4);
+    std::cout << num_threads << " update threads: " << std::fixed << std::setprecision(0)
+              << num_keys * rounds / elapsed << " updates/sec, "
+              << num_keys * rounds * num_workers / elapsed << " pushes/sec of "
+              << key_size << " floats" << std::endl;
+  }
+}
@@ -27,6 +27,8 @@
 #include <mxnet/storage.h>
 #include <cstdio>
 #include "test_util.h"
+#include "../src/storage/cpu_device_storage.h"
+#include "../src/storage/pooled_storage_manager.h"
 
 TEST(Storage, Basic_CPU) {
   constexpr size_t kSize = 1024;
@@ -42,6 +44,75 @@ TEST(Storage, Basic_CPU) {
   storage->Free(handle);
 }
 
+TEST(Storage, Pooled_CPU) {
+  using CPUPool = mxnet::storage::CPUPooledStorageManager<mxnet::storage::CPUDeviceStorage>;
+  mxnet::Context context_cpu{};
+  {
+    CPUPool pool(false);
+    mxnet::Storage::Handle handle;
+    handle.size = 1000;
+    handle.ctx = context_cpu;
+    pool.Alloc(&handle);
+    auto ptr = handle.dptr;
+    pool.Free(handle);
+    // same page-rounded size class is reused
+    handle.size = 4096;
+    pool.Alloc(&handle);
+    EXPECT_EQ(handle.dptr, ptr);
+    size_t used, pooled;
+    EXPECT_TRUE(pool.GetPoolStats(&used, &pooled));
+    EXPECT_EQ(used, 4096);
+    EXPECT_EQ(pooled, 0);
+    pool.Free(handle);
+    EXPECT_TRUE(pool.GetPoolStats(&used, &pooled));
+    EXPECT_EQ(pooled, 4096);
+    pool.ReleaseAll();
+    EXPECT_TRUE(pool.GetPoolStats(&used, &pooled));
+    EXPECT_EQ(used, 0);
+    EXPECT_EQ(pooled, 0);
+  }
+  {
+    putenv("MXNET_CPU_MEM_POOL_ROUND_LINEAR_CUTOFF=20");
+    CPUPool pool(true);
+    mxnet::Storage::Handle handle, handle2;
+    handle.size = 32;
+    handle.ctx = context_cpu;
+    handle2.size = 2097153;
+    handle2.ctx = context_cpu;
+    pool.Alloc(&handle);
+    pool.Alloc(&handle2);
+    auto ptr = handle.dptr;
+    auto ptr2 = handle2.dptr;
+    pool.Free(handle);
+    pool.Free(handle2);
+
+    handle.size = 4095;
+    pool.Alloc(&handle);
+    EXPECT_EQ(handle.dptr, ptr);
+    handle2.size = 3145728;
+    pool.Alloc(&handle2);
+    EXPECT_EQ(handle2.dptr, ptr2);
+    pool.Free(handle);
+    pool.Free(handle2);
+    unsetenv("MXNET_CPU_MEM_POOL_ROUND_LINEAR_CUTOFF");
+  }
+  {
+    // chunks freed beyond the limit are not cached
+    putenv("MXNET_CPU_MEM_POOL_LIMIT=1");
+    CPUPool pool(false);
+    mxnet::Storage::Handle handle;
+    handle.size = 2 << 20;
+    handle.ctx = context_cpu;
+    pool.Alloc(&handle);
+    pool.Free(handle);
+    size_t used, pooled;
+    EXPECT_TRUE(pool.GetPoolStats(&used, &pooled));
+    EXPECT_EQ(used, 0);
+    EXPECT_EQ(pooled, 0);
+    unsetenv("MXNET_CPU_MEM_POOL_LIMIT");
+  }
+}
+
 #if MXNET_USE_CUDA
 TEST(Storage_GPU, Basic_GPU) {
   if (mxnet::test::unitTestsWithCuda) {
@@ -165,6 +165,184 @@ def test_reshape():
     assert np.all(new_exe.arg_arrays[1].asnumpy() == 1)
 
 
+@with_seed()
+def test_reshape_buckets():
+    # executors reshaped to shapes that fit in the memory plan of an earlier
+    # executor reuse its plan, others are planned anew
+    x = mx.sym.Variable('x')
+    h = mx.sym.FullyConnected(x, num_hidden=16, name='fc1')
+    h = mx.sym.Activation(h, act_type='tanh')
+    y = mx.sym.FullyConnected(h, num_hidden=4, name='fc2')
+    y = mx.sym.softmax(y)
+
+    exe = y.simple_bind(mx.cpu(), x=(8, 10), grad_req='null')
+    for arr in exe.arg_arrays[1:]:
+        arr[:] = np.random.uniform(-1, 1, arr.shape)
+    args = dict(zip(y.list_arguments(), exe.arg_arrays))
+
+    def check(exe, batch):
+        x_np = np.random.uniform(-1, 1, (batch, 10))
+        exe.arg_dict['x'][:] = x_np
+        exe.forward(is_train=False)
+        h_np = np.tanh(np.dot(x_np, args['fc1_weight'].asnumpy().T) + args['fc1_bias'].asnumpy())
+        y_np = np.dot(h_np, args['fc2_weight'].asnumpy().T) + args['fc2_bias'].asnumpy()
+        y_np = np.exp(y_np - y_np.max(axis=1, keepdims=True))
+        y_np /= y_np.sum(axis=1, keepdims=True)
+        assert_almost_equal(exe.outputs[0].asnumpy(), y_np, rtol=1e-4, atol=1e-5)
+
+    check(exe, 8)
+    # only batch 12 exceeds the plans of the earlier batches when it comes first
+    for batch, reused in [(3, True), (8, True), (1, True), (12, False), (5, True),
+                          (12, True), (2, True)]:
+        new_exe = exe.reshape(allow_up_sizing=True, x=(batch, 10))
+        assert ('Reshape reused the memory plan' in new_exe.debug_str()) == reused
+        check(new_exe, batch)
+        exe = new_exe
+
+
+@with_seed()
+def test_parallel_init():
+    # graphs with many nodes create their operators in parallel
+    x = mx.sym.Variable('x')
+    y = x
+    for i in range(300):
+        y = mx.sym.FullyConnected(y, num_hidden=8, no_bias=True, name='fc%d' % i)
+        y = mx.sym.clip(y, -1, 1)
+    shape = (4, 8)
+    exe = y.simple_bind(mx.cpu(), x=shape)
+    assert np.all(exe.grad_dict['fc0_weight'].asnumpy() == 0)
+    y_np = np.random.uniform(-1, 1, shape)
+    exe.arg_dict['x'][:] = y_np
+    for i in range(300):
+        w = np.random.uniform(-0.5, 0.5, (8, 8))
+        exe.arg_dict['fc%d_weight' % i][:] = w
+        y_np = np.clip(np.dot(y_np, w.T), -1, 1)
+    exe.forward(is_train=False)
+    assert_almost_equal(exe.outputs[0].asnumpy(), y_np, rtol=1e-3, atol=1e-5)
+
+
+@with_seed()
+def test_elemwise_fusion():
+    # chains of elementwise operators are run by a single fused kernel,
+    # intermediate results used outside of the chain must still be written
+    a = mx.sym.Variable('a')
+    b = mx.sym.Variable('b')
+    x = mx.sym.relu(a * 2 - 1)
+    y = mx.sym.Activation(x + b, act_type='sigmoid')
+    z = mx.sym.sqrt(mx.sym.abs(y * x) + 1)
+    shape = (64, 1000)
+    a_np = np.random.uniform(-1, 1, shape)
+    b_np = np.random.uniform(-1, 1, shape)
+    x_np = np.maximum(a_np * 2 - 1, 0)
+    y_np = 1 / (1 + np.exp(-(x_np + b_np)))
+    z_np = np.sqrt(np.abs(y_np * x_np) + 1)
+    for is_train in [False, True]:
+        exe = mx.sym.Group([x, z]).simple_bind(mx.cpu(), a=shape, b=shape,
+                                               grad_req='write' if is_train else 'null')
+        # the forward pass is split in two chains by the variable b
+        fused = [line.split()[1:] for line in exe.debug_str().splitlines()
+                 if line.startswith('FusedElemwise:')]
+        assert len(fused) >= 2
+        assert [len(names) for names in fused[:2]] == [3, 6]
+        exe.arg_dict['a'][:] = a_np
+        exe.arg_dict['b'][:] = b_np
+        exe.forward(is_train=is_train)
+        assert_almost_equal(exe.outputs[0].asnumpy(), x_np, rtol=1e-5, atol=1e-6)
+        assert_almost_equal(exe.outputs[1].asnumpy(), z_np, rtol=1e-5, atol=1e-6)
+        if is_train:
+            exe.backward([mx.nd.zeros(shape), mx.nd.ones(shape)])
+            dz_dy = x_np / (2 * z_np) * np.sign(y_np * x_np)
+            dz_db = dz_dy * y_np * (1 - y_np)
+            assert_almost_equal(exe.grad_dict['b'].asnumpy(), dz_db, rtol=1e-4, atol=1e-5)
+
+
+@with_seed()
+def test_arena_memory_plan():
+    # the arena plan must give the same results as the plan by storage id
+    import os
+    data = mx.sym.Variable('data')
+    net = mx.sym.FullyConnected(data, num_hidden=64, name='fc1')
+    net = mx.sym.Activation(net, act_type='relu')
+    branch = mx.sym.FullyConnected(net, num_hidden=64, name='fc2')
+    net = mx.sym.Activation(net + branch, act_type='tanh')
+    net = mx.sym.FullyConnected(net, num_hidden=10, name='fc3')
+    net = mx.sym.SoftmaxOutput(net, name='softmax')
+    shapes = {'data': (32, 100), 'softmax_label': (32,)}
+    args = {name: mx.nd.random.uniform(-0.1, 0.1, shape) for name, shape in
+            zip(net.list_arguments(), net.infer_shape(**shapes)[0])}
+    results = []
+    for arena in ['0', '1']:
+        os.environ['MXNET_MEM_PLAN_ARENA'] = arena
+        try:
+            exe = net.simple_bind(mx.cpu(), **shapes)
+        finally:
+            del os.environ['MXNET_MEM_PLAN_ARENA']
+        for name, arr in args.items():
+            exe.arg_dict[name][:] = arr
+        exe.forward(is_train=True)
+        exe.backward()
+        results.append([exe.outputs[0].asnumpy()] +
+                       [exe.grad_dict[name].asnumpy() for name in sorted(args)])
+    for expected, actual in zip(results[0], results[1]):
+        assert_almost_equal(expected, actual)
+
+
+@with_seed()
+def test_gradient_checkpointing():
+    # recomputing forward nodes in the backward pass must not change the gradients
+    import os
+    data = mx.sym.Variable('data')
+    net = data
+    for i in range(6):
+        net = mx.sym.FullyConnected(net, num_hidden=32, name='fc%d' % i)
+        if i == 3:
+            with mx.AttrScope(__checkpoint__='True'):
+                net = mx.sym.Activation(net, act_type='tanh', name='checkpoint')
+        else:
+            net = mx.sym.Activation(net, act_type='relu')
+    net = mx.sym.sum(net)
+    shape = (16, 32)
+    args = {name: mx.nd.random.uniform(-0.5, 0.5, arg_shape) for name, arg_shape in
+            zip(net.list_arguments(), net.infer_shape(data=shape)[0])}
+
+    def run_executor():
+        exe = net.simple_bind(mx.cpu(), data=shape)
+        for name, arr in args.items():
+            exe.arg_dict[name][:] = arr
+        exe.forward(is_train=True)
+        exe.backward()
+        return [exe.grad_dict[name].asnumpy() for name in sorted(args)], exe.debug_str()
+
+    def run_cached_op():
+        block = mx.gluon.SymbolBlock(net, [data], params=None)
+        for param in block.collect_params().values():
+            param._load_init(args[param.name], mx.cpu())
+        block.hybridize(static_alloc=True)
+        x = args['data'].copy()
+        x.attach_grad()
+        with mx.autograd.record():
+            y = block(x)
+        y.backward()
+        return [x.grad.asnumpy()]
+
+    expected_grads, graph = run_executor()
+    assert '_mirror' not in graph
+    expected = [expected_grads, run_cached_op()]
+    for budget in ['0', '-1', '0.01']:
+        os.environ['MXNET_BACKWARD_CHECKPOINT_MB'] = budget
+        try:
+            executor_grads, graph = run_executor()
+            actual = [executor_grads, run_cached_op()]
+        finally:
+            del os.environ['MXNET_BACKWARD_CHECKPOINT_MB']
+        # the backward pass recomputes forward nodes as mirrors, but never the checkpoint
+        assert '_mirror' in graph, budget
+        assert 'checkpoint_mirror' not in graph, budget
+        for grads, expected_grads in zip(actual, expected):
+            for grad, expected_grad in zip(grads, expected_grads):
+                assert_almost_equal(grad, expected_grad, rtol=1e-5, atol=1e-6)
+
+
 if __name__ == "__main__":
     import nose
     nose.runmodule()
@@ -337,6 +337,159 @@ def test_CSVIter():
     for dtype in ['int32', 'int64', 'float32']:
         check_CSVIter_synthetic(dtype=dtype)
 
+def test_block_parallel_text_iters():
+    cwd = os.getcwd()
+    data_path = os.path.join(cwd, 'block_data.csv')
+    label_path = os.path.join(cwd, 'block_label.csv')
+    with open(data_path, 'w') as fout:
+        for i in range(1003):
+            fout.write(','.join([str(i * 7 + j) for j in range(6)]) + '\n')
+    with open(label_path, 'w') as fout:
+        for i in range(1003):
+            fout.write('%d,%d\n' % (i, -i))
+    # the block-parallel parser returns the same batches as the row by row parser
+    for round_batch in [True, False]:
+        for dtype in ['int32', 'int64', 'float32']:
+            kwargs = dict(data_csv=data_path, data_shape=(2, 3), label_csv=label_path,
+                          label_shape=(2,), batch_size=100, round_batch=round_batch, dtype=dtype)
+            ref = mx.io.CSVIter(**kwargs)
+            block = mx.io.CSVIter(parse_threads=3, parse_chunk_size=1, **kwargs)
+            for epoch in range(2):
+                ref.reset()
+                block.reset()
+                for ref_batch, block_batch in zip(ref, block):
+                    assert ref_batch.pad == block_batch.pad
+                    valid = 100 - ref_batch.pad
+                    assert_almost_equal(ref_batch.data[0].asnumpy()[:valid],
+                                        block_batch.data[0].asnumpy()[:valid])
+                    assert_almost_equal(ref_batch.label[0].asnumpy()[:valid],
+                                        block_batch.label[0].asnumpy()[:valid])
+                assert next(ref, None) is None
+                assert next(block, None) is None
+
+    libsvm_path = os.path.join(cwd, 'block_data.t')
+    with open(libsvm_path, 'w') as fout:
+        for i in range(1003):
+            feats = ['%d:%.1f' % (j, i + j * 0.5) for j in range(i % 5, 10, 3)]
+            fout.write(' '.join([str(i % 3)] + feats) + '\n')
+    kwargs = dict(data_libsvm=libsvm_path, data_shape=(10,), batch_size=64)
+    ref = mx.io.LibSVMIter(**kwargs)
+    block = mx.io.LibSVMIter(parse_threads=4, **kwargs)
+    for epoch in range(2):
+        ref.reset()
+        block.reset()
+        for ref_batch, block_batch in zip(ref, block):
+            assert ref_batch.pad == block_batch.pad
+            block_batch.data[0].check_format(True)
+            assert_almost_equal(ref_batch.data[0].asnumpy(), block_batch.data[0].asnumpy())
+            assert_almost_equal(ref_batch.label[0].asnumpy(), block_batch.label[0].asnumpy())
+        assert next(ref, None) is None
+        assert next(block, None) is None
+
+def test_text_iter_cache():
+    cwd = os.getcwd()
+    data_path = os.path.join(cwd, 'cache_data.csv')
+    libsvm_path = os.path.join(cwd, 'cache_data.t')
+
+    def write_csv(offset):
+        with open(data_path, 'w') as fout:
+            for i in range(250):
+                fout.write(','.join([str(offset + i + j) for j in range(4)]) + '\n')
+
+    def write_libsvm(offset):
+        with open(libsvm_path, 'w') as fout:
+            for i in range(250):
+                feats = ['%d:%.1f' % (j, offset + i - j) for j in range(i % 3, 8, 2)]
+                fout.write(' '.join([str(i % 2)] + feats) + '\n')
+
+    def check(make_iter, write, cache_path):
+        write(0)
+        if os.path.exists(cache_path):
+            os.remove(cache_path)
+        ref = [(b.data[0].asnumpy(), b.label[0].asnumpy(), b.pad) for b in make_iter()]
+        cached = make_iter(cache_file=cache_path)
+        # the first pass parses the text and writes the cache, the second pass reads it
+        for epoch in range(2):
+            cached.reset()
+            batches = list(cached)
+            assert len(batches) == len(ref)
+            for (data, label, pad), batch in zip(ref, batches):
+                assert pad == batch.pad
+                assert_almost_equal(data, batch.data[0].asnumpy())
+                assert_almost_equal(label, batch.label[0].asnumpy())
+        assert os.path.exists(cache_path)
+        # a rewritten input changes the stamp in the signature, so a new iterator
+        # parses the text again instead of reading the stale cache
+        write(1000)
+        try:
+            new_ref = [b.data[0].asnumpy() for b in make_iter()]
+            assert not np.array_equal(new_ref[0], ref[0][0])
+            batches = [b.data[0].asnumpy() for b in make_iter(cache_file=cache_path)]
+            assert len(batches) == len(new_ref)
+            for data, batch in zip(new_ref, batches):
+                assert_almost_equal(data, batch)
+        finally:
+            os.remove(cache_path)
+
+    check(lambda **kwargs: mx.io.CSVIter(data_csv=data_path, data_shape=(2, 2), batch_size=50,
+                                         **kwargs),
+          write_csv, os.path.join(cwd, 'cache_data.csv.cache'))
+    check(lambda **kwargs: mx.io.LibSVMIter(data_libsvm=libsvm_path, data_shape=(8,),
+                                            batch_size=50, **kwargs),
+          write_libsvm, os.path.join(cwd, 'cache_data.t.cache'))
+
+def test_adaptive_prefetch():
+    data_path = os.path.join(os.getcwd(), 'prefetch_data.csv')
+    with open(data_path, 'w') as fout:
+        for i in range(1000):
+            fout.write(','.join([str(i)] * 8) + '\n')
+    make_iter = lambda **kwargs: mx.io.CSVIter(data_csv=data_path, data_shape=(8,),
+                                               batch_size=10, **kwargs)
+    ref = [batch.data[0].asnumpy() for batch in make_iter()]
+    # with and without a memory budget, every batch is returned in order
+    for memory in [0, 1]:
+        data_iter = make_iter(adaptive_prefetch=True, prefetch_memory=memory, prefetch_buffer=2)
+        for epoch in range(3):
+            data_iter.reset()
+            for i, batch in enumerate(data_iter):
+                if i % 7 == 0:
+                    time.sleep(0.002)
+                assert_almost_equal(batch.data[0].asnumpy(), ref[i])
+                # stop the second epoch early, the reset must not block
+                if epoch == 1 and i == 20:
+                    break
+
+def test_ImageRecordIter_pipeline():
+    get_cifar10()
+    def make_iter(**kwargs):
+        return mx.io.ImageRecordIter(
+            path_imgrec="data/cifar/train.rec",
+            mean_img="data/cifar/cifar10_mean.bin",
+            shuffle=False,
+            data_shape=(3, 28, 28),
+            batch_size=128,
+            prefetch_buffer=2,
+            **kwargs)
+    # the pipelined iterator returns the same batches, including the padded last one
+    for round_batch in [True, False]:
+        ref = make_iter(round_batch=round_batch)
+        pipe = make_iter(round_batch=round_batch, pipeline=True, decode_threads=3,
+                         augment_threads=2, batch_threads=2, pipeline_queue_size=16)
+        for epoch in range(2):
+            ref.reset()
+            pipe.reset()
+            num_batches = 0
+            for ref_batch, pipe_batch in zip(ref, pipe):
+                assert ref_batch.pad == pipe_batch.pad
+                valid = 128 - ref_batch.pad
+                assert_almost_equal(ref_batch.data[0].asnumpy()[:valid],
+                                    pipe_batch.data[0].asnumpy()[:valid])
+                assert_almost_equal(ref_batch.label[0].asnumpy()[:valid],
+                                    pipe_batch.label[0].asnumpy()[:valid])
+                num_batches += 1
+            assert num_batches == (50000 + 127) // 128
+            assert next(pipe, None) is None
+
 @unittest.skip("Flaky test: https://github.com/apache/incubator-mxnet/issues/11359")
 def test_ImageRecordIter_seed_augmentation():
     get_cifar10()
@@ -434,4 +587,5 @@ if __name__ == "__main__":
     test_LibSVMIter()
     test_NDArrayIter_csr()
     test_CSVIter()
+    test_ImageRecordIter_pipeline()
     test_ImageRecordIter_seed_augmentation()
@@ -327,6 +327,14 @@ def test_invalid_pull():
         check_invalid_key_types_single(kvs[i], single_keys[1 - i])
         check_invalid_key_types_list(kvs[i], list_keys[1 - i])
 
+@with_seed()
+def test_device_gradient_compression_type():
+    kv = mx.kv.create('device')
+    kv.set_gradient_compression({'type': '2bit', 'threshold': 0.5})
+    # only 2bit compression runs on gpus, so the other types are rejected up front
+    for params in [{'type': 'topk', 'ratio': 0.01}, {'type': '1bit'}, {'type': 'fp16'}]:
+        assertRaises(MXNetError, kv.set_gradient_compression, params)
+
 if __name__ == '__main__':
     import nose
     nose.runmodule()
@@ -64,6 +64,12 @@ def test_predictor():
     predictor_out2 = predictor.get_output(0)
     assert_almost_equal(out2.asnumpy(), predictor_out2, rtol=1e-5, atol=1e-6)
 
+    # reshape back to a cached shape, the cached executor still holds input1
+    predictor.reshape({'data':input1.shape})
+    predictor.forward()
+    predictor_out1 = predictor.get_output(0)
+    assert_almost_equal(out1.asnumpy(), predictor_out1, rtol=1e-5, atol=1e-6)
+
     # destroy the predictor
     del predictor
 